@@ -53,12 +53,17 @@ monster_respawn_wait = 45;   -- How many multiples of monster_interval after a z
                              -- it can be reanimated. (Trac #152)
 monster_wait_time = 200;  -- How long monsters can 'pause' for
 monster_wait_chance = 0.2; -- Chance of a monster 'pausing', if nobody can see it.
+monster_ai_batching = 1;  -- 1 = run all monster AIs from a single task (faster with many monsters); 0 = one task per monster
 flying_monster_targetting_offset = 450;   -- how close do you have to be (in 1000ths of a square) to a bat so that he can bite you.
 flying_monster_bite_wait = 400;           -- After attacking, bat will be unable to attack again for this long (in ms)
 walking_monster_damage_delay = 1000;      -- Timing for zombie animation (when a zombie is damaged) (in ms).
 
+-- Dungeon generation
+dungeon_layout_attempts = 4;   -- How many dungeon layouts to try at once (each on its own thread)?
+
 -- Timing stuff
 control_poll_interval = 50;    -- how frequently to poll the controller
+control_refresh_interval = 500; -- max time between re-checks of the available controls (normally they are re-checked only when something changes)
 player_task_interval = 200;    -- How often to recheck the mini-map?
 missile_check_interval = 12;   -- How often to check for missile collisions.
 
@@ -17,6 +17,16 @@ PROJECTS_MAIN = ['Coercri', 'guichan', 'KnightsClient', 'KnightsEngine',
                  'KnightsMain', 'KnightsServer', 'KnightsShared', 
                  'Misc', 'RStream']
 
+# The dedicated server only needs the parts of Coercri that do not
+# depend on SDL or FreeType (see server_src_filter below).
+PROJECTS_SERVER = ['Coercri', 'DedicatedServer', 'KnightsEngine',
+                   'KnightsServer', 'KnightsShared', 'Misc', 'RStream']
+
+# The benchmark program (not built by default; use "make bench").
+# It links against the same libraries as the dedicated server.
+PROJECTS_BENCH = ['Coercri', 'KnightsBench', 'KnightsClient', 'KnightsEngine',
+                  'KnightsServer', 'KnightsShared', 'Misc', 'RStream']
+
 
 # add project path to a path and normalize
 def add_proj_path(proj, p):
@@ -77,6 +87,13 @@ def get_srcs_with_inc_dirs(projects):
             srcs_with_inc_dirs.append((s, incdirs))
     return sorted(srcs_with_inc_dirs)
 
+# Returns True if a source file should be linked into the dedicated server
+def server_src_filter(srcname):
+    for prefix in ["src/coercri/gcn/", "src/coercri/gfx/", "src/coercri/sdl/"]:
+        if srcname.startswith(prefix):
+            return False
+    return True
+
 
 # Main program
 
@@ -99,7 +116,7 @@ else:
     online_platform_comment = "# Support for online platforms (like Steam) is disabled in this version\n# of Knights, hence ONLINE_PLATFORM_FLAGS is empty."
 
 # Calculate PROJECTS_ALL
-PROJECTS_ALL = list(set(PROJECTS_MAIN))
+PROJECTS_ALL = list(set(PROJECTS_MAIN + PROJECTS_SERVER + PROJECTS_BENCH))
 
 # Start printing the Makefile.
 print (f"""# Makefile for Knights
@@ -208,6 +225,8 @@ DATA_DIR = $(PREFIX)/share/knights
 BOOST_SUFFIX = 
 
 KNIGHTS_BINARY_NAME = knights
+KNIGHTS_SERVER_BINARY_NAME = knights_server
+KNIGHTS_BENCH_BINARY_NAME = knights_bench
 
 CC = gcc
 CXX = g++
@@ -235,6 +254,8 @@ INSTALL = install
 
 # Get all source files / include dirs
 srcs_with_inc_dirs_main = get_srcs_with_inc_dirs(PROJECTS_MAIN)
+srcs_with_inc_dirs_server = [x for x in get_srcs_with_inc_dirs(PROJECTS_SERVER) if server_src_filter(x[0])]
+srcs_with_inc_dirs_bench = [x for x in get_srcs_with_inc_dirs(PROJECTS_BENCH) if server_src_filter(x[0])]
 srcs_with_inc_dirs_all = get_srcs_with_inc_dirs(PROJECTS_ALL)
 
 # Print the lists of object files for main program.
@@ -244,10 +265,26 @@ for (sfile, incdirs) in srcs_with_inc_dirs_main:
 print()
 print()
 
+# Print the lists of object files for the dedicated server.
+print ("OFILES_SERVER =", end=" ")
+for (sfile, incdirs) in srcs_with_inc_dirs_server:
+    print (get_obj_file(sfile), end=" ")
+print()
+print()
+
+# Print the lists of object files for the benchmark program.
+print ("OFILES_BENCH =", end=" ")
+for (sfile, incdirs) in srcs_with_inc_dirs_bench:
+    print (get_obj_file(sfile), end=" ")
+print()
+print()
+
 # Print "build" target
 print ("""
 
-build: $(KNIGHTS_BINARY_NAME)
+build: $(KNIGHTS_BINARY_NAME) $(KNIGHTS_SERVER_BINARY_NAME)
+
+bench: $(KNIGHTS_BENCH_BINARY_NAME)
 
 """)
 
@@ -284,6 +321,18 @@ $(KNIGHTS_BINARY_NAME): $(OFILES_MAIN)
 \t$(CXX) $(LDFLAGS) -o $@ $^ """ + pkg_link_flags_knights + """ -lX11 $(BOOST_LIBS)
 """)
 
+# Print target for dedicated server binary
+print ("""
+$(KNIGHTS_SERVER_BINARY_NAME): $(OFILES_SERVER)
+\t$(CXX) $(LDFLAGS) -o $@ $^ $(LUA_LIBS) `pkg-config libenet --libs` $(BOOST_LIBS)
+""")
+
+# Print target for benchmark binary
+print ("""
+$(KNIGHTS_BENCH_BINARY_NAME): $(OFILES_BENCH)
+\t$(CXX) $(LDFLAGS) -o $@ $^ $(LUA_LIBS) `pkg-config libenet --libs` $(BOOST_LIBS)
+""")
+
 
 # Print "clean" target
 
@@ -293,15 +342,24 @@ clean:
 \trm -f $(OFILES_MAIN:.o=.d)
 \trm -f $(OFILES_MAIN:.o=.P)
 \trm -f $(KNIGHTS_BINARY_NAME)
+\trm -f $(OFILES_SERVER)
+\trm -f $(OFILES_SERVER:.o=.d)
+\trm -f $(OFILES_SERVER:.o=.P)
+\trm -f $(KNIGHTS_SERVER_BINARY_NAME)
+\trm -f $(OFILES_BENCH)
+\trm -f $(OFILES_BENCH:.o=.d)
+\trm -f $(OFILES_BENCH:.o=.P)
+\trm -f $(KNIGHTS_BENCH_BINARY_NAME)
 """)
 
 # Print the 'install' target.
 print ("""
 install: install_knights install_docs
 
-install_knights: $(KNIGHTS_BINARY_NAME)
+install_knights: $(KNIGHTS_BINARY_NAME) $(KNIGHTS_SERVER_BINARY_NAME)
 \t$(INSTALL) -m 755 -d $(BIN_DIR)
 \t$(INSTALL) -m 755 $(KNIGHTS_BINARY_NAME) $(BIN_DIR)
+\t$(INSTALL) -m 755 $(KNIGHTS_SERVER_BINARY_NAME) $(BIN_DIR)
 \t$(INSTALL) -m 755 -d $(DATA_DIR)""")
 
 for root, dirs, files in os.walk('knights_data'):
@@ -309,11 +367,6 @@ for root, dirs, files in os.walk('knights_data'):
         f2 = os.path.join(root, f)
         print ("\t$(INSTALL) -m 644 -D " + f2 + " $(DATA_DIR)" + f2[12:])
 
-for root, dirs, files in os.walk('knights_data/server'):
-    for f in files:
-        f2 = os.path.join(root, f)
-        print ("\t$(INSTALL) -m 644 -D " + f2 + " $(DATA_DIR)" + f2[12:])
-
 print()
 print ("install_docs:")
 print ("\t$(INSTALL) -m 755 -d $(DOC_DIR)")
@@ -345,7 +398,8 @@ print()
 # Print the 'uninstall' target
 print ("""
 uninstall:
-\trm -f $(BIN_DIR)/$(KNIGHTS_BINARY_NAME)""")
+\trm -f $(BIN_DIR)/$(KNIGHTS_BINARY_NAME)
+\trm -f $(BIN_DIR)/$(KNIGHTS_SERVER_BINARY_NAME)""")
 
 for root, dirs, files in os.walk('knights_data'):
     for f in files:
@@ -365,3 +419,5 @@ for root, dirs, files in os.walk('docs'):
 
 print()
 print ("-include $(OFILES_MAIN:.o=.P)")
+print ("-include $(OFILES_SERVER:.o=.P)")
+print ("-include $(OFILES_BENCH:.o=.P)")
@@ -0,0 +1,74 @@
+/*
+ * bench.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Helpers shared by the benchmarks in the "knights_bench" program.
+ *
+ * Each benchmark is a function that reads its settings from a
+ * BenchOptions (given on the command line as name=value pairs) and
+ * prints its results to stdout.
+ *
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+
+class BenchOptions {
+public:
+    // Parses "name=value" arguments. Throws std::runtime_error on bad syntax.
+    BenchOptions(int argc, char **argv);
+
+    int getInt(const std::string &name, int dflt) const;
+    std::string getString(const std::string &name, const std::string &dflt) const;
+
+    // Throws std::runtime_error if any option was given that the
+    // benchmark did not ask for (most likely a typo).
+    void checkAllUsed() const;
+
+private:
+    std::map<std::string, std::string> opts;
+    mutable std::set<std::string> used;
+};
+
+class BenchTimer {
+public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) { }
+    double elapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// The benchmarks themselves
+void BenchGame(const BenchOptions &opts);
+void BenchRoomMap(const BenchOptions &opts);
+void BenchTaskManager(const BenchOptions &opts);
+
+#endif
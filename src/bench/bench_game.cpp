@@ -0,0 +1,962 @@
+/*
+ * bench_game.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * "game" benchmark: a headless load test. Runs a KnightsServer in
+ * process, with a number of games each joined by "bot" clients
+ * (KnightsClient objects that press random controls), and reports
+ * the CPU time, Lua allocation and server-to-client traffic while
+ * the games are being played.
+ *
+ * No network is involved: the bots' output is handed straight to
+ * KnightsServer::receiveInputData, and the server's output straight
+ * to KnightsClient::receiveInputData. The bots run in the main
+ * thread; the games run on their own update threads, as usual.
+ *
+ * With oldobservers=1, every second observer announces itself as the
+ * oldest compatible client version, so the server sends it the older
+ * message encodings. The observers all see the same games, so this
+ * compares the encodings on the same session.
+ *
+ * With tasktrace=<file>, every TaskManager call made by the game is
+ * recorded and saved to the file, for the "tasks" benchmark.
+ *
+ * With loss=<percent> and/or rtt=<ms>, the server-to-client half of
+ * an ENet connection is emulated (see LossyLink), and the time taken
+ * for knight locations to show up on the clients' mini maps is
+ * reported. unreliable=0 sends everything on the reliable channel,
+ * as older clients (and non-ENet transports) do; this is the
+ * baseline to compare against.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "bench.hpp"
+#include "client_callbacks.hpp"
+#include "client_config.hpp"
+#include "dungeon_view.hpp"
+#include "find_knights_data_dir.hpp"
+#include "include_lua.hpp"
+#include "knights_callbacks.hpp"
+#include "knights_client.hpp"
+#include "knights_config.hpp"
+#include "knights_server.hpp"
+#include "mini_map.hpp"
+#include "player_id.hpp"
+#include "protocol.hpp"
+#include "read_module_names.hpp"
+#include "status_display.hpp"
+#include "task_manager.hpp"
+#include "task_trace.hpp"
+#include "user_control.hpp"
+#include "version.hpp"
+#include "vfs.hpp"
+
+// coercri includes
+#include "network/byte_buf.hpp"
+#include "timer/generic_timer.hpp"
+
+#include "boost/shared_ptr.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+    //
+    // Counts the memory allocated by one game's Lua state.
+    //
+
+    struct LuaAllocCounter {
+        lua_Alloc orig_func;
+        void *orig_ud;
+        std::atomic<long long> bytes;
+        std::atomic<long long> count;
+    };
+
+    void * CountingLuaAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
+    {
+        // (If ptr is null, osize is not a size but a type code.)
+        LuaAllocCounter *counter = static_cast<LuaAllocCounter*>(ud);
+        const size_t old_size = ptr ? osize : 0;
+        if (nsize > old_size) {
+            counter->bytes.fetch_add(nsize - old_size, std::memory_order_relaxed);
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+        }
+        return counter->orig_func(counter->orig_ud, ptr, osize, nsize);
+    }
+
+    // Installs a TaskTraceRecorder (if r is non-null) for as long as
+    // this object exists.
+    struct TraceRecorderGuard {
+        explicit TraceRecorderGuard(TaskTraceRecorder *r) { TaskManager::setTraceRecorder(r); }
+        ~TraceRecorderGuard() { TaskManager::setTraceRecorder(0); }
+    };
+
+    // Monster stress test: raises the base module's total monster limit
+    // to "limit" and places that many zombies in the dungeon when it is
+    // generated (on top of the usual initial monsters).
+    void SetupMonsterStress(lua_State *lua, int limit)
+    {
+        static const char *chunk =
+            "local n = ...\n"
+            "total_monster_limit = n\n"
+            "local orig_setup_monsters = setup_monsters\n"
+            "setup_monsters = function()\n"
+            "   orig_setup_monsters()\n"
+            "   kts.AddMonsters(m_zombie, n)\n"
+            "end\n";
+
+        if (luaL_loadstring(lua, chunk) != LUA_OK) {                 // [func]
+            throw std::runtime_error(lua_tostring(lua, -1));
+        }
+
+        // Run the chunk inside the base module's namespace
+        lua_getfield(lua, LUA_REGISTRYINDEX, "_MOD_REGISTRY");      // [func registry]
+        lua_getfield(lua, -1, "base");                               // [func registry entry]
+        if (!lua_istable(lua, -1)) throw std::runtime_error("base module not found");
+        lua_getfield(lua, -1, "ns");                                 // [func registry entry ns]
+        lua_setupvalue(lua, -4, 1);                                  // [func registry entry]
+        lua_pop(lua, 2);                                             // [func]
+
+        lua_pushinteger(lua, limit);                                 // [func limit]
+        if (lua_pcall(lua, 1, 0, 0) != LUA_OK) {
+            throw std::runtime_error(lua_tostring(lua, -1));
+        }
+    }
+
+
+    //
+    // The bots.
+    //
+
+    // Ignores everything except whether the bot's own knight (entity
+    // id 0) is approached (e.g. to a door or chest).
+    class BotDungeonView : public DungeonView {
+    public:
+        BotDungeonView() : knight_approached(false) { }
+        bool isKnightApproached() const { return knight_approached; }
+
+        void setCurrentRoom(int, int, int) override { }
+        void addEntity(unsigned short int id, int, int, MapHeight, MapDirection,
+                       const Anim *, const Overlay *, int, int, bool, bool, bool approached,
+                       int, MotionType motion_type, int, const PlayerID &) override
+        {
+            if (id == 0) knight_approached = approached || motion_type == MT_APPROACH;
+        }
+        void rmEntity(unsigned short int id) override { if (id == 0) knight_approached = false; }
+        void repositionEntity(unsigned short int, int, int) override { }
+        void moveEntity(unsigned short int id, MotionType motion_type, int, bool) override
+        {
+            if (id == 0) knight_approached = motion_type == MT_APPROACH;
+        }
+        void flipEntityMotion(unsigned short int, int, int) override { }
+        void setAnimData(unsigned short int, const Anim *, const Overlay *, int, int,
+                         bool, bool, bool) override { }
+        void setFacing(unsigned short int, MapDirection) override { }
+        void setSpeechBubble(unsigned short int, bool) override { }
+        void clearTiles(int, int, bool) override { }
+        void setTile(int, int, int, const Graphic *, boost::shared_ptr<const ColourChange>, bool) override { }
+        void setItem(int, int, const Graphic *, bool) override { }
+        void placeIcon(int, int, const Graphic *, int) override { }
+        void flashMessage(const LocalMsg &, int) override { }
+        void cancelContinuousMessages() override { }
+        void addContinuousMessage(const LocalMsg &) override { }
+
+    private:
+        bool knight_approached;
+    };
+
+    // Measures how long the knight locations sent by the server take
+    // to show up on a bot's mini maps. An update counts as shown when
+    // the client applies a location for that knight from a packet that
+    // the server sent at the same time or later (so if the update was
+    // lost, and a later packet makes good the loss, the wait for that
+    // packet is counted too).
+    class KnightLocationTracker {
+    public:
+        // tracking = the bot gets the locations on the unreliable channel.
+        explicit KnightLocationTracker(bool tracking) : measuring(false), tracking(tracking), send_time(0), now(0) { }
+
+        // Called as the server sends an unreliable packet (before it
+        // might be lost). Records the locations that have changed.
+        void onSendUnreliable(const std::vector<unsigned char> &data, int time)
+        {
+            Coercri::InputByteBuf buf(data);
+            int display = 0;
+            while (!buf.eof()) {
+                switch (buf.readUbyte()) {
+                case SERVER_SWITCH_PLAYER:
+                    display = buf.readUbyte();
+                    break;
+                case SERVER_MAP_KNIGHT_LOCATION:
+                    {
+                        const std::pair<int, int> key(display, buf.readUbyte());
+                        int locn = buf.readUbyte();
+                        if (locn != 255) locn = locn * 256 + buf.readUbyte();
+                        std::map<std::pair<int, int>, int>::iterator it = last_sent.find(key);
+                        if (it == last_sent.end() || it->second != locn) {
+                            last_sent[key] = locn;
+                            pending[key].push_back(time);
+                        }
+                    }
+                    break;
+                case SERVER_TIME_REMAINING:
+                    buf.readVarInt();
+                    break;
+                default:
+                    throw std::runtime_error("unexpected message on unreliable channel");
+                }
+            }
+        }
+
+        // Called before the client decodes a packet.
+        void setPacket(int packet_send_time, int time_now)
+        {
+            send_time = packet_send_time;
+            now = time_now;
+        }
+
+        // Called as the client applies a knight location.
+        void onApply(int display, int knight)
+        {
+            if (tracking) {
+                std::deque<int> &times = pending[std::make_pair(display, knight)];
+                while (!times.empty() && times.front() <= send_time) {
+                    if (measuring) latencies.push_back(now - times.front());
+                    times.pop_front();
+                }
+            } else {
+                // Every update is sent once, and arrives (eventually)
+                if (measuring) latencies.push_back(now - send_time);
+            }
+        }
+
+        int getNumPending() const
+        {
+            int n = 0;
+            for (std::map<std::pair<int, int>, std::deque<int> >::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+                n += int(it->second.size());
+            }
+            return n;
+        }
+
+        bool measuring;
+        std::vector<int> latencies;   // in ms
+
+    private:
+        bool tracking;
+        int send_time, now;
+        std::map<std::pair<int, int>, int> last_sent;   // key = (display, knight), value = encoded location
+        std::map<std::pair<int, int>, std::deque<int> > pending;   // send times of updates not shown yet
+    };
+
+    class TrackingMiniMap : public MiniMap {
+    public:
+        TrackingMiniMap(KnightLocationTracker &tracker, int display) : tracker(tracker), display(display) { }
+        void setSize(int, int) override { }
+        void setColour(int, int, MiniMapColour) override { }
+        void wipeMap() override { }
+        void mapKnightLocation(int n, int, int) override { tracker.onApply(display, n); }
+        void mapItemLocation(int, int, bool) override { }
+    private:
+        KnightLocationTracker &tracker;
+        int display;
+    };
+
+    // Emulates the server-to-client direction of an ENet connection.
+    // Each packet is lost with the given probability, and otherwise
+    // arrives rtt/2 after it was sent. A lost reliable packet is sent
+    // again after a timeout (2*rtt at first, doubling each time, as
+    // ENet does), and holds up all the later reliable packets, as the
+    // channel is ordered. A lost unreliable packet is just lost.
+    class LossyLink {
+    public:
+        struct Packet {
+            std::vector<unsigned char> data;
+            bool reliable;
+            int send_time;
+            int arrival_time;
+        };
+
+        LossyLink(int loss_percent, int rtt, unsigned int seed)
+            : loss_percent(loss_percent), rtt(rtt), rng(seed), last_reliable_arrival(0) { }
+
+        void send(const std::vector<unsigned char> &data, bool reliable, int now)
+        {
+            Packet p;
+            p.data = data;
+            p.reliable = reliable;
+            p.send_time = now;
+            if (reliable) {
+                int timeout = std::max(2 * rtt, 1);
+                while (isLost()) {
+                    now += timeout;
+                    timeout *= 2;
+                }
+                p.arrival_time = std::max(now + rtt / 2, last_reliable_arrival);
+                last_reliable_arrival = p.arrival_time;
+                reliable_queue.push_back(p);
+            } else if (!isLost()) {
+                p.arrival_time = now + rtt / 2;
+                unreliable_queue.push_back(p);
+            }
+        }
+
+        // Gets the next packet (from either channel) that has arrived by "now".
+        bool receive(int now, Packet &p)
+        {
+            std::deque<Packet> *q = nullptr;
+            if (!reliable_queue.empty() && reliable_queue.front().arrival_time <= now) q = &reliable_queue;
+            if (!unreliable_queue.empty() && unreliable_queue.front().arrival_time <= now
+            && (!q || unreliable_queue.front().arrival_time < q->front().arrival_time)) {
+                q = &unreliable_queue;
+            }
+            if (!q) return false;
+            p = q->front();
+            q->pop_front();
+            return true;
+        }
+
+    private:
+        bool isLost() { return int(rng() % 100) < loss_percent; }
+
+        int loss_percent, rtt;
+        std::mt19937 rng;
+        std::deque<Packet> reliable_queue, unreliable_queue;   // packets in flight
+        int last_reliable_arrival;
+    };
+
+    class NullStatusDisplay : public StatusDisplay {
+    public:
+        void setBackpack(int, const Graphic *, const Graphic *, int, int, const LocalKey &) override { }
+        void addSkull() override { }
+        void setHealth(int) override { }
+        void setPotionMagic(PotionMagic, bool) override { }
+        void setQuestHints(const std::vector<LocalMsg> &) override { }
+    };
+
+    class Bot : public ClientCallbacks, public KnightsCallbacks {
+    public:
+        Bot(const std::string &name, const std::string &game, bool observer, int num_observers,
+            const std::vector<std::pair<int, int> > &menu, unsigned int seed, int version,
+            bool unreliable, int loss_percent, int rtt)
+            : client(true), conn(nullptr), version(version),
+              unreliable(unreliable && version >= UNRELIABLE_CHANNEL_VERSION_NUM),
+              link(loss_percent, rtt, seed),
+              tracker(this->unreliable),
+              bytes_received(0), largest_packet(0), first_second_bytes(0),
+              name(name), game(game), observer(observer),
+              num_observers(num_observers),
+              menu(menu), rng(seed),
+              sent_version(false), sent_join(false), join_accepted(false), sent_ready(false),
+              start_received(false), in_game(false), start_time(0), next_action_time(0)
+        {
+            client.setClientCallbacks(this);
+            client.setKnightsCallbacks(this);
+            client.setMessageByteCounts(&msg_bytes);
+        }
+
+        // Sends any commands that are due.
+        void poll(int now)
+        {
+            if (!sent_join) {
+                client.setPlayerIdAndControls(PlayerID(Coercri::UTF8String::fromUTF8(name)), true);
+                client.joinGame(game);
+                sent_join = true;
+            }
+
+            // Players wait for the observers to become observers, as the
+            // game would otherwise wait for them to be ready as well.
+            if (join_accepted && !sent_ready && (observer || int(observers.size()) >= num_observers)) {
+                if (observer) {
+                    client.setObsFlag(true);
+                } else {
+                    for (std::vector<std::pair<int, int> >::const_iterator it = menu.begin(); it != menu.end(); ++it) {
+                        client.setMenuSelection(it->first, it->second);
+                    }
+                    client.setReady(true);
+                }
+                sent_ready = true;
+            }
+
+            if (start_received) {
+                client.finishedLoading();
+                start_received = false;
+                in_game = true;
+                start_time = now;
+                next_action_time = now;
+            }
+
+            if (in_game && !observer && config && now >= next_action_time) {
+                next_action_time = now + pressRandomControl();
+            }
+        }
+
+        // Gets the data to send to the server. The first data sent
+        // starts with the version string, which is changed here if the
+        // bot is pretending to be an older client.
+        void getOutputData(std::vector<unsigned char> &data)
+        {
+            client.getOutputData(data);
+            if (!sent_version && !data.empty()) {
+                const std::string current = "Knights/" KNIGHTS_VERSION;
+                std::vector<unsigned char>::iterator it = std::search(data.begin(), data.end(), current.begin(), current.end());
+                if (it == data.end()) throw std::runtime_error(name + ": version string not found");
+                char digits[4];
+                std::snprintf(digits, sizeof(digits), "%03d", version);
+                std::copy(digits, digits + 3, it + current.size() - 3);
+                sent_version = true;
+            }
+        }
+
+        // Passes a packet from the server to the KnightsClient.
+        void receive(const LossyLink::Packet &packet, int now)
+        {
+            const std::vector<unsigned char> &data = packet.data;
+            bytes_received += data.size();
+            if (in_game) {
+                largest_packet = std::max(largest_packet, data.size());
+                if (now - start_time < 1000) first_second_bytes += data.size();
+            }
+            tracker.setPacket(packet.send_time, now);
+            if (packet.reliable) {
+                if (tracker.measuring) reliable_latencies.push_back(now - packet.send_time);
+                client.receiveInputData(data);
+            } else {
+                client.receiveUnreliableInputData(data);
+            }
+        }
+
+        bool isInGame() const { return in_game; }
+        bool isObserver() const { return observer; }
+        boost::shared_ptr<const ClientConfig> getConfig() const { return config; }
+
+        KnightsClient client;
+        ServerConnection *conn;
+        const int version;   // protocol version announced to the server
+        const bool unreliable;   // true if the server sends us knight locations on the unreliable channel
+        LossyLink link;
+        KnightLocationTracker tracker;
+        std::vector<int> reliable_latencies;   // in ms
+
+        // Statistics
+        long long bytes_received;
+        size_t largest_packet;
+        long long first_second_bytes;
+        std::vector<long long> msg_bytes;   // bytes received, by message code
+
+        // ClientCallbacks
+        void connectionLost() override { throw std::runtime_error(name + ": connection lost"); }
+        void connectionFailed() override { throw std::runtime_error(name + ": connection failed"); }
+        void serverError(const LocalMsg &error) override
+        {
+            throw std::runtime_error(name + ": server error: " + error.key.getKey());
+        }
+        void connectionAccepted(int) override { }
+        void joinGameAccepted(boost::shared_ptr<const ClientConfig> conf,
+                              const std::vector<std::string> &, int,
+                              const std::vector<PlayerID> &, const std::vector<bool> &,
+                              const std::vector<int> &, const std::vector<PlayerID> &obs,
+                              bool) override
+        {
+            observers.insert(obs.begin(), obs.end());
+            config = conf;
+            join_accepted = true;
+        }
+        void playerConnected(const PlayerID &) override { }
+        void playerDisconnected(const PlayerID &) override { }
+        void updateGame(const std::string &, int, int, GameStatus) override { }
+        void dropGame(const std::string &) override { }
+        void updatePlayer(const PlayerID &, const std::string &, bool) override { }
+        void playerList(const std::vector<ClientPlayerInfo> &) override { }
+        void setTimeRemaining(int) override { }
+        void playerIsReadyToEnd(const PlayerID &) override { }
+        void playerVotedToRestart(const PlayerID &, uint8_t, int) override { }
+        void leaveGame() override { }
+        void setMenuSelection(int, int, const std::vector<int> &) override { }
+        void setQuestDescription(const std::vector<LocalMsg> &) override { }
+        void setItemHelp(int, std::vector<LocalMsg>) override { }
+        void startGame(int, bool, const std::vector<PlayerID> &, bool) override { start_received = true; }
+        void gotoMenu() override { in_game = false; }
+        void playerJoinedThisGame(const PlayerID &id, bool obs_flag, int) override
+        {
+            if (obs_flag) observers.insert(id);
+        }
+        void playerLeftThisGame(const PlayerID &, bool) override { }
+        void setPlayerHouseColour(const PlayerID &, int) override { }
+        void setAvailableHouseColours(const std::vector<Coercri::Color> &) override { }
+        void setReady(const PlayerID &, bool) override { }
+        void deactivateReadyFlags() override { }
+        void setObsFlag(const PlayerID &id, bool obs_flag) override
+        {
+            if (obs_flag) observers.insert(id);
+            else observers.erase(id);
+        }
+        void chat(const PlayerID &, const Coercri::UTF8String &) override { }
+        void announcementLoc(const LocalMsg &, bool) override { }
+
+        // KnightsCallbacks
+        DungeonView & getDungeonView(int) override { return dungeon_view; }
+        MiniMap & getMiniMap(int display) override
+        {
+            std::unique_ptr<TrackingMiniMap> &mm = mini_maps[display];
+            if (!mm) mm.reset(new TrackingMiniMap(tracker, display));
+            return *mm;
+        }
+        StatusDisplay & getStatusDisplay(int) override { return status_display; }
+        void playSound(int, const Sound &, int) override { }
+        void winGame(int) override { }
+        void loseGame(int) override { }
+        void setAvailableControls(int, const std::vector<std::pair<const UserControl*, bool> > &ctrls) override
+        {
+            // Only use controls from the Action Menu (this excludes suicide)
+            available_controls.clear();
+            for (std::vector<std::pair<const UserControl*, bool> >::const_iterator it = ctrls.begin(); it != ctrls.end(); ++it) {
+                const UserControl *ctrl = it->first;
+                if (!ctrl->getSuicideKey() && (ctrl->getMenuSpecial() & UserControl::MS_NO_MENU) == 0) {
+                    available_controls.push_back(ctrl);
+                }
+            }
+        }
+        void setMenuHighlight(int, const UserControl *) override { }
+        void flashScreen(int, int) override { }
+        void gameMsgLoc(int, const LocalMsg &, bool) override { }
+        void popUpWindow(const std::vector<TutorialWindow> &) override { }
+        void onElimination(int) override { }
+        void disableView(int) override { }
+        void goIntoObserverMode(int, const std::vector<PlayerID> &) override { }
+
+    private:
+        // Sends a random control, and returns how long (in ms) to hold it for.
+        int pressRandomControl()
+        {
+            // Mostly walk around, sometimes attack, and sometimes use
+            // whatever else is available (open doors, pick up items...)
+            const int r = int(rng() % 10);
+            if (r < 3 && !available_controls.empty()) {
+                client.sendControl(0, available_controls[rng() % available_controls.size()]);
+                return 100 + int(rng() % 200);
+            } else if (r < 4) {
+                client.sendControl(0, config->standard_controls.at(SC_ATTACK + int(rng() % 4)));
+                return 200 + int(rng() % 300);
+            } else if (dungeon_view.isKnightApproached()) {
+                // Step back, so that the knight can move again
+                client.sendControl(0, config->standard_controls.at(SC_WITHDRAW));
+                return 100 + int(rng() % 200);
+            } else {
+                client.sendControl(0, config->standard_controls.at(SC_MOVE + int(rng() % 4)));
+                return 300 + int(rng() % 700);
+            }
+        }
+
+        std::string name, game;
+        bool observer;
+        int num_observers;
+        std::set<PlayerID> observers;
+        std::vector<std::pair<int, int> > menu;
+        std::mt19937 rng;
+
+        bool sent_version, sent_join, join_accepted, sent_ready, start_received, in_game;
+        int start_time, next_action_time;
+
+        boost::shared_ptr<const ClientConfig> config;
+        std::vector<const UserControl *> available_controls;
+
+        BotDungeonView dungeon_view;
+        std::map<int, std::unique_ptr<TrackingMiniMap> > mini_maps;
+        NullStatusDisplay status_display;
+    };
+
+
+    // Parses "item:choice,item:choice,..." (menu item and choice numbers
+    // are as shown by showmenu=1).
+    std::vector<std::pair<int, int> > ParseMenu(const std::string &s)
+    {
+        std::vector<std::pair<int, int> > result;
+        std::istringstream str(s);
+        std::string entry;
+        while (std::getline(str, entry, ',')) {
+            const size_t colon = entry.find(':');
+            if (colon == std::string::npos) throw std::runtime_error("Bad menu setting: " + entry);
+            try {
+                result.push_back(std::make_pair(std::stoi(entry.substr(0, colon)), std::stoi(entry.substr(colon + 1))));
+            } catch (std::exception &) {
+                throw std::runtime_error("Bad menu setting: " + entry);
+            }
+        }
+        return result;
+    }
+
+    void PrintMenu(const Menu &menu)
+    {
+        std::cout << "Menu items (use menu=item:choice,...):\n";
+        for (int i = 0; i < menu.getNumItems(); ++i) {
+            const MenuItem &item = menu.getItem(i);
+            std::cout << "  " << i << ": " << item.getTitleKey().getKey();
+            if (item.isNumeric()) {
+                std::cout << " (numeric)";
+            } else {
+                std::cout << " (" << item.getNumChoices() << " choices)";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    // Groups the server messages for the traffic breakdown.
+    enum TrafficKind { TK_ROOM_SQUARES, TK_MINI_MAP_COLOURS, TK_MINI_MAP_MARKERS, TK_OTHER, NUM_TRAFFIC_KINDS };
+    const char * const TRAFFIC_KIND_NAMES[NUM_TRAFFIC_KINDS] = {
+        "room squares", "mini map colours", "mini map markers", "other"
+    };
+
+    TrafficKind GetTrafficKind(int msg_code)
+    {
+        switch (msg_code) {
+        case SERVER_CLEAR_TILES:
+        case SERVER_SET_TILE:
+        case SERVER_SET_ITEM:
+        case SERVER_SET_ITEM_NULL:
+        case SERVER_SET_SQUARES:
+            return TK_ROOM_SQUARES;
+        case SERVER_SET_MAP_SIZE:
+        case SERVER_SET_COLOUR:
+        case SERVER_WIPE_MAP:
+        case SERVER_SET_COLOURS_PACKED:
+            return TK_MINI_MAP_COLOURS;
+        case SERVER_MAP_KNIGHT_LOCATION:
+        case SERVER_MAP_ITEM_LOCATION:
+            return TK_MINI_MAP_MARKERS;
+        default:
+            return TK_OTHER;
+        }
+    }
+
+    // Traffic totals for one group of bots (the players, or the
+    // observers using one protocol version).
+    struct TrafficGroup {
+        TrafficGroup() : num_bots(0), kind_bytes(), total_bytes(0), largest_packet(0), first_second(0) { }
+        int num_bots;
+        long long kind_bytes[NUM_TRAFFIC_KINDS];
+        long long total_bytes;
+        size_t largest_packet;
+        long long first_second;
+    };
+
+    // Moves data between the bots and the server, and lets the bots
+    // send their commands.
+    void Exchange(KnightsServer &server, std::vector<std::unique_ptr<Bot> > &bots,
+                  int now, std::vector<unsigned char> &buf, double &decode_ms)
+    {
+        for (std::unique_ptr<Bot> &bot : bots) {
+            bot->poll(now);
+            bot->getOutputData(buf);
+            if (!buf.empty()) server.receiveInputData(*bot->conn, buf);
+        }
+        for (std::unique_ptr<Bot> &bot : bots) {
+            server.getOutputData(*bot->conn, buf);
+            if (!buf.empty()) bot->link.send(buf, true, now);
+            server.getUnreliableOutputData(*bot->conn, buf);
+            if (!buf.empty()) {
+                bot->tracker.onSendUnreliable(buf, now);
+                bot->link.send(buf, false, now);
+            }
+
+            LossyLink::Packet packet;
+            while (bot->link.receive(now, packet)) {
+                BenchTimer timer;
+                bot->receive(packet, now);
+                decode_ms += timer.elapsedMs();
+            }
+        }
+    }
+
+    // Prints the mean, 95th percentile and maximum of a list of times.
+    void PrintLatencies(const std::string &title, std::vector<int> v)
+    {
+        std::cout << "  " << title << std::string(17 - title.size(), ' ');
+        if (v.empty()) {
+            std::cout << "(none)\n";
+            return;
+        }
+        std::sort(v.begin(), v.end());
+        double total = 0;
+        for (int x : v) total += x;
+        std::cout << "mean " << (total / v.size()) << " ms, p95 " << v[v.size() * 95 / 100]
+                  << " ms, max " << v.back() << " ms (" << v.size() << ")\n";
+    }
+}
+
+void BenchGame(const BenchOptions &opts)
+{
+    const int num_games = opts.getInt("games", 1);
+    const int num_players = opts.getInt("players", 2);
+    const int num_observers = opts.getInt("observers", 0);
+    const int seconds = opts.getInt("seconds", 60);
+    const int seed = opts.getInt("seed", 1);
+    const std::vector<std::pair<int, int> > menu = ParseMenu(opts.getString("menu", ""));
+    const bool show_menu = opts.getInt("showmenu", 0) != 0;
+    const bool run_lua_gc = opts.getInt("luagc", 1) != 0;
+    const int num_monsters = opts.getInt("monsters", 0);
+    const bool old_observers = opts.getInt("oldobservers", 0) != 0;
+    const std::string task_trace_file = opts.getString("tasktrace", "");
+    const int loss_percent = opts.getInt("loss", 0);
+    const int rtt = opts.getInt("rtt", 0);
+    const bool use_unreliable = opts.getInt("unreliable", 1) != 0;
+    const std::filesystem::path data_dir = opts.getString("datadir", FindKnightsDataDir().string());
+    opts.checkAllUsed();
+
+    if (num_games < 1 || num_players < 1 || num_observers < 0 || seconds < 1
+    || loss_percent < 0 || loss_percent >= 100 || rtt < 0) {
+        throw std::runtime_error("invalid options");
+    }
+    // The recorder cannot tell apart calls from games running at the same time
+    if (!task_trace_file.empty() && num_games != 1) {
+        throw std::runtime_error("tasktrace requires games=1");
+    }
+
+    std::cout << "games=" << num_games << " players=" << num_players << " observers=" << num_observers
+              << " seconds=" << seconds << " seed=" << seed << "\n";
+
+    boost::shared_ptr<Coercri::Timer> timer(new Coercri::GenericTimer);
+    const unsigned int start_msec = timer->getMsec();
+
+    // Load the modules (as the dedicated server does)
+    VFS root_vfs;
+    root_vfs.add(data_dir / "modules", "");
+    std::vector<std::string> module_names = ReadModuleNames(root_vfs, "modules.txt");
+    VFS module_vfs;
+    for (const std::string &name : module_names) {
+        module_vfs.add(data_dir / "modules" / name, name);
+    }
+
+    std::vector<std::unique_ptr<LuaAllocCounter> > lua_counters;
+    std::vector<std::unique_ptr<Bot> > bots;
+    std::vector<unsigned char> buf;
+    double decode_ms = 0;
+
+    TaskTraceWriter trace_writer;
+    TraceRecorderGuard trace_guard(task_trace_file.empty() ? 0 : &trace_writer);
+
+    {
+        KnightsServer server(timer, false, "", "");
+
+        for (int g = 0; g < num_games; ++g) {
+            const std::string game_name = "Game " + std::to_string(g + 1);
+            boost::shared_ptr<KnightsConfig> config(new KnightsConfig(module_vfs, module_names, false));
+
+            // Count Lua allocations (the game has not started running yet,
+            // so it is safe to replace the allocator here)
+            lua_State *lua = config->getLuaState().get();
+            std::unique_ptr<LuaAllocCounter> counter(new LuaAllocCounter);
+            counter->orig_func = lua_getallocf(lua, &counter->orig_ud);
+            counter->bytes = 0;
+            counter->count = 0;
+            lua_setallocf(lua, &CountingLuaAlloc, counter.get());
+
+            // With luagc=0 the Lua garbage collector never runs, so
+            // comparing the CPU time against a normal run gives the
+            // time spent in garbage collection.
+            if (!run_lua_gc) lua_gc(lua, LUA_GCSTOP);
+            if (num_monsters > 0) SetupMonsterStress(lua, num_monsters);
+            lua_counters.push_back(std::move(counter));
+
+            server.startNewGame(config, game_name);
+
+            for (int p = 0; p < num_players + num_observers; ++p) {
+                const bool obs = p >= num_players;
+                const std::string bot_name = (obs ? "Observer " : "Bot ") + std::to_string(g + 1) + "." + std::to_string(p + 1);
+                // only the first player in each game changes the menu
+                const std::vector<std::pair<int, int> > bot_menu = (p == 0 ? menu : std::vector<std::pair<int, int> >());
+                // with oldobservers=1, every second observer is an "old" client
+                const int version = (old_observers && obs && (p - num_players) % 2 == 1) ? COMPATIBLE_VERSION_NUM : KNIGHTS_VERSION_NUM;
+                std::unique_ptr<Bot> bot(new Bot(bot_name, game_name, obs, num_observers, bot_menu, seed * 1000 + g * 100 + p, version,
+                                                 use_unreliable, loss_percent, rtt));
+                bot->conn = &server.newClientConnection("", PlayerID());
+                if (use_unreliable) server.enableUnreliableOutput(*bot->conn);
+                bots.push_back(std::move(bot));
+            }
+        }
+
+        // Wait for all the games to start
+        const int STARTUP_TIMEOUT_MS = 120000;
+        while (true) {
+            const int now = int(timer->getMsec() - start_msec);
+            Exchange(server, bots, now, buf, decode_ms);
+            bool all_started = true;
+            for (const std::unique_ptr<Bot> &bot : bots) {
+                if (!bot->isInGame()) all_started = false;
+            }
+            if (all_started) break;
+            if (show_menu && bots[0]->getConfig()) break;
+            if (now > STARTUP_TIMEOUT_MS) throw std::runtime_error("timed out waiting for games to start");
+            timer->sleepMsec(1);
+        }
+
+        if (show_menu) {
+            PrintMenu(*bots[0]->getConfig()->menu);
+            for (std::unique_ptr<Bot> &bot : bots) {
+                server.connectionClosed(*bot->conn);
+            }
+            return;
+        }
+
+        const int startup_ms = int(timer->getMsec() - start_msec);
+
+        // Measure
+        std::vector<long long> lua_bytes_start, lua_count_start;
+        for (const std::unique_ptr<LuaAllocCounter> &c : lua_counters) {
+            lua_bytes_start.push_back(c->bytes.load());
+            lua_count_start.push_back(c->count.load());
+        }
+        long long bytes_start = 0;
+        std::vector<std::vector<long long> > msg_bytes_start;
+        for (const std::unique_ptr<Bot> &bot : bots) {
+            bytes_start += bot->bytes_received;
+            msg_bytes_start.push_back(bot->msg_bytes);
+            bot->tracker.measuring = true;
+        }
+        decode_ms = 0;
+
+        const std::clock_t cpu_start = std::clock();
+        BenchTimer wall;
+        while (wall.elapsedMs() < seconds * 1000.0) {
+            const int now = int(timer->getMsec() - start_msec);
+            Exchange(server, bots, now, buf, decode_ms);
+            timer->sleepMsec(5);
+        }
+        const double cpu_ms = double(std::clock() - cpu_start) * 1000.0 / CLOCKS_PER_SEC;
+        const double wall_ms = wall.elapsedMs();
+
+        long long lua_bytes = 0, lua_count = 0;
+        for (size_t i = 0; i < lua_counters.size(); ++i) {
+            lua_bytes += lua_counters[i]->bytes.load() - lua_bytes_start[i];
+            lua_count += lua_counters[i]->count.load() - lua_count_start[i];
+        }
+        long long bytes = -bytes_start;
+        size_t largest_packet = 0;
+        long long first_second = 0;
+        for (const std::unique_ptr<Bot> &bot : bots) {
+            bytes += bot->bytes_received;
+            largest_packet = std::max(largest_packet, bot->largest_packet);
+            first_second = std::max(first_second, bot->first_second_bytes);
+        }
+
+        const double secs = wall_ms / 1000.0;
+        std::cout << std::fixed << std::setprecision(1)
+                  << "startup            " << startup_ms << " ms\n"
+                  << "process cpu        " << cpu_ms << " ms (" << (100.0 * cpu_ms / wall_ms) << "% of one core)\n"
+                  << "  bot decoding     " << decode_ms << " ms\n"
+                  << "lua allocation     " << (lua_bytes / secs / num_games / 1024.0) << " KB/s per game, "
+                  << (lua_count / secs / num_games) << " allocs/s per game\n"
+                  << "server to clients  " << (bytes / secs / bots.size()) << " bytes/s per client\n"
+                  << "largest packet     " << largest_packet << " bytes (after the game started)\n"
+                  << "first second       " << first_second << " bytes (most received by one client"
+                  << " in the first second of a game)\n";
+
+        // Break the traffic down by message kind, for the players and
+        // for the observers of each protocol version
+        std::map<int, TrafficGroup> groups;   // key = observer version, or 0 for players
+        for (size_t i = 0; i < bots.size(); ++i) {
+            const Bot &bot = *bots[i];
+            TrafficGroup &group = groups[bot.isObserver() ? bot.version : 0];
+            ++group.num_bots;
+            for (int code = 0; code < 256; ++code) {
+                const long long b = bot.msg_bytes[code] - msg_bytes_start[i][code];
+                group.kind_bytes[GetTrafficKind(code)] += b;
+                group.total_bytes += b;
+            }
+            group.largest_packet = std::max(group.largest_packet, bot.largest_packet);
+            group.first_second = std::max(group.first_second, bot.first_second_bytes);
+        }
+
+        std::cout << "traffic breakdown  ";
+        for (std::map<int, TrafficGroup>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+            std::ostringstream name;
+            if (it->first == 0) name << "players";
+            else name << "obs v" << std::setw(3) << std::setfill('0') << it->first;
+            std::cout << std::setw(12) << name.str();
+        }
+        std::cout << "\n";
+        for (int k = 0; k <= NUM_TRAFFIC_KINDS; ++k) {
+            const std::string kind = k < NUM_TRAFFIC_KINDS ? TRAFFIC_KIND_NAMES[k] : "total";
+            std::cout << "  " << kind << std::string(17 - kind.size(), ' ');
+            for (std::map<int, TrafficGroup>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+                const long long b = k < NUM_TRAFFIC_KINDS ? it->second.kind_bytes[k] : it->second.total_bytes;
+                std::cout << std::setw(12) << (b / secs / it->second.num_bots);
+            }
+            std::cout << (k == 0 ? "   (bytes/s per client)\n" : "\n");
+        }
+        std::cout << "  largest packet   ";
+        for (std::map<int, TrafficGroup>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+            std::cout << std::setw(12) << it->second.largest_packet;
+        }
+        std::cout << "\n  first second     ";
+        for (std::map<int, TrafficGroup>::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+            std::cout << std::setw(12) << it->second.first_second;
+        }
+        std::cout << "\n";
+
+        if (loss_percent > 0 || rtt > 0) {
+            std::vector<int> knight_latencies, reliable_latencies;
+            int num_pending = 0;
+            for (const std::unique_ptr<Bot> &bot : bots) {
+                knight_latencies.insert(knight_latencies.end(), bot->tracker.latencies.begin(), bot->tracker.latencies.end());
+                reliable_latencies.insert(reliable_latencies.end(), bot->reliable_latencies.begin(), bot->reliable_latencies.end());
+                num_pending += bot->tracker.getNumPending();
+            }
+            std::cout << "emulated link      loss=" << loss_percent << "% rtt=" << rtt << " ms, knight locations sent "
+                      << (use_unreliable ? "unreliable" : "reliable") << "\n";
+            PrintLatencies("knight locations", knight_latencies);
+            if (num_pending > 0) std::cout << "    (" << num_pending << " still not shown at the end)\n";
+            PrintLatencies("reliable packets", reliable_latencies);
+        }
+
+        for (std::unique_ptr<Bot> &bot : bots) {
+            server.connectionClosed(*bot->conn);
+        }
+    }
+
+    // The KnightsConfigs (and their Lua states) are gone now, so the
+    // counters can be freed.
+    lua_counters.clear();
+
+    if (!task_trace_file.empty()) {
+        trace_writer.save(task_trace_file);
+        std::cout << "task trace         " << trace_writer.getNumEvents() << " events written to " << task_trace_file << "\n";
+    }
+}
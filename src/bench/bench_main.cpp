@@ -0,0 +1,137 @@
+/*
+ * bench_main.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Main program for "knights_bench".
+ *
+ * This is a development tool, not part of the game: it runs
+ * micro-benchmarks of individual engine and server components, so
+ * that optimisations can be compared against the code they replaced.
+ * It is built by "make bench" (it is not installed).
+ *
+ * Usage: knights_bench <benchmark> [name=value ...]
+ *
+ */
+
+#include "misc.hpp"
+
+#include "bench.hpp"
+#include "rng.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    struct BenchInfo {
+        const char *name;
+        void (*func)(const BenchOptions &);
+        const char *description;
+    };
+
+    const BenchInfo g_benchmarks[] = {
+        { "game", &BenchGame,
+          "headless load test with bot clients (games=, players=, observers=, seconds=, seed=, menu=, showmenu=, luagc=, monsters=, oldobservers=, tasktrace=, loss=, rtt=, unreliable=, datadir=)" },
+        { "rooms", &BenchRoomMap,
+          "RoomMap queries: lookup grid vs. linear scan (width=, height=, rooms=, pairs=, passes=, seed=)" },
+        { "tasks", &BenchTaskManager,
+          "TaskManager queue: replays a task trace through the heap and the old tree queue (trace=, repeat=)" },
+    };
+
+    void PrintUsage(const char *prog)
+    {
+        std::cout << "Usage: " << prog << " <benchmark> [name=value ...]\n";
+        std::cout << "\n";
+        std::cout << "Benchmarks:\n";
+        for (const BenchInfo &b : g_benchmarks) {
+            std::cout << "  " << b.name << ": " << b.description << "\n";
+        }
+    }
+}
+
+BenchOptions::BenchOptions(int argc, char **argv)
+{
+    for (int i = 0; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            throw std::runtime_error("Expected name=value, got: " + arg);
+        }
+        opts[arg.substr(0, eq)] = arg.substr(eq + 1);
+    }
+}
+
+int BenchOptions::getInt(const std::string &name, int dflt) const
+{
+    used.insert(name);
+    std::map<std::string, std::string>::const_iterator it = opts.find(name);
+    if (it == opts.end()) return dflt;
+    try {
+        return std::stoi(it->second);
+    } catch (std::exception &) {
+        throw std::runtime_error("Bad integer value for " + name + ": " + it->second);
+    }
+}
+
+std::string BenchOptions::getString(const std::string &name, const std::string &dflt) const
+{
+    used.insert(name);
+    std::map<std::string, std::string>::const_iterator it = opts.find(name);
+    return it == opts.end() ? dflt : it->second;
+}
+
+void BenchOptions::checkAllUsed() const
+{
+    for (std::map<std::string, std::string>::const_iterator it = opts.begin(); it != opts.end(); ++it) {
+        if (used.find(it->first) == used.end()) {
+            throw std::runtime_error("Unknown option: " + it->first);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string name = argv[1];
+    for (const BenchInfo &b : g_benchmarks) {
+        if (name == b.name) {
+            try {
+                g_rng.initialize();
+                BenchOptions opts(argc - 2, argv + 2);
+                b.func(opts);
+                return 0;
+            } catch (std::exception &e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    PrintUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * bench_room_map.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * "rooms" benchmark: RoomMap queries, using the lookup grid built by
+ * RoomMap::doneAddingRooms, compared against the linear scan over all
+ * rooms that RoomMap used before the grid was added.
+ *
+ * The dungeon is a width x height rectangle split into the requested
+ * number of rooms by repeatedly cutting the largest room in two
+ * (neighbouring rooms share their border squares, as in a real
+ * dungeon). The query mix follows the game's callers: getRoomAtPos
+ * and isCorner on every square (as SenseItemsTask and the view code
+ * do), and inSameRoom on random pairs of nearby squares (as
+ * FindClosestKnight does for every monster).
+ *
+ */
+
+#include "misc.hpp"
+
+#include "bench.hpp"
+#include "map_support.hpp"
+#include "room_map.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    struct Rect {
+        int x, y, w, h;
+    };
+
+    // The original RoomMap query code (linear search), for comparison.
+    class LinearRoomMap {
+    public:
+        explicit LinearRoomMap(const std::vector<Rect> &r) : rooms(r) { }
+
+        void getRoomAtPos(const MapCoord &mc, int &r1, int &r2) const
+        {
+            r1 = r2 = -1;
+            for (std::vector<Rect>::const_iterator it = rooms.begin(); it != rooms.end(); ++it) {
+                if (mc.getX() >= it->x && mc.getX() < it->x + it->w
+                && mc.getY() >= it->y && mc.getY() < it->y + it->h) {
+                    const bool x_corner = mc.getX() == it->x || mc.getX() == it->x + it->w - 1;
+                    const bool y_corner = mc.getY() == it->y || mc.getY() == it->y + it->h - 1;
+                    if (x_corner && y_corner) continue;
+                    if (r1 == -1) {
+                        r1 = int(it - rooms.begin());
+                    } else {
+                        r2 = int(it - rooms.begin());
+                        return;
+                    }
+                }
+            }
+        }
+
+        bool isCorner(const MapCoord &mc) const
+        {
+            for (std::vector<Rect>::const_iterator it = rooms.begin(); it != rooms.end(); ++it) {
+                if ((mc.getX() == it->x || mc.getX() == it->x + it->w - 1)
+                    && (mc.getY() == it->y || mc.getY() == it->y + it->h - 1)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool inSameRoom(const MapCoord &mc1, const MapCoord &mc2) const
+        {
+            int r1a, r1b, r2a, r2b;
+            getRoomAtPos(mc1, r1a, r1b);
+            getRoomAtPos(mc2, r2a, r2b);
+            if (r1a != -1 && (r1a == r2a || r1a == r2b)) return true;
+            if (r1b != -1 && (r1b == r2a || r1b == r2b)) return true;
+            return false;
+        }
+
+    private:
+        std::vector<Rect> rooms;
+    };
+
+    // Split a width x height area into num_rooms rooms. Rooms include
+    // their borders, so the two halves of a cut share one row or
+    // column of squares.
+    std::vector<Rect> MakeLayout(int width, int height, int num_rooms, std::mt19937 &rng)
+    {
+        const int MIN_SIZE = 4;
+        std::vector<Rect> rooms(1);
+        rooms[0].x = rooms[0].y = 0;
+        rooms[0].w = width;
+        rooms[0].h = height;
+
+        while (int(rooms.size()) < num_rooms) {
+            // Cut the room with the largest area
+            std::vector<Rect>::iterator big = rooms.begin();
+            for (std::vector<Rect>::iterator it = rooms.begin(); it != rooms.end(); ++it) {
+                if (it->w * it->h > big->w * big->h) big = it;
+            }
+            Rect a = *big, b = *big;
+            if (big->w >= big->h) {
+                if (big->w < 2 * MIN_SIZE) break;
+                const int cut = MIN_SIZE - 1 + int(rng() % (big->w - 2 * MIN_SIZE + 2));
+                a.w = cut + 1;
+                b.x = big->x + cut;
+                b.w = big->w - cut;
+            } else {
+                if (big->h < 2 * MIN_SIZE) break;
+                const int cut = MIN_SIZE - 1 + int(rng() % (big->h - 2 * MIN_SIZE + 2));
+                a.h = cut + 1;
+                b.y = big->y + cut;
+                b.h = big->h - cut;
+            }
+            *big = a;
+            rooms.push_back(b);
+        }
+
+        return rooms;
+    }
+
+    template<class RM>
+    long RunQueries(const RM &rm, int width, int height, int passes,
+                    const std::vector<MapCoord> &pairs, double &ms)
+    {
+        // The result is a checksum of all the answers, so that both
+        // implementations can be checked against each other (and
+        // the compiler cannot skip the work).
+        long sum = 0;
+        BenchTimer timer;
+        for (int p = 0; p < passes; ++p) {
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    int r1, r2;
+                    rm.getRoomAtPos(MapCoord(x, y), r1, r2);
+                    sum += r1 * 3 + r2 * 7;
+                    if (rm.isCorner(MapCoord(x, y))) ++sum;
+                }
+            }
+            for (size_t i = 0; i + 1 < pairs.size(); i += 2) {
+                if (rm.inSameRoom(pairs[i], pairs[i+1])) sum += long(i);
+            }
+        }
+        ms = timer.elapsedMs();
+        return sum;
+    }
+}
+
+void BenchRoomMap(const BenchOptions &opts)
+{
+    const int width = opts.getInt("width", 200);
+    const int height = opts.getInt("height", 200);
+    const int num_rooms = opts.getInt("rooms", 400);
+    const int num_pairs = opts.getInt("pairs", 100000);
+    const int passes = opts.getInt("passes", 20);
+    const int seed = opts.getInt("seed", 1);
+    opts.checkAllUsed();
+
+    if (width < 4 || height < 4 || num_rooms < 1 || num_pairs < 0 || passes < 1) {
+        throw std::runtime_error("invalid options");
+    }
+
+    std::mt19937 rng(seed);
+    const std::vector<Rect> layout = MakeLayout(width, height, num_rooms, rng);
+
+    RoomMap room_map;
+    for (std::vector<Rect>::const_iterator it = layout.begin(); it != layout.end(); ++it) {
+        room_map.addRoom(MapCoord(it->x, it->y), it->w, it->h);
+    }
+    room_map.doneAddingRooms();
+
+    // doneAddingRooms shuffles the room numbers, so read the rooms
+    // back out in RoomMap's order before building the linear version.
+    std::vector<Rect> shuffled;
+    for (size_t r = 0; r < layout.size(); ++r) {
+        MapCoord pos;
+        Rect rect;
+        room_map.getRoomLocation(int(r), pos, rect.w, rect.h);
+        rect.x = pos.getX();
+        rect.y = pos.getY();
+        shuffled.push_back(rect);
+    }
+    const LinearRoomMap linear_map(shuffled);
+
+    // Pairs of squares up to 10 squares apart (some off the map edge)
+    std::vector<MapCoord> pairs;
+    pairs.reserve(num_pairs * 2);
+    for (int i = 0; i < num_pairs; ++i) {
+        const int x = int(rng() % width), y = int(rng() % height);
+        pairs.push_back(MapCoord(x, y));
+        pairs.push_back(MapCoord(x + int(rng() % 21) - 10, y + int(rng() % 21) - 10));
+    }
+
+    std::cout << "width=" << width << " height=" << height << " rooms=" << layout.size()
+              << " pairs=" << num_pairs << " passes=" << passes << " seed=" << seed << "\n";
+
+    const long queries = long(passes) * (2L * width * height + num_pairs);
+
+    double linear_ms, grid_ms;
+    const long linear_sum = RunQueries(linear_map, width, height, passes, pairs, linear_ms);
+    const long grid_sum = RunQueries(room_map, width, height, passes, pairs, grid_ms);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "linear " << std::setw(10) << linear_ms << " ms "
+              << std::setw(8) << (linear_ms * 1.0e6 / queries) << " ns/query\n"
+              << "grid   " << std::setw(10) << grid_ms << " ms "
+              << std::setw(8) << (grid_ms * 1.0e6 / queries) << " ns/query\n";
+
+    if (linear_sum != grid_sum) {
+        throw std::runtime_error("grid and linear lookups gave different answers");
+    }
+    std::cout << std::setprecision(1) << "speedup " << (linear_ms / grid_ms) << "x\n";
+}
@@ -0,0 +1,357 @@
+/*
+ * bench_task_manager.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * "tasks" benchmark: replays a recorded task trace (see
+ * task_trace.hpp) through the TaskManager, and through
+ * TreeTaskManager, a copy of the balanced-tree queue that the
+ * TaskManager used before the heap was introduced.
+ *
+ * The replay makes the same calls, in the same order, as the game
+ * that the trace was recorded from. Each task, when executed, makes
+ * the calls that its real counterpart made during its execute(). Both
+ * queues must run the tasks in the recorded order; the replay stops
+ * with an error if they do not.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "bench.hpp"
+#include "task.hpp"
+#include "task_manager.hpp"
+#include "task_trace.hpp"
+
+#include "boost/shared_ptr.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    // The old TaskManager queue, for comparison. Each priority has a
+    // tree ordered by (time, seq); removing or rescheduling a task
+    // searches all the tasks with the same exec time (as the original
+    // multiset-based TaskManager did).
+
+    class TreeTaskManager;
+
+    class TreeTask {
+        friend class TreeTaskManager;
+    public:
+        TreeTask() : pri(TP_NORMAL), time(-1) { }
+        virtual ~TreeTask() { }
+        virtual void execute(TreeTaskManager &) = 0;
+    private:
+        TaskPri pri;
+        int time;
+    };
+
+    class TreeTaskManager {
+    public:
+        TreeTaskManager() : gvt(0), next_seq(0), stopped(false) { }
+
+        void addTask(boost::shared_ptr<TreeTask> t, TaskPri pri, int exec_time);
+        uint64_t allocSeq() { return next_seq++; }
+        void addTaskWithSeq(boost::shared_ptr<TreeTask> t, TaskPri pri, int exec_time, uint64_t seq);
+        void changeTaskPri(boost::shared_ptr<TreeTask> t, TaskPri new_pri);
+        void changeExecTime(boost::shared_ptr<TreeTask> t, int new_exec_time);
+        void rmTask(boost::shared_ptr<TreeTask> t);
+        void rmAllTasks();
+        void advanceToTime(int target_time);
+
+    private:
+        typedef std::map<std::pair<int, uint64_t>, boost::shared_ptr<TreeTask> > TreeType;
+        enum { NUM_QUEUES = 2 };
+        TreeType tree_queue[NUM_QUEUES];
+
+        TreeType::iterator find(const TreeTask &t);
+        void insert(boost::shared_ptr<TreeTask> t, uint64_t seq);
+
+        int gvt;
+        uint64_t next_seq;
+        bool stopped;
+    };
+
+    TreeTaskManager::TreeType::iterator TreeTaskManager::find(const TreeTask &t)
+    {
+        TreeType &q = tree_queue[t.pri];
+        if (t.time < 0) return q.end();
+        for (TreeType::iterator it = q.lower_bound(std::make_pair(t.time, uint64_t(0)));
+             it != q.end() && it->first.first == t.time; ++it) {
+            if (it->second.get() == &t) return it;
+        }
+        return q.end();
+    }
+
+    void TreeTaskManager::insert(boost::shared_ptr<TreeTask> t, uint64_t seq)
+    {
+        TreeType &q = tree_queue[t->pri];
+        const std::pair<int, uint64_t> key(t->time, seq);
+        q.insert(std::make_pair(key, std::move(t)));
+    }
+
+    void TreeTaskManager::addTask(boost::shared_ptr<TreeTask> t, TaskPri pri, int exec_time)
+    {
+        if (stopped) return;
+        addTaskWithSeq(t, pri, exec_time, next_seq++);
+    }
+
+    void TreeTaskManager::addTaskWithSeq(boost::shared_ptr<TreeTask> t, TaskPri pri, int exec_time, uint64_t seq)
+    {
+        if (stopped) return;
+        t->pri = pri;
+        t->time = exec_time;
+        insert(t, seq);
+    }
+
+    void TreeTaskManager::changeTaskPri(boost::shared_ptr<TreeTask> t, TaskPri new_pri)
+    {
+        if (t->pri == new_pri) return;
+        TreeType::iterator it = find(*t);
+        if (it == tree_queue[t->pri].end()) return;
+        tree_queue[t->pri].erase(it);
+        t->pri = new_pri;
+        insert(t, next_seq++);
+    }
+
+    void TreeTaskManager::changeExecTime(boost::shared_ptr<TreeTask> t, int new_exec_time)
+    {
+        if (t->time == new_exec_time) return;
+        TreeType::iterator it = find(*t);
+        if (it == tree_queue[t->pri].end()) return;
+        tree_queue[t->pri].erase(it);
+        t->time = new_exec_time;
+        insert(t, next_seq++);
+    }
+
+    void TreeTaskManager::rmTask(boost::shared_ptr<TreeTask> t)
+    {
+        TreeType::iterator it = find(*t);
+        if (it != tree_queue[t->pri].end()) {
+            tree_queue[t->pri].erase(it);
+            t->time = -1;
+        }
+    }
+
+    void TreeTaskManager::rmAllTasks()
+    {
+        for (int i = 0; i < NUM_QUEUES; ++i) {
+            for (TreeType::iterator it = tree_queue[i].begin(); it != tree_queue[i].end(); ++it) {
+                it->second->time = -1;
+            }
+            tree_queue[i].clear();
+        }
+        stopped = true;
+    }
+
+    void TreeTaskManager::advanceToTime(int target_time)
+    {
+        if (target_time <= gvt) return;
+
+        for (int tp = 1; tp >= 0; --tp) {
+            while (!tree_queue[tp].empty()) {
+                TreeType::iterator it = tree_queue[tp].begin();
+                if (it->first.first > target_time) break;
+                if (it->first.first > gvt) gvt = it->first.first;
+                boost::shared_ptr<TreeTask> t = it->second;
+                tree_queue[tp].erase(it);
+                t->time = -1;
+                t->execute(*this);
+            }
+        }
+
+        gvt = target_time;
+    }
+
+
+    // Replays a trace through a queue of type TM (TaskManager or
+    // TreeTaskManager), whose tasks derive from TaskBase.
+    template<class TM, class TaskBase>
+    class Replay {
+    public:
+        Replay(const std::vector<TaskTraceEvent> &ev, int num_tasks)
+            : events(ev), pos(0), executed(0)
+        {
+            for (int i = 0; i < num_tasks; ++i) {
+                tasks.push_back(boost::shared_ptr<ReplayTask>(new ReplayTask(*this, i)));
+            }
+        }
+
+        // Returns the time taken in ms.
+        double run()
+        {
+            pos = 0;
+            executed = 0;
+            BenchTimer timer;
+
+            std::unique_ptr<TM> tm(new TM);
+            while (pos < events.size()) {
+                const TaskTraceEvent &ev = events[pos++];
+                if (ev.op == TaskTraceEvent::NEW_MANAGER) {
+                    tm->rmAllTasks();   // resets the tasks
+                    tm.reset(new TM);
+                } else if (ev.op == TaskTraceEvent::EXECUTE) {
+                    fail("tasks executed in a different order");
+                } else if (ev.op == TaskTraceEvent::END) {
+                    fail("unexpected end of task execution");
+                } else {
+                    apply(*tm, ev);
+                }
+            }
+            tm->rmAllTasks();
+
+            return timer.elapsedMs();
+        }
+
+        long getExecuted() const { return executed; }
+
+    private:
+        class ReplayTask : public TaskBase {
+        public:
+            ReplayTask(Replay &r, int i) : replay(r), id(i) { }
+            void execute(TM &tm) override { replay.runTask(tm, id); }
+        private:
+            Replay &replay;
+            int id;
+        };
+
+        void runTask(TM &tm, int id)
+        {
+            if (pos == events.size() || events[pos].op != TaskTraceEvent::EXECUTE || events[pos].task != id) {
+                fail("tasks executed in a different order");
+            }
+            ++pos;
+            ++executed;
+            while (true) {
+                if (pos == events.size()) fail("trace ends during task execution");
+                const TaskTraceEvent &ev = events[pos++];
+                if (ev.op == TaskTraceEvent::END) break;
+                if (ev.op == TaskTraceEvent::NEW_MANAGER || ev.op == TaskTraceEvent::EXECUTE) {
+                    fail("unexpected event during task execution");
+                }
+                apply(tm, ev);
+            }
+        }
+
+        void apply(TM &tm, const TaskTraceEvent &ev)
+        {
+            switch (ev.op) {
+            case TaskTraceEvent::ADD:
+                tm.addTask(tasks[ev.task], ev.pri, ev.time);
+                break;
+            case TaskTraceEvent::ADD_WITH_SEQ:
+                tm.addTaskWithSeq(tasks[ev.task], ev.pri, ev.time, ev.seq);
+                break;
+            case TaskTraceEvent::ALLOC_SEQ:
+                tm.allocSeq();
+                break;
+            case TaskTraceEvent::CHANGE_PRI:
+                tm.changeTaskPri(tasks[ev.task], ev.pri);
+                break;
+            case TaskTraceEvent::CHANGE_TIME:
+                tm.changeExecTime(tasks[ev.task], ev.time);
+                break;
+            case TaskTraceEvent::RM:
+                tm.rmTask(tasks[ev.task]);
+                break;
+            case TaskTraceEvent::RM_ALL:
+                tm.rmAllTasks();
+                break;
+            case TaskTraceEvent::ADVANCE:
+                tm.advanceToTime(ev.time);
+                break;
+            default:
+                fail("unexpected event");
+            }
+        }
+
+        void fail(const char *what) const
+        {
+            std::ostringstream msg;
+            msg << "replay failed at event " << pos << ": " << what;
+            throw std::runtime_error(msg.str());
+        }
+
+        const std::vector<TaskTraceEvent> &events;
+        size_t pos;
+        long executed;
+        std::vector<boost::shared_ptr<ReplayTask> > tasks;
+    };
+
+    template<class TM, class TaskBase>
+    double BestOf(const std::vector<TaskTraceEvent> &events, int num_tasks, int repeat, long &executed)
+    {
+        Replay<TM, TaskBase> replay(events, num_tasks);
+        double best = 0;
+        for (int i = 0; i < repeat; ++i) {
+            const double ms = replay.run();
+            if (i == 0 || ms < best) best = ms;
+        }
+        executed = replay.getExecuted();
+        return best;
+    }
+
+    void Print(const char *name, double ms, size_t num_events)
+    {
+        std::cout << std::left << std::setw(6) << name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(10) << ms << " ms"
+                  << std::setw(8) << (ms * 1.0e6 / double(num_events)) << " ns/event\n";
+    }
+}
+
+void BenchTaskManager(const BenchOptions &opts)
+{
+    const std::string trace_file = opts.getString("trace", "");
+    const int repeat = opts.getInt("repeat", 5);
+    opts.checkAllUsed();
+
+    if (trace_file.empty()) throw std::runtime_error("trace= is required (record one with: game tasktrace=<file>)");
+    if (repeat < 1) throw std::runtime_error("repeat must be positive");
+
+    int num_tasks = 0;
+    const std::vector<TaskTraceEvent> events = ReadTaskTrace(trace_file, num_tasks);
+
+    std::cout << "trace=" << trace_file << " repeat=" << repeat << "\n"
+              << events.size() << " events, " << num_tasks << " tasks\n";
+
+    long tree_executed = 0, heap_executed = 0;
+    const double tree_ms = BestOf<TreeTaskManager, TreeTask>(events, num_tasks, repeat, tree_executed);
+    Print("tree", tree_ms, events.size());
+
+    const double heap_ms = BestOf<TaskManager, Task>(events, num_tasks, repeat, heap_executed);
+    Print("heap", heap_ms, events.size());
+
+    if (tree_executed != heap_executed) throw std::runtime_error("queues executed a different number of tasks");
+    std::cout << heap_executed << " tasks executed\n"
+              << std::fixed << std::setprecision(2) << "speedup " << (tree_ms / heap_ms) << "x\n";
+}
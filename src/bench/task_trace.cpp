@@ -0,0 +1,207 @@
+/*
+ * task_trace.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "task_trace.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    const char * const TRACE_HEADER = "knights-task-trace 1";
+
+    bool HasTask(TaskTraceEvent::Op op)
+    {
+        switch (op) {
+        case TaskTraceEvent::ADD:
+        case TaskTraceEvent::ADD_WITH_SEQ:
+        case TaskTraceEvent::CHANGE_PRI:
+        case TaskTraceEvent::CHANGE_TIME:
+        case TaskTraceEvent::RM:
+        case TaskTraceEvent::EXECUTE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool HasPri(TaskTraceEvent::Op op)
+    {
+        return op == TaskTraceEvent::ADD || op == TaskTraceEvent::ADD_WITH_SEQ || op == TaskTraceEvent::CHANGE_PRI;
+    }
+
+    bool HasTime(TaskTraceEvent::Op op)
+    {
+        return op == TaskTraceEvent::ADD || op == TaskTraceEvent::ADD_WITH_SEQ
+            || op == TaskTraceEvent::CHANGE_TIME || op == TaskTraceEvent::ADVANCE;
+    }
+}
+
+void TaskTraceWriter::add(const TaskManager &tm, TaskTraceEvent::Op op, const Task *t, TaskPri pri, int time, uint64_t seq)
+{
+    if (&tm != current_tm) {
+        TaskTraceEvent ev = { TaskTraceEvent::NEW_MANAGER, 0, TP_NORMAL, 0, 0 };
+        events.push_back(ev);
+        current_tm = &tm;
+    }
+
+    int id = 0;
+    if (t) {
+        // A new Task may be given the address of one that has been
+        // deleted. This is harmless: the deleted task cannot have been
+        // in the queue, so the replay can reuse the same task object.
+        std::map<const Task *, int>::const_iterator it = task_ids.find(t);
+        if (it == task_ids.end()) {
+            id = int(task_ids.size());
+            task_ids.insert(std::make_pair(t, id));
+        } else {
+            id = it->second;
+        }
+    }
+
+    TaskTraceEvent ev = { op, id, pri, time, seq };
+    events.push_back(ev);
+}
+
+void TaskTraceWriter::onAddTask(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time)
+{
+    add(tm, TaskTraceEvent::ADD, &t, pri, exec_time, 0);
+}
+
+void TaskTraceWriter::onAddTaskWithSeq(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time, uint64_t seq)
+{
+    add(tm, TaskTraceEvent::ADD_WITH_SEQ, &t, pri, exec_time, seq);
+}
+
+void TaskTraceWriter::onAllocSeq(const TaskManager &tm)
+{
+    add(tm, TaskTraceEvent::ALLOC_SEQ, 0, TP_NORMAL, 0, 0);
+}
+
+void TaskTraceWriter::onChangeTaskPri(const TaskManager &tm, const Task &t, TaskPri new_pri)
+{
+    add(tm, TaskTraceEvent::CHANGE_PRI, &t, new_pri, 0, 0);
+}
+
+void TaskTraceWriter::onChangeExecTime(const TaskManager &tm, const Task &t, int new_exec_time)
+{
+    add(tm, TaskTraceEvent::CHANGE_TIME, &t, TP_NORMAL, new_exec_time, 0);
+}
+
+void TaskTraceWriter::onRmTask(const TaskManager &tm, const Task &t)
+{
+    add(tm, TaskTraceEvent::RM, &t, TP_NORMAL, 0, 0);
+}
+
+void TaskTraceWriter::onRmAllTasks(const TaskManager &tm)
+{
+    add(tm, TaskTraceEvent::RM_ALL, 0, TP_NORMAL, 0, 0);
+}
+
+void TaskTraceWriter::onAdvanceToTime(const TaskManager &tm, int target_time)
+{
+    add(tm, TaskTraceEvent::ADVANCE, 0, TP_NORMAL, target_time, 0);
+}
+
+void TaskTraceWriter::onExecuteBegin(const TaskManager &tm, const Task &t)
+{
+    add(tm, TaskTraceEvent::EXECUTE, &t, TP_NORMAL, 0, 0);
+}
+
+void TaskTraceWriter::onExecuteEnd(const TaskManager &tm)
+{
+    add(tm, TaskTraceEvent::END, 0, TP_NORMAL, 0, 0);
+}
+
+void TaskTraceWriter::save(const std::string &filename) const
+{
+    std::ofstream str(filename.c_str());
+    str << TRACE_HEADER << "\n";
+    for (std::vector<TaskTraceEvent>::const_iterator it = events.begin(); it != events.end(); ++it) {
+        str << char(it->op);
+        if (HasTask(it->op)) str << ' ' << it->task;
+        if (HasPri(it->op)) str << ' ' << int(it->pri);
+        if (HasTime(it->op)) str << ' ' << it->time;
+        if (it->op == TaskTraceEvent::ADD_WITH_SEQ) str << ' ' << it->seq;
+        str << '\n';
+    }
+    if (!str) throw std::runtime_error("could not write task trace: " + filename);
+}
+
+std::vector<TaskTraceEvent> ReadTaskTrace(const std::string &filename, int &num_tasks)
+{
+    std::ifstream str(filename.c_str());
+    if (!str) throw std::runtime_error("could not open task trace: " + filename);
+
+    std::string line;
+    if (!std::getline(str, line) || line != TRACE_HEADER) {
+        throw std::runtime_error("not a task trace: " + filename);
+    }
+
+    std::vector<TaskTraceEvent> events;
+    num_tasks = 0;
+    int line_num = 1;
+    while (std::getline(str, line)) {
+        ++line_num;
+        std::istringstream ls(line);
+        char op;
+        TaskTraceEvent ev = { TaskTraceEvent::NEW_MANAGER, 0, TP_NORMAL, 0, 0 };
+        int pri = 0;
+        ls >> op;
+        ev.op = TaskTraceEvent::Op(op);
+        switch (ev.op) {
+        case TaskTraceEvent::NEW_MANAGER:
+        case TaskTraceEvent::ADD:
+        case TaskTraceEvent::ADD_WITH_SEQ:
+        case TaskTraceEvent::ALLOC_SEQ:
+        case TaskTraceEvent::CHANGE_PRI:
+        case TaskTraceEvent::CHANGE_TIME:
+        case TaskTraceEvent::RM:
+        case TaskTraceEvent::RM_ALL:
+        case TaskTraceEvent::ADVANCE:
+        case TaskTraceEvent::EXECUTE:
+        case TaskTraceEvent::END:
+            break;
+        default:
+            ls.setstate(std::ios::failbit);
+            break;
+        }
+        if (HasTask(ev.op)) ls >> ev.task;
+        if (HasPri(ev.op)) ls >> pri;
+        if (HasTime(ev.op)) ls >> ev.time;
+        if (ev.op == TaskTraceEvent::ADD_WITH_SEQ) ls >> ev.seq;
+
+        if (!ls || ev.task < 0 || (pri != TP_LOW && pri != TP_NORMAL)) {
+            std::ostringstream msg;
+            msg << "bad task trace event at " << filename << ":" << line_num;
+            throw std::runtime_error(msg.str());
+        }
+        ev.pri = TaskPri(pri);
+        if (ev.task >= num_tasks) num_tasks = ev.task + 1;
+        events.push_back(ev);
+    }
+
+    return events;
+}
@@ -0,0 +1,102 @@
+/*
+ * task_trace.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Task traces: a record of every call made to the TaskManager during
+ * a game, so that the calls can be replayed later (see the "tasks"
+ * benchmark). Traces are recorded by the "game" benchmark (option
+ * tasktrace=).
+ *
+ * A trace is a text file with one event per line. Tasks are numbered
+ * in the order they were first seen. The events made by a task from
+ * within its execute() function come between its EXECUTE and END
+ * events.
+ *
+ */
+
+#ifndef TASK_TRACE_HPP
+#define TASK_TRACE_HPP
+
+#include "task.hpp"
+#include "task_manager.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct TaskTraceEvent {
+    enum Op {
+        NEW_MANAGER = 'N',   // following events are for a new TaskManager
+        ADD = 'A',           // task, pri, time
+        ADD_WITH_SEQ = 'S',  // task, pri, time, seq
+        ALLOC_SEQ = 'Q',
+        CHANGE_PRI = 'P',    // task, pri
+        CHANGE_TIME = 'T',   // task, time
+        RM = 'R',            // task
+        RM_ALL = 'X',
+        ADVANCE = 'V',       // time
+        EXECUTE = 'E',       // task
+        END = 'D'
+    };
+
+    Op op;
+    int task;
+    TaskPri pri;
+    int time;
+    uint64_t seq;
+};
+
+class TaskTraceWriter : public TaskTraceRecorder {
+public:
+    TaskTraceWriter() : current_tm(0) { }
+
+    void onAddTask(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time) override;
+    void onAddTaskWithSeq(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time, uint64_t seq) override;
+    void onAllocSeq(const TaskManager &tm) override;
+    void onChangeTaskPri(const TaskManager &tm, const Task &t, TaskPri new_pri) override;
+    void onChangeExecTime(const TaskManager &tm, const Task &t, int new_exec_time) override;
+    void onRmTask(const TaskManager &tm, const Task &t) override;
+    void onRmAllTasks(const TaskManager &tm) override;
+    void onAdvanceToTime(const TaskManager &tm, int target_time) override;
+    void onExecuteBegin(const TaskManager &tm, const Task &t) override;
+    void onExecuteEnd(const TaskManager &tm) override;
+
+    // Throws std::runtime_error if the file cannot be written.
+    void save(const std::string &filename) const;
+    size_t getNumEvents() const { return events.size(); }
+
+private:
+    void add(const TaskManager &tm, TaskTraceEvent::Op op, const Task *t, TaskPri pri, int time, uint64_t seq);
+
+    const TaskManager *current_tm;
+    std::map<const Task *, int> task_ids;
+    std::vector<TaskTraceEvent> events;
+};
+
+// Reads a trace written by TaskTraceWriter::save. num_tasks is set to
+// the number of distinct tasks in the trace. Throws std::runtime_error
+// if the file cannot be read.
+std::vector<TaskTraceEvent> ReadTaskTrace(const std::string &filename, int &num_tasks);
+
+#endif
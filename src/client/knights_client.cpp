@@ -72,7 +72,8 @@ public:
         : ndisplays(0), player(0),
           knights_callbacks(0), client_callbacks(0),
           next_announcement_is_error(false),
-          allow_untrusted_strings(allow_untrusted_strings)
+          allow_untrusted_strings(allow_untrusted_strings),
+          msg_byte_counts(0)
     {
         for (int i = 0; i < 2; ++i) last_cts_ctrl[i] = 0;
     }
@@ -88,6 +89,7 @@ public:
     bool next_announcement_is_error;
     bool allow_untrusted_strings;
     std::vector<UTF8String> pending_chat_messages;
+    std::vector<long long> *msg_byte_counts;
 
     // helper functions
     void receiveConfiguration(Coercri::InputByteBuf &buf);
@@ -139,6 +141,12 @@ KnightsCallbacks* KnightsClient::getKnightsCallbacks() const
     return pimpl->knights_callbacks;
 }
 
+void KnightsClient::setMessageByteCounts(std::vector<long long> *counts)
+{
+    if (counts) counts->resize(256);
+    pimpl->msg_byte_counts = counts;
+}
+
 void KnightsClient::receiveInputData(const std::vector<ubyte> &data)
 {
     // This is where we decode the messages coming from the server,
@@ -156,6 +164,7 @@ void KnightsClient::receiveInputData(const std::vector<ubyte> &data)
         MiniMap * mini_map = knights_cb ? &knights_cb->getMiniMap(pimpl->player) : 0;
         StatusDisplay * status_display = knights_cb ? &knights_cb->getStatusDisplay(pimpl->player) : 0;
 
+        const size_t msg_start = buf.getPos();
         const unsigned char msg_code = buf.readUbyte();
         switch (msg_code) {
 
@@ -756,6 +765,49 @@ void KnightsClient::receiveInputData(const std::vector<ubyte> &data)
             }
             break;
 
+        case SERVER_SET_SQUARES:
+            {
+                struct Stack {
+                    const Graphic *item;
+                    std::vector<int> depth;
+                    std::vector<const Graphic *> gfx;
+                    std::vector<boost::shared_ptr<ColourChange> > cc;
+                };
+                const int num_stacks = buf.readVarIntThrow(0, 225);
+                std::vector<Stack> stacks(num_stacks);
+                for (std::vector<Stack>::iterator st = stacks.begin(); st != stacks.end(); ++st) {
+                    st->item = pimpl->readGraphic(buf);
+                    const int num_tiles = buf.readUbyte();
+                    for (int i = 0; i < num_tiles; ++i) {
+                        int depth;
+                        bool cc_set;
+                        ReadTileInfo(buf, depth, cc_set);
+                        st->depth.push_back(depth);
+                        st->gfx.push_back(pimpl->readGraphic(buf));
+                        st->cc.push_back(boost::shared_ptr<ColourChange>(cc_set ? new ColourChange(buf) : nullptr));
+                    }
+                }
+
+                const int num_squares = buf.readVarIntThrow(0, 225);
+                for (int i = 0; i < num_squares; ++i) {
+                    int x, y;
+                    ReadRoomCoord(buf, x, y);
+                    const Stack &st = stacks.at(buf.readVarIntThrow(0, num_stacks - 1));
+                    if (dungeon_view) {
+                        dungeon_view->setItem(x, y, st.item, true);
+                        dungeon_view->clearTiles(x, y, true);
+                        for (size_t t = 0; t < st.gfx.size(); ++t) {
+                            dungeon_view->setTile(x, y, st.depth[t], st.gfx[t], st.cc[t], true);
+                        }
+                    }
+                }
+
+#ifdef LOG_MSGS
+                std::cout << "SERVER_SET_SQUARES " << num_stacks << " " << num_squares << std::endl;
+#endif
+            }
+            break;
+
         case SERVER_PLACE_ICON:
             {
                 int x, y;
@@ -810,6 +862,30 @@ void KnightsClient::receiveInputData(const std::vector<ubyte> &data)
             }
             break;
 
+        case SERVER_SET_COLOURS_PACKED:
+            {
+                const int nblocks = buf.readVarIntThrow(0, 1000000);
+                for (int i = 0; i < nblocks; ++i) {
+                    const int start_x = buf.readUbyte();
+                    const int start_y = buf.readUbyte();
+                    const int width = buf.readUbyte();
+                    const int height = buf.readUbyte();
+                    int byte = 0, shift = 8;
+                    for (int y = start_y; y < start_y + height; ++y) {
+                        for (int x = start_x; x < start_x + width; ++x) {
+                            if (shift == 8) {
+                                byte = buf.readUbyte();
+                                shift = 0;
+                            }
+                            const int col = (byte >> shift) & 3;
+                            shift += 2;
+                            if (col != PACKED_COL_UNCHANGED && mini_map) mini_map->setColour(x, y, MiniMapColour(COL_WALL + col));
+                        }
+                    }
+                }
+            }
+            break;
+
         case SERVER_WIPE_MAP:
             if (mini_map) mini_map->wipeMap();
             break;
@@ -961,6 +1037,65 @@ void KnightsClient::receiveInputData(const std::vector<ubyte> &data)
         default:
             throw ProtocolError(ProtocolErrorCode::UNKNOWN_SERVER_MESSAGE);
         }
+
+        if (pimpl->msg_byte_counts) {
+            (*pimpl->msg_byte_counts)[msg_code] += buf.getPos() - msg_start;
+        }
+    }
+}
+
+void KnightsClient::receiveUnreliableInputData(const std::vector<ubyte> &data)
+{
+    // Only a few message types can be sent this way (see
+    // protocol.hpp). The packet might have been delayed, so it may
+    // refer to a game that has already ended (or not started yet);
+    // if so, it is ignored. The display selected by the reliable
+    // stream (pimpl->player) is not affected.
+
+    Coercri::InputByteBuf buf(data);
+    int display = 0;
+
+    while (!buf.eof()) {
+        ClientCallbacks * client_cb = pimpl->client_callbacks;
+        KnightsCallbacks * knights_cb = pimpl->knights_callbacks;
+
+        const size_t msg_start = buf.getPos();
+        const unsigned char msg_code = buf.readUbyte();
+        switch (msg_code) {
+
+        case SERVER_MAP_KNIGHT_LOCATION:
+            {
+                const int knight_id = buf.readUbyte();
+                int x = buf.readUbyte();
+                int y = -1;
+                if (x == 255) {
+                    x = -1;
+                } else {
+                    y = buf.readUbyte();
+                }
+                if (knights_cb) knights_cb->getMiniMap(display).mapKnightLocation(knight_id, x, y);
+            }
+            break;
+
+        case SERVER_SWITCH_PLAYER:
+            display = buf.readUbyte();
+            if (display >= pimpl->ndisplays) return;
+            break;
+
+        case SERVER_TIME_REMAINING:
+            {
+                const int milliseconds = buf.readVarInt();
+                if (client_cb && knights_cb) client_cb->setTimeRemaining(milliseconds);
+            }
+            break;
+
+        default:
+            throw ProtocolError(ProtocolErrorCode::UNKNOWN_SERVER_MESSAGE);
+        }
+
+        if (pimpl->msg_byte_counts) {
+            (*pimpl->msg_byte_counts)[msg_code] += buf.getPos() - msg_start;
+        }
     }
 }
 
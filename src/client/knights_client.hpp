@@ -69,6 +69,11 @@ public:
     // this will generate calls to the callback interfaces, if set (see below).
     void receiveInputData(const std::vector<ubyte> &data);
 
+    // process a packet received on the unreliable channel (see protocol.hpp).
+    // (Packets may be lost, but must be passed in the order they were sent,
+    // i.e. any that arrive late should be dropped, as ENet does.)
+    void receiveUnreliableInputData(const std::vector<ubyte> &data);
+
     // get the output data (and then clear the output buffer).
     // caller is then responsible for sending this data to the server.
     // any existing contents of 'data' are deleted.
@@ -89,6 +94,11 @@ public:
     void setClientCallbacks(ClientCallbacks *client_callbacks);
     KnightsCallbacks* getKnightsCallbacks() const;
     void setKnightsCallbacks(KnightsCallbacks *knights_callbacks);
+
+    // If set, the size (in bytes) of each incoming server message is added to
+    // (*counts)[message code]. The vector is resized to 256 entries. (Used by
+    // knights_bench to break down the server-to-client traffic.)
+    void setMessageByteCounts(std::vector<long long> *counts);
     
 
     //
@@ -57,7 +57,10 @@ namespace Coercri {
         enet_address_set_host(&address, hostname.c_str());
         address.port = port;
 
-        peer = enet_host_connect(host, &address, 1, 0);  // open 1 channel only. no user data supplied.
+        // Open 2 channels: 0 = reliable, 1 = unreliable sequenced. No user data supplied.
+        // (Older versions opened 1 channel only; an incoming connection
+        // from one of those will have peer->channelCount == 1.)
+        peer = enet_host_connect(host, &address, 2, 0);
         if (!peer) {
             // enet_host_connect failed; go to FAILED state
             state = FAILED;
@@ -88,6 +91,10 @@ namespace Coercri {
             enet_packet_destroy(queued_packets.front());
             queued_packets.pop();
         }
+        while (!queued_unreliable_packets.empty()) {
+            enet_packet_destroy(queued_unreliable_packets.front());
+            queued_unreliable_packets.pop();
+        }
         if (peer) {
             // If close() was called previously, then the "disconnect"
             // packet might not have been sent yet - doing a "flush"
@@ -143,6 +150,22 @@ namespace Coercri {
         // Packets send to a CLOSED or FAILED connection are silently dropped.
     }
 
+    void EnetNetworkConnection::send(const ByteChain &chain)
+    {
+        boost::unique_lock lock(mutex);
+        if (state == CONNECTED && peer) {
+            // Gather the chain straight into the packet (one copy).
+            ENetPacket *packet = enet_packet_create(nullptr, chain.size(), ENET_PACKET_FLAG_RELIABLE);
+            if (chain.size() > 0) chain.gather(packet->data);
+            enet_peer_send(peer, 0, packet);
+        } else if (state == PENDING) {
+            std::vector<unsigned char> buf(chain.size());
+            if (!buf.empty()) chain.gather(&buf[0]);
+            outgoing_packets.push(buf);
+        }
+        // Packets send to a CLOSED or FAILED connection are silently dropped.
+    }
+
     void EnetNetworkConnection::receive(std::vector<unsigned char> &buf)
     {
         boost::unique_lock lock(mutex);
@@ -172,6 +195,33 @@ namespace Coercri {
         }
     }
 
+    void EnetNetworkConnection::sendUnreliable(const std::vector<unsigned char> &buf)
+    {
+        boost::unique_lock lock(mutex);
+
+        // Unlike send(), nothing is queued while PENDING: the packet
+        // could have been lost anyway.
+        if (state == CONNECTED && peer && peer->channelCount >= 2 && !buf.empty()) {
+            ENetPacket *packet = enet_packet_create(&buf[0], buf.size(), 0);  // unreliable sequenced
+            enet_peer_send(peer, 1, packet);
+        }
+    }
+
+    bool EnetNetworkConnection::receiveUnreliable(std::vector<unsigned char> &buf)
+    {
+        boost::unique_lock lock(mutex);
+
+        buf.clear();
+        if (queued_unreliable_packets.empty()) return false;
+
+        ENetPacket *packet = queued_unreliable_packets.front();
+        unsigned char* ptr = static_cast<unsigned char*>(packet->data);
+        buf.assign(ptr, ptr + packet->dataLength);
+        enet_packet_destroy(packet);
+        queued_unreliable_packets.pop();
+        return true;
+    }
+
     std::string EnetNetworkConnection::getAddress()
     {
         boost::unique_lock lock(mutex);
@@ -201,11 +251,15 @@ namespace Coercri {
         }
     }
 
-    void EnetNetworkConnection::onReceivePacket(ENetPacket *packet)
+    void EnetNetworkConnection::onReceivePacket(ENetPacket *packet, int channel)
     {
         boost::unique_lock lock(mutex);
 
-        queued_packets.push(packet);
+        if (channel == 1) {
+            queued_unreliable_packets.push(packet);
+        } else {
+            queued_packets.push(packet);
+        }
     }
 
     void EnetNetworkConnection::onDisconnect()
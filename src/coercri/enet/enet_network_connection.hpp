@@ -69,13 +69,17 @@ namespace Coercri {
         virtual State getState() const;
         virtual void close();
         virtual void send(const std::vector<unsigned char> &);
+        virtual void send(const ByteChain &);
         virtual void receive(std::vector<unsigned char> &);
+        virtual bool supportsUnreliable() const { return true; }
+        virtual void sendUnreliable(const std::vector<unsigned char> &);
+        virtual bool receiveUnreliable(std::vector<unsigned char> &);
         virtual std::string getAddress();
         virtual int getPingTime();
         
         // Functions called by EnetNetworkDriver:
         void onReceiveAcknowledgment();
-        void onReceivePacket(ENetPacket *packet);
+        void onReceivePacket(ENetPacket *packet, int channel);
         void onDisconnect();
 
     private:
@@ -88,6 +92,7 @@ namespace Coercri {
         ENetPeer *peer;
         State state;
         std::queue<ENetPacket*> queued_packets;  // incoming packets
+        std::queue<ENetPacket*> queued_unreliable_packets;  // incoming packets on the unreliable channel
         std::queue<std::vector<unsigned char> > outgoing_packets;   // waiting to be transmitted when we go from PENDING to CONNECTED
 
 #ifdef ENET_BANDWIDTH_LIMIT  // if defined, implements a receive bandwidth limitation, for testing
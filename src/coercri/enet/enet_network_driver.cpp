@@ -265,7 +265,7 @@ namespace Coercri {
                 // A packet has been received.
                 {
                     EnetNetworkConnection* from_conn = static_cast<EnetNetworkConnection*>(event.peer->data);
-                    from_conn->onReceivePacket(event.packet);
+                    from_conn->onReceivePacket(event.packet, event.channelID);
                 }
                 break;
             }
@@ -253,4 +253,72 @@ namespace Coercri {
         (*buf)[pos] = payload_size >> 8;
         (*buf)[pos+1] = payload_size & 0xff;
     }
+
+    void ByteChain::append(const Slice &slice)
+    {
+        if (!slice || slice->empty()) return;
+
+        if (slice->size() < MIN_SHARED_SLICE) {
+            own.insert(own.end(), slice->begin(), slice->end());
+        } else {
+            Piece p;
+            p.pos = own.size();
+            p.slice = slice;
+            pieces.push_back(p);
+            slice_bytes += slice->size();
+        }
+    }
+
+    void ByteChain::append(const ByteChain &other)
+    {
+        size_t pos = 0;
+        for (std::vector<Piece>::const_iterator it = other.pieces.begin(); it != other.pieces.end(); ++it) {
+            own.insert(own.end(), other.own.begin() + pos, other.own.begin() + it->pos);
+            pos = it->pos;
+
+            Piece p;
+            p.pos = own.size();
+            p.slice = it->slice;
+            pieces.push_back(p);
+            slice_bytes += it->slice->size();
+        }
+        own.insert(own.end(), other.own.begin() + pos, other.own.end());
+    }
+
+    void ByteChain::clear()
+    {
+        own.clear();
+        pieces.clear();
+        slice_bytes = 0;
+    }
+
+    void ByteChain::swap(ByteChain &other)
+    {
+        own.swap(other.own);
+        pieces.swap(other.pieces);
+        std::swap(slice_bytes, other.slice_bytes);
+    }
+
+    void ByteChain::gather(ubyte *dest) const
+    {
+        size_t pos = 0;
+        for (std::vector<Piece>::const_iterator it = pieces.begin(); it != pieces.end(); ++it) {
+            dest = std::copy(own.begin() + pos, own.begin() + it->pos, dest);
+            dest = std::copy(it->slice->begin(), it->slice->end(), dest);
+            pos = it->pos;
+        }
+        std::copy(own.begin() + pos, own.end(), dest);
+    }
+
+    void ByteChain::moveTo(std::vector<ubyte> &out)
+    {
+        if (pieces.empty() && out.empty()) {
+            out.swap(own);
+        } else if (!empty()) {
+            const size_t old_size = out.size();
+            out.resize(old_size + size());
+            gather(&out[old_size]);
+        }
+        clear();
+    }
 }
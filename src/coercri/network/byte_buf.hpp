@@ -6,6 +6,10 @@
  *   Classes for marshalling various types (ints, strings etc) to/from
  *   a vector<unsigned char>. This makes it easier to send/receive
  *   binary data over a NetworkConnection.
+ *
+ *   Also ByteChain, a byte buffer that can hold shared (refcounted)
+ *   blocks of bytes by reference, so that the same data can be sent
+ *   to several connections without copying it for each one.
  *   
  * AUTHOR:
  *   Stephen Thompson
@@ -49,11 +53,72 @@
 #ifndef COERCRI_BYTE_BUF_HPP
 #define COERCRI_BYTE_BUF_HPP
 
+#include "boost/shared_ptr.hpp"
+
 #include <string>
 #include <vector>
 
 namespace Coercri {
 
+    // A sequence of bytes made up of the chain's own bytes, with
+    // shared read-only "slices" inserted in between them.
+    //
+    // New bytes are written to the end of ownBytes() (directly, or
+    // through an OutputByteBuf). append(slice) adds a slice by
+    // reference; it is logically placed after all the bytes written so
+    // far. gather() copies the whole sequence out, in order, e.g. into
+    // a network packet.
+    //
+    // A slice must not be modified once it has been appended to a
+    // chain (it may be read by another thread, or by another chain).
+    // Slices smaller than MIN_SHARED_SLICE bytes are just copied into
+    // ownBytes(), as that is cheaper than keeping a reference.
+    //
+    // Clearing a chain keeps the capacity of ownBytes(), so a chain
+    // that is re-used each update does not normally allocate memory.
+
+    class ByteChain {
+    public:
+        typedef unsigned char ubyte;
+        typedef boost::shared_ptr<const std::vector<ubyte> > Slice;
+
+        static const size_t MIN_SHARED_SLICE = 64;
+
+        ByteChain() : slice_bytes(0) { }
+
+        // The chain's own bytes. Writing to the end of this vector
+        // appends to the chain. Bytes may be removed from the end
+        // (e.g. with pop_back), but not past the point where the most
+        // recent slice was appended.
+        std::vector<ubyte> & ownBytes() { return own; }
+
+        void append(const Slice &slice);
+        void append(const ByteChain &other);  // shares other's slices, copies its own bytes
+
+        size_t size() const { return own.size() + slice_bytes; }
+        bool empty() const { return size() == 0; }
+        void clear();
+        void swap(ByteChain &other);
+
+        // Copy the contents, in order. "dest" must have room for size() bytes.
+        void gather(ubyte *dest) const;
+
+        // Append the contents to "out", then clear the chain. (If there
+        // are no slices, and "out" is empty, the vectors are swapped
+        // instead of copying.)
+        void moveTo(std::vector<ubyte> &out);
+
+    private:
+        struct Piece {
+            size_t pos;    // position in "own" where the slice goes
+            Slice slice;
+        };
+
+        std::vector<ubyte> own;
+        std::vector<Piece> pieces;
+        size_t slice_bytes;
+    };
+
     // Thread Safety: Multiple threads can access DIFFERENT ByteBufs
     // concurrently, but only one thread should access a given ByteBuf
     // at any one time.
@@ -94,6 +159,11 @@ namespace Coercri {
         // This appends to the given vector.
         OutputByteBuf(std::vector<ubyte> &buf_) : buf(&buf_) { }
 
+        // This appends to the given ByteChain. (The chain must not have
+        // slices appended to it while a payload size is waiting to be
+        // backpatched.)
+        OutputByteBuf(ByteChain &chain) : buf(&chain.ownBytes()) { }
+
         void writeUbyte(int x);
         void writeUshort(int x);
         void writeShort(int x);
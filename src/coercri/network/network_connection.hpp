@@ -49,6 +49,8 @@
 #ifndef COERCRI_NETWORK_CONNECTION_HPP
 #define COERCRI_NETWORK_CONNECTION_HPP
 
+#include "byte_buf.hpp"
+
 #include <string>
 #include <vector>
 
@@ -101,6 +103,31 @@ namespace Coercri {
         // Note: Packets sent to a CLOSED or FAILED connection are silently dropped.
         virtual void send(const std::vector<unsigned char> &) = 0;
 
+        // Send the contents of a ByteChain as a single packet.
+        // The default implementation gathers it into a vector first;
+        // implementations can override this to gather straight into
+        // the packet instead.
+        virtual void send(const ByteChain &chain)
+        {
+            std::vector<unsigned char> buf(chain.size());
+            if (!buf.empty()) chain.gather(&buf[0]);
+            send(buf);
+        }
+
+
+        // Unreliable sequenced channel (optional).
+        //
+        // Packets sent with sendUnreliable may be lost, and any that
+        // arrive out of order are dropped, but they are never held up
+        // by lost packets on the main (reliable) channel.
+        // receiveUnreliable returns one packet per call (false if
+        // there are none left).
+        //
+        // The default implementation has no such channel.
+        virtual bool supportsUnreliable() const { return false; }
+        virtual void sendUnreliable(const std::vector<unsigned char> &) { }
+        virtual bool receiveUnreliable(std::vector<unsigned char> &) { return false; }
+
 
         // Find out the address of the other end of this connection.
         virtual std::string getAddress() = 0;
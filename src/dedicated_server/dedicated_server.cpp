@@ -0,0 +1,360 @@
+/*
+ * dedicated_server.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Main program for the dedicated Knights server ("knights_server").
+ *
+ * This runs a KnightsServer hosting one or more named games, and
+ * routes packets between it and remote clients over ENet. Unlike the
+ * "Host LAN Game" mode of the main program, it has no dependency on
+ * SDL, guichan or FreeType, and does not open any window or audio
+ * device.
+ *
+ * The server runs until it receives SIGINT or SIGTERM, at which point
+ * it disconnects all clients and shuts down the games cleanly.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "exception_base.hpp"
+#include "find_knights_data_dir.hpp"
+#include "game_scheduler.hpp"
+#include "knights_config.hpp"
+#include "knights_log.hpp"
+#include "knights_server.hpp"
+#include "player_id.hpp"
+#include "read_module_names.hpp"
+#include "rng.hpp"
+#include "server_config.hpp"
+#include "version.hpp"
+#include "vfs.hpp"
+
+// coercri includes
+#include "enet/enet_network_driver.hpp"
+#include "network/network_connection.hpp"
+#include "timer/generic_timer.hpp"
+
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // Set by the signal handler to request a clean shutdown.
+    volatile std::sig_atomic_t g_quit_requested = 0;
+
+    extern "C" void HandleQuitSignal(int)
+    {
+        g_quit_requested = 1;
+    }
+
+    // KnightsLog implementation that writes timestamped lines to
+    // either a file or stdout.
+    class ServerLog : public KnightsLog {
+    public:
+        explicit ServerLog(const std::filesystem::path &filename)
+        {
+            if (!filename.empty()) {
+                file.open(filename, std::ios::out | std::ios::app);
+                if (!file) {
+                    throw std::runtime_error("Could not open log file: " + filename.string());
+                }
+            }
+        }
+
+        virtual void logMessage(const std::string &msg) override
+        {
+            // Format the current time
+            char time_buf[64];
+            const std::time_t t = std::time(nullptr);
+            std::strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", std::gmtime(&t));
+
+            // logMessage can be called from the update threads, so we need a lock
+            boost::lock_guard<boost::mutex> lock(mutex);
+            std::ostream &out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+            out << time_buf << '\t' << msg << std::endl;
+        }
+
+    private:
+        boost::mutex mutex;
+        std::ofstream file;
+    };
+
+    // A connected remote client.
+    struct RemoteClient {
+        ServerConnection *server_conn;
+        boost::shared_ptr<Coercri::NetworkConnection> remote;
+    };
+
+    // Convert a LocalMsg to a string, for printing fatal errors. (We
+    // don't load any localization files, so this just prints the key
+    // together with any string parameters.)
+    std::string MsgToString(const LocalMsg &msg)
+    {
+        std::string result = msg.key.getKey();
+        for (const LocalParam &param : msg.params) {
+            if (param.getType() == LocalParam::Type::STRING) {
+                result += ": ";
+                result += param.getString().asUTF8();
+            }
+        }
+        return result;
+    }
+
+    // Build the VFS containing the requested modules.
+    VFS MakeModuleVFS(const std::filesystem::path &modules_dir,
+                      std::vector<std::string> &module_names)
+    {
+        if (module_names.empty()) {
+            VFS root_vfs;
+            root_vfs.add(modules_dir, "");
+            module_names = ReadModuleNames(root_vfs, "modules.txt");
+            if (module_names.empty()) {
+                throw std::runtime_error("No modules listed in " + (modules_dir / "modules.txt").string());
+            }
+        }
+
+        VFS result;
+        for (const std::string &name : module_names) {
+            const std::filesystem::path path = modules_dir / name;
+            if (!std::filesystem::is_directory(path)) {
+                throw std::runtime_error("Module directory not found: " + path.string());
+            }
+            result.add(path, name);
+        }
+        return result;
+    }
+
+    // exception classes.
+    struct PrintUsageAndExit { };
+    struct PrintVersionAndExit { };
+
+    // Read one command line parameter. Throws PrintUsageAndExit if we have run out of parameters.
+    std::string ReadParam(int &i, int argc, char const * const * argv)
+    {
+        ++i;
+        if (i >= argc) throw PrintUsageAndExit();
+        return argv[i];
+    }
+
+    void ParseCmdLineArgs(int argc, char const * const * argv,
+                          std::filesystem::path &data_dir,
+                          std::filesystem::path &config_file)
+    {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "-c" || arg == "--config") {
+                config_file = ReadParam(i, argc, argv);
+            } else if (arg == "-d" || arg == "--datadir") {
+                data_dir = ReadParam(i, argc, argv);
+            } else if (arg == "-v" || arg == "--version") {
+                throw PrintVersionAndExit();
+            } else {
+                throw PrintUsageAndExit();
+            }
+        }
+    }
+
+    void RunServer(const std::filesystem::path &data_dir, const ServerConfig &config)
+    {
+        std::unique_ptr<ServerLog> log(new ServerLog(config.log_file));
+
+        boost::shared_ptr<Coercri::Timer> timer(new Coercri::GenericTimer);
+        const unsigned int start_time = timer->getMsec();
+
+        g_rng.initialize();
+
+        // Load the modules and create the games.
+        std::vector<std::string> module_names = config.modules;
+        VFS module_vfs = MakeModuleVFS(data_dir / "modules", module_names);
+
+        Coercri::EnetNetworkDriver net_driver(config.max_players, 0, config.use_compression);
+
+        // NOTE: server must be destroyed before net_driver, and
+        // before the log (as the games write to the log as they shut
+        // down).
+        KnightsServer server(timer, false, config.motd_file.string(), "");
+        server.setKnightsLog(log.get());
+
+        // Use a shared pool of worker threads, if requested.
+        int num_worker_threads = config.worker_threads;
+        if (num_worker_threads < 0) {
+            num_worker_threads = std::max(1, int(boost::thread::hardware_concurrency()));
+        }
+        if (num_worker_threads > 0) {
+            server.setGameScheduler(boost::shared_ptr<GameScheduler>(new GameScheduler(timer, num_worker_threads)));
+        }
+
+        for (const std::string &game_name : config.game_names) {
+            // Each game gets its own KnightsConfig, because the
+            // KnightsConfig owns the Lua state that the game runs in.
+            boost::shared_ptr<KnightsConfig> knights_config(new KnightsConfig(module_vfs, module_names, false));
+            server.startNewGame(knights_config, game_name);
+        }
+
+        net_driver.setServerPort(config.port);
+        net_driver.enableServer(true);
+
+        log->logMessage("\tserver started\tport=" + std::to_string(config.port)
+                        + ", games=" + std::to_string(config.game_names.size())
+                        + ", worker_threads=" + std::to_string(num_worker_threads)
+                        + ", startup_time=" + std::to_string(timer->getMsec() - start_time) + "ms");
+
+        std::vector<RemoteClient> clients;
+        std::vector<unsigned char> net_msg;
+        Coercri::ByteChain out_msg;
+
+        while (!g_quit_requested) {
+
+            // Update network driver
+            while (net_driver.doEvents()) { }
+
+            // Tell the server what the ping times are
+            for (auto &client : clients) {
+                server.setPingTime(*client.server_conn, client.remote->getPingTime());
+            }
+
+            // Receive incoming messages, and remove any clients who
+            // have disconnected
+            for (size_t i = 0; i < clients.size(); /* incremented below */) {
+                RemoteClient &client = clients[i];
+
+                client.remote->receive(net_msg);
+                if (!net_msg.empty()) {
+                    server.receiveInputData(*client.server_conn, net_msg);
+                }
+
+                if (client.remote->getState() == Coercri::NetworkConnection::CLOSED) {
+                    server.connectionClosed(*client.server_conn);
+                    clients.erase(clients.begin() + i);
+                } else {
+                    ++i;
+                }
+            }
+
+            // Send outgoing messages
+            for (auto &client : clients) {
+                // (The chain is gathered straight into the ENet packet.)
+                server.getOutputData(*client.server_conn, out_msg);
+                if (!out_msg.empty()) {
+                    client.remote->send(out_msg);
+                }
+
+                server.getUnreliableOutputData(*client.server_conn, net_msg);
+                if (!net_msg.empty()) {
+                    client.remote->sendUnreliable(net_msg);
+                }
+            }
+
+            // Accept new incoming connections
+            Coercri::NetworkDriver::Connections new_conns = net_driver.pollIncomingConnections();
+            for (auto &conn : new_conns) {
+                RemoteClient client;
+                client.server_conn = &server.newClientConnection(conn->getAddress(), PlayerID());
+                if (conn->supportsUnreliable()) server.enableUnreliableOutput(*client.server_conn);
+                client.remote = conn;
+                clients.push_back(client);
+            }
+
+            // Sleep to conserve CPU. We use a relatively short sleep so as not to
+            // impact ping times too much.
+            timer->sleepMsec(3);
+        }
+
+        log->logMessage("\tserver shutting down\tplayers=" + std::to_string(clients.size()));
+
+        // Disconnect all clients
+        for (auto &client : clients) {
+            server.connectionClosed(*client.server_conn);
+            client.remote->close();
+        }
+
+        // Give ENet a short time to deliver the disconnect messages
+        for (int i = 0; i < 20; ++i) {
+            while (net_driver.doEvents()) { }
+            timer->sleepMsec(10);
+        }
+
+        clients.clear();
+        net_driver.enableServer(false);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::filesystem::path default_data_dir = FindKnightsDataDir();
+    std::filesystem::path data_dir = default_data_dir;
+    std::filesystem::path config_file;
+
+    try {
+        ParseCmdLineArgs(argc, argv, data_dir, config_file);
+        if (config_file.empty()) {
+            config_file = data_dir / "server" / "server_config.txt";
+        }
+
+        const ServerConfig config = LoadServerConfig(config_file);
+
+        std::signal(SIGINT, HandleQuitSignal);
+        std::signal(SIGTERM, HandleQuitSignal);
+
+        RunServer(data_dir, config);
+
+    } catch (PrintUsageAndExit &) {
+        std::cout << "Usage: " << argv[0] << " [options]\n";
+        std::cout << "\n";
+        std::cout << "Options:\n";
+        std::cout << "  -c, --config [file name]: Set location of server config file\n";
+        std::cout << "     (default: <datadir>/server/server_config.txt)\n";
+        std::cout << "  -d, --datadir [directory name]: Set location of 'knights_data' directory\n";
+        std::cout << "     (default: " << default_data_dir << ")\n";
+        std::cout << "  -v, --version:  Print Knights version and exit.\n";
+        return 1;
+
+    } catch (PrintVersionAndExit &) {
+        std::cout << "Knights server version " << KNIGHTS_VERSION << std::endl;
+
+    } catch (ExceptionBase &e) {
+        std::cerr << "ERROR: " << MsgToString(e.getMsg()) << std::endl;
+        return 1;
+
+    } catch (std::exception &e) {
+        std::cerr << "ERROR: Caught exception: " << e.what() << std::endl;
+        return 1;
+
+    } catch (...) {
+        std::cerr << "ERROR: Unknown exception caught" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
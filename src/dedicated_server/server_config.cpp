@@ -0,0 +1,146 @@
+/*
+ * server_config.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "read_module_names.hpp"
+#include "server_config.hpp"
+#include "trim.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+    int ParseInt(const std::string &value, const std::string &where, int min_value, int max_value)
+    {
+        size_t pos = 0;
+        int result = 0;
+        try {
+            result = std::stoi(value, &pos);
+        } catch (std::exception &) {
+            pos = 0;
+        }
+        if (pos == 0 || pos != value.size() || result < min_value || result > max_value) {
+            throw std::runtime_error(where + ": invalid number '" + value + "'");
+        }
+        return result;
+    }
+
+    bool ParseBool(const std::string &value, const std::string &where)
+    {
+        if (value == "yes" || value == "true" || value == "1") return true;
+        if (value == "no" || value == "false" || value == "0") return false;
+        throw std::runtime_error(where + ": expected yes or no, got '" + value + "'");
+    }
+
+    std::filesystem::path ParsePath(const std::string &value, const std::filesystem::path &base_dir)
+    {
+        if (value.empty()) return {};
+        std::filesystem::path p = value;
+        if (p.is_relative()) p = base_dir / p;
+        return p;
+    }
+}
+
+ServerConfig LoadServerConfig(const std::filesystem::path &filename)
+{
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("Could not open config file: " + filename.string());
+    }
+
+    const std::filesystem::path base_dir = filename.parent_path();
+
+    ServerConfig config;
+    std::unordered_set<std::string> seen_games;
+
+    std::string line;
+    int line_num = 0;
+    while (std::getline(file, line)) {
+        ++line_num;
+        const std::string where = filename.string() + ", line " + std::to_string(line_num);
+
+        // Strip comment
+        const size_t hash_pos = line.find('#');
+        if (hash_pos != std::string::npos) line.erase(hash_pos);
+
+        line = Trim(line);
+        if (line.empty()) continue;
+
+        const size_t eq_pos = line.find('=');
+        if (eq_pos == std::string::npos) {
+            throw std::runtime_error(where + ": expected 'key = value'");
+        }
+        const std::string key = Trim(line.substr(0, eq_pos));
+        const std::string value = Trim(line.substr(eq_pos + 1));
+
+        if (key == "port") {
+            config.port = ParseInt(value, where, 1, 65535);
+        } else if (key == "max_players") {
+            config.max_players = ParseInt(value, where, 1, 4095);
+        } else if (key == "worker_threads") {
+            if (value == "auto") {
+                config.worker_threads = -1;
+            } else {
+                config.worker_threads = ParseInt(value, where, 0, 1024);
+            }
+        } else if (key == "use_compression") {
+            config.use_compression = ParseBool(value, where);
+        } else if (key == "motd_file") {
+            config.motd_file = ParsePath(value, base_dir);
+        } else if (key == "log_file") {
+            config.log_file = ParsePath(value, base_dir);
+        } else if (key == "modules") {
+            // Comma-separated list of module names
+            config.modules.clear();
+            size_t start = 0;
+            while (start <= value.size()) {
+                size_t comma = value.find(',', start);
+                if (comma == std::string::npos) comma = value.size();
+                const std::string name = Trim(value.substr(start, comma - start));
+                if (!IsValidModuleName(name)) {
+                    throw std::runtime_error(where + ": invalid module name '" + name + "'");
+                }
+                config.modules.push_back(name);
+                start = comma + 1;
+            }
+        } else if (key == "game") {
+            if (value.empty()) {
+                throw std::runtime_error(where + ": game name missing");
+            }
+            if (!seen_games.insert(value).second) {
+                throw std::runtime_error(where + ": duplicate game name '" + value + "'");
+            }
+            config.game_names.push_back(value);
+        } else {
+            throw std::runtime_error(where + ": unknown setting '" + key + "'");
+        }
+    }
+
+    if (config.game_names.empty()) {
+        throw std::runtime_error(filename.string() + ": no games defined (add at least one 'game = <name>' line)");
+    }
+
+    return config;
+}
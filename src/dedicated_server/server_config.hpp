@@ -0,0 +1,75 @@
+/*
+ * server_config.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Configuration file for the dedicated (headless) Knights server.
+ *
+ * The file is a list of "key = value" lines. Blank lines, and
+ * anything following a '#', are ignored. See
+ * knights_data/server/server_config.txt for an example.
+ *
+ */
+
+#ifndef SERVER_CONFIG_HPP
+#define SERVER_CONFIG_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct ServerConfig {
+    // UDP port to listen on
+    int port = 16399;
+
+    // Maximum number of simultaneous client connections
+    int max_players = 64;
+
+    // Whether to use ENet's range coder packet compression
+    bool use_compression = true;
+
+    // Number of worker threads used to run the games. Zero means that
+    // each running game gets its own thread; -1 means "one per CPU core".
+    int worker_threads = 0;
+
+    // MOTD file sent to clients on connection (empty = no MOTD)
+    std::filesystem::path motd_file;
+
+    // Log file (empty = log to stdout)
+    std::filesystem::path log_file;
+
+    // Modules to load for each game. If empty, the modules listed in
+    // knights_data/modules/modules.txt are used.
+    std::vector<std::string> modules;
+
+    // Names of the games to create at startup. Each game gets its own
+    // KnightsConfig (and hence its own Lua state).
+    std::vector<std::string> game_names;
+};
+
+// Load the config file. Relative paths found in the file (motd_file,
+// log_file) are interpreted relative to the directory containing the
+// config file. Throws std::runtime_error if the file cannot be read
+// or contains errors.
+ServerConfig LoadServerConfig(const std::filesystem::path &filename);
+
+#endif
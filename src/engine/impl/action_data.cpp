@@ -134,51 +134,154 @@ ActionData::ActionData(lua_State *lua)
     }
 }
 
+namespace {
+    // cxt table pool.
+    //
+    // Free cxt tables are held in an array in the registry. Tables in
+    // use are recorded in a second (weak-keyed) registry table, so
+    // that RecycleCxtTable can tell whether a table came from the pool.
+    // (Only the cxt tables themselves are pooled. The position tables
+    // inside them are created afresh each time, as Lua code often keeps
+    // hold of a position after the action has finished.)
+    const char g_cxt_free_key = 0;
+    const char g_cxt_in_use_key = 0;
+
+    // Pushes the given registry table, creating it the first time
+    void PushPoolTable(lua_State *lua, const char *key, const char *mode)
+    {
+        if (lua_rawgetp(lua, LUA_REGISTRYINDEX, key) != LUA_TTABLE) {   // [x]
+            lua_pop(lua, 1);                          // []
+            lua_createtable(lua, 0, 0);               // [tbl]
+            if (mode) {
+                lua_createtable(lua, 0, 1);           // [tbl mt]
+                lua_pushstring(lua, mode);            // [tbl mt mode]
+                lua_setfield(lua, -2, "__mode");      // [tbl mt]
+                lua_setmetatable(lua, -2);            // [tbl]
+            }
+            lua_pushvalue(lua, -1);                   // [tbl tbl]
+            lua_rawsetp(lua, LUA_REGISTRYINDEX, key); // [tbl]
+        }
+    }
+
+    // Pushes an empty cxt table (from the free list, or a new one) and marks it as in use.
+    void PushEmptyCxt(lua_State *lua)
+    {
+        PushPoolTable(lua, &g_cxt_free_key, nullptr);  // [free]
+        const lua_Integer n = lua_rawlen(lua, -1);
+        if (n > 0) {
+            lua_rawgeti(lua, -1, n);                   // [free cxt]
+            lua_pushnil(lua);                          // [free cxt nil]
+            lua_rawseti(lua, -3, n);                   // [free cxt]
+            lua_remove(lua, -2);                       // [cxt]
+        } else {
+            lua_pop(lua, 1);                           // []
+            lua_createtable(lua, 0, 9);                // [cxt]
+        }
+
+        PushPoolTable(lua, &g_cxt_in_use_key, "k");    // [cxt in_use]
+        lua_pushvalue(lua, -2);                        // [cxt in_use cxt]
+        lua_pushboolean(lua, 1);                       // [cxt in_use cxt true]
+        lua_rawset(lua, -3);                           // [cxt in_use]
+        lua_pop(lua, 1);                               // [cxt]
+    }
+
+    // Sets cxt[field] to a new position table holding mc, or leaves it
+    // nil if mc is null.
+    // Stack: [cxt]
+    void SetCxtPos(lua_State *lua, const char *field, const MapCoord &mc)
+    {
+        if (!mc.isNull()) {
+            lua_createtable(lua, 0, 2);         // [cxt pos]
+            lua_pushinteger(lua, mc.getX());    // [cxt pos x]
+            lua_setfield(lua, -2, "x");         // [cxt pos]
+            lua_pushinteger(lua, mc.getY());    // [cxt pos y]
+            lua_setfield(lua, -2, "y");         // [cxt pos]
+            lua_setfield(lua, -2, field);       // [cxt]
+        }
+    }
+}
+
 void ActionData::pushCxtTable(lua_State *lua) const
 {
-    // create 'cxt' table
-    lua_createtable(lua, 0, 9);   // [cxt]
+    // get an empty 'cxt' table from the pool
+    PushEmptyCxt(lua);                // [cxt]
 
     // use weak ptr for the creature, so that the creature is not
     // prevented from dying just because the lua code kept a
     // reference to it.
-    NewLuaWeakPtr<Creature>(lua, getActor());   // [cxt actor]
-    lua_setfield(lua, -2, "actor");                   // [cxt]
+    PushLuaWeakPtr<Creature>(lua, getActor());   // [cxt actor]
+    lua_setfield(lua, -2, "actor");                    // [cxt]
 
     if (getActor()) {
-        PushMapCoord(lua, getActor()->getPos());  // [cxt pos]
-        lua_setfield(lua, -2, "actor_pos");     // [cxt]
+        SetCxtPos(lua, "actor_pos", getActor()->getPos());
     }
 
     // same for 'victim'
-    NewLuaWeakPtr<Creature>(lua, getVictim());
+    PushLuaWeakPtr<Creature>(lua, getVictim());
     lua_setfield(lua, -2, "victim");
 
     if (getVictim()) {
-        PushMapCoord(lua, getVictim()->getPos());
-        lua_setfield(lua, -2, "victim_pos");
+        SetCxtPos(lua, "victim_pos", getVictim()->getPos());
     }
 
-    NewLuaPtr<ItemType>(lua, item);
+    PushLuaPtr<ItemType>(lua, item);
     lua_setfield(lua, -2, "item_type");
 
-    PushMapCoord(lua, item_coord);
-    lua_setfield(lua, -2, "item_pos");
+    SetCxtPos(lua, "item_pos", item_coord);
 
-    NewLuaSharedPtr<Tile>(lua, tile);
+    PushLuaSharedPtr<Tile>(lua, tile);
     lua_setfield(lua, -2, "tile");
 
-    PushMapCoord(lua, tile_coord);
-    lua_setfield(lua, -2, "tile_pos");
+    SetCxtPos(lua, "tile_pos", tile_coord);
 
     // generic pos
-    PushMapCoord(lua, generic_coord);
-    lua_setfield(lua, -2, "pos");
+    SetCxtPos(lua, "pos", generic_coord);
 
     PushOriginator(lua, getOriginator());  // [cxt player]
     lua_setfield(lua, -2, "originator");          // [cxt]
 }
 
+void RecycleCxtTable(lua_State *lua)
+{
+    // [cxt]
+    if (!lua_istable(lua, -1)) {
+        lua_pop(lua, 1);
+        return;
+    }
+
+    PushPoolTable(lua, &g_cxt_in_use_key, "k");  // [cxt in_use]
+    lua_pushvalue(lua, -2);                       // [cxt in_use cxt]
+    lua_rawget(lua, -2);                          // [cxt in_use flag]
+    if (lua_isnil(lua, -1)) {
+        // not one of ours (or already recycled)
+        lua_pop(lua, 3);                          // []
+        return;
+    }
+    lua_pop(lua, 1);                              // [cxt in_use]
+
+    // no longer in use
+    lua_pushvalue(lua, -2);                       // [cxt in_use cxt]
+    lua_pushnil(lua);                             // [cxt in_use cxt nil]
+    lua_rawset(lua, -3);                          // [cxt in_use]
+    lua_pop(lua, 1);                              // [cxt]
+
+    // clear out the cxt table (including anything the Lua code added),
+    // so that it doesn't keep any objects alive while in the pool
+    lua_pushnil(lua);                             // [cxt nil]
+    while (lua_next(lua, -2) != 0) {              // [cxt key val]
+        lua_pop(lua, 1);                          // [cxt key]
+        lua_pushvalue(lua, -1);                   // [cxt key key]
+        lua_pushnil(lua);                         // [cxt key key nil]
+        lua_rawset(lua, -4);                      // [cxt key]
+    }                                             // [cxt]
+
+    // add it to the free list
+    PushPoolTable(lua, &g_cxt_free_key, nullptr); // [cxt free]
+    lua_insert(lua, -2);                          // [free cxt]
+    lua_rawseti(lua, -2, lua_rawlen(lua, -2) + 1); // [free]
+    lua_pop(lua, 1);                              // []
+}
+
 
 void ActionData::setItem(DungeonMap *dmap, const MapCoord &mc, ItemType * it)
 {
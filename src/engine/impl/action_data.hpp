@@ -93,7 +93,9 @@ public:
     // (See also fn GetOriginatorFromCxt, below)
     explicit ActionData(lua_State *lua);
 
-    // push contents of *this as a table onto the lua stack
+    // push contents of *this as a table onto the lua stack.
+    // The table is taken from a pool, and should be handed back with
+    // RecycleCxtTable once the Lua code using it has finished.
     void pushCxtTable(lua_State *lua) const;
     
     // modifier fns:
@@ -127,4 +129,12 @@ private:
 // shortcuts to access certain fields of lua cxt table directly:
 Originator GetOriginatorFromCxt(lua_State *lua);
 
+// Pops a cxt table from the lua stack, and returns it to the pool so that
+// a later pushCxtTable can reuse it. Does nothing else if the value is
+// not a cxt table that is currently in use.
+// NOTE: Lua code should therefore not keep references to cxt itself
+// after it has finished running (see lua_docs/lua/cxt.html). The
+// position tables within it are not reused, and can be kept.
+void RecycleCxtTable(lua_State *lua);
+
 #endif
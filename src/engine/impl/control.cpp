@@ -65,8 +65,7 @@ void Control::newIndex(lua_State *lua)
 
 bool Control::checkPossible(const ActionData &ad) const
 {
-    // NOTE: Don't really want to run 'possible' as a coroutine
-    // (which is what execute() does), but this is more convenient, 
-    // because we don't have a function to run it normally!
-    return !possible.hasValue() || possible.execute(ad);
+    // 'possible' is a pure predicate, so it is called directly
+    // rather than as a coroutine.
+    return !possible.hasValue() || possible.check(ad);
 }
@@ -59,6 +59,10 @@ public:
     bool canExecuteWhileMoving() const { return can_execute_while_moving; }
     bool canExecuteWhileStunned() const { return can_execute_while_stunned; }
 
+    // Runs the "possible" function (if any). This must not yield, and
+    // should not have side effects, as it is only re-run when the
+    // available controls are recomputed (see
+    // Player::needControlsRecompute).
     bool checkPossible(const ActionData &ad) const;
 
 private:
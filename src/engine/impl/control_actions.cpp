@@ -62,7 +62,7 @@ using std::vector;
 namespace {
     void DoStun(shared_ptr<Creature> actor, int gvt) 
     {
-        actor->stunUntil(gvt + Mediator::instance().cfgInt("action_delay"));
+        actor->stunUntil(gvt + Mediator::instance().cfg().action_delay);
     }
 
     shared_ptr<Knight> ExtractKnight(const ActionData &ad)
@@ -126,7 +126,7 @@ namespace {
 
             // unload the crossbow, and stun
             actor->setItemInHand(itype->getUnloaded());
-            actor->stunUntil(gvt + Mediator::instance().cfgInt("crossbow_delay"));
+            actor->stunUntil(gvt + Mediator::instance().cfg().crossbow_delay);
             
             // run event hook
             Mediator::instance().runHook("HOOK_SHOOT", actor);
@@ -270,7 +270,7 @@ void A_Activate::execute(const ActionData &ad) const
     // Check if there was a creature. If so, stun him for "action_delay".
     if (actor) {
         Mediator &mediator(Mediator::instance());
-        actor->stunUntil(mediator.getGVT() + mediator.cfgInt("action_delay"));
+        actor->stunUntil(mediator.getGVT() + mediator.cfg().action_delay);
     }
 }
 
@@ -400,7 +400,7 @@ void A_Move::execute(const ActionData &ad) const
         // Normal Motion Cmd
         if (actor->getFacing() != dir) {
             actor->setFacing(dir);
-            int turn_delay = mediator.cfgInt("turn_delay");
+            int turn_delay = mediator.cfg().turn_delay;
             if (actor->hasQuickness()) turn_delay = (turn_delay * 2) / 3;
             actor->stunUntil(gvt + turn_delay);
         } else {
@@ -412,7 +412,7 @@ void A_Move::execute(const ActionData &ad) const
                 actor->move(MT_APPROACH);
             }
         }
-    } else if (actor->getOffset() <= mediator.cfgInt("walk_limit")) {
+    } else if (actor->getOffset() <= mediator.cfg().walk_limit) {
         // In this case we are in the middle of moving, and we are allowed to turn back,
         // but no other motion actions are allowed.
         if (dir == Opposite(actor->getFacing())) {
@@ -613,7 +613,7 @@ void A_PickLock::execute(const ActionData &ad) const
     if (!cr) return;
     shared_ptr<Lockable> t = GetLockPickTarget(ad);
     if (!t) return;
-    if (g_rng.getBool(prob)) {
+    if (Mediator::getRNG().getBool(prob)) {
         // lock pick was successful
         // We can call "open" directly to make the tile open (even though it is locked)
         t->open(*cr->getMap(), DisplaceCoord(cr->getPos(), cr->getFacing()), ad.getOriginator());
@@ -621,7 +621,7 @@ void A_PickLock::execute(const ActionData &ad) const
     
     // compute stun time (lock picking is faster with quickness)
     int time = waiting_time;
-    if (cr->hasQuickness()) time = time * 100 / mediator.cfgInt("quickness_factor"); 
+    if (cr->hasQuickness()) time = time * 100 / mediator.cfg().quickness_factor; 
     cr->stunUntil(gvt + time);
 }
 
@@ -721,7 +721,9 @@ namespace {
             if (amt > 0) {
                 // Remove item from the ground
                 if (amt < item->getNumber()) {
-                    item->setNumber(item->getNumber() - amt);
+                    const int old_number = item->getNumber();
+                    item->setNumber(old_number - amt);
+                    actor->getMap()->itemNumberChanged(mc, old_number);
                 } else {
                     actor->getMap()->rmItem(mc);
                 }
@@ -799,8 +801,7 @@ bool A_SetBearTrap::possible(const ActionData &ad) const
     if (!CheckDropSquare(*actor->getMap(), mc, trap_itype, dummy)) return false;
 
     // There must be no (walking) creature in the square ahead. (Trac #8)
-    std::vector<boost::shared_ptr<Entity> > entities;
-    actor->getMap()->getEntities(mc, entities);
+    const std::vector<boost::shared_ptr<Entity> > &entities = actor->getMap()->getEntitiesAt(mc);
     for (std::vector<boost::shared_ptr<Entity> >::const_iterator it = entities.begin(); it != entities.end(); ++it) {
         Creature *cr = dynamic_cast<Creature*>(it->get());
         if (cr && cr->getHeight() == H_WALKING) {
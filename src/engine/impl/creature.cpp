@@ -91,7 +91,7 @@ ImpactTask::ImpactResult ImpactTask::tryCreatureImpact(Creature &me)
     == Opposite(me.getFacing()) && target_creature->impactVeto(gvt, me)) {
         // enemy is going to hit me first -- abort my attack and wait.
         me.setAnimFrame(0, 0);
-        me.stunUntil(gvt + mediator.cfgInt("attack_threshold") + 1);
+        me.stunUntil(gvt + mediator.cfg().attack_threshold + 1);
         return VETO;
     }
 
@@ -113,7 +113,7 @@ ImpactTask::ImpactResult ImpactTask::tryCreatureImpact(Creature &me)
             const ItemType *parry_weapon = target_creature->getItemInHand();
             if (parry_weapon) {
                 const float parry_chance = parry_weapon->getParryChance();
-                if (g_rng.getBool(parry_chance)) {
+                if (Mediator::getRNG().getBool(parry_chance)) {
                     // Successful parry
                     target_creature->parry();
                     return HIT;
@@ -165,9 +165,9 @@ void ImpactTask::execute(TaskManager &tm)
     // Clean up attacker's anim state and stun time (assuming impact was not vetoed).
     if (result != VETO) {
         Mediator & mediator(Mediator::instance());
-        const int qf = me->hasQuickness() ? mediator.cfgInt("quickness_factor") : 100;
+        const int qf = me->hasQuickness() ? mediator.cfg().quickness_factor : 100;
         const int ds_time = me->item_in_hand->getMeleeDownswingTime();
-        const int wt_time = ds_time + mediator.cfgInt("melee_delay_time");
+        const int wt_time = ds_time + mediator.cfg().melee_delay_time;
         me->setAnimFrame(AF_IMPACT, gvt + ds_time * 100 / qf);
         me->stunUntil(gvt + wt_time * 100 / qf);
     }
@@ -180,7 +180,7 @@ void ImpactTask::execute(TaskManager &tm)
 bool Creature::impactVeto(int gvt, const Creature &attacker)
 {
     Mediator &mediator(Mediator::instance());
-    if (impact_time >= gvt && impact_time <= gvt + mediator.cfgInt("attack_threshold")) {
+    if (impact_time >= gvt && impact_time <= gvt + mediator.cfg().attack_threshold) {
         // I am about to hit the attacker, just as he hits me, ie the
         // impact times are simultaneous (to within attack_threshold).
         // In this case we decide 50/50 who wins.
@@ -195,13 +195,13 @@ bool Creature::impactVeto(int gvt, const Creature &attacker)
         const bool defender_is_knight = dynamic_cast<const Knight *>(this) != 0;
         const bool must_veto = !attacker_is_knight && defender_is_knight;
         const bool must_not_veto = attacker_is_knight && !defender_is_knight;
-        if (must_veto || (!must_not_veto && g_rng.getBool(0.5f))) {
+        if (must_veto || (!must_not_veto && Mediator::getRNG().getBool(0.5f))) {
             // attacker loses (veto his impact)
             return true;
         } else {
             // I lose -- cancel my own impact.
             setAnimFrame(0, 0);
-            stunUntil(gvt + mediator.cfgInt("attack_threshold"));
+            stunUntil(gvt + mediator.cfg().attack_threshold);
             return false;
         }
     } else {
@@ -253,7 +253,7 @@ void ThrowingTask::execute(TaskManager &tm)
 
     // reset anim / stun time
     Mediator &mediator(Mediator::instance());
-    const int qf = me->hasQuickness() ? mediator.cfgInt("quickness_factor") : 100;
+    const int qf = me->hasQuickness() ? mediator.cfg().quickness_factor : 100;
     const int ds_time = itype.getMissileDownswingTime();
     const int wait_until = gvt + ds_time * 100 / qf;
     me->setAnimFrame(AF_THROW_DOWN, wait_until);
@@ -362,7 +362,7 @@ void Creature::swing()
     TaskManager &tm(Mediator::instance().getTaskManager());
     
     const int gvt = tm.getGVT();
-    const int qf = hasQuickness() ? Mediator::instance().cfgInt("quickness_factor") : 100;
+    const int qf = hasQuickness() ? Mediator::instance().cfg().quickness_factor : 100;
     const int time_to_impact = item_in_hand->getMeleeBackswingTime() * 100 / qf;
     this->impact_time = gvt + time_to_impact;
 
@@ -387,7 +387,7 @@ void Creature::adjustImpactTimeIfMoving()
         const int gvt = Mediator::instance().getTaskManager().getGVT();
         const int base_time_to_impact = this->impact_time - gvt;
         const int earliest_impact = getArrivalTime() + 
-            std::max(0, base_time_to_impact - Mediator::instance().cfgInt("att_mov_delay_time"));
+            std::max(0, base_time_to_impact - Mediator::instance().cfg().att_mov_delay_time);
         if (this->impact_time < earliest_impact) this->impact_time = earliest_impact;
     }
 }
@@ -402,7 +402,7 @@ void Creature::delayedSetAnimFrame(int fr)
         // If we are moving, then we might delay the start of the
         // backswing animation, for aesthetic reasons.
 
-        const int earliest_anim_time = getArrivalTime() - mediator.cfgInt("att_mov_anim_time");
+        const int earliest_anim_time = getArrivalTime() - mediator.cfg().att_mov_anim_time;
 
         if (earliest_anim_time > gvt) {
             // We require a delay, add a task to set the anim frame
@@ -440,8 +440,7 @@ bool Creature::canThrow(bool strict) const
     // (Requested by KnightRider)
     const MapDirection facing = getFacing();
     const MapCoord pos = DisplaceCoord(getDestinationPos(), facing);
-    std::vector<shared_ptr<Entity> > ents;
-    getMap()->getEntities(pos, ents);
+    const std::vector<shared_ptr<Entity> > &ents = getMap()->getEntitiesAt(pos);
     for (std::vector<shared_ptr<Entity> >::const_iterator it = ents.begin(); it != ents.end(); ++it) {
         if (it->get() != this && dynamic_cast<Creature*>(it->get())) {
             // there is a creature (other than myself) in the square ahead.
@@ -484,7 +483,7 @@ void Creature::doThrow(ItemType &itype)
     
     // Work out timings.
     const int gvt = tm.getGVT();
-    const int qf = hasQuickness() ? mediator.cfgInt("quickness_factor") : 100;
+    const int qf = hasQuickness() ? mediator.cfg().quickness_factor : 100;
     this->impact_time = gvt + itype.getMissileBackswingTime() * 100 / qf;
     adjustImpactTimeIfMoving();
 
@@ -517,7 +516,7 @@ void Creature::parry()
 {
     if (!getMap()) return;
     Mediator &mediator(Mediator::instance());
-    const int finish_time = mediator.getGVT() + mediator.cfgInt("parry_delay");
+    const int finish_time = mediator.getGVT() + mediator.cfg().parry_delay;
     setAnimFrame(AF_PARRY, finish_time);
     stunUntil(finish_time);
 
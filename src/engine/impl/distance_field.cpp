@@ -0,0 +1,71 @@
+/*
+ * distance_field.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "distance_field.hpp"
+#include "dungeon_map.hpp"
+
+void DistanceField::update(const DungeonMap &dm, const MapCoord &tgt, MapHeight ht)
+{
+    if (&dm == dmap && tgt == target && ht == height
+    && dm.getAccessVersion() == access_version && dm.getWidth() == width) {
+        return;  // already up to date
+    }
+
+    dmap = &dm;
+    target = tgt;
+    height = ht;
+    access_version = dm.getAccessVersion();
+    width = dm.getWidth();
+
+    const int w = dm.getWidth();
+    const int h = dm.getHeight();
+    dist.assign(size_t(w) * h, (unsigned short)UNREACHABLE);
+    if (!dm.valid(tgt)) return;
+
+    // Breadth-first search outwards from the target. (The target
+    // square itself is always included, even if it is not clear.)
+    queue.clear();
+    queue.reserve(dist.size());
+    const int start = tgt.getY() * w + tgt.getX();
+    dist[start] = 0;
+    queue.push_back(start);
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const int idx = queue[head];
+        const int x = idx % w, y = idx / w;
+        const unsigned short d = dist[idx] + 1;
+        if (d >= UNREACHABLE) break;
+
+        for (int i = 0; i < 4; ++i) {
+            const MapCoord mc = DisplaceCoord(MapCoord(x, y), MapDirection(i));
+            if (!dm.valid(mc)) continue;
+            const int n = mc.getY() * w + mc.getX();
+            if (dist[n] != UNREACHABLE) continue;
+            if (dm.getAccessTilesOnly(mc, ht) != A_CLEAR) continue;
+            dist[n] = d;
+            queue.push_back(n);
+        }
+    }
+}
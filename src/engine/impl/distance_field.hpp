@@ -0,0 +1,76 @@
+/*
+ * distance_field.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * A DistanceField holds, for every square of a DungeonMap, the number
+ * of moves needed to reach a given target square (travelling only
+ * through squares that are A_CLEAR at a given height, ignoring
+ * entities). Monsters use it to find their way towards (or away from)
+ * a knight: see ChooseDirectionOnField in monster_support.hpp.
+ *
+ * Each Knight owns one field per height, which is shared by all the
+ * monsters chasing that knight. The field is recomputed (by a
+ * breadth-first search) only when it is requested after the target
+ * has moved to a new square, or the map's tile access has changed
+ * (e.g. a door has opened or closed).
+ *
+ */
+
+#ifndef DISTANCE_FIELD_HPP
+#define DISTANCE_FIELD_HPP
+
+#include "map_support.hpp"
+
+#include <vector>
+
+class DungeonMap;
+
+class DistanceField {
+public:
+    static const int UNREACHABLE = 0xffff;
+
+    DistanceField() : dmap(0), height(H_WALKING), access_version(0), width(0) { }
+
+    // Make sure the field is up to date for the given map, target and height.
+    void update(const DungeonMap &dmap, const MapCoord &target, MapHeight height);
+
+    // Number of moves from mc to the target, or UNREACHABLE.
+    int getDistance(const MapCoord &mc) const
+    {
+        if (mc.getX() < 0 || mc.getY() < 0 || mc.getX() >= width) return UNREACHABLE;
+        const size_t idx = size_t(mc.getY()) * width + mc.getX();
+        return idx < dist.size() ? dist[idx] : UNREACHABLE;
+    }
+
+private:
+    const DungeonMap *dmap;
+    MapCoord target;
+    MapHeight height;
+    unsigned int access_version;
+    int width;
+
+    std::vector<unsigned short> dist;
+    std::vector<int> queue;   // kept between updates to avoid reallocation
+};
+
+#endif
@@ -31,6 +31,7 @@
 #include "home_manager.hpp"
 #include "item.hpp"
 #include "lockable.hpp"
+#include "mediator.hpp"
 #include "monster_manager.hpp"
 #include "monster_type.hpp"
 #include "my_exceptions.hpp"
@@ -41,6 +42,13 @@
 #include "segment_set.hpp"
 #include "tile.hpp"
 
+#ifndef VIRTUAL_SERVER
+#include "boost/thread/thread.hpp"
+#endif
+
+#include <algorithm>
+#include <exception>
+
 using std::vector;
 
 namespace {
@@ -88,7 +96,8 @@ namespace {
 
     // Function to lay out the edges and blocks.
     
-    void DoLayout(int nplayers,                  // in
+    void DoLayout(RNG &rng,
+                  int nplayers,                  // in
                   int homes_required,            // in
                   const DungeonLayout &layout,   // in
                   HomeType home_type,            // in
@@ -99,7 +108,7 @@ namespace {
                   std::vector<bool> &horiz_exits,  // out
                   std::vector<bool> &vert_exits)   // out
     {
-        RNG_Wrapper myrng(g_rng);
+        RNG_Wrapper myrng(rng);
         int x, y;
 
         // get width and height
@@ -112,9 +121,9 @@ namespace {
         edges.clear();
         blocks.clear();
         
-        const bool flipx = g_rng.getBool();
-        const bool flipy = g_rng.getBool();
-        const bool rotate = g_rng.getBool();
+        const bool flipx = rng.getBool();
+        const bool flipy = rng.getBool();
+        const bool rotate = rng.getBool();
         for (int i=0; i<lwidth; ++i) {
             for (int j=0; j<lheight; ++j) {
                 x=i;
@@ -251,7 +260,8 @@ namespace {
     // reflection/rotation. Also appends all homes in the segment
     // (whether special or not) to 'all_homes'. Returns number of
     // homes added (whether special or not).
-    int AddSegment(const Segment *segment,
+    int AddSegment(RNG &rng,
+                   const Segment *segment,
                    int x,
                    int y,
                    int lwidth,
@@ -263,8 +273,8 @@ namespace {
         SegmentInfo &inf = segment_infos[y*lwidth + x];
         inf.segment = segment;
         if (allow_rotate) {
-            inf.x_reflect = g_rng.getBool();
-            inf.nrot = g_rng.getInt(0, 4);
+            inf.x_reflect = rng.getBool();
+            inf.nrot = rng.getInt(0, 4);
         } else {
             inf.x_reflect = false;
             inf.nrot = 0;
@@ -276,7 +286,8 @@ namespace {
     // Copies N non-special homes, chosen randomly from the last M elements of "all_homes", into "assigned_homes". 
     // Precondition: there must be at least that many non-special homes available.
     // Note: this will reorder all_homes.
-    void AssignHomes(std::vector<HomeInfo> &all_homes,
+    void AssignHomes(RNG &rng,
+                     std::vector<HomeInfo> &all_homes,
                      int how_many_to_choose_from,
                      int how_many_to_choose,
                      std::vector<HomeInfo> &assigned_homes)
@@ -284,7 +295,7 @@ namespace {
         ASSERT(how_many_to_choose_from <= int(all_homes.size()));
         
         // Shuffle the last M homes
-        RNG_Wrapper myrng(g_rng);
+        RNG_Wrapper myrng(rng);
         std::shuffle(all_homes.end() - how_many_to_choose_from, all_homes.end(), myrng);
 
         // Loop through that list.
@@ -309,7 +320,8 @@ namespace {
     // 'assign' is the number of non-special homes to copy into
     // 'assigned_homes'.
     //
-    void SetHomeSegment(const SegmentSet &segment_set,
+    void SetHomeSegment(RNG &rng,
+                        const SegmentSet &segment_set,
                         int x,
                         int y,
                         int lwidth,
@@ -328,7 +340,7 @@ namespace {
         const int max_attempts = 50;
         const Segment *r = 0;
         for (int i = 0; i < max_attempts; ++i) {
-            r = segment_set.getSegment(minhomes);
+            r = segment_set.getSegment(rng, minhomes);
                // ... returns a segment with at least 'minhomes' non-special homes
                // (returns 0 if impossible)
             
@@ -348,14 +360,14 @@ namespace {
         if (!r) throw DungeonGenerationFailed();
 
         // Add it to the dungeon
-        const int nhomes_avail = AddSegment(r, x, y, lwidth, rwidth, rheight, allow_rotate,
+        const int nhomes_avail = AddSegment(rng, r, x, y, lwidth, rwidth, rheight, allow_rotate,
                                             segment_infos, all_homes);
 
         // Assign homes if required
         // NOTE: Precondition of AssignHomes is satisfied, because SegmentSet::getSegment
         // guaranteed that there are at least minhomes non-special homes, and minhomes >= assign.
         if (assign > 0) {
-            AssignHomes(all_homes, nhomes_avail, assign, assigned_homes);
+            AssignHomes(rng, all_homes, nhomes_avail, assign, assigned_homes);
         }
     }
     
@@ -364,7 +376,8 @@ namespace {
     // block, and records the home locations. Also, if H_CLOSE or
     // H_AWAY requested, assigns homes to players.
     
-    void PlaceSegments(int nplayers,
+    void PlaceSegments(RNG &rng,
+                       int nplayers,
                        int homes_required,
                        HomeType home_type,
                        int lwidth, int lheight,
@@ -378,7 +391,7 @@ namespace {
                        std::vector<HomeInfo> &assigned_homes,   // out
                        std::vector<HomeInfo> &all_homes)        // out
     {
-        RNG_Wrapper myrng(g_rng);
+        RNG_Wrapper myrng(rng);
                     
         segment_infos.clear();
         segment_infos.resize(lwidth*lheight);
@@ -390,7 +403,7 @@ namespace {
                 int x, y;
                 FetchBlockFrom(edges, x, y);
                 ASSERT(x >= 0 && x < lwidth && y >= 0 && y < lheight);
-                SetHomeSegment(segment_set, x, y, lwidth, rwidth, rheight, allow_rotate, 
+                SetHomeSegment(rng, segment_set, x, y, lwidth, rwidth, rheight, allow_rotate, 
                                segment_infos, assigned_homes, all_homes, 1, 1);
             }
         }
@@ -401,7 +414,7 @@ namespace {
             int x, y;
             FetchEdgeOrBlock(edges, blocks, x, y);
             ASSERT(x >= 0 && x < lwidth && y >= 0 && y < lheight);
-            AddSegment(*it, x, y, lwidth, rwidth, rheight, allow_rotate, segment_infos, all_homes);
+            AddSegment(rng, *it, x, y, lwidth, rwidth, rheight, allow_rotate, segment_infos, all_homes);
         }
         
         // Eliminate "special" blocks if they have not been assigned.
@@ -414,7 +427,7 @@ namespace {
             int x, y;
             FetchEdgeOrBlock(edges, blocks, x, y);
             ASSERT(x >= 0 && x < lwidth && y >= 0 && y < lheight);
-            SetHomeSegment(segment_set, x, y, lwidth, rwidth, rheight, allow_rotate,
+            SetHomeSegment(rng, segment_set, x, y, lwidth, rwidth, rheight, allow_rotate,
                            segment_infos,
                            assigned_homes, all_homes,
                            nplayers, nplayers);
@@ -443,7 +456,7 @@ namespace {
             int x, y;
             FetchBlockFrom(blocks, x, y);
             ASSERT(x >= 0 && x < lwidth && y >= 0 && y < lheight);
-            SetHomeSegment(segment_set, x, y, lwidth, rwidth, rheight, allow_rotate,
+            SetHomeSegment(rng, segment_set, x, y, lwidth, rwidth, rheight, allow_rotate,
                            segment_infos, assigned_homes, all_homes, n, 0);
         }
 
@@ -453,7 +466,7 @@ namespace {
             if (CountNonSpecialHomes(all_homes) < nplayers) {
                 throw DungeonGenerationFailed();
             } else {
-                AssignHomes(all_homes, all_homes.size(), nplayers, assigned_homes);
+                AssignHomes(rng, all_homes, all_homes.size(), nplayers, assigned_homes);
             }
         }
         
@@ -726,7 +739,8 @@ namespace {
         return true;
     }
         
-    void KnockThroughDoors(int lwidth, int lheight,
+    void KnockThroughDoors(RNG &rng,
+                           int lwidth, int lheight,
                            int rwidth, int rheight,
                            const std::vector<boost::shared_ptr<Tile> > &hdoor_tiles,
                            const std::vector<boost::shared_ptr<Tile> > &vdoor_tiles,
@@ -759,7 +773,7 @@ namespace {
 
                     int ndoors_placed = 0;
                     for (int i = 0; i < max_attempts; ++i) {
-                        MapCoord mc(g_rng.getInt(0, rwidth) + x*(rwidth+1) + 1,
+                        MapCoord mc(rng.getInt(0, rwidth) + x*(rwidth+1) + 1,
                                     (y+1)*(rheight+1));
                         MapCoord side1 = DisplaceCoord(mc, D_WEST);
                         MapCoord side2 = DisplaceCoord(mc, D_EAST);
@@ -793,7 +807,7 @@ namespace {
                     int ndoors_placed = 0;
                     for (int i = 0; i < max_attempts; ++i) {
                         MapCoord mc((x+1)*(rwidth+1),
-                                    g_rng.getInt(0, rheight) + y*(rheight+1) + 1);
+                                    rng.getInt(0, rheight) + y*(rheight+1) + 1);
                         MapCoord side1 = DisplaceCoord(mc, D_NORTH);
                         MapCoord side2 = DisplaceCoord(mc, D_SOUTH);
                         MapCoord front = DisplaceCoord(mc, D_WEST);
@@ -822,6 +836,105 @@ namespace {
 
     // ------------------------------------------------------------------------------
 
+    // Layout planning.
+
+    // The result of one attempt at the "planning" stage of dungeon
+    // generation (DoLayout, PlaceSegments and Compress). This stage does
+    // not touch the DungeonMap, the Mediator or Lua, so several
+    // attempts can be made at once, on different threads.
+    struct LayoutPlan {
+        LayoutPlan() : ok(false), lwidth(0), lheight(0), door_seed(0) { }
+
+        bool ok;                       // true if the attempt succeeded
+        std::exception_ptr error;      // set if the attempt threw something other than DungeonGenerationFailed
+
+        int lwidth, lheight;
+        std::vector<bool> horiz_exits, vert_exits;
+        std::vector<SegmentInfo> segment_infos;
+        std::vector<HomeInfo> assigned_homes, all_homes;
+        uint64_t door_seed;            // seed for KnockThroughDoors
+    };
+
+    void PlanLayout(uint64_t seed,
+                    int nplayers,
+                    int homes_required,
+                    int rwidth, int rheight,
+                    const DungeonSettings &settings,
+                    const SegmentSet &segment_set,
+                    LayoutPlan &plan)
+    {
+        // Each attempt has its own RNG, so that the result depends
+        // only on the seed.
+        RNG rng(false);
+        rng.initialize(seed);
+
+        try {
+            std::vector<BlockInfo> edges, blocks;
+            DoLayout(rng, nplayers, homes_required, *settings.layout, settings.home_type,
+                     plan.lwidth, plan.lheight, edges, blocks, plan.horiz_exits, plan.vert_exits);
+
+            PlaceSegments(rng, nplayers, homes_required,
+                          settings.home_type, plan.lwidth, plan.lheight, rwidth, rheight,
+                          settings.allow_rotate,
+                          segment_set,
+                          settings.required_segments,
+                          edges, blocks,
+                          plan.segment_infos, plan.assigned_homes, plan.all_homes);
+
+            Compress(plan.lwidth, plan.lheight, rwidth, rheight,
+                     plan.segment_infos, plan.horiz_exits, plan.vert_exits,
+                     plan.assigned_homes, plan.all_homes);
+
+            plan.door_seed = rng.generateSeed();
+            plan.ok = true;
+
+        } catch (DungeonGenerationFailed &) {
+            // plan.ok remains false
+        } catch (...) {
+            // This might be running on a worker thread, so pass the
+            // exception back to DungeonGenerator to be rethrown.
+            plan.error = std::current_exception();
+        }
+    }
+
+    // Makes one planning attempt for each seed. On return, plans[i]
+    // holds the result for seeds[i], except that attempts after the
+    // first successful one might not have been made.
+    void PlanLayouts(const std::vector<uint64_t> &seeds,
+                     int nplayers,
+                     int homes_required,
+                     int rwidth, int rheight,
+                     const DungeonSettings &settings,
+                     const SegmentSet &segment_set,
+                     std::vector<LayoutPlan> &plans)
+    {
+        plans.clear();
+        plans.resize(seeds.size());
+
+#ifdef VIRTUAL_SERVER
+        // No threads available; make the attempts one at a time.
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            PlanLayout(seeds[i], nplayers, homes_required, rwidth, rheight, settings, segment_set, plans[i]);
+            if (plans[i].ok || plans[i].error) break;
+        }
+#else
+        // The first attempt runs on this thread, and each of the
+        // others on a thread of its own.
+        boost::thread_group threads;
+        for (size_t i = 1; i < seeds.size(); ++i) {
+            threads.create_thread([&, i]() {
+                PlanLayout(seeds[i], nplayers, homes_required, rwidth, rheight, settings, segment_set, plans[i]);
+            });
+        }
+        if (!seeds.empty()) {
+            PlanLayout(seeds[0], nplayers, homes_required, rwidth, rheight, settings, segment_set, plans[0]);
+        }
+        threads.join_all();
+#endif
+    }
+
+    // ------------------------------------------------------------------------------
+
     // Item generation helpers
 
     bool Forbidden(int cat,
@@ -877,7 +990,7 @@ namespace {
         bool placed = false;
         for (vector<shared_ptr<Tile> >::iterator it = tiles.begin(); it != tiles.end(); ++it) {
             if ((*it)->canPlaceItem() && !(*it)->itemPlacedAlready()) {
-                (*it)->placeItem(item);
+                (*it)->placeItem(&dmap, mc, item);
                 placed = true;
                 break;
             }
@@ -1038,7 +1151,7 @@ namespace {
             
             // Up to 10 attempts.
             for (int i = 0; i < 10 && !lockpicks_placed; ++i) {
-                const int r = g_rng.getInt(0, squares.size());
+                const int r = Mediator::getRNG().getInt(0, squares.size());
                 const MapCoord mc = squares[r];
                 
                 // Work out whether we can place items here.
@@ -1080,12 +1193,12 @@ namespace {
 
 // Top level dungeon generation function
 
-void DungeonGenerator(DungeonMap &dmap,
-                      CoordTransform &ct,
-                      HomeManager &home_manager,
-                      MonsterManager &monster_manager,
-                      const std::vector<Player*> &players,
-                      const DungeonSettings &settings)
+uint64_t DungeonGenerator(DungeonMap &dmap,
+                          CoordTransform &ct,
+                          HomeManager &home_manager,
+                          MonsterManager &monster_manager,
+                          const std::vector<Player*> &players,
+                          const DungeonSettings &settings)
 {
     int rwidth = 0, rheight = 0;
     FindRsize(settings.normal_segments, rwidth, rheight);
@@ -1094,38 +1207,51 @@ void DungeonGenerator(DungeonMap &dmap,
     // Homes required is equal to number of players (unless H_NONE is set).
     const int homes_required = (settings.home_type == H_NONE ? 0 : players.size());
 
-    int lwidth, lheight;
-    std::vector<BlockInfo> edges, blocks;
-    std::vector<bool> horiz_exits, vert_exits;
-    
-    DoLayout(players.size(), homes_required, *settings.layout, settings.home_type,
-             lwidth, lheight, edges, blocks, horiz_exits, vert_exits);
+    // Choose a seed for each planning attempt. If the settings give a
+    // seed, make a single attempt with that, to reproduce a previous
+    // layout.
+    std::vector<uint64_t> seeds;
+    if (settings.seed != 0) {
+        seeds.push_back(settings.seed);
+    } else {
+        const int num_attempts = std::max(1, Mediator::instance().cfg().dungeon_layout_attempts);
+        for (int i = 0; i < num_attempts; ++i) {
+            seeds.push_back(Mediator::getRNG().generateSeed());
+        }
+    }
 
-    std::vector<SegmentInfo> segment_infos;
-    std::vector<HomeInfo> assigned_homes, all_homes;
-    
-    PlaceSegments(players.size(), homes_required,
-                  settings.home_type, lwidth, lheight, rwidth, rheight,
-                  settings.allow_rotate,
-                  SegmentSet(settings.normal_segments),
-                  settings.required_segments,
-                  edges, blocks,
-                  segment_infos, assigned_homes, all_homes);
-
-    Compress(lwidth, lheight, rwidth, rheight,
-             segment_infos, horiz_exits, vert_exits,
-             assigned_homes, all_homes);
+    std::vector<LayoutPlan> plans;
+    PlanLayouts(seeds, players.size(), homes_required, rwidth, rheight,
+                settings, SegmentSet(settings.normal_segments), plans);
+
+    // Use the lowest numbered successful attempt. (Not simply the one
+    // that finished first, as the game must not depend on thread
+    // timing.)
+    size_t winner = 0;
+    while (winner < plans.size() && !plans[winner].ok) {
+        if (plans[winner].error) std::rethrow_exception(plans[winner].error);
+        ++winner;
+    }
+    if (winner == plans.size()) throw DungeonGenerationFailed();
+
+    const LayoutPlan &plan = plans[winner];
+    const int lwidth = plan.lwidth, lheight = plan.lheight;
+    const std::vector<HomeInfo> &all_homes = plan.all_homes;
+    const std::vector<HomeInfo> &assigned_homes = plan.assigned_homes;
 
+    // Build the map from the plan.
     dmap.create(lwidth*(rwidth+1)+1, lheight*(rheight+1)+1);
     
     CopySegmentsToMap(lwidth, lheight, rwidth, rheight,
                       settings.wall_tiles,
-                      segment_infos,
+                      plan.segment_infos,
                       dmap, ct, monster_manager);
 
-    KnockThroughDoors(lwidth, lheight, rwidth, rheight,
+    RNG door_rng(false);
+    door_rng.initialize(plan.door_seed);
+    KnockThroughDoors(door_rng, lwidth, lheight, rwidth, rheight,
                       settings.hdoor_tiles, settings.vdoor_tiles,
-                      segment_infos, horiz_exits, vert_exits,
+                      plan.segment_infos, plan.horiz_exits, plan.vert_exits,
                       dmap);
 
     // Inform the home manager that we have added homes to the dungeon.
@@ -1144,6 +1270,8 @@ void DungeonGenerator(DungeonMap &dmap,
         pos = DisplaceCoord(pos, Opposite(facing));
         players[i]->resetHome(&dmap, pos, facing);
     }
+
+    return seeds[winner];
 }
 
 // --------------------------------------------------------------------------------------
@@ -1191,7 +1319,7 @@ void GenerateItem(DungeonMap &dmap,
 
     for (int tries = 0; tries < maxtries; ++tries) {
         // Select a tile category
-        int t = g_rng.getInt(0, total_weight);
+        int t = Mediator::getRNG().getInt(0, total_weight);
         int chosen_cat = -999;
         for (weight_table::const_iterator it = weights.begin(); it != weights.end(); ++it) {
             t -= it->second;
@@ -1208,8 +1336,8 @@ void GenerateItem(DungeonMap &dmap,
         // zero.)
         MapCoord mc;
         for (int q = 0; q < w*h; ++q) {
-            mc.setX(g_rng.getInt(0, w));
-            mc.setY(g_rng.getInt(0, h));
+            mc.setX(Mediator::getRNG().getInt(0, w));
+            mc.setY(Mediator::getRNG().getInt(0, h));
 
             // work out the tile category
             dmap.getTiles(mc, tiles);
@@ -1249,7 +1377,7 @@ void GenerateStuff(DungeonMap &dmap,
             // Look for the chosen category in our container of ItemGenerators.
             if (chosen_cat >= 0) {
                 std::map<int, StuffInfo>::const_iterator it = stuff.find(chosen_cat);
-                if (it != stuff.end() && g_rng.getBool(it->second.chance)) {
+                if (it != stuff.end() && Mediator::getRNG().getBool(it->second.chance)) {
                     // We are to generate an item
                     std::pair<ItemType *, int> result = it->second.gen.get();
                     ASSERT(result.first);
@@ -1272,8 +1400,8 @@ void GenerateMonsters(DungeonMap &dmap,
     std::vector<boost::shared_ptr<Tile> > tiles;
     for (int i = 0; i < num_monsters; ++i) {
         for (int tries = 0; tries < 10; ++tries) {
-            const int x = g_rng.getInt(0, dmap.getWidth());
-            const int y = g_rng.getInt(0, dmap.getHeight());
+            const int x = Mediator::getRNG().getInt(0, dmap.getWidth());
+            const int y = Mediator::getRNG().getInt(0, dmap.getHeight());
             const MapCoord mc(x, y);
 
             // To place a monster, need a non-stair tile with clear access at the relevant height.
@@ -29,6 +29,7 @@
 #include "boost/shared_ptr.hpp"
 using namespace boost;
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <vector>
@@ -68,6 +69,7 @@ struct DungeonSettings {
     std::vector<const Segment*> normal_segments, required_segments;
     HomeType home_type;
     bool allow_rotate;
+    uint64_t seed;   // if non-zero, reproduce the layout that was generated from this seed
 };
 
 
@@ -76,13 +78,18 @@ struct DungeonSettings {
 // Throws DungeonGenerationFailed if something goes wrong.
 // NB The present algorithm assumes that all Segments are the same size.
 //
+// Up to MISC_CONFIG.dungeon_layout_attempts layouts are planned at
+// once (on separate threads, where available), and the first one (in
+// order of planning) that succeeds is used. Returns the seed of that layout; passing this back
+// in DungeonSettings::seed will generate the same layout again.
+//
 
-void DungeonGenerator(DungeonMap &dmap,
-                      CoordTransform &ct,
-                      HomeManager &home_manager,
-                      MonsterManager &monster_manager,
-                      const std::vector<Player*> &players,
-                      const DungeonSettings &settings);
+uint64_t DungeonGenerator(DungeonMap &dmap,
+                          CoordTransform &ct,
+                          HomeManager &home_manager,
+                          MonsterManager &monster_manager,
+                          const std::vector<Player*> &players,
+                          const DungeonSettings &settings);
 
 
 //
@@ -37,9 +37,9 @@
 #include "task_manager.hpp"
 #include "tile.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
-using std::list;
 using std::make_pair;
 using std::pair;
 using std::vector;
@@ -62,18 +62,26 @@ void MapHelper::addEntity(shared_ptr<Entity> e)
     ASSERT(dmap->valid(e->getPos()));
 
     // add to "entities"
-    dmap->entities.insert(make_pair(e->getPos(), e));
+    dmap->entities[dmap->index(e->getPos())].push_back(e);
     
     // Moving entities must be stored twice in "entities", once in the "behind" square
     // and once in the "ahead" square:
     if (e->getMotionType() == MT_MOVE) {
         const MapCoord mc2 = DisplaceCoord(e->getPos(), e->getFacing());
         if (dmap->valid(mc2)) {
-            dmap->entities.insert(make_pair(mc2, e));
+            dmap->entities[dmap->index(mc2)].push_back(e);
         }
     }
 }
 
+namespace {
+    void RemoveFromList(std::vector<shared_ptr<Entity> > &ents, const shared_ptr<Entity> &e)
+    {
+        std::vector<shared_ptr<Entity> >::iterator it = std::find(ents.begin(), ents.end(), e);
+        if (it != ents.end()) ents.erase(it);
+    }
+}
+
 void MapHelper::rmEntity(shared_ptr<Entity> e)
 {
     if (!e) return;
@@ -82,26 +90,13 @@ void MapHelper::rmEntity(shared_ptr<Entity> e)
     ASSERT(dmap->valid(e->getPos()));
 
     // remove from "current" pos
-    typedef DungeonMap::EntityContainer::iterator Itor;
-    pair<Itor,Itor> p = dmap->entities.equal_range(e->getPos());
-    for (Itor it = p.first; it != p.second; ++it) {
-        if (it->second == e) {
-            dmap->entities.erase(it);
-            break;
-        }
-    }
+    RemoveFromList(dmap->entities[dmap->index(e->getPos())], e);
 
     // remove from "forward" pos (if moving)
     if (e->isMoving() && !e->isApproaching()) {
         const MapCoord mc2 = DisplaceCoord(e->getPos(), e->getFacing());
         if (dmap->valid(mc2)) {
-            p = dmap->entities.equal_range(mc2);
-            for (Itor it = p.first; it != p.second; ++it) {
-                if (it->second == e) {
-                    dmap->entities.erase(it);
-                    break;
-                }
-            }
+            RemoveFromList(dmap->entities[dmap->index(mc2)], e);
         }
     }
 }
@@ -113,8 +108,11 @@ void MapHelper::rmEntity(shared_ptr<Entity> e)
 //  DungeonMap  //
 //////////////////
 
+const DungeonMap::EntityList DungeonMap::no_entities;
+const DungeonMap::TileList DungeonMap::no_tiles;
+
 DungeonMap::DungeonMap()
-    : map_width(0), map_height(0), room_map(0)
+    : access_version(0), map_width(0), map_height(0), room_map(0)
 { }
 
 DungeonMap::~DungeonMap()
@@ -129,14 +127,25 @@ void DungeonMap::create(int w, int h)
     entities.clear();
     items.clear();
     tiles.clear();
+    tile_access.clear();
 
     map_width = w;
     map_height = h;
+    entities.resize(w*h);
+    items.resize(w*h);
     tiles.resize(w*h);
 
+    TileAccess clear_access;
+    std::fill(clear_access.acc, clear_access.acc + H_MISSILES + 1, (unsigned char)A_CLEAR);
+    clear_access.colour = COL_UNMAPPED;
+    tile_access.assign(w*h, clear_access);
+    ++access_version;
+
     setRoomMap(0);
 
     displaced_items.clear();
+    item_tally.clear();
+    critical_items.clear();
 }
 
 void DungeonMap::setRoomMap(RoomMap *r)
@@ -147,9 +156,8 @@ void DungeonMap::setRoomMap(RoomMap *r)
 
 void DungeonMap::getEntities(const MapCoord &mc, vector<shared_ptr<Entity> > &results) const
 {
-    results.clear();
-    pair<EntityContainer::iterator, EntityContainer::iterator> p = entities.equal_range(mc);
-    transform(p.first, p.second, back_inserter(results), GetSecond<shared_ptr<Entity> >());
+    const EntityList &ents = getEntitiesAt(mc);
+    results.assign(ents.begin(), ents.end());
 }
 
 void DungeonMap::getAllEntities(const MapCoord &mc, vector<shared_ptr<Entity> > &results)
@@ -175,11 +183,8 @@ namespace {
 void DungeonMap::doEntity(const MapCoord &mc, MapDirection facing, 
                           vector<shared_ptr<Entity> > &results) const
 {
-    if (valid(mc)) {
-        vector<shared_ptr<Entity> > ents;
-        getEntities(mc, ents);
-        ::copy_if(ents.begin(), ents.end(), back_inserter(results), ApproachTest(facing));
-    }
+    const EntityList &ents = getEntitiesAt(mc);
+    ::copy_if(ents.begin(), ents.end(), back_inserter(results), ApproachTest(facing));
 }
 
 shared_ptr<Creature> DungeonMap::getTargetCreatureHelper(const Entity &attacker,
@@ -190,14 +195,13 @@ shared_ptr<Creature> DungeonMap::getTargetCreatureHelper(const Entity &attacker,
     const int halfway_point_upper = sloppy ? 600 : 500;
     const int halfway_point_lower = sloppy ? 400 : 500;
     
-    vector<shared_ptr<Entity> > ents;
     shared_ptr<Creature> result;
     MapHeight result_height;
     
     // We don't have a separate index for "targettable creatures"; instead we rely
-    // on dynamic casting from the main entities index (getEntities)...
-    getEntities(mc, ents);
-    for (vector<shared_ptr<Entity> >::iterator it = ents.begin(); it != ents.end(); ++it) {
+    // on dynamic casting from the main entities index (getEntitiesAt)...
+    const EntityList &ents = getEntitiesAt(mc);
+    for (EntityList::const_iterator it = ents.begin(); it != ents.end(); ++it) {
         if (
 
         // Check that I am not targetting myself!
@@ -268,9 +272,8 @@ MapAccess DungeonMap::getAccess(const MapCoord &mc, MapHeight h, Entity *ignore)
     // one entity can be present per square per height.
     // 22-Oct-2006: changed this so that an entity which is moving outwards and which
     // is more than 50% through its move, does not block a square.
-    vector<shared_ptr<Entity> > ents;
-    getEntities(mc, ents);
-    for (vector<shared_ptr<Entity> >::iterator it = ents.begin(); it != ents.end(); ++it) {
+    const EntityList &ents = entities[index(mc)];
+    for (EntityList::const_iterator it = ents.begin(); it != ents.end(); ++it) {
         if (it->get() != ignore
             && (*it)->getHeight() == h
             && ((*it)->getOffset() < halfway_mark || 
@@ -282,19 +285,39 @@ MapAccess DungeonMap::getAccess(const MapCoord &mc, MapHeight h, Entity *ignore)
     return getAccessTilesOnly(mc, h);
 }
 
-MapAccess DungeonMap::getAccessTilesOnly(const MapCoord &mc, MapHeight h) const
+void DungeonMap::updateTileAccess(int idx)
 {
-    if (!valid(mc)) return A_BLOCKED;   // no such square
-
-    // Check for Tiles.
-    MapAccess result = A_CLEAR;
-    int i = index(mc);
-    for (list<shared_ptr<Tile> >::const_iterator it = tiles[i].begin(); it != tiles[i].end();
-    ++it) {
-        MapAccess a = (*it)->getAccess(h);
-        if (a < result) result = a;
+    TileAccess &ta = tile_access[idx];
+    for (int h = 0; h <= H_MISSILES; ++h) {
+        MapAccess result = A_CLEAR;
+        for (TileList::const_iterator it = tiles[idx].begin(); it != tiles[idx].end(); ++it) {
+            MapAccess a = (*it)->getAccess(MapHeight(h));
+            if (a < result) result = a;
+        }
+        if (ta.acc[h] != (unsigned char)result) {
+            ta.acc[h] = (unsigned char)result;
+            ++access_version;
+        }
+    }
+
+    MiniMapColour col = COL_UNMAPPED;
+    for (TileList::const_iterator it = tiles[idx].begin(); it != tiles[idx].end(); ++it) {
+        const MiniMapColour c = (*it)->getColour();
+        if (c < col) col = c;
+    }
+    ta.colour = (unsigned char)col;
+}
+
+void DungeonMap::tileAccessChanged(const MapCoord &mc)
+{
+    if (valid(mc)) updateTileAccess(index(mc));
+}
+
+void DungeonMap::tileAccessChanged()
+{
+    for (int i = 0; i < int(tile_access.size()); ++i) {
+        updateTileAccess(i);
     }
-    return result;
 }
 
 //
@@ -306,12 +329,11 @@ bool DungeonMap::canPlaceMissile(const MapCoord &mc, MapDirection dir) const
     // Note it's ok to place a missile on mc, as long as no other
     // missile is already present, however access for tile ahead is
     // checked in the normal way.
-    vector<shared_ptr<Entity> > ents;
-    getEntities(mc, ents);
+    const EntityList &ents = getEntitiesAt(mc);
 
     MapHeight h = MapHeight(int(H_MISSILES) + int(dir));
 
-    for (vector<shared_ptr<Entity> >::iterator it = ents.begin(); it != ents.end(); ++it) {
+    for (EntityList::const_iterator it = ents.begin(); it != ents.end(); ++it) {
         if ((*it)->getHeight() == h) return false;
     }
     return (getAccess(DisplaceCoord(mc, dir), h) > A_BLOCKED);
@@ -324,8 +346,7 @@ bool DungeonMap::canPlaceMissile(const MapCoord &mc, MapDirection dir) const
 
 shared_ptr<Item> DungeonMap::getItem(const MapCoord &mc) const
 {
-    ItemContainer::const_iterator it = items.find(mc);
-    if (it != items.end()) return it->second;
+    if (valid(mc)) return items[index(mc)];
     else return shared_ptr<Item>();
 }
 
@@ -338,8 +359,10 @@ bool DungeonMap::addItem(const MapCoord &mc, shared_ptr<Item> it)
 {
     if (!valid(mc)) return false;
     if (!it) return false;
-    pair<ItemContainer::iterator,bool> p = items.insert(make_pair(mc,it));
-    if (!p.second) return false;
+    shared_ptr<Item> &slot = items[index(mc)];
+    if (slot) return false;
+    slot = it;
+    countItem(mc, it.get(), 1);
     Mediator::instance().onAddItem(*this, mc, *it);
     return true;
 }
@@ -347,13 +370,38 @@ bool DungeonMap::addItem(const MapCoord &mc, shared_ptr<Item> it)
 bool DungeonMap::rmItem(const MapCoord &mc)
 {
     if (!valid(mc)) return false;
-    ItemContainer::iterator itor = items.find(mc);
-    if (itor == items.end()) return false;
-    Mediator::instance().onRmItem(*this, mc, *itor->second);
-    items.erase(itor);
+    shared_ptr<Item> &slot = items[index(mc)];
+    if (!slot) return false;
+    Mediator::instance().onRmItem(*this, mc, *slot);
+    countItem(mc, slot.get(), -1);
+    slot.reset();
     return true;
 }
 
+void DungeonMap::itemNumberChanged(const MapCoord &mc, int old_number)
+{
+    if (!valid(mc)) return;
+    const Item *item = items[index(mc)].get();
+    if (item) item_tally.change(item->getType(), 0, item->getNumber() - old_number);
+}
+
+void DungeonMap::placedItemChanged(const MapCoord &mc, const Item *old_item, const Item *new_item)
+{
+    countItem(mc, old_item, -1);
+    countItem(mc, new_item, 1);
+}
+
+void DungeonMap::countItem(const MapCoord &mc, const Item *item, int sign)
+{
+    if (!item) return;
+    item_tally.change(item->getType(), sign, sign * item->getNumber());
+    if (item->getType().isCritical()) {
+        int &n = critical_items[mc];
+        n += sign;
+        if (n == 0) critical_items.erase(mc);
+    }
+}
+
 bool DungeonMap::addTile(const MapCoord &mc, shared_ptr<Tile> t, const Originator &originator)
 {
     if (!valid(mc)) return false;
@@ -366,7 +414,7 @@ bool DungeonMap::addTile(const MapCoord &mc, shared_ptr<Tile> t, const Originato
 
     const int idx = index(mc);
     const int tdepth = t->getDepth();
-    list<shared_ptr<Tile> >::iterator it;
+    TileList::iterator it;
 
     bool need_sweep_items = false;
     bool need_destroy_items = (t->destroyItems());
@@ -396,6 +444,8 @@ bool DungeonMap::addTile(const MapCoord &mc, shared_ptr<Tile> t, const Originato
          it != tiles[idx].end() && (*it)->getDepth() >= tdepth;
          ++it) ; // move "it" up to the correct position
     tiles[idx].insert(it, t);
+    updateTileAccess(idx);
+    placedItemChanged(mc, 0, t->getPlacedItem().get());
 
     // "post" events
     Mediator::instance().onAddTile(*this, mc, *t, originator);
@@ -420,7 +470,7 @@ bool DungeonMap::rmTile(const MapCoord &mc, shared_ptr<Tile> t, const Originator
     if (!valid(mc)) return false;
     if (!t) return false;
     const int idx = index(mc);
-    list<shared_ptr<Tile> >::iterator it;
+    TileList::iterator it;
 
     // find where to remove the tile from   
     it = find(tiles[idx].begin(), tiles[idx].end(), t);
@@ -428,6 +478,8 @@ bool DungeonMap::rmTile(const MapCoord &mc, shared_ptr<Tile> t, const Originator
 
     // remove it
     tiles[idx].erase(it);
+    updateTileAccess(idx);
+    placedItemChanged(mc, t->getPlacedItem().get(), 0);
 
     // "post" events
     Mediator::instance().onRmTile(*this, mc, *t, originator);
@@ -440,19 +492,27 @@ void DungeonMap::clearTiles(const MapCoord &mc)
     if (!valid(mc)) return;
     const int idx = index(mc);
 
-    for (list<shared_ptr<Tile> >::iterator it = tiles[idx].begin();
+    for (TileList::iterator it = tiles[idx].begin();
     it != tiles[idx].end(); ++it) {
         Mediator::instance().onRmTile(*this, mc, **it, Originator(OT_None()));
+        placedItemChanged(mc, (*it)->getPlacedItem().get(), 0);
     }
     tiles[idx].clear();
+    updateTileAccess(idx);
 }
 
 void DungeonMap::clearAll()
 {
     displaced_items.clear();
-    entities.clear();
-    items.clear();
+    for (EntityContainer::iterator it = entities.begin(); it != entities.end(); ++it) {
+        it->clear();
+    }
+    std::fill(items.begin(), items.end(), shared_ptr<Item>());
     tiles.clear();
+    tile_access.clear();
+    ++access_version;
+    item_tally.clear();
+    critical_items.clear();
 }
 
 
@@ -464,8 +524,8 @@ void DungeonMap::getTiles(const MapCoord &mc, vector<shared_ptr<Tile> > &output)
 {
     output.clear();
     if (!valid(mc)) return;
-    const list<shared_ptr<Tile> > & t(tiles[index(mc)]);
-    copy(t.begin(), t.end(), back_inserter(output));
+    const TileList & t(tiles[index(mc)]);
+    output.assign(t.begin(), t.end());
 }
 
 
@@ -497,18 +557,23 @@ public:
             ++di.tries;
             
             // Generate a random map square
-            const int x = g_rng.getInt(0, dmap.getWidth());
-            const int y = g_rng.getInt(0, dmap.getHeight());
+            const int x = Mediator::getRNG().getInt(0, dmap.getWidth());
+            const int y = Mediator::getRNG().getInt(0, dmap.getHeight());
             const MapCoord mc(x,y);
 
             // Attempt to drop the item into the square
             // Note: don't allow nonlocal drop - if a "local" drop fails, we might as well just wait
             // until the next attempt.
+            // Note: DropItem may change the item's number (if it is partly merged into an
+            // existing stack) so we take it out of the tally while it is being dropped.
+            dmap.item_tally.remove(*di.item);
             const bool result = DropItem(di.item, dmap, mc, false, false, D_NORTH, shared_ptr<Creature>());
+            dmap.item_tally.add(*di.item);
         
             if (result || di.item->getNumber() == 0) {
                 // Drop was successful.
                 printRespawnMessage(di);
+                dmap.item_tally.remove(*di.item);
                 dmap.displaced_items.erase(dmap.displaced_items.begin() + which_item);
                 break;   // Exit after first successful replacement
             } else {
@@ -520,6 +585,7 @@ public:
                     boost::shared_ptr<Item> current_item = dmap.getItem(mc);
                     if (current_item) {
                         dmap.rmItem(mc);
+                        dmap.item_tally.remove(*di.item);
                         dmap.addItem(mc, di.item);
                         printRespawnMessage(di);
                         dmap.displaced_items.erase(dmap.displaced_items.begin() + which_item);
@@ -532,7 +598,7 @@ public:
         if (!dmap.displaced_items.empty()) {
             // There are still outstanding items so try again after item_replacement_interval.
             tm.addTask(shared_from_this(), TP_NORMAL, tm.getGVT()
-                + Mediator::instance().cfgInt("item_replacement_interval"));
+                + Mediator::instance().cfg().item_replacement_interval);
         }
     }
 
@@ -556,18 +622,20 @@ void DungeonMap::addDisplacedItem(shared_ptr<Item> i)
     if (displaced_items.empty()) {
         shared_ptr<Task> t(new ItemReplacementTask(*this));
         TaskManager &tm(Mediator::instance().getTaskManager());
-        tm.addTask(t, TP_NORMAL, tm.getGVT() + Mediator::instance().cfgInt("item_replacement_interval"));
+        tm.addTask(t, TP_NORMAL, tm.getGVT() + Mediator::instance().cfg().item_replacement_interval);
     }
     DisplacedItem di;
     di.item = i;
     displaced_items.push_back(di);
+    item_tally.add(*i);
 }
 
 void DungeonMap::countItems(std::map<ItemType*, int> &result) const
 {
     // search items on tiles.
     for (ItemContainer::const_iterator it = items.begin(); it != items.end(); ++it) {
-        ItemType * item_type = &it->second->getType();
+        if (!*it) continue;
+        ItemType * item_type = &(*it)->getType();
         std::map<ItemType*, int>::iterator result_it = result.find(item_type);
         if (result_it != result.end()) ++result_it->second;
     }
@@ -581,7 +649,7 @@ void DungeonMap::countItems(std::map<ItemType*, int> &result) const
 
     // search items "stored" in tiles. This catches items in chests.
     for (TileContainer::const_iterator it1 = tiles.begin(); it1 != tiles.end(); ++it1) {
-        for (list<shared_ptr<Tile> >::const_iterator it2 = it1->begin(); it2 != it1->end(); ++it2) {
+        for (TileList::const_iterator it2 = it1->begin(); it2 != it1->end(); ++it2) {
             const Item * placed_item = (*it2)->getPlacedItem().get();
             if (placed_item) {
                 ItemType * item_type = &placed_item->getType();
@@ -34,15 +34,13 @@
 #ifndef DUNGEON_MAP_HPP
 #define DUNGEON_MAP_HPP
 
+#include "item_tally.hpp"
 #include "map_support.hpp"
+#include "mini_map_colour.hpp"
 
-#include "boost/multi_index_container.hpp"
-#include "boost/multi_index/hashed_index.hpp"
 #include "boost/shared_ptr.hpp"
 using namespace boost;
-using namespace boost::multi_index;
 
-#include <list>
 #include <map>
 #include <vector>
 
@@ -82,7 +80,32 @@ public:
     MapAccess getAccess(const MapCoord &mc, MapHeight h, Entity *ignore = 0) const;
 
     // same, but checks only tiles -- not entities.
-    MapAccess getAccessTilesOnly(const MapCoord &mc, MapHeight h) const;
+    // (This is a simple lookup; the combined access level of the tiles on each square
+    // is cached.)
+    MapAccess getAccessTilesOnly(const MapCoord &mc, MapHeight h) const
+    {
+        if (!valid(mc)) return A_BLOCKED;   // no such square
+        return MapAccess(tile_access[index(mc)].acc[h > H_MISSILES ? H_MISSILES : h]);
+    }
+
+    // This must be called if the MapAccess of a tile changes while the tile is in the
+    // map. (Tile::setAccess does this automatically.) The second version can be used if
+    // the position of the tile is not known; it updates the whole map.
+    void tileAccessChanged(const MapCoord &mc);
+    void tileAccessChanged();
+
+    // Counter that is incremented whenever the result of
+    // getAccessTilesOnly changes for any square (e.g. a door opens).
+    // Used to tell when cached pathfinding data is out of date.
+    unsigned int getAccessVersion() const { return access_version; }
+
+    // The lowest (i.e. most wall-like) mini map colour of any tile on the square, or
+    // COL_UNMAPPED if there are no tiles. Cached, like getAccessTilesOnly.
+    MiniMapColour getMiniMapColour(const MapCoord &mc) const
+    {
+        if (!valid(mc)) return COL_UNMAPPED;
+        return MiniMapColour(tile_access[index(mc)].colour);
+    }
     
     // check if we can place a new missile at a given square
     bool canPlaceMissile(const MapCoord &mc, MapDirection dir_of_travel) const;
@@ -106,6 +129,14 @@ public:
     bool addTile(const MapCoord &mc, shared_ptr<Tile> ti, const Originator &);
     bool rmTile(const MapCoord &mc, shared_ptr<Tile> ti, const Originator &);
 
+    // This must be called if the number of an item (Item::setNumber) changes while the
+    // item is in the map.
+    void itemNumberChanged(const MapCoord &mc, int old_number);
+
+    // This must be called if the placed item of a tile changes while the tile is in the
+    // map. (Tile::placeItem does this automatically, if given a DungeonMap.)
+    void placedItemChanged(const MapCoord &mc, const Item *old_item, const Item *new_item);
+
     // this removes all tiles at a given mapcoord.
     void clearTiles(const MapCoord &mc);
 
@@ -117,6 +148,14 @@ public:
     // NB if an entity is halfway between squares then it counts as being on both of those
     // squares.
     void getEntities(const MapCoord &mc, std::vector<boost::shared_ptr<Entity> > &results) const;
+
+    // Non-copying version of getEntities. Returns a reference to the map's own list of
+    // entities at the given square (an empty list if mc is invalid).
+    // NOTE: The list may change if any entity moves, or is added to or removed from the
+    // map. Callers that might cause this while iterating (e.g. by damaging creatures, or
+    // running Lua code) must use getEntities instead.
+    const std::vector<boost::shared_ptr<Entity> > & getEntitiesAt(const MapCoord &mc) const
+        { return valid(mc) ? entities[index(mc)] : no_entities; }
     
     // get all entities, including approached ones
     // return them in "results" vector (existing contents of "results" vector are cleared).
@@ -137,6 +176,13 @@ public:
     // Returns results in a vector (not the most efficient method, but probably the most
     // flexible). Existing contents of the vector are deleted.
     void getTiles(const MapCoord &mc, std::vector<boost::shared_ptr<Tile> > &output) const;
+
+    // Non-copying version of getTiles. Returns a reference to the map's own list of
+    // tiles at the given square (an empty list if mc is invalid).
+    // NOTE: As with getEntitiesAt, callers that might add or remove tiles (including
+    // indirectly, e.g. by running Lua code) while iterating must use getTiles instead.
+    const std::vector<boost::shared_ptr<Tile> > & getTilesAt(const MapCoord &mc) const
+        { return valid(mc) ? tiles[index(mc)] : no_tiles; }
     
     // displaced items:
     // Used for items that should have been dropped (eg when a knight died), but there
@@ -144,12 +190,23 @@ public:
     // (onto a random square) as soon as possible.
     void addDisplacedItem(shared_ptr<Item> i);
 
-    // Direct access to the displaced items vector. NOTE: Do not use this to add displaced items
-    // as it will not set up the item replacement task. (Call addDisplacedItem instead.) It should
-    // be ok to remove items, or modify existing ones, though.
-    std::vector<DisplacedItem> & getDisplacedItems() { return displaced_items; }
+    // Read-only access to the displaced items vector. (Items must be added through
+    // addDisplacedItem, so that the item replacement task is set up and the item tally is
+    // kept up to date.)
+    const std::vector<DisplacedItem> & getDisplacedItems() const { return displaced_items; }
+
+    // Running count of all items on the floor, placed in tiles (e.g. chests), or waiting in
+    // the displaced items list. (The contents of stuff bags are counted separately by
+    // StuffManager.)
+    const ItemTally & getItemTally() const { return item_tally; }
 
-    // Count items of various types. Used by item respawn code
+    // Squares where there is a critical item, either on the floor or placed in a tile.
+    // (The value is the number of critical items on the square.) Items in stuff bags are
+    // not included; see StuffManager::getStuffBagSquares.
+    const std::map<MapCoord, int> & getCriticalItemSquares() const { return critical_items; }
+
+    // Count items of various types by searching the whole map. (Slow -- getItemTally
+    // should normally be used instead. This is kept for checking the tally in debug builds.)
     void countItems(std::map<ItemType*, int> &result) const;
     
 private:
@@ -159,54 +216,63 @@ private:
 
     // helper for getTargetCreature
     shared_ptr<Creature> getTargetCreatureHelper(const Entity &, const MapCoord &, bool) const;
+
+    // recalculate tile_access for one square
+    void updateTileAccess(int idx);
+
+    // add (sign=1) or remove (sign=-1) an item on the floor, or placed in a tile, to/from
+    // item_tally and critical_items
+    void countItem(const MapCoord &mc, const Item *item, int sign);
     
     // get index corresponding to a mapcoord
     int index(const MapCoord &mc) const
         { ASSERT(valid(mc)); return mc.getY() * map_width + mc.getX(); }
     
 private:
-    // Dungeon contents. Use hash tables for entities and items (since
-    // these are likely to be sparse) but a straightforward
-    // index-by-square for tiles (tiles are likely to be dense, with
-    // at least one on each square). Use boost::multi_index for the
-    // hash tables (I don't like to rely on hash_map/hash_set since
-    // they seem to be non-standardized between different compilers).
+    // Dungeon contents. Entities, items and tiles are all stored
+    // index-by-square. Each square has a (usually very short) list of
+    // entities, at most one item, and a list of tiles (sorted by
+    // depth, highest first). The per-square lists keep their capacity
+    // as things come and go, so once the game is under way, moving
+    // entities around does not allocate memory.
 
     // Note that any Entity halfway between two squares is given two
     // separate entries in entities index (except for approaching
     // entities which only get one entry, on their "base" square).
 
-    template<class T>
-    struct GetPos {
-        typedef MapCoord result_type;
-        const MapCoord & operator()(const std::pair<MapCoord, T> &p) const {
-            return p.first;
-        }
-    };
-    template<class T>
-    struct GetSecond {
-        typedef MapCoord result_type;
-        const T & operator()(const std::pair<MapCoord,T> &p) const {
-            return p.second;
-        }
-    };
-
-    typedef boost::multi_index_container<std::pair<MapCoord, shared_ptr<Entity> >, 
-        indexed_by< hashed_non_unique<GetPos<shared_ptr<Entity> > > > > EntityContainer;
-    typedef boost::multi_index_container<std::pair<MapCoord, shared_ptr<Item> >,
-        indexed_by< hashed_unique<GetPos<shared_ptr<Item> > > > > ItemContainer;
-    typedef std::vector<std::list<shared_ptr<Tile> > > TileContainer;
+    typedef std::vector<shared_ptr<Entity> > EntityList;
+    typedef std::vector<EntityList> EntityContainer;
+    typedef std::vector<shared_ptr<Item> > ItemContainer;
+    typedef std::vector<shared_ptr<Tile> > TileList;
+    typedef std::vector<TileList> TileContainer;
 
     EntityContainer entities;
     ItemContainer items;
     TileContainer tiles;
 
+    // For each square, the lowest MapAccess of any tile on that square,
+    // at each height from 0 to H_MISSILES, and the lowest MiniMapColour.
+    // Kept up to date by addTile, rmTile, clearTiles and tileAccessChanged.
+    struct TileAccess {
+        unsigned char acc[H_MISSILES + 1];
+        unsigned char colour;
+    };
+    std::vector<TileAccess> tile_access;
+    unsigned int access_version;
+
+    static const EntityList no_entities;
+    static const TileList no_tiles;
+
     int map_width, map_height;
 
     RoomMap *room_map;
 
     // List of items that need to be re-placed
     std::vector<DisplacedItem> displaced_items;
+
+    // Counts of the items in "items", "displaced_items" and placed in "tiles".
+    ItemTally item_tally;
+    std::map<MapCoord, int> critical_items;
     friend class ItemReplacementTask;
 };
 
@@ -0,0 +1,81 @@
+/*
+ * engine_config.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "config_map.hpp"
+#include "engine_config.hpp"
+
+#include <stdexcept>
+
+namespace {
+    float GetProbability(const ConfigMap &cmap, const std::string &key)
+    {
+        const float p = cmap.getFloat(key);
+        if (p < 0 || p > 1) throw std::runtime_error("Config error: " + key + " must be between 0 and 1");
+        return p;
+    }
+}
+
+EngineConfig::EngineConfig(const ConfigMap &cmap)
+{
+    action_delay = cmap.getInt("action_delay");
+    approach_offset = cmap.getInt("approach_offset");
+    att_mov_anim_time = cmap.getInt("att_mov_anim_time");
+    att_mov_delay_time = cmap.getInt("att_mov_delay_time");
+    attack_threshold = cmap.getInt("attack_threshold");
+    blood_icon_duration = cmap.getInt("blood_icon_duration");
+    control_poll_interval = cmap.getInt("control_poll_interval");
+    control_refresh_interval = cmap.getInt("control_refresh_interval");
+    crossbow_delay = cmap.getInt("crossbow_delay");
+    dagger_time_delay = cmap.getInt("dagger_time_delay");
+    door_closed_damage = cmap.getInt("door_closed_damage");
+    dungeon_layout_attempts = cmap.getInt("dungeon_layout_attempts");
+    fast_regen_amount = cmap.getInt("fast_regen_amount");
+    fast_regen_time = cmap.getInt("fast_regen_time");
+    flying_monster_bite_wait = cmap.getInt("flying_monster_bite_wait");
+    flying_monster_targetting_offset = cmap.getInt("flying_monster_targetting_offset");
+    healing_amount = cmap.getInt("healing_amount");
+    healing_time = cmap.getInt("healing_time");
+    item_replacement_interval = cmap.getInt("item_replacement_interval");
+    knight_hitpoints = cmap.getInt("knight_hitpoints");
+    melee_delay_time = cmap.getInt("melee_delay_time");
+    missile_check_interval = cmap.getInt("missile_check_interval");
+    monster_ai_batching = cmap.getInt("monster_ai_batching") != 0;
+    monster_interval = cmap.getInt("monster_interval");
+    monster_radius = cmap.getInt("monster_radius");
+    monster_wait_chance = GetProbability(cmap, "monster_wait_chance");
+    monster_wait_time = cmap.getInt("monster_wait_time");
+    parry_delay = cmap.getInt("parry_delay");
+    player_task_interval = cmap.getInt("player_task_interval");
+    quickness_factor = cmap.getInt("quickness_factor");
+    respawn_delay = cmap.getInt("respawn_delay");
+    slow_regen_amount = cmap.getInt("slow_regen_amount");
+    slow_regen_time = cmap.getInt("slow_regen_time");
+    super_regen_amount = cmap.getInt("super_regen_amount");
+    super_regen_time = cmap.getInt("super_regen_time");
+    turn_delay = cmap.getInt("turn_delay");
+    walk_limit = cmap.getInt("walk_limit");
+    walk_time = cmap.getInt("walk_time");
+    walking_monster_damage_delay = cmap.getInt("walking_monster_damage_delay");
+}
@@ -0,0 +1,85 @@
+/*
+ * engine_config.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * EngineConfig holds the values from the MISC_CONFIG table that the
+ * engine uses during the game. These are read from the ConfigMap
+ * once, when the game starts (so that a missing or invalid setting is
+ * reported straight away), and can then be read cheaply via
+ * Mediator::cfg().
+ *
+ * To add a new setting, add a field below and read it in the
+ * constructor (engine_config.cpp).
+ *
+ */
+
+#ifndef ENGINE_CONFIG_HPP
+#define ENGINE_CONFIG_HPP
+
+class ConfigMap;
+
+struct EngineConfig {
+    explicit EngineConfig(const ConfigMap &cmap);   // throws BadConfig if a setting is missing
+
+    int action_delay;
+    int approach_offset;
+    int att_mov_anim_time;
+    int att_mov_delay_time;
+    int attack_threshold;
+    int blood_icon_duration;
+    int control_poll_interval;
+    int control_refresh_interval;
+    int crossbow_delay;
+    int dagger_time_delay;
+    int door_closed_damage;
+    int dungeon_layout_attempts;
+    int fast_regen_amount;
+    int fast_regen_time;
+    int flying_monster_bite_wait;
+    int flying_monster_targetting_offset;
+    int healing_amount;
+    int healing_time;
+    int item_replacement_interval;
+    int knight_hitpoints;
+    int melee_delay_time;
+    int missile_check_interval;
+    bool monster_ai_batching;
+    int monster_interval;
+    int monster_radius;
+    float monster_wait_chance;   // probability (0 to 1)
+    int monster_wait_time;
+    int parry_delay;
+    int player_task_interval;
+    int quickness_factor;
+    int respawn_delay;
+    int slow_regen_amount;
+    int slow_regen_time;
+    int super_regen_amount;
+    int super_regen_time;
+    int turn_delay;
+    int walk_limit;
+    int walk_time;
+    int walking_monster_damage_delay;
+};
+
+#endif
@@ -36,7 +36,7 @@
 namespace {
     int TravelTime(int dist, int speed)
     {
-        const int result = Mediator::instance().cfgInt("walk_time") * dist * 100 / (speed * 1000);
+        const int result = Mediator::instance().cfg().walk_time * dist * 100 / (speed * 1000);
         return (result > 0) ? result : 1;   // result should be at least 1.
     }
 }
@@ -290,7 +290,7 @@ void Entity::getAnimData(const Anim *&a, const Overlay *&ov, int &f, int &zt, bo
 void Entity::move(MotionType mt, bool missile_mode /* = false */)
 {
     Mediator &mediator = Mediator::instance();
-    const int approach_offset = mediator.cfgInt("approach_offset");
+    const int approach_offset = mediator.cfg().approach_offset;
     const int points_per_square = 1000;
 
     // Get some constants
@@ -352,7 +352,7 @@ void Entity::move(MotionType mt, bool missile_mode /* = false */)
 void Entity::flipMotion()
 {
     Mediator &mediator = Mediator::instance();
-    const int turn_delay = mediator.cfgInt("turn_delay");
+    const int turn_delay = mediator.cfg().turn_delay;
     
     if (!dmap) return;
     if (!isMoving() || isApproaching()) return;
@@ -391,7 +391,7 @@ void Entity::flipMotion()
 int Entity::getOffset() const
 {
     Mediator &mediator = Mediator::instance();
-    const int approach_offset = mediator.cfgInt("approach_offset");
+    const int approach_offset = mediator.cfg().approach_offset;
     
     if (!getMap()) return 0;
     const MotionType mt = getMotionType();
@@ -65,7 +65,7 @@ void GoreManager::placeBlood(DungeonMap &dmap, const MapCoord &mc)
 {
     Mediator &mediator = Mediator::instance();
     placeNextTile(dmap, mc, blood_tiles);
-    mediator.placeIcon(dmap, mc, blood_icon, mediator.cfgInt("blood_icon_duration"));
+    mediator.placeIcon(dmap, mc, blood_icon, mediator.cfg().blood_icon_duration);
 }
 
 void GoreManager::placeKnightCorpse(DungeonMap &dmap, const MapCoord &mc, const Player &pl,
@@ -165,7 +165,7 @@ void HomeManager::getRandomHomeFor(Player &pl,
     } else {
     
         // Generate a random number ...
-        int r = g_rng.getInt(0, int(unsecured_homes.size()));
+        int r = Mediator::getRNG().getInt(0, int(unsecured_homes.size()));
 
         // ... and return the rth home
         dmap_out = unsecured_homes[r].dmap;
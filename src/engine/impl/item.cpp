@@ -173,6 +173,7 @@ bool DropItem(shared_ptr<Item> drop_item, DungeonMap &dmap, const MapCoord &mc,
             int new_number = curr_item->getNumber() + drop_item->getNumber();
             int max_stack = drop_item->getType().getMaxStack();
             bool drop_all;
+            const int curr_item_orig_num = curr_item->getNumber();
             if (new_number > max_stack) {
                 // We can drop some, but not all, into the existing stack
                 curr_item->setNumber(max_stack);
@@ -184,6 +185,7 @@ bool DropItem(shared_ptr<Item> drop_item, DungeonMap &dmap, const MapCoord &mc,
                 drop_item->setNumber(0);
                 drop_all = true;
             }
+            dmap.itemNumberChanged(dest, curr_item_orig_num);
             if (curr_item->getGraphic() != old_graphic) {
                 mediator.onChangeItemGraphic(dmap, dest, *curr_item);
             }
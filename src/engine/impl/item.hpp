@@ -37,6 +37,7 @@
 #define ITEM_HPP
 
 #include "item_type.hpp"
+#include "map_support.hpp"
 #include "originator.hpp"
 
 //
@@ -38,6 +38,8 @@ ItemCheckTask::ItemCheckTask(DungeonMap &dmap_, int interval_)
 {
     // scan the dungeon for any critical items.
     // (this is the "inverse" of findMissingItems.)
+    // (this searches the whole dungeon, but only has to be done once; after this,
+    // countMissingItems can use the running item tallies instead.)
     
     findMissingItems(required_items);
 
@@ -49,7 +51,17 @@ ItemCheckTask::ItemCheckTask(DungeonMap &dmap_, int interval_)
 void ItemCheckTask::execute(TaskManager &tm)
 {
     std::map<ItemType *, int> missing_items;
-    findMissingItems(missing_items);
+    countMissingItems(missing_items);
+
+#ifndef NDEBUG
+    // Check the item tallies against a full search of the dungeon.
+    std::map<ItemType *, int> check_items;
+    findMissingItems(check_items);
+    for (std::map<ItemType *, int>::const_iterator it = missing_items.begin(); it != missing_items.end(); ++it) {
+        ASSERT(check_items[it->first] == it->second);
+    }
+#endif
+    
     for (std::map<ItemType *, int>::const_iterator it = missing_items.begin(); it != missing_items.end(); ++it) {
         if (it->second > 0) {
             // Add to displaced items list
@@ -80,6 +92,32 @@ void ItemCheckTask::processItem(std::map<ItemType *, int> &missing_items, const
     processItemType(missing_items, item->getType(), item->getNumber());
 }
 
+void ItemCheckTask::countMissingItems(std::map<ItemType *, int> &missing_items) const
+{
+    Mediator & mediator = Mediator::instance();
+    const ItemTally & map_tally = dmap.getItemTally();
+    const ItemTally & stuff_tally = mediator.getStuffManager().getItemTally();
+    const std::vector<Player*> & players = mediator.getPlayers();
+
+    missing_items = required_items;
+
+    for (std::map<ItemType *, int>::iterator it = missing_items.begin(); it != missing_items.end(); ++it) {
+        ItemType & itype = *it->first;
+
+        // items on the map, in chests, or displaced; and items in stuff bags.
+        it->second -= map_tally.getUnits(itype) + stuff_tally.getUnits(itype);
+
+        // items held by knights.
+        for (std::vector<Player*>::const_iterator p = players.begin(); p != players.end(); ++p) {
+            boost::shared_ptr<Knight> kt = (*p)->getKnight();
+            if (kt) {
+                if (kt->getItemInHand() == &itype) --(it->second);
+                it->second -= kt->getNumCarried(itype);
+            }
+        }
+    }
+}
+
 void ItemCheckTask::findMissingItems(std::map<ItemType *, int> &missing_items) const
 {
     Mediator & mediator = Mediator::instance();
@@ -130,8 +168,8 @@ void ItemCheckTask::findMissingItems(std::map<ItemType *, int> &missing_items) c
 
     // check for displaced items.
     // call processItem on each.
-    std::vector<DungeonMap::DisplacedItem> & displaced_items = dmap.getDisplacedItems();
-    for (std::vector<DungeonMap::DisplacedItem>::iterator it = displaced_items.begin(); it != displaced_items.end(); ++it) {
+    const std::vector<DungeonMap::DisplacedItem> & displaced_items = dmap.getDisplacedItems();
+    for (std::vector<DungeonMap::DisplacedItem>::const_iterator it = displaced_items.begin(); it != displaced_items.end(); ++it) {
         processItem(missing_items, it->item);
     }
 }
@@ -28,6 +28,10 @@
  * present in the dungeon. If not, it adds them to the dungeonmap for
  * respawning (as "displaced items").
  *
+ * The check uses the running item tallies kept by DungeonMap and
+ * StuffManager (see ItemTally), so it does not need to search the
+ * whole dungeon each time.
+ *
  * NOTE: This duplicates a lot of what is done in ItemRespawnTask so
  * maybe the two classes should be merged together somehow.
  * 
@@ -60,6 +64,7 @@ public:
 private:
     static void processItemType(std::map<ItemType *, int> &missing_items, ItemType &itype, int no);
     static void processItem(std::map<ItemType *, int> &missing_items, const boost::shared_ptr<Item> &item);
+    void countMissingItems(std::map<ItemType *, int> &missing_items) const;
     void findMissingItems(std::map<ItemType *, int> &missing_items) const;
     
 private:
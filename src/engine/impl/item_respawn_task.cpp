@@ -81,6 +81,42 @@ ItemRespawnTask::ItemRespawnTask(const std::vector<ItemType*> &items_to_respawn,
 void ItemRespawnTask::countItems(std::map<ItemType*, int> &result) const
 {
     // "result" is assumed to be initialized with the desired item types.
+
+    const Mediator & mediator = Mediator::instance();
+    const ItemTally & stuff_tally = mediator.getStuffManager().getItemTally();
+    const DungeonMap * dmap = mediator.getMap().get();
+
+#ifndef NDEBUG
+    // Check the item tallies against a full search of the dungeon.
+    std::map<ItemType*, int> check = result;
+    searchItems(check);
+#endif
+
+    for (std::map<ItemType*, int>::iterator item_it = result.begin();
+    item_it != result.end(); ++item_it) {
+        const ItemType & item_type = *item_it->first;
+
+        // Count items held by players
+        for (vector<Player*>::const_iterator player_it = mediator.getPlayers().begin();
+        player_it != mediator.getPlayers().end(); ++player_it) {
+            shared_ptr<Knight> kt((*player_it)->getKnight());
+            if (kt) {
+                item_it->second += kt->getNumCarried(item_type);
+                if (kt->getItemInHand() == &item_type) ++ item_it->second;
+            }
+        }
+
+        // Count items stored in stuff bags, and items in the map
+        item_it->second += stuff_tally.getStacks(item_type);
+        if (dmap) item_it->second += dmap->getItemTally().getStacks(item_type);
+
+        ASSERT(item_it->second == check[item_it->first]);
+    }
+}
+
+void ItemRespawnTask::searchItems(std::map<ItemType*, int> &result) const
+{
+    // As countItems, but searches the whole dungeon instead of using the item tallies.
     
     const Mediator & mediator = Mediator::instance();
 
@@ -122,10 +158,16 @@ int ItemRespawnTask::countActiveLockpicks() const
         }
 
         // Count lockpicks in stuff bags
-        std::map<ItemType*, int> n_in_stuff_bags;
-        n_in_stuff_bags[lockpicks] = 0;
-        mediator.getStuffManager().countItems(n_in_stuff_bags);
-        result += n_in_stuff_bags[lockpicks];
+        const int n_in_stuff_bags = mediator.getStuffManager().getItemTally().getStacks(*lockpicks);
+        result += n_in_stuff_bags;
+
+#ifndef NDEBUG
+        // Check the tally against a search of all stuff bags
+        std::map<ItemType*, int> check;
+        check[lockpicks] = 0;
+        mediator.getStuffManager().countItems(check);
+        ASSERT(check[lockpicks] == n_in_stuff_bags);
+#endif
     }
 
     return result;
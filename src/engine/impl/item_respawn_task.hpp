@@ -56,6 +56,7 @@ public:
     
 private:
     void countItems(std::map<ItemType*, int> &result) const;
+    void searchItems(std::map<ItemType*, int> &result) const;
     int countActiveLockpicks() const;
     
 private:
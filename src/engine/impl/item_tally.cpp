@@ -0,0 +1,58 @@
+/*
+ * item_tally.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "item.hpp"
+#include "item_tally.hpp"
+
+void ItemTally::add(const Item &item)
+{
+    change(item.getType(), 1, item.getNumber());
+}
+
+void ItemTally::remove(const Item &item)
+{
+    change(item.getType(), -1, -item.getNumber());
+}
+
+void ItemTally::change(const ItemType &itype, int stacks, int units)
+{
+    Count &c = counts[&itype];
+    c.stacks += stacks;
+    c.units += units;
+    ASSERT(c.stacks >= 0 && c.units >= 0);
+    if (c.stacks == 0 && c.units == 0) counts.erase(&itype);
+}
+
+int ItemTally::getStacks(const ItemType &itype) const
+{
+    std::map<const ItemType *, Count>::const_iterator it = counts.find(&itype);
+    return it == counts.end() ? 0 : it->second.stacks;
+}
+
+int ItemTally::getUnits(const ItemType &itype) const
+{
+    std::map<const ItemType *, Count>::const_iterator it = counts.find(&itype);
+    return it == counts.end() ? 0 : it->second.units;
+}
@@ -0,0 +1,64 @@
+/*
+ * item_tally.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * An ItemTally keeps running totals of how many items of each
+ * ItemType are held in some container. Both the number of Item
+ * objects ("stacks") and the total of their getNumber() values
+ * ("units") are tracked.
+ *
+ * DungeonMap keeps a tally of the items in the map, and StuffManager
+ * keeps one for the contents of stuff bags. These are used by
+ * ItemCheckTask and ItemRespawnTask, which would otherwise have to
+ * search the whole dungeon to find out which items still exist.
+ *
+ */
+
+#ifndef ITEM_TALLY_HPP
+#define ITEM_TALLY_HPP
+
+#include <map>
+
+class Item;
+class ItemType;
+
+class ItemTally {
+public:
+    void add(const Item &item);
+    void remove(const Item &item);
+    void change(const ItemType &itype, int stacks, int units);
+    void clear() { counts.clear(); }
+
+    int getStacks(const ItemType &itype) const;
+    int getUnits(const ItemType &itype) const;
+
+private:
+    struct Count {
+        Count() : stacks(0), units(0) { }
+        int stacks;
+        int units;
+    };
+    std::map<const ItemType *, Count> counts;
+};
+
+#endif
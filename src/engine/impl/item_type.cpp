@@ -29,6 +29,7 @@
 #include "item.hpp"
 #include "item_type.hpp"
 #include "lua_setup.hpp"
+#include "mediator.hpp"
 #include "rng.hpp"
 #include "task_manager.hpp"
 #include "tile.hpp"
@@ -304,7 +305,7 @@ void ItemType::doCreatureImpact(int gvt, shared_ptr<Creature> attacker,
     
     int stun_until = melee_stun_time.get() + gvt;
     int damage = melee_damage.get();
-    if (with_strength) damage += g_rng.getInt(1,3); // add d2 dmg if you have strength
+    if (with_strength) damage += Mediator::getRNG().getInt(1,3); // add d2 dmg if you have strength
     target->damage(damage, attacker->getOriginator(), stun_until);
 }
 
@@ -154,18 +154,18 @@ void Knight::resetMagic()
 
         switch (current_potion) {
         case SLOW_REGENERATION:
-            dt = mediator.cfgInt("slow_regen_time");
-            amt = mediator.cfgInt("slow_regen_amount");
+            dt = mediator.cfg().slow_regen_time;
+            amt = mediator.cfg().slow_regen_amount;
             break;
 
         case FAST_REGENERATION:
-            dt = mediator.cfgInt("fast_regen_time");
-            amt = mediator.cfgInt("fast_regen_amount");
+            dt = mediator.cfg().fast_regen_time;
+            amt = mediator.cfg().fast_regen_amount;
             break;
 
         case SUPER:
-            dt = mediator.cfgInt("super_regen_time");
-            amt = mediator.cfgInt("super_regen_amount");
+            dt = mediator.cfg().super_regen_time;
+            amt = mediator.cfg().super_regen_amount;
             break;
         }
 
@@ -188,7 +188,7 @@ void Knight::resetMagic()
 void Knight::resetSpeed()
 {
     if (hasQuickness()) {
-        setSpeed(getBaseSpeed() * Mediator::instance().cfgInt("quickness_factor") / 100);
+        setSpeed(getBaseSpeed() * Mediator::instance().cfg().quickness_factor / 100);
     } else {
         setSpeed(getBaseSpeed());
     }
@@ -279,9 +279,9 @@ void Knight::startHomeHealing()
     Mediator &mediator = Mediator::instance();
     TaskManager &tm(mediator.getTaskManager());
     stopHomeHealing();
-    const int dt = mediator.cfgInt("healing_time");
+    const int dt = mediator.cfg().healing_time;
     home_healing_task.reset(new HealingTask(static_pointer_cast<Creature>(shared_from_this()),
-                                            dt, mediator.cfgInt("healing_amount")));
+                                            dt, mediator.cfg().healing_amount));
     tm.addTask(home_healing_task, TP_NORMAL, tm.getGVT() + dt);
 }
 
@@ -357,7 +357,7 @@ void Knight::swing()
         Mediator &med = Mediator::instance();
         const int gvt = med.getGVT();
         if (!getDaggerThrownFlag()) {
-            dagger_time = gvt + med.cfgInt("dagger_time_delay");
+            dagger_time = gvt + med.cfg().dagger_time_delay;
             setDaggerThrownFlag();
         }
         if (gvt < dagger_time) {
@@ -462,9 +462,12 @@ int Knight::addToBackpack(ItemType &itype, int no_to_add)
 
     no += no_to_add;
     if (no > maxno && maxno != 0) no = maxno;
-    if (no != oldno) getPlayer()->getStatusDisplay().setBackpack
-                         (itype.getBackpackSlot(), itype.getBackpackGraphic(),
-                          itype.getBackpackOverdraw(), no, maxno, itype.getMouseOverHintKey());
+    if (no != oldno) {
+        getPlayer()->getStatusDisplay().setBackpack
+            (itype.getBackpackSlot(), itype.getBackpackGraphic(),
+             itype.getBackpackOverdraw(), no, maxno, itype.getMouseOverHintKey());
+        getPlayer()->invalidateControls();
+    }
     return no - oldno;
 }
 
@@ -473,6 +476,8 @@ void Knight::rmFromBackpack(const ItemType &itype, int no_to_rm)
     int idx = backpackFind(itype);
     if (idx == -1) return;
 
+    getPlayer()->invalidateControls();
+
     int & no(backpack[idx].second);
     no -= no_to_rm;
     if (no <= 0) {
@@ -653,6 +658,13 @@ void Knight::throwAwayItem(const ItemType *i)
     if (getItemInHand()) setOverlay(getItemInHand()->getOverlay());
 }
 
+const DistanceField & Knight::getDistanceField(MapHeight ht)
+{
+    DistanceField &field = (ht == H_FLYING ? flying_field : walking_field);
+    field.update(*getMap(), getPos(), ht);
+    return field;
+}
+
 bool Knight::canThrowItem(const ItemType &it, bool strict) const
 {
     if (!canThrow(strict)) return false;
@@ -670,7 +682,7 @@ void Knight::throwItem(ItemType &it)
         Mediator &med = Mediator::instance();
         const int gvt = med.getGVT();
         if (!getDaggerThrownFlag()) {
-            dagger_time = gvt + med.cfgInt("dagger_time_delay");
+            dagger_time = gvt + med.cfg().dagger_time_delay;
             setDaggerThrownFlag();
         }
         if (gvt < dagger_time) {
@@ -30,6 +30,7 @@
 #define KNIGHT_HPP
 
 #include "creature.hpp"
+#include "distance_field.hpp"
 #include "potion_magic.hpp"
 
 #include <list>
@@ -142,6 +143,12 @@ public:
     // canThrowItem: true if Creature::canThrow() and you are carrying itemtype and itemtype->canThrow().
     bool canThrowItem(const ItemType &itemtype, bool strict) const;
     void throwItem(ItemType &itemtype);
+
+
+    // Distance field leading to this knight (for monster pathfinding),
+    // for monsters moving at the given height (H_WALKING or H_FLYING).
+    // Must only be called while the knight is in a map.
+    const DistanceField & getDistanceField(MapHeight ht);
     
 
 protected:
@@ -172,6 +179,7 @@ private:
     shared_ptr<Task> regeneration_task, home_healing_task;
     std::list<weak_ptr<DispelObserver> > dispel_list;
     int dagger_time;
+    DistanceField walking_field, flying_field;
 };
 
 #endif
@@ -37,8 +37,10 @@
 
 void KnightTask::doControls(shared_ptr<Knight> knight)
 {
-    // Compute available controls
-    player.computeAvailableControls();
+    // Compute available controls (if anything has changed since last time)
+    if (player.needControlsRecompute(Mediator::instance().getGVT())) {
+        player.computeAvailableControls();
+    }
 
     // Read the player's controller input.
     const Control * ctrl = player.readControl();
@@ -111,12 +113,9 @@ void KnightTask::doControls(shared_ptr<Knight> knight)
     
 void KnightTask::execute(TaskManager &tm)
 {
-    // This routine calls Player::computeAvailableControls at regular
-    // intervals. It might be better to call computeAvailableControls
-    // only when needed (eg after motion, or after any change to
-    // items, tiles etc in a square adjacent to the knight), ie in an
-    // event driven way. That would be more efficient, but also more
-    // complicated than what we are doing now.
+    // This routine calls Player::computeAvailableControls when
+    // needed (i.e. after motion, or after any change to items, tiles
+    // etc near the knight -- see Player::needControlsRecompute).
 
     // This routine is also responsible for executing controls
     // selected by the player (information on the selected controls is
@@ -191,7 +190,7 @@ void KnightTask::execute(TaskManager &tm)
     // Now set up for next time. Task should re-execute at
     // min(gvt+control_poll_interval, stunned_until, moving_until).
 
-    int new_time = gvt + Mediator::instance().cfgInt("control_poll_interval");
+    int new_time = gvt + Mediator::instance().cfg().control_poll_interval;
 
     if (knight->isMoving()) {
         const int arr_time = knight->getArrivalTime();
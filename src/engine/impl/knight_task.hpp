@@ -23,8 +23,9 @@
 
 /*
  * This task reads controller inputs from the DungeonView and forwards
- * them to the player's knight. It also handles the calling of
- * Player::computeAvailableControls at regular intervals.
+ * them to the player's knight. It also calls
+ * Player::computeAvailableControls whenever the available controls
+ * may have changed.
  *
  * (KnightTask can really be thought of as part of Player. In fact the
  * two files could probably be merged.)
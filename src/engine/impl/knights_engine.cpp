@@ -61,7 +61,8 @@ public:
           respawn_delay(-1),
           lockpick_itemtype(0), lockpick_init_time(-1), lockpick_interval(-1),
           final_gvt(0),
-          prev_n_skulls(-1)
+          prev_n_skulls(-1),
+          detached_mediator(nullptr)
     { } 
 
     // Keep a reference on the configuration
@@ -109,6 +110,9 @@ public:
     int prev_n_skulls;
     std::vector<PlayerState> prev_player_states;
 
+    // Non-null while the engine is detached from any thread (see detachFromThread)
+    Mediator *detached_mediator;
+
     void doInitialUpdateIfNeeded();
 };
 
@@ -116,6 +120,7 @@ public:
 KnightsEngine::KnightsEngine(boost::shared_ptr<KnightsConfig> config,
                              const std::vector<int> &hse_cols,
                              const std::vector<PlayerID> &player_ids,
+                             uint64_t rng_seed,
                              bool &deathmatch_mode,
                              std::vector<LocalMsg> &messages)
 {
@@ -130,7 +135,7 @@ KnightsEngine::KnightsEngine(boost::shared_ptr<KnightsConfig> config,
                                  pimpl->quest_hint_manager,
                                  pimpl->stuff_manager, pimpl->task_manager,
                                  pimpl->view_manager, config->getConfigMap(),
-                                 config->getLuaState());
+                                 config->getLuaState(), rng_seed);
 
 
         // Most initialization work is delegated to the KnightsConfig object
@@ -225,6 +230,9 @@ void KnightsEngine::resetMap()
 KnightsEngine::~KnightsEngine()
 {
     try {
+        // The Mediator must be on this thread while the game is torn down
+        attachToThread();
+
         // To prevent MediatorUnavailable exceptions we create a "dummy" callbacks object
         DummyCallbacks dcb;
         Mediator::instance().setCallbacks(&dcb);
@@ -252,6 +260,21 @@ KnightsEngine::~KnightsEngine()
 // update
 //
 
+void KnightsEngine::detachFromThread()
+{
+    if (!pimpl->detached_mediator) {
+        pimpl->detached_mediator = Mediator::detachInstance();
+    }
+}
+
+void KnightsEngine::attachToThread()
+{
+    if (pimpl->detached_mediator) {
+        Mediator::attachInstance(pimpl->detached_mediator);
+        pimpl->detached_mediator = nullptr;
+    }
+}
+
 int KnightsEngine::getTimeToNextUpdate() const
 {
     return pimpl->task_manager.getTimeToNextUpdate();
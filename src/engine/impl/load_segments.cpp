@@ -30,11 +30,103 @@
 #include "segment.hpp"
 #include "trim.hpp"
 #include "vfs.hpp"
+#include "xxhash.hpp"
 
 #include "include_lua.hpp"
 
+#include "boost/shared_ptr.hpp"
+#ifndef VIRTUAL_SERVER
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#endif
+
+#include <iterator>
+#include <map>
+#include <sstream>
+
 using std::unique_ptr;
 
+namespace {
+
+    // Parsing the segment files is a noticeable part of the time
+    // taken to create a KnightsConfig, and on a server, a new
+    // KnightsConfig is created for every game. So we keep the parsed
+    // contents of each file, for the lifetime of the process. The
+    // key is a hash of the file contents, so if a file changes, it
+    // is just parsed again.
+    //
+    // Only the SegmentSources are cached. Creating the Segments
+    // themselves (looking up the tiles in the tile table) still has
+    // to be done for each KnightsConfig, as the tiles belong to that
+    // KnightsConfig's Lua state.
+
+    struct ParsedSegmentFile {
+        size_t file_size;
+        std::vector<SegmentSource> segments;
+    };
+
+    std::map<uint64_t, boost::shared_ptr<const ParsedSegmentFile> > g_segment_cache;
+
+#ifndef VIRTUAL_SERVER
+    boost::mutex g_segment_cache_mutex;
+#endif
+
+    uint64_t HashContents(const std::string &contents)
+    {
+        XXHash hasher(0);
+        hasher.updateHashPartial(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+        return hasher.finalHash();
+    }
+
+    boost::shared_ptr<const ParsedSegmentFile> FindInCache(uint64_t hash, size_t file_size)
+    {
+#ifndef VIRTUAL_SERVER
+        boost::lock_guard<boost::mutex> lock(g_segment_cache_mutex);
+#endif
+        std::map<uint64_t, boost::shared_ptr<const ParsedSegmentFile> >::const_iterator it = g_segment_cache.find(hash);
+        if (it != g_segment_cache.end() && it->second->file_size == file_size) {
+            return it->second;
+        } else {
+            return boost::shared_ptr<const ParsedSegmentFile>();
+        }
+    }
+
+    void AddToCache(uint64_t hash, boost::shared_ptr<const ParsedSegmentFile> file)
+    {
+#ifndef VIRTUAL_SERVER
+        boost::lock_guard<boost::mutex> lock(g_segment_cache_mutex);
+#endif
+        g_segment_cache[hash] = file;
+    }
+
+    void ParseSegmentFile(std::istream &str, lua_State *lua, std::vector<SegmentSource> &segments)
+    {
+        while (1) {
+            std::string x;
+            std::getline(str, x);
+            if (!str) luaL_error(lua, "Problem loading segments: read error");
+
+            x = Trim(x);
+
+            if (x == "segment") {
+                segments.push_back(SegmentSource());
+                Segment::parse(str, lua, segments.back());
+
+            } else if (x == "eof") {
+                return;
+
+            } else if (x.size() > 0 && x[0] == '#'
+                       || x.size() == 0) {
+                // Comment or blank line
+                // (Do nothing)
+
+            } else {
+                luaL_error(lua, "Problem loading segments: incorrect file format");
+            }
+        }
+    }
+}
+
 void LoadSegments(lua_State *lua, KnightsConfigImpl *kc,
                   const char *filename)
 {
@@ -44,35 +136,30 @@ void LoadSegments(lua_State *lua, KnightsConfigImpl *kc,
     std::string to_load = LuaResolveFile(lua, filename);
     std::ifstream str = vfs.open(to_load);
 
+    const std::string contents((std::istreambuf_iterator<char>(str)), std::istreambuf_iterator<char>());
+    const uint64_t hash = HashContents(contents);
+
+    boost::shared_ptr<const ParsedSegmentFile> parsed = FindInCache(hash, contents.size());
+    if (!parsed) {
+        boost::shared_ptr<ParsedSegmentFile> new_file(new ParsedSegmentFile);
+        new_file->file_size = contents.size();
+        std::istringstream contents_str(contents);
+        ParseSegmentFile(contents_str, lua, new_file->segments);
+        AddToCache(hash, new_file);
+        parsed = new_file;
+    }
+
     lua_newtable(lua);    // [tiletbl result]
     lua_insert(lua, -2);  // [result tiletbl]
 
     int idx = 1;
-
-    while (1) {
-        std::string x;
-        std::getline(str, x);
-        if (!str) luaL_error(lua, "Problem loading segments: read error");
-
-        x = Trim(x);
-
-        if (x == "segment") {
-            unique_ptr<Segment> segment(new Segment(str, lua)); // reads tiletbl (doesn't pop)
-            Segment *result = kc->addLuaSegment(std::move(segment));
-            NewLuaPtr<Segment>(lua, result);  // [result tiletbl newseg]
-            lua_rawseti(lua, -3, idx++);      // [result tiletbl]
-
-        } else if (x == "eof") {
-            lua_pop(lua, 1);   // [result]
-            return;
-
-        } else if (x.size() > 0 && x[0] == '#'
-                   || x.size() == 0) {
-            // Comment or blank line
-            // (Do nothing)
-
-        } else {
-            luaL_error(lua, "Problem loading segments: incorrect file format");
-        }
+    for (std::vector<SegmentSource>::const_iterator it = parsed->segments.begin();
+    it != parsed->segments.end(); ++it) {
+        unique_ptr<Segment> segment(new Segment(*it, lua)); // reads tiletbl (doesn't pop)
+        Segment *result = kc->addLuaSegment(std::move(segment));
+        NewLuaPtr<Segment>(lua, result);  // [result tiletbl newseg]
+        lua_rawseti(lua, -3, idx++);      // [result tiletbl]
     }
+
+    lua_pop(lua, 1);   // [result]
 }
@@ -228,11 +228,11 @@ void Lockable::generateLock(int nkeys)
         if (nkeys <= 0) {
             lock = 0;    // unlocked
         } else {
-            if (g_rng.getBool(lock_chance)) {
-                if (g_rng.getBool(pick_only_chance)) {
+            if (Mediator::getRNG().getBool(lock_chance)) {
+                if (Mediator::getRNG().getBool(pick_only_chance)) {
                     lock = PICK_ONLY_LOCK_NUM;    // locked, and can be opened by lockpicks only
                 } else {
-                    lock = g_rng.getInt(1, max(keymax,nkeys)+1); // normal lock
+                    lock = Mediator::getRNG().getInt(1, max(keymax,nkeys)+1); // normal lock
                     if (lock > nkeys) lock = 0; // unlocked (keymax has come into effect)
                 }
             } else {
@@ -23,10 +23,10 @@
 
 #include "misc.hpp"
 
+#include "action_data.hpp"
 #include "knights_callbacks.hpp"
 #include "localization.hpp"
 #include "lua_exec_coroutine.hpp"
-#include "lua_ref.hpp"
 #include "lua_traceback.hpp"
 #include "mediator.hpp"
 #include "task.hpp"
@@ -37,45 +37,167 @@
 #include "boost/noncopyable.hpp"
 
 namespace {
+    // A CoroutineTask holds a coroutine that has yielded, and resumes
+    // it when the requested time is up. (Coroutines that never yield
+    // do not need a CoroutineTask at all.)
     class CoroutineTask : public Task, boost::noncopyable {
     public:
-        // Protocol: Push cxt, fn and args onto lua stack, then call ctor
-        // which will pop them and push them onto the thread stack.
-        // Then call execute(tm) to run it for the first time, or just
-        // add it to TaskManager if you want a delayed initial
-        // execution.
-        explicit CoroutineTask(lua_State *lua, int nargs);
-        ~CoroutineTask();                
+        ~CoroutineTask();
         virtual void execute(TaskManager &tm); // overridden from Task
 
-        bool doExec(TaskManager &tm);
-
-    private:
-        lua_State *getThread(lua_State *);
-        void doExec(Mediator &m, TaskManager &tm, int nargs);
+        // Pops [thread cxt] from the lua stack and saves them in the registry.
+        void save(lua_State *lua);
     };
-}
 
-CoroutineTask::CoroutineTask(lua_State *lua, int nargs)
-{
-    // [cxt fn args]
-    
-    // setup a new thread, store in registry
-    lua_newthread(lua); // [cxt fn args thread]
-    lua_State *thread = lua_tothread(lua, -1);
-    lua_rawsetp(lua, LUA_REGISTRYINDEX, this); // [cxt fn args]
+    // Registry key for the pool of idle Lua threads. When a coroutine
+    // returns normally, its thread goes back into the pool, so that it
+    // can be reused by a later LuaExecCoroutine call.
+    const char g_thread_pool_key = 0;
+
+    // Max number of idle threads kept in the pool. (Normally only a few
+    // are needed, as threads are only in use while they are running, or
+    // while nested calls are running.)
+    const lua_Integer MAX_IDLE_THREADS = 16;
+
+    // Pushes an idle thread (from the pool, or a new one)
+    lua_State * PushIdleThread(lua_State *lua)
+    {
+        if (lua_rawgetp(lua, LUA_REGISTRYINDEX, &g_thread_pool_key) != LUA_TTABLE) {  // [x]
+            lua_pop(lua, 1);                                       // []
+            lua_createtable(lua, MAX_IDLE_THREADS, 0);              // [pool]
+            lua_pushvalue(lua, -1);                                // [pool pool]
+            lua_rawsetp(lua, LUA_REGISTRYINDEX, &g_thread_pool_key);   // [pool]
+        }
+
+        const lua_Integer n = lua_rawlen(lua, -1);
+        if (n > 0) {
+            lua_rawgeti(lua, -1, n);     // [pool thread]
+            lua_pushnil(lua);            // [pool thread nil]
+            lua_rawseti(lua, -3, n);     // [pool thread]
+            lua_remove(lua, -2);         // [thread]
+        } else {
+            lua_pop(lua, 1);             // []
+            lua_newthread(lua);          // [thread]
+        }
+        return lua_tothread(lua, -1);
+    }
+
+    // Pops a thread, whose function has returned (and whose stack is
+    // empty), and puts it back into the pool.
+    void ReleaseIdleThread(lua_State *lua)
+    {
+        lua_rawgetp(lua, LUA_REGISTRYINDEX, &g_thread_pool_key);   // [thread pool]
+        const lua_Integer n = lua_rawlen(lua, -1);
+        if (n < MAX_IDLE_THREADS) {
+            lua_insert(lua, -2);          // [pool thread]
+            lua_rawseti(lua, -2, n + 1);  // [pool]
+            lua_pop(lua, 1);              // []
+        } else {
+            lua_pop(lua, 2);              // []
+        }
+    }
 
-    // move the main function and arguments across to the new thread.
-    lua_xmove(lua, thread, nargs + 1);  // [cxt]
+    // Runs (or resumes) a thread, with [thread cxt] on top of the lua
+    // stack. The thread's stack should contain the function and nargs
+    // arguments (or nothing, if the thread is being resumed).
+    //
+    // "cxt" is set as the global cxt while the thread runs, and the
+    // previous value is restored afterwards.
+    //
+    // If the thread yields a delay, the coroutine is rescheduled (using
+    // "task", or a new CoroutineTask if "task" is null). Otherwise the
+    // thread is finished with, and (if it returned normally) goes back
+    // into the pool.
+    //
+    // Pops [thread cxt]. Returns the function's first result, converted
+    // to bool, if it returned; otherwise false.
+    bool RunThread(lua_State *lua, int nargs, shared_ptr<CoroutineTask> task)
+    {
+        lua_State *thread = lua_tothread(lua, -2);
+        ASSERT(thread);
+
+        // Swap in our cxt
+        lua_getglobal(lua, "cxt");    // [thread cxt oldcxt]
+        lua_insert(lua, -2);          // [thread oldcxt cxt]
+        lua_setglobal(lua, "cxt");    // [thread oldcxt]
+
+        // resume the thread
+        //   nullptr => being called from top level (not from any particular thread)
+        int nresults = 0;
+        const int status = lua_resume(thread, nullptr, nargs, &nresults);
+
+        // Get the (possibly changed) cxt back, and restore the previous value
+        lua_getglobal(lua, "cxt");    // [thread oldcxt cxt]
+        lua_insert(lua, -2);          // [thread cxt oldcxt]
+        lua_setglobal(lua, "cxt");    // [thread cxt]
+
+        switch (status) {
+        case LUA_OK:
+            // Coroutine has returned. Clear its stack, then put the
+            // thread and cxt back in their pools. If there is a
+            // task, it will not be rescheduled, so will be deleted.
+            {
+                bool result = false;
+                if (nresults >= 1) {
+                    result = lua_toboolean(thread, -nresults) != 0;
+                }
+                lua_settop(thread, 0);
+                RecycleCxtTable(lua);    // [thread]
+                ReleaseIdleThread(lua);  // []
+                return result;
+            }
+
+        case LUA_YIELD:
+            // Coroutine has yielded a value.
+            if (nresults >= 1 && lua_isnumber(thread, -nresults)) {
+                const int time = lua_tointeger(thread, -nresults);
+                if (time >= 0) {
+
+                    // remove yielded values from thread stack
+                    lua_pop(thread, nresults);
 
-    // now save the context
-    lua_rawsetp(lua, LUA_REGISTRYINDEX, ((char*)this)+1);  // []
+                    // save the thread and its cxt in the task
+                    if (!task) task.reset(new CoroutineTask);
+                    task->save(lua);  // []
+
+                    // reschedule the task
+                    TaskManager &tm = Mediator::instance().getTaskManager();
+                    tm.addTask(task, TP_NORMAL, tm.getGVT() + time);
+
+                    return false;
+                }
+            }
+
+            // Otherwise: push a fake error message then fall through
+            // to error case.
+            lua_settop(thread, 0);
+            lua_pushstring(thread, "incorrect yield");
+
+            // Fall through
+
+        default:
+            // Coroutine raised an error. The error message is on top of stack.
+            // (The thread cannot be reused in this case.)
+            {
+                const char *p = lua_tostring(thread, -1);
+                std::string err(p ? p : "<No err msg>");
+                err += LuaTraceback(thread);
+                lua_settop(thread, 0);  // clear its stack
+                RecycleCxtTable(lua);   // [thread]
+                lua_pop(lua, 1);        // []
+
+                LocalMsg msg{LocalKey("lua_error_is"), {LocalParam(UTF8String::fromUTF8Safe(err))}};
+                Mediator::instance().getCallbacks().gameMsgLoc(-1, msg, true); // display the error message
+                return false;
+            }
+        }
+    }
 }
 
 CoroutineTask::~CoroutineTask()
 {
     try {
-        // We must remove the key from the registry
+        // We must remove the keys from the registry
         Mediator &mediator(Mediator::instance());
         lua_State *lua = mediator.getLuaState();
         lua_pushnil(lua);
@@ -87,111 +209,31 @@ CoroutineTask::~CoroutineTask()
     }
 }
 
-lua_State * CoroutineTask::getThread(lua_State *lua)
-{
-    // get the thread from the registry
-    lua_rawgetp(lua, LUA_REGISTRYINDEX, this);  // [thread]
-    lua_State *thread = lua_tothread(lua, -1);
-    lua_pop(lua, 1);      // []
-    ASSERT(thread);
-    return thread;
-}
-
-void CoroutineTask::execute(TaskManager &tm)
+void CoroutineTask::save(lua_State *lua)
 {
-    // ignore return value from doExec
-    doExec(tm);
+    // [thread cxt]
+    lua_rawsetp(lua, LUA_REGISTRYINDEX, ((char*)this)+1);  // [thread]
+    lua_rawsetp(lua, LUA_REGISTRYINDEX, this);             // []
 }
 
-bool CoroutineTask::doExec(TaskManager &tm)
+void CoroutineTask::execute(TaskManager &)
 {
-    Mediator &mediator(Mediator::instance());
-    lua_State *lua = mediator.getLuaState();
-    lua_State *thread = getThread(lua);
-
-    // work out how many args there are. (We assume that if the thread
-    // stack is non-empty then this is the first run, otherwise, this
-    // is a resume)
-    const int init_stack = lua_gettop(thread);
-    const int nargs = init_stack == 0 ? 0 : init_stack - 1;
-
-    // Save the current value of "cxt" in the registry
-    lua_getglobal(lua, "cxt");  // pushes oldcxt
-    LuaRef cxt_save(lua);       // pops it again.
-
-    // restore the context
-    lua_rawgetp(thread, LUA_REGISTRYINDEX, ((char*)this)+1);
-    lua_setglobal(thread, "cxt");
-
-    // resume the thread
-    //   nullptr => being called from top level (not from any particular thread)
-    int nresults = 0;
-    const int status = lua_resume(thread, nullptr, nargs, &nresults);
-
-    // save the context again
-    lua_getglobal(thread, "cxt");
-    lua_rawsetp(thread, LUA_REGISTRYINDEX, ((char*)this)+1);
-
-    // and restore the previous value of cxt
-    cxt_save.push(lua);
-    lua_setglobal(lua, "cxt");
-
-    switch (status) {
-    case LUA_OK:
-        // Coroutine has returned. Clear its stack, then return w/o
-        // rescheduling the task. This will cause *this to be deleted,
-        // which in turn will remove the Lua thread from the registry,
-        // the Lua GC will then destroy the thread.
-        {
-            bool result = false;
-            if (nresults >= 1) {
-                result = lua_toboolean(thread, -nresults) != 0;
-            }
-            lua_settop(thread, 0);
-            return result;
-        }
-
-    case LUA_YIELD:
-        // Coroutine has yielded a value.
-        if (nresults >= 1 && lua_isnumber(thread, -nresults)) {
-            const int time = lua_tointeger(thread, -nresults);
-            if (time >= 0) {
-
-                // reschedule the task
-                tm.addTask(shared_from_this(), TP_NORMAL, tm.getGVT() + time);
-
-                // remove yielded values from thread stack
-                lua_pop(thread, nresults);
-
-                return false;
-            }
-        }
-
-        // Otherwise: push a fake error message then fall through
-        // to error case.
-        lua_settop(thread, 0);
-        lua_pushstring(thread, "incorrect yield");
-
-        // Fall through
-
-    default:
-        // Coroutine raised an error. The error message is on top of stack
-        {
-            const char *p = lua_tostring(thread, -1);
-            std::string err(p ? p : "<No err msg>");
-            err += LuaTraceback(thread);
-            lua_settop(thread, 0);  // clear its stack
+    lua_State *lua = Mediator::instance().getLuaState();
+    lua_rawgetp(lua, LUA_REGISTRYINDEX, this);             // [thread]
+    lua_rawgetp(lua, LUA_REGISTRYINDEX, ((char*)this)+1);  // [thread cxt]
 
-            LocalMsg msg{LocalKey("lua_error_is"), {LocalParam(UTF8String::fromUTF8Safe(err))}};
-            mediator.getCallbacks().gameMsgLoc(-1, msg, true); // display the error message
-            return false;
-        }
-    }
+    // ignore return value
+    RunThread(lua, 0, static_pointer_cast<CoroutineTask>(shared_from_this()));
 }
-            
 
 bool LuaExecCoroutine(lua_State *lua, int nargs)
 {
-    shared_ptr<CoroutineTask> task(new CoroutineTask(lua, nargs));  // pops cxt, fn and args from stack.
-    return task->doExec(Mediator::instance().getTaskManager());
+    // [cxt fn args]
+    lua_State *thread = PushIdleThread(lua);  // [cxt fn args thread]
+    lua_insert(lua, -nargs-3);                // [thread cxt fn args]
+
+    // move the main function and arguments across to the thread.
+    lua_xmove(lua, thread, nargs + 1);        // [thread cxt]
+
+    return RunThread(lua, nargs, shared_ptr<CoroutineTask>());
 }
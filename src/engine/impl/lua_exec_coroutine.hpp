@@ -29,6 +29,10 @@ struct lua_State;
 // Pops a cxt table, a function and n arguments from the stack, and 
 // launches the function as a coroutine.
 
+// The coroutine runs on a Lua thread taken from a pool; if the function
+// returns without yielding (the usual case) then the thread goes
+// straight back into the pool, and no Task is created.
+
 // If the function yields a number, then it will delay that many ms
 // and re-execute after that time. (A Task is added to take care of
 // this.) The yield will not return any values back to Lua.
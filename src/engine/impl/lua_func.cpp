@@ -24,10 +24,12 @@
 #include "misc.hpp"
 
 #include "action_data.hpp"
+#include "knights_callbacks.hpp"
 #include "lua_check.hpp"
 #include "lua_exec.hpp"
 #include "lua_exec_coroutine.hpp"
 #include "lua_func.hpp"
+#include "mediator.hpp"
 #include "my_exceptions.hpp"
 
 #include "include_lua.hpp"
@@ -63,6 +65,35 @@ bool LuaFunc::execute(const ActionData &ad) const
     }
 }
 
+bool LuaFunc::check(const ActionData &ad) const
+{
+    lua_State *lua = function_ref.getLuaState();
+    if (!lua || !function_ref.hasValue()) return false;
+
+    // Swap in our own "cxt" table, saving the old one
+    lua_getglobal(lua, "cxt");   // [oldcxt]
+    ad.pushCxtTable(lua);        // [oldcxt cxt]
+    lua_pushvalue(lua, -1);      // [oldcxt cxt cxt]
+    lua_setglobal(lua, "cxt");   // [oldcxt cxt]
+
+    bool result = false;
+    try {
+        function_ref.push(lua);  // [oldcxt cxt func]
+        LuaExec(lua, 0, 1);      // [oldcxt cxt result]
+        result = lua_toboolean(lua, -1) != 0;
+        lua_pop(lua, 1);         // [oldcxt cxt]
+    } catch (LuaError &e) {
+        // LuaExec has cleaned up the stack: [oldcxt cxt]
+        Mediator::instance().getCallbacks().gameMsgLoc(-1, e.getMsg(), true);
+    }
+
+    // Restore the old "cxt"
+    RecycleCxtTable(lua);        // [oldcxt]
+    lua_setglobal(lua, "cxt");   // []
+
+    return result;
+}
+
 void LuaFunc::runNArgsNoPop(lua_State *lua, int n) const
 {
     // [a1 .. an]
@@ -80,6 +80,16 @@ public:
     //
     bool execute(const ActionData &) const;
 
+    // This is like execute(), but calls the function directly rather
+    // than as a coroutine, and so is much cheaper. It is intended for
+    // predicates (such as Control "possible" functions), which must
+    // not yield; if the function yields or raises an error, the error
+    // is displayed in-game and check() returns false.
+    //
+    // If stored func is nil, check() returns false.
+    //
+    bool check(const ActionData &) const;
+
     
 private:
     LuaRef function_ref;
@@ -246,6 +246,9 @@ namespace {
         // * special_segments     -- list of segments, all must be included
         // * entry_type           -- one of "none", "close", "away", "random" (corresponding to HomeType enum)
         // * allow_rotate         -- boolean, default true.
+        // * seed                 -- optional integer, reproduces the layout that was generated from this seed.
+
+        // Returns the seed of the generated layout (or nothing if generation failed).
 
         DungeonSettings settings;
         
@@ -292,15 +295,27 @@ namespace {
             settings.allow_rotate = false;
         }
 
+        lua_getfield(lua, 1, "seed");
+        if (lua_isnil(lua, -1)) {
+            settings.seed = 0;
+        } else if (lua_isinteger(lua, -1)) {
+            settings.seed = static_cast<uint64_t>(lua_tointeger(lua, -1));
+        } else {
+            luaL_error(lua, "'seed' must be an integer");
+        }
+        lua_pop(lua, 1);
+
         Mediator &m = Mediator::instance();
 
         try {
-            DungeonGenerator(*m.getMap(),
-                             *m.getCoordTransform(),
-                             m.getHomeManager(),
-                             m.getMonsterManager(),
-                             m.getPlayers(),
-                             settings);
+            const uint64_t seed = DungeonGenerator(*m.getMap(),
+                                                   *m.getCoordTransform(),
+                                                   m.getHomeManager(),
+                                                   m.getMonsterManager(),
+                                                   m.getPlayers(),
+                                                   settings);
+            lua_pushinteger(lua, static_cast<lua_Integer>(seed));
+            return 1;
             
         } catch (DungeonGenerationFailed &f) {
             lua_getglobal(lua, "kts");  // [kts]
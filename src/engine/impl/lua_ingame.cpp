@@ -828,7 +828,7 @@ namespace {
         int low = luaL_checkinteger(lua, 1);
         int high = luaL_checkinteger(lua, 2);
 
-        int result = g_rng.getInt(low, high + 1);  // g_rng uses exclusive upper bound; we use inclusive; so add one.
+        int result = Mediator::getRNG().getInt(low, high + 1);  // Mediator::getRNG() uses exclusive upper bound; we use inclusive; so add one.
 
         lua_pushinteger(lua, result);
         return 1;
@@ -840,7 +840,7 @@ namespace {
         if (chance < 0) chance = 0;
         if (chance > 1) chance = 1;
 
-        lua_pushboolean(lua, g_rng.getBool(float(chance)) ? 1 : 0);
+        lua_pushboolean(lua, Mediator::getRNG().getBool(float(chance)) ? 1 : 0);
         return 1;
     }
 
@@ -851,8 +851,8 @@ namespace {
             luaL_error(lua, "Problem in GetRandomPos: Map not created yet");
         }
 
-        const int x = g_rng.getInt(0, dmap->getWidth());
-        const int y = g_rng.getInt(0, dmap->getHeight());
+        const int x = Mediator::getRNG().getInt(0, dmap->getWidth());
+        const int y = Mediator::getRNG().getInt(0, dmap->getHeight());
 
         lua_createtable(lua, 0, 2);
         lua_pushinteger(lua, x);
@@ -1110,7 +1110,7 @@ namespace {
                         lua_pushboolean(lua, false);
                         return 1;
                     } else {
-                        (*it)->placeItem(item);
+                        (*it)->placeItem(dmap, mc, item);
                         lua_pushboolean(lua, true);
                         return 1;
                     }
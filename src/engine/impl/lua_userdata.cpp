@@ -291,6 +291,58 @@ namespace {
         if (index < 0) --index; // because the metatable has been added to stack!
         lua_setmetatable(lua, index);
     }
+
+    // Registry keys for the userdata caches used by PushLuaPtr etc.
+    // There is one cache per pointer type, because the same object can
+    // be pushed as (say) both a raw and a shared pointer.
+    const char g_raw_cache_key = 0;
+    const char g_shared_cache_key = 0;
+    const char g_weak_cache_key = 0;
+
+    // Pushes the given cache table, creating it the first time. A cache
+    // maps object addresses (as light userdata) to Knights userdata. It
+    // has weak values, so it does not keep anything alive by itself.
+    void PushUserdataCache(lua_State *lua, const char *key)
+    {
+        if (lua_rawgetp(lua, LUA_REGISTRYINDEX, key) != LUA_TTABLE) {   // [x]
+            lua_pop(lua, 1);                          // []
+            lua_createtable(lua, 0, 0);               // [cache]
+            lua_createtable(lua, 0, 1);               // [cache mt]
+            lua_pushstring(lua, "v");                 // [cache mt "v"]
+            lua_setfield(lua, -2, "__mode");          // [cache mt]
+            lua_setmetatable(lua, -2);                // [cache]
+            lua_pushvalue(lua, -1);                   // [cache cache]
+            lua_rawsetp(lua, LUA_REGISTRYINDEX, key); // [cache]
+        }
+    }
+
+    // If the cache holds a userdata with the given tag and pointer type,
+    // which still refers to ptr, then push it and return true. Otherwise
+    // push nothing and return false.
+    // (For a weak pointer, "still refers to ptr" fails if the object has
+    // died, as the address might since have been reused.)
+    bool PushFromCache(lua_State *lua, const char *key, void *ptr, LuaTag tag, LuaPtrType ptr_type)
+    {
+        PushUserdataCache(lua, key);   // [cache]
+        lua_rawgetp(lua, -1, ptr);     // [cache ud]
+        const UserData *ud = static_cast<const UserData*>(lua_touserdata(lua, -1));
+        if (ud && ud->tag == tag && ud->ptr_type == ptr_type && GetPtr(*ud) == ptr) {
+            lua_remove(lua, -2);       // [ud]
+            return true;
+        } else {
+            lua_pop(lua, 2);           // []
+            return false;
+        }
+    }
+
+    // Add the userdata on top of the stack to the cache. (It is left on the stack.)
+    void AddToCache(lua_State *lua, const char *key, void *ptr)
+    {
+        PushUserdataCache(lua, key);   // [ud cache]
+        lua_pushvalue(lua, -2);        // [ud cache ud]
+        lua_rawsetp(lua, -2, ptr);     // [ud cache]
+        lua_pop(lua, 1);               // [ud]
+    }
 }
 
 void NewLuaPtr_Impl(lua_State *lua, void *ptr, LuaTag tag)
@@ -332,6 +384,37 @@ void NewLuaWeakPtr_Impl(lua_State *lua, boost::weak_ptr<void> ptr, LuaTag tag)
     }
 }
 
+void PushLuaPtr_Impl(lua_State *lua, void *ptr, LuaTag tag)
+{
+    if (!ptr) {
+        lua_pushnil(lua);
+    } else if (!PushFromCache(lua, &g_raw_cache_key, ptr, tag, PTR_RAW)) {
+        NewLuaPtr_Impl(lua, ptr, tag);
+        AddToCache(lua, &g_raw_cache_key, ptr);
+    }
+}
+
+void PushLuaSharedPtr_Impl(lua_State *lua, boost::shared_ptr<void> ptr, LuaTag tag)
+{
+    if (!ptr) {
+        lua_pushnil(lua);
+    } else if (!PushFromCache(lua, &g_shared_cache_key, ptr.get(), tag, PTR_SHARED)) {
+        NewLuaSharedPtr_Impl(lua, ptr, tag);
+        AddToCache(lua, &g_shared_cache_key, ptr.get());
+    }
+}
+
+void PushLuaWeakPtr_Impl(lua_State *lua, boost::weak_ptr<void> ptr, LuaTag tag)
+{
+    void *raw = ptr.lock().get();
+    if (!raw) {
+        lua_pushnil(lua);
+    } else if (!PushFromCache(lua, &g_weak_cache_key, raw, tag, PTR_WEAK)) {
+        NewLuaWeakPtr_Impl(lua, ptr, tag);
+        AddToCache(lua, &g_weak_cache_key, raw);
+    }
+}
+
 void * ReadLuaPtr_Impl(lua_State *lua, int index, LuaTag expected_tag)
 {
     if (lua_isnil(lua, index)) {
@@ -35,6 +35,9 @@ typedef unsigned short int LuaTag;
 void NewLuaPtr_Impl(lua_State *lua, void *ptr, LuaTag tag);
 void NewLuaSharedPtr_Impl(lua_State *lua, boost::shared_ptr<void> ptr, LuaTag tag);
 void NewLuaWeakPtr_Impl(lua_State *lua, boost::weak_ptr<void> ptr, LuaTag tag);
+void PushLuaPtr_Impl(lua_State *lua, void *ptr, LuaTag tag);
+void PushLuaSharedPtr_Impl(lua_State *lua, boost::shared_ptr<void> ptr, LuaTag tag);
+void PushLuaWeakPtr_Impl(lua_State *lua, boost::weak_ptr<void> ptr, LuaTag tag);
 void * ReadLuaPtr_Impl(lua_State *lua, int index, LuaTag expected_tag);
 boost::shared_ptr<void> ReadLuaSharedPtr_Impl(lua_State *lua, int index, LuaTag expected_tag);
 boost::weak_ptr<void> ReadLuaWeakPtr_Impl(lua_State *lua, int index, LuaTag expected_tag);
@@ -50,6 +53,17 @@ template<class T> inline void NewLuaPtr(lua_State *lua, T *ptr) { NewLuaPtr_Impl
 template<class T> inline void NewLuaSharedPtr(lua_State *lua, boost::shared_ptr<T> ptr) { NewLuaSharedPtr_Impl(lua, ptr, LuaTraits<T>::tag); }
 template<class T> inline void NewLuaWeakPtr(lua_State *lua, boost::weak_ptr<T> ptr) { NewLuaWeakPtr_Impl(lua, ptr, LuaTraits<T>::tag); }
 
+//
+// As above, but if a userdata for the same object (and pointer type) is
+// still alive in Lua then that userdata is pushed again, instead of a
+// new one being created. Intended for frequently called code (such as
+// ActionData::pushCxtTable) where creating new userdatas each time
+// would make a lot of garbage.
+//
+template<class T> inline void PushLuaPtr(lua_State *lua, T *ptr) { PushLuaPtr_Impl(lua, (void*)ptr, LuaTraits<T>::tag); }
+template<class T> inline void PushLuaSharedPtr(lua_State *lua, boost::shared_ptr<T> ptr) { PushLuaSharedPtr_Impl(lua, ptr, LuaTraits<T>::tag); }
+template<class T> inline void PushLuaWeakPtr(lua_State *lua, boost::weak_ptr<T> ptr) { PushLuaWeakPtr_Impl(lua, ptr, LuaTraits<T>::tag); }
+
 
 // Read a Lua userdata object from a given stack index
 // 
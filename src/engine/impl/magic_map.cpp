@@ -36,6 +36,8 @@
 #include "task_manager.hpp"
 #include "tile.hpp"
 
+#include <algorithm>
+
 using std::vector;
 
 void MagicMapping(boost::shared_ptr<Knight> kt)
@@ -48,31 +50,14 @@ void MagicMapping(boost::shared_ptr<Knight> kt)
 
 void MagicMapping(Player &player, const DungeonMap &dmap)
 {
-    vector<shared_ptr<Tile> > tiles;
-    vector<char> is_wall;
-    is_wall.reserve(dmap.getWidth() * dmap.getHeight());
-
-    for (int y=0; y<dmap.getHeight(); ++y) {
-        for (int x=0; x<dmap.getWidth(); ++x) {
-            MapCoord mc(x,y);
-            dmap.getTiles(mc, tiles);
-            bool flag = false;
-            for (vector<shared_ptr<Tile> >::iterator it = tiles.begin(); it != tiles.end();
-            ++it) {
-                if ((*it)->getColour() == COL_WALL) {
-                    flag = true;
-                    break;
-                }
-            }
-            is_wall.push_back(flag);
-        }
-    }
-
+    // Note: DungeonMap caches the mini map colour of each square, so
+    // this does not need to look at the tiles themselves.
+    
     for (int y=0; y<dmap.getHeight(); ++y) {
         for (int x=0; x<dmap.getWidth(); ++x) {
             MapCoord mc(x,y);
 
-            const bool wall_here = (is_wall[y*dmap.getWidth() + x] != 0);
+            if (dmap.getMiniMapColour(mc) != COL_WALL) continue;
 
             // If a wall is surrounded by 8 other walls then we don't draw it.
             // This prevents ugly blocks of colour for those segments that have large
@@ -82,12 +67,12 @@ void MagicMapping(Player &player, const DungeonMap &dmap)
             for (int yy = y-1; yy <= y+1; ++yy) {
                 for (int xx = x-1; xx <= x+1; ++xx) {
                     if (xx < 0 || xx >= dmap.getWidth() || yy < 0 || yy >= dmap.getHeight()
-                    || is_wall[yy*dmap.getWidth() + xx]) {
+                    || dmap.getMiniMapColour(MapCoord(xx,yy)) == COL_WALL) {
                         ++wallcount;
                     }
                 }
             }
-            if (wall_here && wallcount < 9) {
+            if (wallcount < 9) {
                 player.setMiniMapColour(mc.getX(), mc.getY(), COL_WALL);
             }
         }
@@ -137,35 +122,53 @@ void SenseItems(shared_ptr<Knight> kt, int stop_time)
     tm.addTask(task, TP_NORMAL, tm.getGVT() + 1);
 }
 
+namespace {
+    bool XThenY(const MapCoord &lhs, const MapCoord &rhs)
+    {
+        return lhs.getX() < rhs.getX() || (lhs.getX() == rhs.getX() && lhs.getY() < rhs.getY());
+    }
+}
+
 SenseItemsTask::SenseItemsTask(Player &pl, int expiry_)
     : player(pl), expiry(expiry_)
 {
     if (!player.getKnight()) return;
     DungeonMap *dmap = player.getKnight()->getMap();
     if (dmap && dmap->getRoomMap()) {
-        for (int x=0; x<dmap->getWidth(); ++x) {
-            for (int y=0; y<dmap->getHeight(); ++y) {
-                const MapCoord mc(x,y);
-                if (interestingItemAt(*dmap, mc, pl)) {
-                    // Item locations are only revealed for rooms that you've already
-                    // mapped. If we were to reveal the location of all items, even those in
-                    // not-yet-visited rooms, then that would unbalance the game, since it
-                    // would be a huge advantage for certain quests (eg quest for gems).
-
-                    // Note that an alternative way of implementing this would have been
-                    // to *always* send the "setHighlight" message, but to filter out
-                    // unmapped squares on the *client*. However, that's a bad idea because
-                    // someone could cheat, by hacking the client program to remove that
-                    // filtering step (hence they would find out the locations of all the gems
-                    // which would be an unfair advantage to them). We want to prevent
-                    // cheating whenever we can.
-
-                    int r1, r2;
-                    dmap->getRoomMap()->getRoomAtPos(mc, r1, r2);
-                    if ((r1 != -1 && pl.isRoomMapped(r1)) || (r2 != -1 && pl.isRoomMapped(r2))) {
-                        items.push_back( mc );
-                        setHighlight(mc, true);
-                    }
+
+        // Rather than searching the whole map, we only need to look at the squares
+        // where DungeonMap knows there is a critical item, plus any stuff bags.
+        // (These are sorted into the same order as a full search would have used.)
+        vector<MapCoord> squares;
+        const std::map<MapCoord, int> & critical_items = dmap->getCriticalItemSquares();
+        for (std::map<MapCoord, int>::const_iterator it = critical_items.begin(); it != critical_items.end(); ++it) {
+            squares.push_back(it->first);
+        }
+        Mediator::instance().getStuffManager().getStuffBagSquares(*dmap, squares);
+        std::sort(squares.begin(), squares.end(), XThenY);
+        squares.erase(std::unique(squares.begin(), squares.end()), squares.end());
+        
+        for (vector<MapCoord>::const_iterator sq = squares.begin(); sq != squares.end(); ++sq) {
+            const MapCoord &mc = *sq;
+            if (interestingItemAt(*dmap, mc, pl)) {
+                // Item locations are only revealed for rooms that you've already
+                // mapped. If we were to reveal the location of all items, even those in
+                // not-yet-visited rooms, then that would unbalance the game, since it
+                // would be a huge advantage for certain quests (eg quest for gems).
+
+                // Note that an alternative way of implementing this would have been
+                // to *always* send the "setHighlight" message, but to filter out
+                // unmapped squares on the *client*. However, that's a bad idea because
+                // someone could cheat, by hacking the client program to remove that
+                // filtering step (hence they would find out the locations of all the gems
+                // which would be an unfair advantage to them). We want to prevent
+                // cheating whenever we can.
+
+                int r1, r2;
+                dmap->getRoomMap()->getRoomAtPos(mc, r1, r2);
+                if ((r1 != -1 && pl.isRoomMapped(r1)) || (r2 != -1 && pl.isRoomMapped(r2))) {
+                    items.push_back( mc );
+                    setHighlight(mc, true);
                 }
             }
         }
@@ -194,7 +197,7 @@ void SenseItemsTask::execute(TaskManager &tm)
     }
 
     // Reschedule
-    tm.addTask(shared_from_this(), TP_NORMAL, Mediator::instance().cfgInt("player_task_interval") + tm.getGVT());
+    tm.addTask(shared_from_this(), TP_NORMAL, Mediator::instance().cfg().player_task_interval + tm.getGVT());
 }
 
 bool SenseItemsTask::interestingItemAt(DungeonMap &dmap, const MapCoord &mc,
@@ -217,9 +220,8 @@ bool SenseItemsTask::interestingItemAt(DungeonMap &dmap, const MapCoord &mc,
     }
 
     // Check items hidden away within tiles (eg Chests)
-    vector<shared_ptr<Tile> > tiles;
-    dmap.getTiles(mc, tiles);
-    for (vector<shared_ptr<Tile> >::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+    const vector<shared_ptr<Tile> > & tiles = dmap.getTilesAt(mc);
+    for (vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end(); ++it) {
         item = (*it)->getPlacedItem();
         if (item && item->getType().isCritical()) return true;
     }
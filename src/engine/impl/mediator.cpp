@@ -40,6 +40,7 @@
 #include "player.hpp"
 #include "player_task.hpp"
 #include "quest_hint_manager.hpp"
+#include "stuff_bag.hpp"
 #include "task_manager.hpp"
 #include "view_manager.hpp"
 
@@ -75,10 +76,11 @@ void Mediator::createInstance(EventManager &em, GoreManager &gm, HomeManager &hm
                               QuestHintManager &qm,
                               StuffManager &sm, TaskManager &tm,
                               ViewManager &vm, boost::shared_ptr<const ConfigMap> cmap,
-                              boost::shared_ptr<lua_State> lua)
+                              boost::shared_ptr<lua_State> lua,
+                              uint64_t rng_seed)
 {
     if (g_mediator_ptr.get()) throw MediatorCreatedTwice();
-    g_mediator_ptr.reset(new Mediator(em, gm, hm, mm, qm, sm, tm, vm, cmap, lua));
+    g_mediator_ptr.reset(new Mediator(em, gm, hm, mm, qm, sm, tm, vm, cmap, lua, rng_seed));
 }
 
 void Mediator::destroyInstance()
@@ -86,6 +88,17 @@ void Mediator::destroyInstance()
     g_mediator_ptr.reset();
 }
 
+Mediator * Mediator::detachInstance()
+{
+    return g_mediator_ptr.release();
+}
+
+void Mediator::attachInstance(Mediator *m)
+{
+    if (g_mediator_ptr.get()) throw MediatorCreatedTwice();
+    g_mediator_ptr.reset(m);
+}
+
 void Mediator::addPlayer(Player &player)
 {
     players.push_back(&player);
@@ -107,6 +120,13 @@ Mediator & Mediator::instance()
     else return *m;
 }
 
+RNG & Mediator::getRNG()
+{
+    Mediator *m = g_mediator_ptr.get();
+    if (m) return m->rng;
+    else return g_rng;
+}
+
 
 //
 // configmap
@@ -223,16 +243,21 @@ void Mediator::placeIcon(DungeonMap &dmap, const MapCoord &mc, const Graphic *g,
 void Mediator::onAddItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item)
 {
     view_manager.onAddItem(dmap, mc, item);
+    stuff_manager.onAddItem(dmap, mc, item);
+    onChangeSquare(dmap, mc);
 }
 
 void Mediator::onRmItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item)
 {
     view_manager.onRmItem(dmap, mc, item);
+    stuff_manager.onRmItem(dmap, mc, item);
+    onChangeSquare(dmap, mc);
 }
 
 void Mediator::onChangeItemGraphic(const DungeonMap &dmap, const MapCoord &mc, const Item &item)
 {
     view_manager.onChangeItemGraphic(dmap, mc, item);
+    onChangeSquare(dmap, mc);
 }
 
 void Mediator::onPickup(const Player &pl, const ItemType &it)
@@ -249,17 +274,31 @@ void Mediator::onAddTile(DungeonMap &dmap, const MapCoord &mc, Tile &tile, const
 {
     view_manager.onAddTile(dmap, mc, tile);
     event_manager.onAddTile(dmap, mc, tile, originator);
+    monster_manager.onAddTile(dmap, mc, tile);
+    onChangeSquare(dmap, mc);
 }
 
 void Mediator::onRmTile(DungeonMap &dmap, const MapCoord &mc, Tile &tile, const Originator &originator)
 {
     view_manager.onRmTile(dmap, mc, tile);
     event_manager.onRmTile(dmap, mc, tile, originator);
+    monster_manager.onRmTile(dmap, mc, tile);
+    onChangeSquare(dmap, mc);
 }
 
 void Mediator::onChangeTile(const DungeonMap &dmap, const MapCoord &mc, const Tile &tile)
 {
     view_manager.onChangeTile(dmap, mc, tile);
+    onChangeSquare(dmap, mc);
+}
+
+void Mediator::onChangeSquare(const DungeonMap &dmap, const MapCoord &mc)
+{
+    // The knights' available controls depend on the items and tiles
+    // near them, so tell the players about the change
+    for (std::vector<Player*>::iterator it = players.begin(); it != players.end(); ++it) {
+        (*it)->onChangeSquare(dmap, mc);
+    }
 }
 
 
@@ -50,9 +50,11 @@
 #ifndef MEDIATOR_HPP
 #define MEDIATOR_HPP
 
+#include "engine_config.hpp"
 #include "map_support.hpp"
 #include "my_exceptions.hpp"
 #include "player_state.hpp"
+#include "rng.hpp"
 #include "secure_result.hpp"
 #include "utf8string.hpp"
 
@@ -126,6 +128,12 @@ public:
     // explicitly by createInstance.)
     static Mediator & instance();
 
+    // Random number generator for the current game. Each game has its
+    // own stream, seeded from the rng_seed given to createInstance, so
+    // games do not contend for a lock and can be replayed from their
+    // seed. Falls back to g_rng if there is no game on this thread.
+    static RNG & getRNG();
+
     //
     // Tell us which KnightsCallbacks to use when events of interest
     // to the client occur.
@@ -139,7 +147,10 @@ public:
 
     //
     // Access general configuration settings.
+    // cfg() gives direct access to the settings used by the engine itself (see
+    // engine_config.hpp), and should be used in preference to cfgInt etc.
     //
+    const EngineConfig & cfg() const { return engine_config; }
     int cfgInt(const std::string &key) const;
     float cfgProbability(const std::string &key) const;
     const std::string &cfgString(const std::string &key) const;
@@ -259,8 +270,15 @@ public:
                                QuestHintManager &qm,
                                StuffManager &sm, TaskManager &tm,
                                ViewManager &vm, boost::shared_ptr<const ConfigMap> cmap,
-                               boost::shared_ptr<lua_State> lua);
+                               boost::shared_ptr<lua_State> lua,
+                               uint64_t rng_seed);
     static void destroyInstance();  // must be called before the game thread exits, otherwise will leak memory
+
+    // Move the current thread's Mediator to another thread. detachInstance
+    // removes it from this thread (without destroying it); attachInstance
+    // makes it the Mediator for the calling thread.
+    static Mediator * detachInstance();
+    static void attachInstance(Mediator *m);
     void setMap(shared_ptr<DungeonMap> dm, shared_ptr<CoordTransform> ct) { dmap = dm; coord_transform = ct; }
     void addPlayer(Player &);
     
@@ -274,21 +292,23 @@ private:
     Mediator(EventManager &em, GoreManager &gm, HomeManager &hm, MonsterManager &mm,
              QuestHintManager &qm,
              StuffManager &sm, TaskManager &tm, ViewManager &vm, boost::shared_ptr<const ConfigMap> cmap,
-             boost::shared_ptr<lua_State> lua)
-        : config_map(cmap), event_manager(em), gore_manager(gm), home_manager(hm), monster_manager(mm),
+             boost::shared_ptr<lua_State> lua, uint64_t rng_seed)
+        : config_map(cmap), engine_config(*cmap), event_manager(em), gore_manager(gm), home_manager(hm), monster_manager(mm),
           quest_hint_manager(qm),
           stuff_manager(sm), task_manager(tm), view_manager(vm), game_running(true), callbacks(0),
-          lua_state(lua), deathmatch_mode(false) { }
+          lua_state(lua), deathmatch_mode(false), rng(false) { rng.initialize(rng_seed); }
     void operator=(const Mediator &) const;  // not defined
     Mediator(const Mediator &);              // not defined
 
 
     void endGame(const std::vector<const Player*> &, bool time_limit_expired);
+    void onChangeSquare(const DungeonMap &, const MapCoord &);  // called when an item or tile changes
     
 private:
 
     // Config Map
     boost::shared_ptr<const ConfigMap> config_map;
+    EngineConfig engine_config;
     
     // References to the Manager objects for this game.
     EventManager &event_manager;
@@ -315,6 +335,9 @@ private:
 
     // this affects the behaviour of timeLimitExpired()
     bool deathmatch_mode;
+
+    // this game's random number stream (only used from the game thread)
+    RNG rng;
 };
 
 #endif
@@ -65,7 +65,7 @@ void MissileTask::execute(TaskManager &tm)
 
             // The missile has a chance to hit something
             const int hit_chance = m->range_left * m->itype.getMissileHitMultiplier() + 1;
-            if (g_rng.getBool(1.0f - 1.0f / hit_chance)) {
+            if (Mediator::getRNG().getBool(1.0f - 1.0f / hit_chance)) {
 
                 // OK the missile successfully hit.
                 // If hit type is CAN_HIT then process damage and delete the missile from the map.
@@ -122,7 +122,7 @@ void MissileTask::execute(TaskManager &tm)
             if (ma == A_APPROACH) {
                 // 'partial' missile access
                 float chance = m->itype.getMissileAccessChance();
-                if (g_rng.getBool(1-chance)) {
+                if (Mediator::getRNG().getBool(1-chance)) {
                     delete_from_map = true;
                     do_hook = true;
                 }
@@ -156,7 +156,7 @@ void MissileTask::execute(TaskManager &tm)
 
         // Reschedule. We check for collisions every "missile_check_interval" but make sure
         // to run the missile task at arrival_time+1 if that is sooner.
-        const int new_time = std::min(tm.getGVT() + Mediator::instance().cfgInt("missile_check_interval"),
+        const int new_time = std::min(tm.getGVT() + Mediator::instance().cfg().missile_check_interval,
                                       m->getArrivalTime() + 1);
         tm.addTask(shared_from_this(), TP_NORMAL, new_time);
     }
@@ -172,7 +172,7 @@ bool CreateMissile(DungeonMap &dmap, const MapCoord &mc, MapDirection dir,
     // Check access ahead. If A_APPROACH ("partial missile access") then check random chance that missile cant be placed
     const MapAccess acc = dmap.getAccess(DisplaceCoord(mc, dir), MapHeight(int(H_MISSILES) + int(dir)));
     if (acc == A_APPROACH) {
-        if (g_rng.getBool(1 - itype.getMissileAccessChance())) {
+        if (Mediator::getRNG().getBool(1 - itype.getMissileAccessChance())) {
             return false;
         }
     }
@@ -186,7 +186,7 @@ bool CreateMissile(DungeonMap &dmap, const MapCoord &mc, MapDirection dir,
     m->addToMap(&dmap, mc);
     m->move(MT_MOVE, true);  // start it forward half a square
     shared_ptr<MissileTask> mt(new MissileTask(m));
-    const int new_time = std::min(mediator.getGVT() + mediator.cfgInt("missile_check_interval"),
+    const int new_time = std::min(mediator.getGVT() + mediator.cfg().missile_check_interval,
                                   m->getArrivalTime() + 1);
     mediator.getTaskManager().addTask(mt, TP_NORMAL, new_time);
     return true;
@@ -29,6 +29,7 @@
 #include "lua_setup.hpp"
 #include "mediator.hpp"
 #include "monster_definitions.hpp"
+#include "monster_manager.hpp"
 #include "monster_support.hpp"
 #include "random_int.hpp"
 #include "rng.hpp"
@@ -69,7 +70,7 @@ namespace {
     bool TargetUnderneathMe(const Creature &me, const Creature &target)
     {
         Mediator &mediator = Mediator::instance();
-        const int flying_monster_targetting_offset = mediator.cfgInt("flying_monster_targetting_offset");
+        const int flying_monster_targetting_offset = mediator.cfg().flying_monster_targetting_offset;
 
         int dist = 0;
 
@@ -95,7 +96,7 @@ namespace {
 
     void ReplaceTask(TaskManager &tm, shared_ptr<Task> task, Monster &mon, bool replace_halfway_through_move)
     {
-        const int monster_wait_time = Mediator::instance().cfgInt("monster_wait_time");
+        const int monster_wait_time = Mediator::instance().cfg().monster_wait_time;
         const int gvt = tm.getGVT();
 
         bool can_act = !mon.isStunned() && !mon.isMoving();
@@ -117,12 +118,13 @@ namespace {
             }
             if (!known) can_act = true;   // Treat unknown case as if we can act (ie. just wait a preset delay time).
         }
+        MonsterScheduler &scheduler = Mediator::instance().getMonsterManager().getScheduler();
         if (can_act) {
             // Monster did not do anything. Wait for a preset delay time.
-            tm.addTask(task, TP_LOW, gvt + monster_wait_time);
+            scheduler.add(tm, task, gvt + monster_wait_time);
         } else {
             // Wait until the monster's current action finishes.
-            tm.addTask(task, TP_LOW, cannot_act_until + 1);
+            scheduler.add(tm, task, cannot_act_until + 1);
         }
     }
 }
@@ -130,8 +132,8 @@ namespace {
 void FlyingMonsterAI::execute(TaskManager &tm)
 {
     Mediator &mediator = Mediator::instance();
-    const float monster_wait_chance_as_fraction = mediator.cfgProbability("monster_wait_chance");
-    const int flying_monster_bite_wait = mediator.cfgInt("flying_monster_bite_wait");
+    const float monster_wait_chance_as_fraction = mediator.cfg().monster_wait_chance;
+    const int flying_monster_bite_wait = mediator.cfg().flying_monster_bite_wait;
 
     shared_ptr<FlyingMonster> bat = vbat.lock();
     if (!bat || !bat->getMap()) return;  // the bat has died
@@ -168,7 +170,8 @@ void FlyingMonsterAI::execute(TaskManager &tm)
             p.first = dir;
             p.second = true;
         } else {
-            p = ChooseDirection(bat, target->getPos(), true, BatCanEnter());
+            p = ChooseDirectionOnField(bat, target->getDistanceField(H_FLYING), true, BatCanEnter());
+            if (!p.second) p = ChooseDirection(bat, target->getPos(), true, BatCanEnter());
         }
         // Don't allow halfway-through bites when running away
         allow_bite_halfway = false;
@@ -178,10 +181,11 @@ void FlyingMonsterAI::execute(TaskManager &tm)
         allow_bite_halfway = false;  // since we're not moving anyway
     } else if (target) {
         // Move towards the target
-        p = ChooseDirection(bat, target->getPos(), false, BatCanEnter());
+        p = ChooseDirectionOnField(bat, target->getDistanceField(H_FLYING), false, BatCanEnter());
+        if (!p.second) p = ChooseDirection(bat, target->getPos(), false, BatCanEnter());
         // We're allowed to bite him halfway through the move...
         allow_bite_halfway = true;
-    } else if (g_rng.getBool(monster_wait_chance_as_fraction)) {
+    } else if (Mediator::getRNG().getBool(monster_wait_chance_as_fraction)) {
         // Special rule - if there is no target then we have a "monster_wait_chance" 
         // chance of doing nothing (as for zombies).
         allow_bite_halfway = false; // since we're not moving anyway
@@ -255,7 +259,7 @@ shared_ptr<Monster> FlyingMonsterType::makeMonster(TaskManager &tm) const
     const int h = std::max(1, health.get());
     shared_ptr<FlyingMonster> mon(new FlyingMonster(*this, h, anim, speed));
     shared_ptr<Task> ai(new FlyingMonsterAI(mon));
-    tm.addTask(ai, TP_LOW, tm.getGVT()+1);
+    Mediator::instance().getMonsterManager().getScheduler().add(tm, ai, tm.getGVT()+1);
     return mon;
 }
 
@@ -291,7 +295,7 @@ void FlyingMonster::bite(shared_ptr<Creature> target)
     }
 
     // set my anim frame, and stun myself.
-    const int wait_until = gvt + mediator.cfgInt("melee_delay_time");
+    const int wait_until = gvt + mediator.cfg().melee_delay_time;
     setAnimFrame(AF_IMPACT, wait_until);
     stunUntil(wait_until);
 }
@@ -351,9 +355,8 @@ namespace {
             if (dmap.getAccess(mc, H_WALKING) != A_CLEAR) return false;
             
             // If a tile is on the "avoid" list then we may not walk into this square
-            std::vector<shared_ptr<Tile> > tiles;
-            dmap.getTiles(mc, tiles);
-            for (std::vector<shared_ptr<Tile> >::iterator it = tiles.begin(); it != tiles.end();
+            const std::vector<shared_ptr<Tile> > &tiles = dmap.getTilesAt(mc);
+            for (std::vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end();
             ++it) {
                 if (find(avoid_tiles.begin(), avoid_tiles.end(), (*it)->getOriginalTile()) != avoid_tiles.end()) {
                     return false;
@@ -389,9 +392,8 @@ namespace {
             
             // A walking monster can also try to smash furniture tiles (as long as they're
             // not doors).
-            std::vector<shared_ptr<Tile> > tiles;
-            dmap.getTiles(mc, tiles);
-            for (std::vector<shared_ptr<Tile> >::iterator it = tiles.begin(); it != tiles.end();
+            const std::vector<shared_ptr<Tile> > &tiles = dmap.getTilesAt(mc);
+            for (std::vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end();
             ++it) {
                 if ((*it)->destructible() && !dynamic_cast<Door*>(it->get())) {
                     return true;
@@ -443,9 +445,15 @@ void WalkingMonsterAI::execute(TaskManager &tm)
     // Choose a direction to move in:
     // (If there is no target, then there is a chance that the monster will stay
     // where it is and do nothing, rather than randomly walking about.)
-    if (!(!target && g_rng.getBool(mediator.cfgProbability("monster_wait_chance")))) {
-        p = ChooseDirection(mon, target? target->getPos() : MapCoord(), run_away,
-                            ZombieCanMove(avoid_tiles, fear_items, hit_items));
+    if (!(!target && Mediator::getRNG().getBool(mediator.cfg().monster_wait_chance))) {
+        const ZombieCanMove zcm(avoid_tiles, fear_items, hit_items);
+        if (target) {
+            // Follow the distance field (this finds a way around obstacles)
+            p = ChooseDirectionOnField(mon, target->getDistanceField(H_WALKING), run_away, zcm);
+        }
+        if (!p.second) {
+            p = ChooseDirection(mon, target? target->getPos() : MapCoord(), run_away, zcm);
+        }
     }
 
     // Move (if we can act)
@@ -471,7 +479,7 @@ void WalkingMonsterAI::execute(TaskManager &tm)
             if (target) {
                 mon->setFacing(DirectionFromTo(mon->getPos(), target->getPos()));
             } else {
-                mon->setFacing(MapDirection(g_rng.getInt(0,4)));
+                mon->setFacing(MapDirection(Mediator::getRNG().getInt(0,4)));
             }
         }
     }
@@ -533,9 +541,9 @@ shared_ptr<Monster> WalkingMonsterType::makeMonster(TaskManager &tm) const
 {
     const int h = std::max(1, health.get());
     shared_ptr<WalkingMonster> monster(new WalkingMonster(*this, h, weapon, anim, speed));
-    monster->setFacing(MapDirection(g_rng.getInt(0,4))); // random initial facing
+    monster->setFacing(MapDirection(Mediator::getRNG().getInt(0,4))); // random initial facing
     shared_ptr<Task> ai(new WalkingMonsterAI(monster, avoid_tiles, fear_items, hit_items));
-    tm.addTask(ai, TP_LOW, tm.getGVT()+1);
+    Mediator::instance().getMonsterManager().getScheduler().add(tm, ai, tm.getGVT()+1);
     return monster;
 }
 
@@ -559,5 +567,5 @@ void WalkingMonster::damage(int amount, const Originator &attacker, int stun_unt
     Monster::damage(amount, attacker, stun_until, inhibit_squelch);
     setAnimFrame(AF_PARRY,
                  stun_until != -1 ? stun_until
-                                  : (mediator.getGVT() + mediator.cfgInt("walking_monster_damage_delay")));
+                                  : (mediator.getGVT() + mediator.cfg().walking_monster_damage_delay));
 }
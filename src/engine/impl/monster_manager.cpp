@@ -41,6 +41,7 @@ using std::vector;
 MonsterManager::MonsterManager()
     : total_current_monsters(0), total_monster_limit(-1), zombie_chance(0),
       necronomicon_counter(0), necromancy_flag(false),
+      candidate_dmap(0), candidate_width(0), candidates_dirty(true),
       monster_respawn_wait(0)
 { }
 
@@ -51,12 +52,14 @@ void MonsterManager::clear()
     necronomicon_counter = 0;
     necromancy_flag = false;
     zombie_activity_counters.clear();
+    candidates_dirty = true;
 }
 
 void MonsterManager::addZombieDecay(shared_ptr<Tile> from, shared_ptr<Tile> to)
 {
     if (!from || !to) return;
     decay_sequence.insert(make_pair(from, to));
+    candidates_dirty = true;
 }
 
 void MonsterManager::addZombieReanimate(shared_ptr<Tile> from, const MonsterType * to)
@@ -67,6 +70,7 @@ void MonsterManager::addZombieReanimate(shared_ptr<Tile> from, const MonsterType
     m.zombie_mode = true;
     m.chance = 0;
     monster_map.insert(make_pair(from, m));
+    candidates_dirty = true;
 }
 
 void MonsterManager::addMonsterGenerator(shared_ptr<Tile> from, const MonsterType * to, float chance)
@@ -77,6 +81,7 @@ void MonsterManager::addMonsterGenerator(shared_ptr<Tile> from, const MonsterTyp
     m.zombie_mode = false;
     m.chance = chance;
     monster_map.insert(make_pair(from, m));
+    candidates_dirty = true;
 }
 
 void MonsterManager::limitMonster(const MonsterType *type, int max_number)
@@ -121,8 +126,8 @@ namespace {
         if (right <= left || bottom <= top) {
             return MapCoord();
         }
-        const int x = g_rng.getInt(left, right);
-        const int y = g_rng.getInt(top, bottom);
+        const int x = Mediator::getRNG().getInt(left, right);
+        const int y = Mediator::getRNG().getInt(top, bottom);
         return MapCoord(x,y);
     }
 }
@@ -138,7 +143,7 @@ void MonsterManager::doMonsterGeneration(DungeonMap &dmap, int left, int top,
     // First of all, we reduce the chances of doing anything in proportion to the
     // number of monsters already in the dungeon:
     if (total_monster_limit > 0
-    && g_rng.getBool(total_current_monsters * 1.0f / total_monster_limit)) {
+    && Mediator::getRNG().getBool(total_current_monsters * 1.0f / total_monster_limit)) {
         return;
     }
     
@@ -152,6 +157,10 @@ void MonsterManager::doMonsterGeneration(DungeonMap &dmap, int left, int top,
         MapCoord mc = GetRandomSquare(left, top, right, bottom);
         if (!dmap.valid(mc)) continue;
 
+        // Most squares have no decaying corpses or monster generators,
+        // and can be skipped straight away.
+        if (!isCandidateSquare(dmap, mc)) continue;
+
         const bool zombie_activity_inhibited = zombieActivityInhibited(mc);
         
         // Get list of tiles at the square:
@@ -247,6 +256,7 @@ void MonsterManager::doNecromancy(int nzoms, DungeonMap &dmap, int left, int top
             // Pick a random square
             MapCoord mc = GetRandomSquare(left, top, right, bottom);
             if (!dmap.valid(mc)) continue;
+            if (!isCandidateSquare(dmap, mc)) continue;
 
             // Get a list of tiles at the square
             dmap.getTiles(mc, tiles);
@@ -331,12 +341,12 @@ void MonsterManager::onPlaceKnightCorpse(const MapCoord &mc)
 
 bool MonsterManager::rollZombieActivity() const
 {
-    return necronomicon_counter > 0 || g_rng.getBool(zombie_chance);
+    return necronomicon_counter > 0 || Mediator::getRNG().getBool(zombie_chance);
 }
 
 bool MonsterManager::rollTileGeneratedMonster(float chance) const
 {
-    return g_rng.getBool(chance);
+    return Mediator::getRNG().getBool(chance);
 }
 
 bool MonsterManager::reachedMonsterLimit(const MonsterType * m) const
@@ -379,6 +389,72 @@ shared_ptr<Monster> MonsterManager::addMonsterToMap(const MonsterType &mt, Dunge
     return mnstr;
 }
 
+//
+// spawn candidate index
+//
+
+bool MonsterManager::isCandidateTile(const Tile &tile) const
+{
+    if (candidate_tiles.find(&tile) != candidate_tiles.end()) return true;
+    shared_ptr<Tile> orig = tile.getOriginalTile();
+    return orig && candidate_tiles.find(orig.get()) != candidate_tiles.end();
+}
+
+void MonsterManager::buildCandidateIndex(const DungeonMap &dmap)
+{
+    candidate_tiles.clear();
+    for (map<shared_ptr<Tile>, shared_ptr<Tile> >::const_iterator it = decay_sequence.begin();
+    it != decay_sequence.end(); ++it) {
+        candidate_tiles.insert(it->first.get());
+    }
+    for (map<shared_ptr<Tile>, MonsterInfo>::const_iterator it = monster_map.begin();
+    it != monster_map.end(); ++it) {
+        candidate_tiles.insert(it->first.get());
+    }
+
+    candidate_dmap = &dmap;
+    candidate_width = dmap.getWidth();
+    candidate_counts.assign(dmap.getWidth() * dmap.getHeight(), 0);
+    for (int y = 0; y < dmap.getHeight(); ++y) {
+        for (int x = 0; x < dmap.getWidth(); ++x) {
+            const vector<shared_ptr<Tile> > &tiles = dmap.getTilesAt(MapCoord(x, y));
+            for (vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end(); ++it) {
+                if (isCandidateTile(**it)) ++candidate_counts[y * candidate_width + x];
+            }
+        }
+    }
+
+    candidates_dirty = false;
+}
+
+bool MonsterManager::isCandidateSquare(const DungeonMap &dmap, const MapCoord &mc)
+{
+    if (candidates_dirty || &dmap != candidate_dmap || dmap.getWidth() != candidate_width
+    || int(candidate_counts.size()) != dmap.getWidth() * dmap.getHeight()) {
+        buildCandidateIndex(dmap);
+    }
+    return candidate_counts[mc.getY() * candidate_width + mc.getX()] != 0;
+}
+
+void MonsterManager::onAddTile(const DungeonMap &dmap, const MapCoord &mc, const Tile &tile)
+{
+    if (candidates_dirty || &dmap != candidate_dmap || !dmap.valid(mc)) return;
+    const size_t idx = mc.getY() * candidate_width + mc.getX();
+    if (idx < candidate_counts.size() && isCandidateTile(tile)) {
+        ++candidate_counts[idx];
+    }
+}
+
+void MonsterManager::onRmTile(const DungeonMap &dmap, const MapCoord &mc, const Tile &tile)
+{
+    if (candidates_dirty || &dmap != candidate_dmap || !dmap.valid(mc)) return;
+    const size_t idx = mc.getY() * candidate_width + mc.getX();
+    if (idx < candidate_counts.size() && candidate_counts[idx] > 0 && isCandidateTile(tile)) {
+        --candidate_counts[idx];
+    }
+}
+
+
 //
 // zombie activity counters (#152) -- support functions
 //
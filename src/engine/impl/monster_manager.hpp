@@ -30,13 +30,16 @@
 #define MONSTER_MANAGER_HPP
 
 #include "map_support.hpp"
+#include "monster_scheduler.hpp"
 
 #include "boost/shared_ptr.hpp"
 using namespace boost;
 
 #include <map>
+#include <set>
 #include <vector>
 
+class DungeonMap;
 class ItemType;
 class Tile;
 class Monster;
@@ -141,6 +144,18 @@ public:
     void onPlaceMonsterCorpse(const MapCoord &mc, const MonsterType &m);
     void onPlaceKnightCorpse(const MapCoord &mc);
 
+    //
+    // these are called by Mediator::onAddTile and onRmTile (to keep
+    // the spawn candidate index up to date)
+    //
+    void onAddTile(const DungeonMap &dmap, const MapCoord &mc, const Tile &tile);
+    void onRmTile(const DungeonMap &dmap, const MapCoord &mc, const Tile &tile);
+
+    //
+    // scheduling of monster AI tasks
+    //
+    MonsterScheduler & getScheduler() { return scheduler; }
+
 private:
     // Noncopyable
     void operator=(const MonsterManager &);
@@ -153,6 +168,11 @@ private:
     shared_ptr<Monster> addMonsterToMap(const MonsterType &mt, DungeonMap &dmap,
                                         const MapCoord &mc);    // gives it a random initial facing
 
+    // spawn candidate index
+    bool isCandidateTile(const Tile &tile) const;
+    bool isCandidateSquare(const DungeonMap &dmap, const MapCoord &mc);
+    void buildCandidateIndex(const DungeonMap &dmap);
+
     bool zombieActivityInhibited(const MapCoord &mc) const;
     void decrementZombieActivityCounters();
     void addZombieActivityCounter(const MapCoord &mc);
@@ -175,7 +195,22 @@ private:
     bool necromancy_flag;  // set true when doNecromancy is called.
 
     std::map<MapCoord, int> zombie_activity_counters;  // Force wait before zombie can respawn (#152)
+
+    // Spawn candidate index. candidate_tiles holds every tile that
+    // appears in decay_sequence or monster_map. candidate_counts holds,
+    // for each square of candidate_dmap, the number of tiles on that
+    // square that are (or are clones of) candidate tiles. Monster
+    // generation only needs to look at the tiles of squares with a
+    // non-zero count. (The index is rebuilt, on next use, when the
+    // tile tables change or the dungeon is wiped.)
+    std::set<const Tile *> candidate_tiles;
+    std::vector<unsigned short> candidate_counts;
+    const DungeonMap *candidate_dmap;
+    int candidate_width;
+    bool candidates_dirty;
     int monster_respawn_wait;
+
+    MonsterScheduler scheduler;
 };
 
 #endif
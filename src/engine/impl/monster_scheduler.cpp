@@ -0,0 +1,105 @@
+/*
+ * monster_scheduler.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "mediator.hpp"
+#include "monster_scheduler.hpp"
+#include "task.hpp"
+#include "task_manager.hpp"
+
+#include <algorithm>
+
+namespace {
+    struct RunsLater {
+        template<class E>
+        bool operator()(const E &lhs, const E &rhs) const {
+            return lhs.time > rhs.time || (lhs.time == rhs.time && lhs.seq > rhs.seq);
+        }
+    };
+}
+
+class MonsterBatchTask : public Task {
+public:
+    explicit MonsterBatchTask(MonsterScheduler &s) : scheduler(s) { }
+    virtual void execute(TaskManager &tm) { scheduler.runBatch(tm); }
+private:
+    MonsterScheduler &scheduler;
+};
+
+MonsterScheduler::MonsterScheduler()
+    : batch_task(new MonsterBatchTask(*this)), in_batch(false)
+{ }
+
+void MonsterScheduler::add(TaskManager &tm, boost::shared_ptr<Task> ai, int exec_time)
+{
+    if (!Mediator::instance().cfg().monster_ai_batching) {
+        tm.addTask(ai, TP_LOW, exec_time);
+        return;
+    }
+
+    // Use the sequence number that addTask would have used, so that
+    // the AI runs at the same point as it would have done as a
+    // separate task.
+    Entry entry;
+    entry.time = exec_time;
+    entry.seq = tm.allocSeq();
+    entry.ai = ai;
+    heap.push_back(entry);
+    std::push_heap(heap.begin(), heap.end(), RunsLater());
+
+    // If the new entry is now the first due, move the batch task to
+    // its place in the queue. (During a batch, runBatch does this at
+    // the end.)
+    if (!in_batch && heap.front().ai == ai) {
+        tm.rmTask(batch_task);
+        tm.addTaskWithSeq(batch_task, TP_LOW, exec_time, entry.seq);
+    }
+}
+
+void MonsterScheduler::runBatch(TaskManager &tm)
+{
+    // Run AIs for as long as they are due, and would have run before
+    // any other TP_LOW task.
+    in_batch = true;
+    try {
+        while (!heap.empty()) {
+            const Entry &front = heap.front();
+            if (front.time > tm.getGVT() || !tm.runsBefore(TP_LOW, front.time, front.seq)) break;
+
+            boost::shared_ptr<Task> ai = front.ai;
+            std::pop_heap(heap.begin(), heap.end(), RunsLater());
+            heap.pop_back();
+
+            ai->execute(tm);  // may call add()
+        }
+    } catch (...) {
+        in_batch = false;
+        throw;
+    }
+    in_batch = false;
+
+    if (!heap.empty()) {
+        tm.addTaskWithSeq(batch_task, TP_LOW, heap.front().time, heap.front().seq);
+    }
+}
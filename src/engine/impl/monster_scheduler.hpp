@@ -0,0 +1,77 @@
+/*
+ * monster_scheduler.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Runs the AI tasks of all the monsters in the dungeon.
+ *
+ * Normally each monster's AI task is simply added to the TaskManager.
+ * If "monster_ai_batching" is enabled in the config, the AI tasks are
+ * instead held in a single heap owned by the MonsterScheduler, and one
+ * TaskManager task runs all the monster AIs that are due in the same
+ * tick, in one pass. This keeps the TaskManager queue short when there
+ * are hundreds of monsters.
+ *
+ * The AI tasks run in exactly the same order (relative to each other,
+ * and to all other tasks) in both modes, so the game plays out the
+ * same either way.
+ *
+ */
+
+#ifndef MONSTER_SCHEDULER_HPP
+#define MONSTER_SCHEDULER_HPP
+
+#include "boost/shared_ptr.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class Task;
+class TaskManager;
+
+class MonsterScheduler {
+public:
+    MonsterScheduler();
+
+    // Schedule a monster AI task to run at the given time, with TP_LOW
+    // priority. (This replaces tm.addTask for monster AI tasks.)
+    void add(TaskManager &tm, boost::shared_ptr<Task> ai, int exec_time);
+
+private:
+    MonsterScheduler(const MonsterScheduler &) = delete;
+    void operator=(const MonsterScheduler &) = delete;
+
+    friend class MonsterBatchTask;
+    void runBatch(TaskManager &tm);
+
+    struct Entry {
+        int time;
+        uint64_t seq;
+        boost::shared_ptr<Task> ai;
+    };
+    std::vector<Entry> heap;   // min-heap by (time, seq)
+
+    boost::shared_ptr<Task> batch_task;  // scheduled at the key of heap.front()
+    bool in_batch;
+};
+
+#endif
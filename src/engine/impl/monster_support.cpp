@@ -28,9 +28,8 @@
 
 bool KnightAt(DungeonMap &dmap, const MapCoord &mc, const std::vector<ItemType *> &fear)
 {
-    std::vector<shared_ptr<Entity> > ents;
-    dmap.getEntities(mc, ents);
-    for (std::vector<shared_ptr<Entity> >::iterator it = ents.begin(); it != ents.end(); ++it) {
+    const std::vector<shared_ptr<Entity> > &ents = dmap.getEntitiesAt(mc);
+    for (std::vector<shared_ptr<Entity> >::const_iterator it = ents.begin(); it != ents.end(); ++it) {
         Knight * kt = dynamic_cast<Knight*>(it->get());
         if (kt && (std::find(fear.begin(), fear.end(), kt->getItemInHand()) == fear.end())) {
             return true;
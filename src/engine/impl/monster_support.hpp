@@ -22,13 +22,14 @@
  */
 
 /*
- * A couple of support routines for monster AI.
+ * A few support routines for monster AI.
  *
  */
 
 #ifndef MONSTER_SUPPORT_HPP
 #define MONSTER_SUPPORT_HPP
 
+#include "distance_field.hpp"
 #include "knight.hpp"
 #include "mediator.hpp"
 #include "player.hpp"
@@ -88,7 +89,7 @@ shared_ptr<Knight> FindClosestKnight(shared_ptr<Entity> ent, T predicate)
     if (best_so_far.empty()) {
         return shared_ptr<Knight>();
     } else {
-        const int idx = g_rng.getInt(0, best_so_far.size());
+        const int idx = Mediator::getRNG().getInt(0, best_so_far.size());
         return best_so_far[idx];
     }
 }
@@ -122,7 +123,7 @@ std::pair<MapDirection,bool> ChooseDirection(shared_ptr<Entity> ent, const MapCo
     }   
 
     // If 50% chance, then swap order of x and y
-    if (g_rng.getBool(0.5f)) {
+    if (Mediator::getRNG().getBool(0.5f)) {
         std::swap(d[0],d[1]);
         std::swap(basedir[0],basedir[1]);
     }   
@@ -141,7 +142,7 @@ std::pair<MapDirection,bool> ChooseDirection(shared_ptr<Entity> ent, const MapCo
     // now include "reverse" directions as well
     for (int i=0; i<2; ++i) {
         if (d[i] == 0) {
-            if (g_rng.getBool(0.5f)) {
+            if (Mediator::getRNG().getBool(0.5f)) {
                 dir[next_dir++] = basedir[i];
                 dir[next_dir++] = Opposite(basedir[i]);
             } else {
@@ -168,4 +169,55 @@ std::pair<MapDirection,bool> ChooseDirection(shared_ptr<Entity> ent, const MapCo
     return std::make_pair(D_NORTH,false);
 }
 
+
+//
+// Choose a direction for a monster to move in, by following a
+// DistanceField downhill (towards the target) or uphill (away from it,
+// if afraid). Squares the monster cannot move into are skipped.
+// Returns false if there is no suitable direction (e.g. the monster
+// is not on the field, or the route is blocked by other creatures),
+// in which case the caller should fall back to ChooseDirection.
+//
+template<class T>
+std::pair<MapDirection,bool> ChooseDirectionOnField(shared_ptr<Entity> ent, const DistanceField &field,
+                                                    bool afraid, T can_walk_into_predicate)
+{
+    if (!ent || !ent->getMap()) return std::make_pair(D_NORTH,false);
+
+    const int here = field.getDistance(ent->getPos());
+    if (here == DistanceField::UNREACHABLE) return std::make_pair(D_NORTH,false);
+
+    // Rank the four directions by distance (starting from a random
+    // direction, so that ties are broken randomly)
+    MapDirection dir[4];
+    int dist[4];
+    int n = 0;
+    const int start = Mediator::getRNG().getInt(0, 4);
+    for (int i = 0; i < 4; ++i) {
+        const MapDirection d = MapDirection((start + i) % 4);
+        const int there = field.getDistance(DisplaceCoord(ent->getPos(), d));
+        if (there == DistanceField::UNREACHABLE) continue;
+        if (afraid ? there <= here : there >= here) continue;
+
+        // insertion sort: best first
+        int j = n++;
+        while (j > 0 && (afraid ? dist[j-1] < there : dist[j-1] > there)) {
+            dir[j] = dir[j-1];
+            dist[j] = dist[j-1];
+            --j;
+        }
+        dir[j] = d;
+        dist[j] = there;
+    }
+
+    // Try each direction in turn
+    for (int i = 0; i < n; ++i) {
+        if (can_walk_into_predicate(*ent->getMap(), DisplaceCoord(ent->getPos(), dir[i]))) {
+            return std::make_pair(dir[i],true);
+        }
+    }
+
+    return std::make_pair(D_NORTH,false);
+}
+
 #endif
@@ -33,8 +33,8 @@
 void MonsterTask::execute(TaskManager &tm)
 {
     Mediator &mediator = Mediator::instance();
-    const int radius = mediator.cfgInt("monster_radius");
-    const int interval = mediator.cfgInt("monster_interval");
+    const int radius = mediator.cfg().monster_radius;
+    const int interval = mediator.cfg().monster_interval;
     
     int left = 999999, right = 0,
         top = 999999, bottom = 0;
@@ -50,6 +50,7 @@
 
 #include "include_lua.hpp"
 
+#include <cstring>
 #include <set>
 #include <sstream>
 
@@ -161,6 +162,7 @@ Player::Player(int plyr_num,
       home_dmap(0), 
       anim(a),
       default_item(di), backpack_capacities(0), control_set(cs),
+      controls_dirty(true), controls_refresh_time(0), controls_stamp(0),
       secured_home_cc(sec_home_cc),
       nskulls(0), nkills(0), frags(0), player_id(plyr_id), player_state(PlayerState::NORMAL),
       respawn_type(R_NORMAL),
@@ -233,18 +235,9 @@ void Player::mapCurrentRoom(const MapCoord &top_left)
     const DungeonMap *dmap = getDungeonMap();
     if (!dmap) return;
 
-    std::vector<boost::shared_ptr<Tile> > tiles;
-    
     for (int j = 0; j < current_room_height; ++j) {
         for (int i = 0; i < current_room_width; ++i) {
-
-            MiniMapColour col = COL_UNMAPPED;
-            dmap->getTiles(MapCoord(i+ox, j+oy), tiles);
-            for (std::vector<boost::shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end(); ++it) {
-                const MiniMapColour c = (*it)->getColour();
-                if (c < col) col = c;
-            }
-            
+            const MiniMapColour col = dmap->getMiniMapColour(MapCoord(i+ox, j+oy));
             setMiniMapColour(i + ox, j + oy, col);
         }
     }
@@ -380,7 +373,7 @@ void Player::onDeath()
     // NOTE: This MUST NOT call Lua because we are not allowed to raise Lua errors from
     // this function...
 
-    scheduleRespawn(Mediator::instance().cfgInt("respawn_delay"));
+    scheduleRespawn(Mediator::instance().cfg().respawn_delay);
 
     // Also add a skull
     getStatusDisplay().addSkull();
@@ -494,9 +487,9 @@ bool Player::respawn()
         // somewhere completely random
         if (respawn_type == R_RANDOM_SQUARE) {
             dmap = Mediator::instance().getMap().get();
-            mc = MapCoord(g_rng.getInt(1, dmap->getWidth() - 1),
-                g_rng.getInt(1, dmap->getHeight() - 1));
-            facing = MapDirection(g_rng.getInt(0, 4));
+            mc = MapCoord(Mediator::getRNG().getInt(1, dmap->getWidth() - 1),
+                Mediator::getRNG().getInt(1, dmap->getHeight() - 1));
+            facing = MapDirection(Mediator::getRNG().getInt(0, 4));
 
         } else {
 
@@ -561,7 +554,7 @@ bool Player::respawn()
 
     // Respawn successful -- Create a new knight.
     shared_ptr<Knight> my_knight(new Knight(*this, backpack_capacities,
-        mediator.cfgInt("knight_hitpoints"), H_WALKING, default_item, anim, 100));
+        mediator.cfg().knight_hitpoints, H_WALKING, default_item, anim, 100));
     this->knight = my_knight;
 
     // Move the knight into the map.
@@ -628,6 +621,10 @@ void Player::computeAvailableControls()
 {
     shared_ptr<Knight> kt = knight.lock();
 
+    controls_dirty = false;
+    controls_refresh_time = Mediator::instance().getGVT() + Mediator::instance().cfg().control_refresh_interval;
+    controls_stamp = ControlStamp(kt.get());
+
     std::map<const Control *, ControlInfo> new_controls;
     
     if (kt && kt->getMap()) {
@@ -679,6 +676,41 @@ void Player::computeAvailableControls()
 }
 
 
+Player::ControlStamp::ControlStamp(const Knight *kt)
+    : knight(kt), dmap(0), facing(D_NORTH), height(H_WALKING),
+      approaching(false), ahead_clear(false), held(0)
+{
+    if (kt && kt->getMap()) {
+        dmap = kt->getMap();
+        pos = kt->getPos();
+        dest_pos = kt->getDestinationPos();
+        targetted_pos = kt->getTargettedPos();
+        facing = kt->getFacing();
+        height = kt->getHeight();
+        approaching = kt->isApproaching();
+        ahead_clear = kt->getMap()->getEntitiesAt(DisplaceCoord(pos, facing)).empty()
+            && kt->getMap()->getEntitiesAt(DisplaceCoord(dest_pos, facing)).empty();
+        held = kt->getItemInHand();
+    }
+}
+
+bool Player::needControlsRecompute(int gvt) const
+{
+    if (controls_dirty || gvt - controls_refresh_time >= 0) return true;
+    shared_ptr<Knight> kt = knight.lock();
+    return !(ControlStamp(kt.get()) == controls_stamp);
+}
+
+void Player::onChangeSquare(const DungeonMap &dmap, const MapCoord &mc)
+{
+    // The controls only look at squares adjacent to the knight's
+    // position or destination, so anything within 2 squares is relevant.
+    if (controls_dirty || controls_stamp.dmap != &dmap) return;
+    const int dx = std::abs(mc.getX() - controls_stamp.pos.getX());
+    const int dy = std::abs(mc.getY() - controls_stamp.pos.getY());
+    if (dx <= 2 && dy <= 2) controls_dirty = true;
+}
+
 void Player::addTileControls(DungeonMap *dmap, const MapCoord &mc,
                              std::map<const Control *, ControlInfo> &cmap,
                              bool ahead,
@@ -689,13 +721,11 @@ void Player::addTileControls(DungeonMap *dmap, const MapCoord &mc,
     if (!dmap) return;
     if (!ahead && approaching) return;  // can't do current square if approaching the square ahead.
 
+    // (Note: we take a copy of the tile list, because checkPossible runs Lua code.)
     std::vector<shared_ptr<Tile> > tiles;
     dmap->getTiles(mc, tiles);
 
-    MapAccess acc = A_CLEAR;
-    for (std::vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end(); ++it) {
-        acc = std::min(acc, (*it)->getAccess(ht));
-    }
+    const MapAccess acc = dmap->getAccessTilesOnly(mc, ht);
 
     for (std::vector<shared_ptr<Tile> >::const_iterator it = tiles.begin(); it != tiles.end();
     ++it) {
@@ -706,9 +736,7 @@ void Player::addTileControls(DungeonMap *dmap, const MapCoord &mc,
             if (ahead) {
                 // square-ahead is ok if there are no entities there.
                 // (This prevents us from shutting doors on other knights, or monsters.)
-                std::vector<shared_ptr<Entity> > entities;
-                dmap->getEntities(mc, entities);
-                ok = (entities.empty());
+                ok = dmap->getEntitiesAt(mc).empty();
 
                 // In the approach based system, square-ahead is usually secondary;
                 // however, if we are approaching it, or it cannot be approached, then it is primary.
@@ -146,7 +146,7 @@ public:
     // (e.g. action bar players have a delay on dagger throwing;
     // non approach based players can pick up from a table without approaching it.)
     bool getApproachBasedControls() const { return approach_based_controls; }
-    void setApproachBasedControls(bool flag) { approach_based_controls = flag; }
+    void setApproachBasedControls(bool flag) { approach_based_controls = flag; controls_dirty = true; }
     bool getActionBarControls() const { return action_bar_controls; }
     void setActionBarControls(bool flag) { action_bar_controls = flag; }
     
@@ -175,7 +175,17 @@ public:
     void getControlInfo(const Control *ctrl_in, ItemType *& itype_out,
                         weak_ptr<Tile> &tile_out, MapCoord &tile_mc_out) const;
     void computeAvailableControls();
-    void clearCurrentControls() { current_controls.clear(); }
+    void clearCurrentControls() { current_controls.clear(); controls_dirty = true; }
+
+    // The available controls are only recomputed when something they
+    // depend on has changed: the knight's position, facing or held
+    // item (checked by needControlsRecompute), or the backpack contents
+    // or nearby items and tiles (reported via invalidateControls and
+    // onChangeSquare). As a safety net, they are also recomputed every
+    // control_refresh_interval ms.
+    bool needControlsRecompute(int gvt) const;
+    void invalidateControls() { controls_dirty = true; }
+    void onChangeSquare(const DungeonMap &dmap, const MapCoord &mc);  // called by Mediator
 
     // get player ID (e.g. Steam ID)
     const PlayerID & getPlayerID() const { return player_id; }
@@ -209,6 +219,27 @@ private:
         }
     };
 
+    // Knight state that the available controls depend on.
+    struct ControlStamp {
+        const Knight *knight;
+        const DungeonMap *dmap;
+        MapCoord pos, dest_pos, targetted_pos;
+        MapDirection facing;
+        MapHeight height;
+        bool approaching;
+        bool ahead_clear;   // no entities ahead of pos or dest_pos
+        const ItemType *held;
+
+        explicit ControlStamp(const Knight *kt);
+        bool operator==(const ControlStamp &rhs) const {
+            return knight == rhs.knight && dmap == rhs.dmap
+                && pos == rhs.pos && dest_pos == rhs.dest_pos && targetted_pos == rhs.targetted_pos
+                && facing == rhs.facing && height == rhs.height
+                && approaching == rhs.approaching && ahead_clear == rhs.ahead_clear
+                && held == rhs.held;
+        }
+    };
+
 private:
     void addTileControls(DungeonMap *dmap, const MapCoord &mc,
                          std::map<const Control *, ControlInfo> &cmap, bool ahead,
@@ -242,6 +273,11 @@ private:
     const std::vector<const Control *> & control_set;
 
     std::map<const Control *, ControlInfo> current_controls;
+
+    // State at the time current_controls was last computed
+    bool controls_dirty;
+    int controls_refresh_time;
+    ControlStamp controls_stamp;
     
     weak_ptr<Knight> knight;
     shared_ptr<RespawnTask> respawn_task;
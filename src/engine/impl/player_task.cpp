@@ -66,12 +66,11 @@ void PlayerTask::execute(TaskManager &tm)
             // entities within a room.
             // NOTE: Knights on the same team as me do not count as "creatures in the room" for this purpose (Trac #126).
             bool found_creature = false;
-            std::vector<shared_ptr<Entity> > entities;
             for (int i=0; i<w; ++i) {
                 for (int j=0; j<h; ++j) {
                     MapCoord mc(top_left.getX() + i, top_left.getY() + j);
-                    dmap->getEntities(mc, entities);
-                    for (std::vector<shared_ptr<Entity> >::iterator it = entities.begin();
+                    const std::vector<shared_ptr<Entity> > &entities = dmap->getEntitiesAt(mc);
+                    for (std::vector<shared_ptr<Entity> >::const_iterator it = entities.begin();
                     it != entities.end(); ++it) {
 
                         Creature * cr = dynamic_cast<Creature*>(it->get());
@@ -144,5 +143,5 @@ void PlayerTask::execute(TaskManager &tm)
         
     // Now reschedule the task
     shared_ptr<PlayerTask> pt(new PlayerTask(pl));
-    tm.addTask(pt, TP_NORMAL, tm.getGVT() + med.cfgInt("player_task_interval"));
+    tm.addTask(pt, TP_NORMAL, tm.getGVT() + med.cfg().player_task_interval);
 }
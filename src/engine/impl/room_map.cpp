@@ -23,6 +23,7 @@
 
 #include "misc.hpp"
 
+#include "mediator.hpp"
 #include "my_exceptions.hpp"
 #include "room_map.hpp"
 #include "rng.hpp"
@@ -30,7 +31,7 @@
 #include <algorithm>
 
 RoomMap::RoomMap()
-    : ready(false)
+    : ready(false), grid_width(0), grid_height(0)
 { }
 
 void RoomMap::addRoom(const MapCoord &top_left, int w, int h)
@@ -50,55 +51,85 @@ void RoomMap::doneAddingRooms()
     // We randomize the order of the rooms. This means that the room
     // numbers (which are sent out to clients) are unpredictable and
     // do not give away any information.
-    RNG_Wrapper myrng(g_rng);
+    RNG_Wrapper myrng(Mediator::getRNG());
     std::shuffle(rooms.begin(), rooms.end(), myrng);        
-}
 
-void RoomMap::getRoomAtPos(const MapCoord &mc, int &r1, int &r2) const
-{
-    // We just search through the room list until we find
-    // something. This is inefficient -- in future might want to
-    // create an index of some sort, so we can just look up the
-    // MapCoord directly.
+    // Build the index. First find the bounding rectangle of all rooms.
+    grid.clear();
+    grid_width = grid_height = 0;
+    if (rooms.empty()) return;
 
-    r1 = r2 = -1;
-        
+    int min_x = rooms[0].pos.getX(), min_y = rooms[0].pos.getY();
+    int max_x = min_x, max_y = min_y;   // (exclusive)
     for (std::vector<RoomInfo>::const_iterator it = rooms.begin(); it != rooms.end(); ++it) {
-        if (mc.getX() >= it->pos.getX() && mc.getX() < it->pos.getX() + it->w
-        && mc.getY() >= it->pos.getY() && mc.getY() < it->pos.getY() + it->h) {
-            // Found the room.
-            const bool x_corner = mc.getX() == it->pos.getX() || mc.getX() == it->pos.getX() + it->w - 1;
-            const bool y_corner = mc.getY() == it->pos.getY() || mc.getY() == it->pos.getY() + it->h - 1;
-            if (x_corner && y_corner) continue;  // exclude the corners
-            if (r1 == -1) {
-                r1 = (it - rooms.begin());
-            } else {
-                r2 = (it - rooms.begin());
-                return;
+        min_x = std::min(min_x, it->pos.getX());
+        min_y = std::min(min_y, it->pos.getY());
+        max_x = std::max(max_x, it->pos.getX() + it->w);
+        max_y = std::max(max_y, it->pos.getY() + it->h);
+    }
+    grid_origin = MapCoord(min_x, min_y);
+    grid_width = max_x - min_x;
+    grid_height = max_y - min_y;
+
+    GridEntry empty;
+    empty.r1 = empty.r2 = -1;
+    empty.corner = false;
+    grid.assign(grid_width * grid_height, empty);
+
+    // Now fill in each room. If more than two rooms cover a square,
+    // the first two (in room number order) are used.
+    for (int r = 0; r < int(rooms.size()); ++r) {
+        const RoomInfo &ri = rooms[r];
+        for (int j = 0; j < ri.h; ++j) {
+            for (int i = 0; i < ri.w; ++i) {
+                GridEntry &g = grid[(ri.pos.getY() - min_y + j) * grid_width + (ri.pos.getX() - min_x + i)];
+                const bool x_corner = i == 0 || i == ri.w - 1;
+                const bool y_corner = j == 0 || j == ri.h - 1;
+                if (x_corner && y_corner) {
+                    // the corners are not part of the room
+                    g.corner = true;
+                } else if (g.r1 == -1) {
+                    g.r1 = r;
+                } else if (g.r2 == -1) {
+                    g.r2 = r;
+                }
             }
         }
     }
 }
 
-bool RoomMap::isCorner(const MapCoord &mc) const
+const RoomMap::GridEntry * RoomMap::lookup(const MapCoord &mc) const
 {
-    for (std::vector<RoomInfo>::const_iterator it = rooms.begin(); it != rooms.end(); ++it) {
-        if ((mc.getX()==it->pos.getX() || mc.getX() == it->pos.getX() + it->w - 1)
-            && (mc.getY()==it->pos.getY() || mc.getY() == it->pos.getY() + it->h - 1)) {
-            return true;
-        }
+    const int x = mc.getX() - grid_origin.getX();
+    const int y = mc.getY() - grid_origin.getY();
+    if (x < 0 || x >= grid_width || y < 0 || y >= grid_height) return 0;
+    return &grid[y * grid_width + x];
+}
+
+void RoomMap::getRoomAtPos(const MapCoord &mc, int &r1, int &r2) const
+{
+    const GridEntry *g = lookup(mc);
+    if (g) {
+        r1 = g->r1;
+        r2 = g->r2;
+    } else {
+        r1 = r2 = -1;
     }
-    return false;
+}
+
+bool RoomMap::isCorner(const MapCoord &mc) const
+{
+    const GridEntry *g = lookup(mc);
+    return g && g->corner;
 }
 
 bool RoomMap::inSameRoom(const MapCoord &mc1, const MapCoord &mc2) const
 {
-    int r1a, r1b;
-    int r2a, r2b;
-    getRoomAtPos(mc1, r1a, r1b);
-    getRoomAtPos(mc2, r2a, r2b);
-    if (r1a != -1 && (r1a == r2a || r1a == r2b)) return true;
-    if (r1b != -1 && (r1b == r2a || r1b == r2b)) return true;
+    const GridEntry *g1 = lookup(mc1);
+    const GridEntry *g2 = lookup(mc2);
+    if (!g1 || !g2) return false;
+    if (g1->r1 != -1 && (g1->r1 == g2->r1 || g1->r1 == g2->r2)) return true;
+    if (g1->r2 != -1 && (g1->r2 == g2->r1 || g1->r2 == g2->r2)) return true;
     return false;
 }
 
@@ -44,6 +44,9 @@ public:
     void addRoom(const MapCoord &top_left, int w, int h);
     void doneAddingRooms();  // call once all rooms are added.
 
+    // NOTE: The following queries are only valid once doneAddingRooms has been
+    // called. They are all simple lookups (doneAddingRooms builds an index).
+
     // "getRoomAtPos" returns the room(s) associated with a square. If
     // it's a border square, 2 room numbers are returned. If it's an
     // interior square, one room number will be returned, and r2 will
@@ -67,6 +70,19 @@ private:
     };
     std::vector<RoomInfo> rooms;
     bool ready; // set once "doneAddingRooms" has been called.
+
+    // Index of rooms by square, built by doneAddingRooms. This
+    // covers the bounding rectangle of all the rooms, starting at
+    // grid_origin.
+    struct GridEntry {
+        int r1, r2;     // as returned by getRoomAtPos
+        bool corner;    // as returned by isCorner
+    };
+    std::vector<GridEntry> grid;
+    MapCoord grid_origin;
+    int grid_width, grid_height;
+
+    const GridEntry * lookup(const MapCoord &mc) const;
 };
 
 #endif
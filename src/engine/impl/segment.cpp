@@ -127,45 +127,43 @@ void Segment::readSquare(lua_State *lua, int x, int y, int n)
     lua_pop(lua, 1);  // [tiletbl]
 }
 
-void Segment::loadData(std::istream &str, lua_State *lua)
+void Segment::loadData(std::istream &str, lua_State *lua, SegmentSource &src)
 {
-    if (width <= 0 || height <= 0) {
+    if (src.width <= 0 || src.height <= 0) {
         luaL_error(lua, "Error in segment file, 'width' and 'height' must come before 'data'");
     }
 
-    data.resize(width * height);
-    
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int n = -1;
-            str >> n;
-            if (!str || n<0) luaL_error(lua, "Error in segment file, bad 'data'");
-            readSquare(lua, x, y, n);
-        }
+    src.data.resize(src.width * src.height);
+
+    for (int i = 0; i < src.width * src.height; ++i) {
+        int n = -1;
+        str >> n;
+        if (!str || n<0) luaL_error(lua, "Error in segment file, bad 'data'");
+        src.data[i] = n;
     }
 }
 
-void Segment::loadRooms(std::istream &str, lua_State *lua)
+void Segment::loadRooms(std::istream &str, lua_State *lua, SegmentSource &src)
 {
     int num = -1;
     str >> num;
     if (!str || num < 0) luaL_error(lua, "Error while loading segment: 'rooms' invalid");
 
-    rooms.reserve(num);
+    src.rooms.reserve(src.rooms.size() + num);
     
     for (int i = 0; i < num; ++i) {
-        int tlx, tly, w, h;
-        str >> tlx >> tly >> w >> h;
-        --tlx;
-        --tly;
+        SegmentSource::Room r;
+        str >> r.tlx >> r.tly >> r.w >> r.h;
+        --r.tlx;
+        --r.tly;
         if (!str) luaL_error(lua, "Error while loading segment: 'rooms' invalid");
-        addRoom(tlx, tly, w, h);
+        src.rooms.push_back(r);
     }
 }
 
-void Segment::loadSwitches(std::istream &str, lua_State *lua)
+void Segment::loadSwitches(std::istream &str, lua_State *lua, SegmentSource &src)
 {
-    if (data.empty()) {
+    if (src.data.empty()) {
         luaL_error(lua, "Error loading segment: 'data' must come before 'switches'");
     }
     
@@ -180,7 +178,7 @@ void Segment::loadSwitches(std::istream &str, lua_State *lua)
         int x = 0, y = 0, nfuncs = 0;
         str >> x >> y >> nfuncs;
 
-        if (!str || x < 0 || y < 0 || x >= width || y >= height) {
+        if (!str || x < 0 || y < 0 || x >= src.width || y >= src.height) {
             luaL_error(lua, "Error loading segment: invalid switch position");
         }
 
@@ -202,23 +200,32 @@ void Segment::loadSwitches(std::istream &str, lua_State *lua)
             lua_code << ");";
         }
 
-        if (luaL_loadstring(lua, lua_code.str().c_str()) != LUA_OK) {
-            luaL_error(lua, "Error in luaL_loadstring while building switch code");
-        }
+        SegmentSource::Switch sw;
+        sw.x = x;
+        sw.y = y;
+        sw.lua_code = lua_code.str();
+        src.switches.push_back(sw);
+    }
+}    
 
-        // switch code is now on top of stack
-        LuaFunc action(lua);   // pops the code off the stack.
+void Segment::addSwitch(lua_State *lua, int x, int y, const std::string &lua_code)
+{
+    if (luaL_loadstring(lua, lua_code.c_str()) != LUA_OK) {
+        luaL_error(lua, "Error in luaL_loadstring while building switch code");
+    }
 
-        // Create dummy tile for the switch-action
-        boost::shared_ptr<Tile> tile;
-        if (isApproachable(x, y)) {
-            tile.reset(new Tile(LuaFunc(), action));
-        } else {
-            tile.reset(new Tile(action, LuaFunc()));
-        }
-        addTile(x, y, tile);
+    // switch code is now on top of stack
+    LuaFunc action(lua);   // pops the code off the stack.
+
+    // Create dummy tile for the switch-action
+    boost::shared_ptr<Tile> tile;
+    if (isApproachable(x, y)) {
+        tile.reset(new Tile(LuaFunc(), action));
+    } else {
+        tile.reset(new Tile(action, LuaFunc()));
     }
-}    
+    addTile(x, y, tile);
+}
 
 bool Segment::readLine(std::istream &str, lua_State *lua, std::string &key, std::string &value)
 {
@@ -242,10 +249,10 @@ bool Segment::readLine(std::istream &str, lua_State *lua, std::string &key, std:
     return false;
 }
     
-Segment::Segment(std::istream &str, lua_State *lua)
-        : width(0), height(0)
+void Segment::parse(std::istream &str, lua_State *lua, SegmentSource &src)
 {
-    // [tiletbl]
+    src = SegmentSource();
+
     while (1) {
         std::string key, value;
         if (readLine(str, lua, key, value)) {
@@ -253,21 +260,21 @@ Segment::Segment(std::istream &str, lua_State *lua)
         } else {
 
             if (key == "data") {
-                loadData(str, lua);
+                loadData(str, lua, src);
 
             } else if (key == "width") {
-                width = std::atoi(value.c_str());
-                if (width <= 0) luaL_error(lua, "Invalid segment width: %d", width);
+                src.width = std::atoi(value.c_str());
+                if (src.width <= 0) luaL_error(lua, "Invalid segment width: %d", src.width);
 
             } else if (key == "height") {
-                height = std::atoi(value.c_str());
-                if (height <= 0) luaL_error(lua, "Invalid segment height: %d", height);
+                src.height = std::atoi(value.c_str());
+                if (src.height <= 0) luaL_error(lua, "Invalid segment height: %d", src.height);
 
             } else if (key == "rooms") {
-                loadRooms(str, lua);
+                loadRooms(str, lua, src);
 
             } else if (key == "switches") {
-                loadSwitches(str, lua);
+                loadSwitches(str, lua, src);
 
             } else if (key == "name") {
                 // (Ignored)
@@ -279,11 +286,33 @@ Segment::Segment(std::istream &str, lua_State *lua)
         }
     }
 
-    if (width <= 0 || height <= 0 || rooms.empty() || data.empty()) {
+    if (src.width <= 0 || src.height <= 0 || src.rooms.empty()
+    || src.data.size() != size_t(src.width * src.height)) {
         luaL_error(lua, "Invalid segment, not all values have been set");
     }
 }
 
+Segment::Segment(const SegmentSource &src, lua_State *lua)
+        : data(src.width * src.height), width(src.width), height(src.height)
+{
+    // [tiletbl]
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            readSquare(lua, x, y, src.data[y*width + x]);
+        }
+    }
+
+    rooms.reserve(src.rooms.size());
+    for (std::vector<SegmentSource::Room>::const_iterator it = src.rooms.begin(); it != src.rooms.end(); ++it) {
+        addRoom(it->tlx, it->tly, it->w, it->h);
+    }
+
+    // (Switches go last, as they depend on the tiles already present.)
+    for (std::vector<SegmentSource::Switch>::const_iterator it = src.switches.begin(); it != src.switches.end(); ++it) {
+        addSwitch(lua, it->x, it->y, it->lua_code);
+    }
+}
+
 void Segment::addTile(int x, int y, shared_ptr<Tile> t)
 {
     if (!t) return;
@@ -48,6 +48,28 @@ class Tile;
 struct lua_State;
 
 
+// The contents of one segment, as read from a segment file. Squares
+// are given as indices into the "tile table", so this does not refer
+// to any Lua objects, and can be shared between KnightsConfigs (see
+// load_segments.cpp).
+struct SegmentSource {
+    SegmentSource() : width(0), height(0) { }
+
+    struct Room {
+        int tlx, tly, w, h;
+    };
+    struct Switch {
+        int x, y;
+        std::string lua_code;
+    };
+
+    int width, height;
+    std::vector<int> data;    // tile table index for each square
+    std::vector<Room> rooms;
+    std::vector<Switch> switches;
+};
+
+
 struct HomeInfo {
     int x;    // The x,y of the home itself
     int y; 
@@ -61,10 +83,15 @@ public:
     // This creates an empty segment of a given size.
     Segment(int w, int h) : data(w*h), width(w), height(h) { }
 
-    // This loads segment data from a text file.
+    // This reads one segment from a text file (just after the "segment" line).
+    // The lua state is only used for reporting errors.
+    // NOTE: It's assumed this is called inside a lua pcall, so it may raise lua errors.
+    static void parse(std::istream &str, lua_State *lua, SegmentSource &result);
+
+    // This creates a segment from parsed data.
     // The lua state should have a "tile table" on top of stack. (The stack is unchanged on exit.)
     // NOTE: It's assumed this is called inside a lua pcall, so it may raise lua errors.
-    Segment(std::istream &str, lua_State *lua);
+    Segment(const SegmentSource &src, lua_State *lua);
     
     // get width and height
     int getWidth() const { return width; }
@@ -105,10 +132,12 @@ private:
     void readTable(lua_State *lua, int x, int y);
     void readTile(lua_State *lua, int x, int y, bool top_level);
     void readSquare(lua_State *lua, int x, int y, int n);
-    void loadData(std::istream &str, lua_State *lua);
-    void loadRooms(std::istream &str, lua_State *lua);
-    void loadSwitches(std::istream &str, lua_State *lua);
-    bool readLine(std::istream &str, lua_State *lua, std::string &key, std::string &value);
+    void addSwitch(lua_State *lua, int x, int y, const std::string &lua_code);
+
+    static void loadData(std::istream &str, lua_State *lua, SegmentSource &src);
+    static void loadRooms(std::istream &str, lua_State *lua, SegmentSource &src);
+    static void loadSwitches(std::istream &str, lua_State *lua, SegmentSource &src);
+    static bool readLine(std::istream &str, lua_State *lua, std::string &key, std::string &value);
     
 private:
     // (TODO) might be better for segments to store tile data in a
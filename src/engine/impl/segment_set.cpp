@@ -38,7 +38,7 @@ SegmentSet::SegmentSet(const std::vector<const Segment *> &input)
     }
 }
 
-const Segment * SegmentSet::getSegment(int minhomes) const
+const Segment * SegmentSet::getSegment(RNG &rng, int minhomes) const
 {
     int nsets = segments.size();
     if (minhomes >= nsets) return nullptr;
@@ -49,7 +49,7 @@ const Segment * SegmentSet::getSegment(int minhomes) const
 
     if (nsegments == 0) return nullptr;
 
-    int r = g_rng.getInt(0, nsegments);
+    int r = rng.getInt(0, nsegments);
     for (int i=minhomes; i<nsets; ++i) {
         if (r < segments[i].size()) {
             return segments[i][r];
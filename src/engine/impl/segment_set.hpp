@@ -29,6 +29,7 @@
 #ifndef SEGMENT_SET_HPP
 #define SEGMENT_SET_HPP
 
+class RNG;
 class Segment;
 
 #include "boost/noncopyable.hpp"
@@ -42,7 +43,8 @@ public:
 
     // minhomes = Minimum number of *non-special* homes required.
     // (Returns nullptr if the request cannot be satisfied.)
-    const Segment * getSegment(int minhomes) const;
+    // The segment is chosen using the given RNG.
+    const Segment * getSegment(RNG &rng, int minhomes) const;
     
 private:
     std::vector<std::vector<const Segment *> > segments;    // segments[nhomes][segmentno].
@@ -173,15 +173,17 @@ void Chest::openImpl(DungeonMap &dmap, const MapCoord &mc, const Originator &)
 {
     setGraphic(&dmap, mc, open_graphic, shared_ptr<const ColourChange>());
     setItemsAllowed(&dmap, mc, true, false);
-    dmap.addItem(mc, stored_item);
-    stored_item = shared_ptr<Item>();
+    shared_ptr<Item> item = stored_item;
+    placeItem(&dmap, mc, shared_ptr<Item>());
+    dmap.addItem(mc, item);
 }
 
 void Chest::closeImpl(DungeonMap &dmap, const MapCoord &mc, const Originator &)
 {
     setGraphic(&dmap, mc, closed_graphic, shared_ptr<const ColourChange>());
-    stored_item = dmap.getItem(mc);
-    if (stored_item) dmap.rmItem(mc);
+    shared_ptr<Item> item = dmap.getItem(mc);
+    if (item) dmap.rmItem(mc);
+    placeItem(&dmap, mc, item);
     setItemsAllowed(&dmap, mc, false, false);
 }
 
@@ -201,8 +203,9 @@ shared_ptr<Item> Chest::getPlacedItem() const
     return stored_item;
 }
 
-void Chest::placeItem(shared_ptr<Item> i) 
+void Chest::placeItem(DungeonMap *dmap, const MapCoord &mc, shared_ptr<Item> i) 
 {
+    if (dmap) dmap->placedItemChanged(mc, stored_item.get(), i.get());
     stored_item = i;
 }
 
@@ -218,7 +221,7 @@ void Chest::onDestroy(DungeonMap &dmap, const MapCoord &mc, shared_ptr<Creature>
 
 bool Chest::generateTrap(DungeonMap &dmap, const MapCoord &mc)
 {
-    if (g_rng.getBool(trap_chance)) {
+    if (Mediator::getRNG().getBool(trap_chance)) {
         lua_State *lua = Mediator::instance().getLuaState();
         PushMapCoord(lua, mc);
         PushMapDirection(lua, facing);
@@ -339,8 +342,9 @@ shared_ptr<Item> Barrel::getPlacedItem() const
     return stored_item;
 }
 
-void Barrel::placeItem(shared_ptr<Item> i)
+void Barrel::placeItem(DungeonMap *dmap, const MapCoord &mc, shared_ptr<Item> i)
 {
+    if (dmap) dmap->placedItemChanged(mc, stored_item.get(), i.get());
     stored_item = i;
 }
 
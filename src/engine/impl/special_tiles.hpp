@@ -68,7 +68,7 @@ public:
     
     virtual bool canPlaceItem() const;
     virtual shared_ptr<Item> getPlacedItem() const;
-    virtual void placeItem(shared_ptr<Item>);
+    virtual void placeItem(DungeonMap *dmap, const MapCoord &mc, shared_ptr<Item>);
     virtual void onDestroy(DungeonMap &, const MapCoord &, shared_ptr<Creature>, const Originator &);
 
     virtual bool generateTrap(DungeonMap &, const MapCoord &);
@@ -95,7 +95,7 @@ public:
     
     virtual bool canPlaceItem() const;
     virtual shared_ptr<Item> getPlacedItem() const;
-    virtual void placeItem(shared_ptr<Item>);
+    virtual void placeItem(DungeonMap *dmap, const MapCoord &mc, shared_ptr<Item>);
     virtual void onDestroy(DungeonMap &, const MapCoord &, shared_ptr<Creature>, const Originator &);
 
 protected:
@@ -149,8 +149,18 @@ void StuffManager::setStuffContents(DungeonMap &dmap, const MapCoord &mc, const
     loc.dmap = &dmap;
     loc.mc = mc;
 
-    stuff_map.erase(loc); // Just in case a "ghost" stuff bag is there already
+    // Usually the stuff bag has already been put down (by DropItem), in which case the
+    // contents must be added to the tally here.
+    const bool live = isStuffBagAt(dmap, mc);
+
+    std::map<Location, StuffContents>::iterator it = stuff_map.find(loc);
+    if (it != stuff_map.end()) {
+        // Just in case a "ghost" stuff bag is there already
+        if (live) tallyContents(it->second, -1);
+        stuff_map.erase(it);
+    }
     stuff_map.insert(std::make_pair(loc, stuff));
+    if (live) tallyContents(stuff, 1);
 }
 
 const std::vector<shared_ptr<Item> > * StuffManager::getItems(DungeonMap *dmap, const MapCoord &mc) const
@@ -163,8 +173,7 @@ const std::vector<shared_ptr<Item> > * StuffManager::getItems(DungeonMap *dmap,
     if (it == stuff_map.end()) {
         return 0;
     } else {
-        shared_ptr<Item> item_here = dmap->getItem(mc);
-        if (!item_here || &item_here->getType() != &getStuffBagItemType()) return 0;  // No actual stuff bag here
+        if (!isStuffBagAt(*dmap, mc)) return 0;  // No actual stuff bag here
         return &it->second.getItems();
     }
 }
@@ -184,12 +193,20 @@ void StuffManager::doPickUp(const MapCoord &mc, shared_ptr<Knight> actor)
         return;
     }
 
+    // Normally the stuff bag has been removed from the map (and therefore the tally)
+    // already, but just in case it hasn't, we take the contents out of the tally while they
+    // are being given to the knight.
+    const bool live = isStuffBagAt(*loc.dmap, mc);
+    if (live) tallyContents(it->second, -1);
+
     it->second.giveToKnight(*loc.dmap, mc, actor);
 
     if (it->second.isEmpty()) {
         // Get rid of the stuff bag once and for all
         stuff_map.erase(it);
     } else {
+        if (live) tallyContents(it->second, 1);
+
         // Some items still left in the bag (probably the knight didn't have room to carry
         // them all). In this case we place another bag onto the map.
         shared_ptr<Item> new_bag(new Item(getStuffBagItemType()));
@@ -221,8 +238,7 @@ void StuffManager::countItems(std::map<ItemType *, int> &result) const
     stuff_it != stuff_map.end();
     ++stuff_it) {
 
-        shared_ptr<Item> item_here = stuff_it->first.dmap->getItem(stuff_it->first.mc);
-        if (!item_here || &item_here->getType() != &getStuffBagItemType()) continue;  // no actual stuff bag here
+        if (!isStuffBagAt(*stuff_it->first.dmap, stuff_it->first.mc)) continue;  // no actual stuff bag here
         
         for (std::vector<shared_ptr<Item> >::const_iterator item_it = stuff_it->second.getItems().begin();
         item_it != stuff_it->second.getItems().end();
@@ -233,3 +249,48 @@ void StuffManager::countItems(std::map<ItemType *, int> &result) const
         }
     }
 }
+
+void StuffManager::getStuffBagSquares(const DungeonMap &dmap, std::vector<MapCoord> &result) const
+{
+    for (std::map<Location, StuffContents>::const_iterator it = stuff_map.begin(); it != stuff_map.end(); ++it) {
+        if (it->first.dmap == &dmap && isStuffBagAt(dmap, it->first.mc)) {
+            result.push_back(it->first.mc);
+        }
+    }
+}
+
+void StuffManager::onAddItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item)
+{
+    tallyItem(dmap, mc, item, 1);
+}
+
+void StuffManager::onRmItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item)
+{
+    tallyItem(dmap, mc, item, -1);
+}
+
+bool StuffManager::isStuffBagAt(const DungeonMap &dmap, const MapCoord &mc) const
+{
+    shared_ptr<Item> item_here = dmap.getItem(mc);
+    return item_here && &item_here->getType() == stuff_bag_item_type.get();
+}
+
+void StuffManager::tallyContents(const StuffContents &stuff, int sign)
+{
+    for (std::vector<shared_ptr<Item> >::const_iterator it = stuff.getItems().begin();
+    it != stuff.getItems().end(); ++it) {
+        item_tally.change((*it)->getType(), sign, sign * (*it)->getNumber());
+    }
+}
+
+void StuffManager::tallyItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item, int sign)
+{
+    if (&item.getType() != stuff_bag_item_type.get()) return;
+
+    Location loc;
+    loc.dmap = const_cast<DungeonMap*>(&dmap);  // only used as a key
+    loc.mc = mc;
+
+    std::map<Location, StuffContents>::const_iterator it = stuff_map.find(loc);
+    if (it != stuff_map.end()) tallyContents(it->second, sign);
+}
@@ -30,6 +30,7 @@
 #define STUFF_BAG_HPP
 
 #include "item.hpp"
+#include "item_tally.hpp"
 #include "legacy_action.hpp"
 
 #include "boost/shared_ptr.hpp"
@@ -111,7 +112,21 @@ public:
     // doDrop runs the onDrop event for each item type in the stuff bag.
     void doDrop(const MapCoord &, shared_ptr<Knight> actor);
 
-    // This is used for counting how many items of various types exist in stuff bags
+    // Get the positions of all stuff bags (with known contents) in the given map.
+    // (Results are appended to "result".)
+    void getStuffBagSquares(const DungeonMap &dmap, std::vector<MapCoord> &result) const;
+
+    // Running count of the items in all stuff bags that are currently in the map.
+    const ItemTally & getItemTally() const { return item_tally; }
+
+    // These must be called whenever an item is added to or removed from the map, so that
+    // the tally can be kept up to date. (Mediator does this.)
+    void onAddItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item);
+    void onRmItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item);
+
+    // Count how many items of various types exist in stuff bags, by searching all of
+    // them. (Slow -- getItemTally should normally be used instead. This is kept for
+    // checking the tally in debug builds.)
     void countItems(std::map<ItemType *, int> &result) const;    
 
     
@@ -128,9 +143,16 @@ private:
         }
     };
 
+    bool isStuffBagAt(const DungeonMap &dmap, const MapCoord &mc) const;
+    void tallyContents(const StuffContents &stuff, int sign);
+    void tallyItem(const DungeonMap &dmap, const MapCoord &mc, const Item &item, int sign);
+
     // NOTE: stuff_map may contain "stale" entries for squares where the stuff bag no longer exists.
     // These should be treated as bogus, and ignored.
     std::map<Location, StuffContents> stuff_map;
+
+    // Counts the contents of those entries in stuff_map that are not stale.
+    ItemTally item_tally;
     
     std::unique_ptr<ItemType> stuff_bag_item_type;
 };
@@ -66,7 +66,7 @@ void SweepCreatures(DungeonMap &dmap, const MapCoord &mc, bool use_height, MapHe
             MapAccess acc = dmap.getAccess(mc, (*it)->getHeight(), it->get());
             if (acc <= A_APPROACH && cr) {
                 // Deal DOOR_CLOSED_DAMAGE to creatures finding themselves in A_BLOCKED squares.
-                cr->damage(Mediator::instance().cfgInt("door_closed_damage"), originator);
+                cr->damage(Mediator::instance().cfg().door_closed_damage, originator);
             }
         }
     }
@@ -38,9 +38,8 @@ enum TaskPri { TP_LOW, TP_NORMAL };
 
 class Task : public enable_shared_from_this<Task> {
     friend class TaskManager;
-    friend class CompareTime;
 public:
-    Task() : time(-1) { }
+    Task() : time(-1), heap_index(-1) { }
     virtual ~Task() { }
 
     // tasks are removed from the TaskManager before execution. They should be re-added (using
@@ -58,6 +57,7 @@ public:
 private:
     TaskPri pri;
     int time;  // time of next run. (this is always -ve if task not currently scheduled.)
+    int heap_index;  // position in the TaskManager's queue, or -1 if not scheduled.
 };
 
 #endif
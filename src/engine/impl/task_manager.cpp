@@ -26,64 +26,200 @@
 #include "task.hpp"
 #include "task_manager.hpp"
 
+#include <algorithm>
 #include <utility>
 
-TaskManager::QueueType::iterator TaskManager::findTask(boost::shared_ptr<Task> t)
+namespace {
+    const int HEAP_ARITY = 4;
+
+    bool Before(int time1, uint64_t seq1, int time2, uint64_t seq2)
+    {
+        return time1 < time2 || (time1 == time2 && seq1 < seq2);
+    }
+}
+
+TaskTraceRecorder * TaskManager::trace_recorder = 0;
+
+bool TaskManager::queueEmpty(int pri) const
+{
+    return task_queue[pri].empty();
+}
+
+Task & TaskManager::queueFront(int pri) const
+{
+    return *task_queue[pri].front().task;
+}
+
+void TaskManager::queueFrontKey(int pri, int &time, uint64_t &seq) const
+{
+    time = task_queue[pri].front().time;
+    seq = task_queue[pri].front().seq;
+}
+
+bool TaskManager::isScheduled(const Task &t) const
 {
-    std::pair<QueueType::iterator,QueueType::iterator> p = task_queue[t->pri].equal_range(t); // compare with CompareTime
-    for (QueueType::iterator it = p.first; it != p.second; ++it) {
-        if (*it == t) {   // compare by pointer
-            return it;
+    // heap_index is checked against the queue as well, just in case
+    // the task belongs to some other TaskManager.
+    if (t.heap_index < 0) return false;
+    const QueueType &q = task_queue[t.pri];
+    return t.heap_index < int(q.size()) && q[t.heap_index].task.get() == &t;
+}
+
+void TaskManager::place(QueueType &q, int idx, HeapEntry &&entry)
+{
+    entry.task->heap_index = idx;
+    q[idx] = std::move(entry);
+}
+
+void TaskManager::siftUp(QueueType &q, int idx)
+{
+    HeapEntry entry = std::move(q[idx]);
+    while (idx > 0) {
+        const int parent = (idx - 1) / HEAP_ARITY;
+        if (!Before(entry.time, entry.seq, q[parent].time, q[parent].seq)) break;
+        place(q, idx, std::move(q[parent]));
+        idx = parent;
+    }
+    place(q, idx, std::move(entry));
+}
+
+void TaskManager::siftDown(QueueType &q, int idx)
+{
+    const int size = int(q.size());
+    HeapEntry entry = std::move(q[idx]);
+    while (true) {
+        const int first_child = idx * HEAP_ARITY + 1;
+        if (first_child >= size) break;
+
+        int best = first_child;
+        const int last_child = std::min(first_child + HEAP_ARITY, size);
+        for (int c = first_child + 1; c < last_child; ++c) {
+            if (Before(q[c].time, q[c].seq, q[best].time, q[best].seq)) best = c;
         }
+
+        if (!Before(q[best].time, q[best].seq, entry.time, entry.seq)) break;
+        place(q, idx, std::move(q[best]));
+        idx = best;
     }
-    return task_queue[t->pri].end();
+    place(q, idx, std::move(entry));
+}
+
+void TaskManager::insert(boost::shared_ptr<Task> t)
+{
+    insert(std::move(t), next_seq++);
+}
+
+void TaskManager::insert(boost::shared_ptr<Task> t, uint64_t seq)
+{
+    QueueType &q = task_queue[t->pri];
+    HeapEntry entry;
+    entry.time = t->time;
+    entry.seq = seq;
+    entry.task = std::move(t);
+    q.push_back(std::move(entry));
+    siftUp(q, int(q.size()) - 1);
+}
+
+boost::shared_ptr<Task> TaskManager::remove(Task &t)
+{
+    // Precondition: isScheduled(t)
+    QueueType &q = task_queue[t.pri];
+    const int idx = t.heap_index;
+
+    boost::shared_ptr<Task> result = std::move(q[idx].task);
+    t.heap_index = -1;
+
+    const int last = int(q.size()) - 1;
+    if (idx != last) {
+        // Move the last entry into the gap, then restore the heap property
+        place(q, idx, std::move(q[last]));
+        q.pop_back();
+        if (idx > 0 && Before(q[idx].time, q[idx].seq, q[(idx - 1) / HEAP_ARITY].time, q[(idx - 1) / HEAP_ARITY].seq)) {
+            siftUp(q, idx);
+        } else {
+            siftDown(q, idx);
+        }
+    } else {
+        q.pop_back();
+    }
+
+    return result;
 }
 
 void TaskManager::addTask(boost::shared_ptr<Task> t, TaskPri pri, int exec_time)
 {
+    if (trace_recorder) trace_recorder->onAddTask(*this, *t, pri, exec_time);
     if (stopped) return;
 
     ASSERT(t->time == -1); // same task must never be added twice.
     t->pri = pri;
     t->time = exec_time;
-    task_queue[pri].insert(t);
+    insert(t);
+}
+
+uint64_t TaskManager::allocSeq()
+{
+    if (trace_recorder) trace_recorder->onAllocSeq(*this);
+    return next_seq++;
+}
+
+void TaskManager::addTaskWithSeq(boost::shared_ptr<Task> t, TaskPri pri, int exec_time, uint64_t seq)
+{
+    if (trace_recorder) trace_recorder->onAddTaskWithSeq(*this, *t, pri, exec_time, seq);
+    if (stopped) return;
+
+    ASSERT(t->time == -1);
+    t->pri = pri;
+    t->time = exec_time;
+    insert(t, seq);
+}
+
+bool TaskManager::runsBefore(TaskPri pri, int exec_time, uint64_t seq) const
+{
+    if (queueEmpty(pri)) return true;
+    int front_time;
+    uint64_t front_seq;
+    queueFrontKey(pri, front_time, front_seq);
+    return Before(exec_time, seq, front_time, front_seq);
 }
 
 void TaskManager::changeTaskPri(boost::shared_ptr<Task> t, TaskPri new_pri)
 {
+    if (trace_recorder) trace_recorder->onChangeTaskPri(*this, *t, new_pri);
     if (t->pri == new_pri) return;
-    QueueType::iterator it = findTask(t);
-    if (it == task_queue[t->pri].end()) return;
-    task_queue[t->pri].erase(it);
+    if (!isScheduled(*t)) return;
+    remove(*t);
     t->pri = new_pri;
-    task_queue[new_pri].insert(t);
+    insert(t);
 }
 
 void TaskManager::changeExecTime(boost::shared_ptr<Task> t, int new_exec_time)
 {
+    if (trace_recorder) trace_recorder->onChangeExecTime(*this, *t, new_exec_time);
     if (t->time == new_exec_time) return;
-    QueueType::iterator it = findTask(t);
-    if (it == task_queue[t->pri].end()) return;
-    task_queue[t->pri].erase(it);
+    if (!isScheduled(*t)) return;
+    remove(*t);
     t->time = new_exec_time;
-    task_queue[t->pri].insert(t);
+    insert(t);
 }
 
 void TaskManager::rmTask(boost::shared_ptr<Task> t)
 {
     if (!t) return;
-    QueueType::iterator it = findTask(t);
-    if (it != task_queue[t->pri].end()) {
+    if (trace_recorder) trace_recorder->onRmTask(*this, *t);
+    if (isScheduled(*t)) {
+        remove(*t);
         t->time = -1;
-        task_queue[t->pri].erase(it);
     }
 }
 
 void TaskManager::rmAllTasks()
 {
+    if (trace_recorder) trace_recorder->onRmAllTasks(*this);
     for (int i = 0; i < NUM_QUEUES; ++i) {
         for (QueueType::iterator it = task_queue[i].begin(); it != task_queue[i].end(); ++it) {
-            (*it)->time = -1;
+            it->task->time = -1;
+            it->task->heap_index = -1;
         }
         task_queue[i].clear();
     }
@@ -93,6 +229,8 @@ void TaskManager::rmAllTasks()
 
 void TaskManager::advanceToTime(int target_time)
 {
+    if (trace_recorder) trace_recorder->onAdvanceToTime(*this, target_time);
+
     // Time should not go backwards
     if (target_time <= gvt) return;
 
@@ -100,14 +238,16 @@ void TaskManager::advanceToTime(int target_time)
     // In future, could ignore some of the low-pri ones dependent on how much CPU time is
     // available.
     for (int tp = 1; tp>=0; --tp) {
-        while (!task_queue[tp].empty()) {
-            shared_ptr<Task> t = *(task_queue[tp].begin());
+        while (!queueEmpty(tp)) {
+            Task &front = queueFront(tp);
+            if (front.time > target_time) break;
+            if (front.time > gvt) gvt = front.time;
+            shared_ptr<Task> t = remove(front);
             ASSERT(t);
-            if (t->time > target_time) break;
-            if (t->time > gvt) gvt = t->time;
-            task_queue[tp].erase(task_queue[tp].begin());
             t->time = -1;
+            if (trace_recorder) trace_recorder->onExecuteBegin(*this, *t);
             t->execute(*this);
+            if (trace_recorder) trace_recorder->onExecuteEnd(*this);
         }
     }
     
@@ -120,8 +260,8 @@ int TaskManager::getTimeToNextUpdate() const
     int result = 60 * 60 * 1000;  // returns 1 hour if all queues are empty...
     
     for (int tp = 1; tp >= 0; --tp) {
-        if (!task_queue[tp].empty()) {
-            const int time = (*task_queue[tp].begin())->time;
+        if (!queueEmpty(tp)) {
+            const int time = queueFront(tp).time;
             const int delta = std::max(1, time - gvt);  // Put a floor of 1 on the result (negative or 0 time to next update would be weird)
             result = std::min(result, delta);
         }
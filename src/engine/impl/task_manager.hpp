@@ -29,22 +29,37 @@
 #ifndef TASK_MANAGER_HPP
 #define TASK_MANAGER_HPP
 
-#include "task.hpp"   // for CompareTime, TaskPri
+#include "task.hpp"   // for TaskPri
 
 #include "boost/shared_ptr.hpp"
-#include <functional>
-#include <set>
+#include <cstdint>
+#include <vector>
 
-class CompareTime {
+class TaskManager;
+
+// A TaskTraceRecorder is told about every call that changes the
+// queues of any TaskManager, and about each task execution (calls
+// made by a task during execute() come between onExecuteBegin and
+// onExecuteEnd). This is only used by knights_bench, to record
+// traces from real games (see src/bench/task_trace.hpp).
+class TaskTraceRecorder {
 public:
-    bool operator()(const boost::shared_ptr<Task> &lhs, const boost::shared_ptr<Task> &rhs) const {
-        return lhs->time < rhs->time;
-    }
+    virtual ~TaskTraceRecorder() { }
+    virtual void onAddTask(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time) = 0;
+    virtual void onAddTaskWithSeq(const TaskManager &tm, const Task &t, TaskPri pri, int exec_time, uint64_t seq) = 0;
+    virtual void onAllocSeq(const TaskManager &tm) = 0;
+    virtual void onChangeTaskPri(const TaskManager &tm, const Task &t, TaskPri new_pri) = 0;
+    virtual void onChangeExecTime(const TaskManager &tm, const Task &t, int new_exec_time) = 0;
+    virtual void onRmTask(const TaskManager &tm, const Task &t) = 0;
+    virtual void onRmAllTasks(const TaskManager &tm) = 0;
+    virtual void onAdvanceToTime(const TaskManager &tm, int target_time) = 0;
+    virtual void onExecuteBegin(const TaskManager &tm, const Task &t) = 0;
+    virtual void onExecuteEnd(const TaskManager &tm) = 0;
 };
 
 class TaskManager {
 public:
-    TaskManager() : gvt(0), stopped(false) { }
+    TaskManager() : gvt(0), next_seq(0), stopped(false) { }
     
     void addTask(boost::shared_ptr<Task> t, TaskPri pri, int exec_time);
     void changeTaskPri(boost::shared_ptr<Task> t, TaskPri new_pri);
@@ -60,15 +75,54 @@ public:
     
     // For information
     int getGVT() const { return gvt; }
+
+    // Support for tasks that run a batch of "sub-tasks" on behalf of
+    // others (see MonsterScheduler). A sub-task can be given the same
+    // place in the run order that it would have had as a separate task:
+    // allocSeq returns the sequence number that addTask would have used
+    // for a task added now; addTaskWithSeq adds a task with a given
+    // (exec_time, seq) key; and runsBefore returns true if a task with
+    // the given key would run before every task currently queued at
+    // the given priority.
+    uint64_t allocSeq();
+    void addTaskWithSeq(boost::shared_ptr<Task> t, TaskPri pri, int exec_time, uint64_t seq);
+    bool runsBefore(TaskPri pri, int exec_time, uint64_t seq) const;
+
+    // Sets the recorder for all TaskManagers (null for none). This must
+    // not be changed while any game is running.
+    static void setTraceRecorder(TaskTraceRecorder *r) { trace_recorder = r; }
     
 private:
-    int gvt;
-    typedef std::multiset<boost::shared_ptr<Task>, CompareTime > QueueType;
+    // Each queue is a 4-ary min-heap, ordered by (time, seq). Every
+    // Task knows its own position in the heap (Task::heap_index), so
+    // tasks can be found, rescheduled or removed without searching.
+    // seq is the order in which tasks were (re-)inserted, which means
+    // that tasks with equal times run in FIFO order.
+    struct HeapEntry {
+        int time;
+        uint64_t seq;
+        boost::shared_ptr<Task> task;
+    };
+    typedef std::vector<HeapEntry> QueueType;
     enum { NUM_QUEUES = 2 };
     QueueType task_queue[NUM_QUEUES];
 
-    QueueType::iterator findTask(boost::shared_ptr<Task>);
+    bool queueEmpty(int pri) const;
+    Task & queueFront(int pri) const;
+    void queueFrontKey(int pri, int &time, uint64_t &seq) const;
 
+    bool isScheduled(const Task &t) const;
+    void insert(boost::shared_ptr<Task> t);
+    void insert(boost::shared_ptr<Task> t, uint64_t seq);
+    boost::shared_ptr<Task> remove(Task &t);
+    void siftUp(QueueType &q, int idx);
+    void siftDown(QueueType &q, int idx);
+    void place(QueueType &q, int idx, HeapEntry &&entry);
+
+    static TaskTraceRecorder *trace_recorder;
+
+    int gvt;
+    uint64_t next_seq;
     bool stopped; // true if rmAllTasks has been called
 };
 
@@ -84,7 +84,7 @@ bool TeleportToRandomSquare(shared_ptr<Entity> ent)
 
     // 50 random attempts to find an empty square, after which we give up.
     for (int i = 0; i < 50; ++i) {
-        MapCoord mc(g_rng.getInt(1, dmap->getWidth()-1), g_rng.getInt(1, dmap->getHeight()-1));
+        MapCoord mc(Mediator::getRNG().getInt(1, dmap->getWidth()-1), Mediator::getRNG().getInt(1, dmap->getHeight()-1));
         if (TrySquare(ent, *dmap, mc)) return true;
     }
 
@@ -102,7 +102,7 @@ void TeleportToRoom(shared_ptr<Entity> from, shared_ptr<Entity> to)
     rmap->getRoomAtPos(to->getPos(), r1, r2);
     if (r2 != -1) {
         // Two rooms were returned. We just choose one at random.
-        if (g_rng.getBool()) r1 = r2;
+        if (Mediator::getRNG().getBool()) r1 = r2;
         r2 = -1;
     }
 
@@ -113,12 +113,12 @@ void TeleportToRoom(shared_ptr<Entity> from, shared_ptr<Entity> to)
     rmap->getRoomLocation(r1, top_left, width, height);
         
     // We must now find an unoccupied space within the room.
-    MapDirection new_facing = MapDirection(g_rng.getInt(0,4));
+    MapDirection new_facing = MapDirection(Mediator::getRNG().getInt(0,4));
     MapCoord new_mc;
     for (int i=0; i<100; ++i) {
         // (try 100 times to find a suitable square)
-        const int x = g_rng.getInt(0, width);
-        const int y = g_rng.getInt(0, height);
+        const int x = Mediator::getRNG().getInt(0, width);
+        const int y = Mediator::getRNG().getInt(0, height);
         MapCoord mc2 = MapCoord(top_left.getX() + x,
                                 top_left.getY() + y);
         if (dmap->getAccess(mc2, H_WALKING) == A_CLEAR) {
@@ -149,7 +149,7 @@ shared_ptr<Knight> FindNearestOtherKnight(const DungeonMap &dmap, const MapCoord
         // Measure distance by Manhattan distance:
         const int d = abs(kpos.getX() - mypos.getX()) + abs(kpos.getY() - mypos.getY());
 
-        if ((d > 0 && d < dist) || (d == dist && g_rng.getBool())) {
+        if ((d > 0 && d < dist) || (d == dist && Mediator::getRNG().getBool())) {
             // Closer target found
             // (or if equal distance, then choose target randomly)
             dist = d;
@@ -166,7 +166,7 @@ shared_ptr<Knight> FindRandomOtherKnight(shared_ptr<Knight> me)
     
     std::vector<int> search_order(players.size());
     for (int i = 0; i < players.size(); ++i) search_order[i] = i;
-    RNG_Wrapper myrng(g_rng);
+    RNG_Wrapper myrng(Mediator::getRNG());
     std::shuffle(search_order.begin(), search_order.end(), myrng);
 
     shared_ptr<Knight> result;
@@ -234,6 +234,16 @@ void Tile::newIndex(lua_State *lua)
             lua_pushvalue(lua, 3);
             readAccess(lua);
             lua_pop(lua, 1);
+
+            // If a game is running, this tile might be in the dungeon (possibly
+            // on many squares, if it is a shared tile), so the DungeonMap's
+            // access cache needs to be rebuilt.
+            try {
+                DungeonMap *dmap = Mediator::instance().getMap().get();
+                if (dmap) dmap->tileAccessChanged();
+            } catch (MediatorUnavailable&) {
+                // No game running (e.g. the tile is being set up by the module init scripts)
+            }
         }
 
     } else if (k == "connectivity_check") {
@@ -550,8 +560,9 @@ void Tile::setAccess(DungeonMap *dmap, const MapCoord &mc, MapHeight height, Map
     access[height] = acc;
     if (dmap) {
         // We don't need to tell Mediator about access changes, but we do need 
-        // to call SweepCreatures.
+        // to update the DungeonMap's access cache, and call SweepCreatures.
         // (See also: Tile::setAccessNoSweep in the header)
+        dmap->tileAccessChanged(mc);
         SweepCreatures(*dmap, mc, true, height, originator);
     }
 }
@@ -561,6 +572,7 @@ void Tile::setAccess(DungeonMap *dmap, const MapCoord &mc, MapAccess acc, const
     for (int i=0; i<=H_MISSILES; ++i) {
         access[i] = acc;
     }
+    dmap->tileAccessChanged(mc);
     SweepCreatures(*dmap, mc, false, H_MISSILES, originator);
 }
 
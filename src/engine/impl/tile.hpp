@@ -157,14 +157,16 @@ public:
     
 
     // placeItem: This is overridden by chests, barrels to place items
-    // into 'storage' as opposed to directly onto the map.
+    // into 'storage' as opposed to directly onto the map. (If the tile is
+    // in a map, that map should be given, so that its item tally can be
+    // updated.)
     // canPlaceItem: this tile accepts 'placed' items.
     // itemPlacedAlready: we have accepted a 'placed' item; no more should be placed.
     // getPlacedItem: access the placed item directly...
     virtual bool canPlaceItem() const { return false; }
     virtual shared_ptr<Item> getPlacedItem() const { return shared_ptr<Item>(); }
     bool itemPlacedAlready() const { return bool(getPlacedItem()); }
-    virtual void placeItem(shared_ptr<Item>) { }
+    virtual void placeItem(DungeonMap *, const MapCoord &, shared_ptr<Item>) { }
 
     // Override the standard connectivity checks
     // -1 = Cannot pass
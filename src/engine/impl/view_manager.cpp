@@ -201,8 +201,7 @@ void ViewManager::uploadSquare(DungeonView &dview, const DungeonMap &dmap, const
     
     // Tiles
     dview.clearTiles(relx, rely, force);
-    std::vector<shared_ptr<Tile> > tiles;
-    dmap.getTiles(mc, tiles);
+    const std::vector<shared_ptr<Tile> > &tiles = dmap.getTilesAt(mc);
     for (std::vector<shared_ptr<Tile> >::const_iterator t = tiles.begin(); t != tiles.end(); ++t) {
         dview.setTile(relx, rely, (*t)->getDepth(), (*t)->getGraphic(), (*t)->getColourChange(), force);
     }
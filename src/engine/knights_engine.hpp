@@ -42,6 +42,7 @@
 
 #include "boost/shared_ptr.hpp"
 
+#include <cstdint>
 #include <vector>
 
 class DungeonView;
@@ -68,13 +69,24 @@ class KnightsEngine {
 public:
     // Start up a new KnightsEngine. Requires KnightsConfig and menu settings.
     // Note that each KnightsGame should have a unique KnightsConfig.
+    // All random numbers used by the game are drawn from a stream seeded
+    // by rng_seed (see RNG::generateSeed), so the same seed (together with
+    // the same inputs) will reproduce the same game.
     KnightsEngine(boost::shared_ptr<KnightsConfig> config,
                   const std::vector<int> &hse_cols,
                   const std::vector<PlayerID> &player_ids,
+                  uint64_t rng_seed,
                   bool &deathmatch_mode,   // output.
                   std::vector<LocalMsg> &msgs);  // output.
     ~KnightsEngine();
 
+    // Normally the KnightsEngine must be used only from the thread that
+    // created it. If the game is to be moved between threads, call
+    // detachFromThread() at the end of each piece of work, and
+    // attachToThread() (from the new thread) before the next one.
+    void detachFromThread();
+    void attachToThread();
+
     // Run one update step (for a given time).
     // Uses KnightsCallbacks to inform caller of what happened during the update.
     void update(int time_delta, KnightsCallbacks &callbacks);
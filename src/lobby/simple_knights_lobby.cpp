@@ -49,6 +49,7 @@ void SimpleLobbyThread::operator()()
 {
     try {
         std::vector<unsigned char> net_msg;
+        Coercri::ByteChain out_msg;
 
         while (true) {
             net_msg.clear();
@@ -93,9 +94,14 @@ void SimpleLobbyThread::operator()()
 
                 // Send outgoing messages to our remote clients
                 for (auto &conn : lobby.incoming_conns) {
-                    lobby.server->getOutputData(*conn.server_conn, net_msg);
+                    lobby.server->getOutputData(*conn.server_conn, out_msg);
+                    if (!out_msg.empty()) {
+                        conn.remote->send(out_msg);
+                    }
+
+                    lobby.server->getUnreliableOutputData(*conn.server_conn, net_msg);
                     if (!net_msg.empty()) {
-                        conn.remote->send(net_msg);
+                        conn.remote->sendUnreliable(net_msg);
                     }
                 }
 
@@ -104,6 +110,7 @@ void SimpleLobbyThread::operator()()
                 for (auto &conn : new_conns) {
                     SimpleKnightsLobby::IncomingConn in;
                     in.server_conn = &lobby.server->newClientConnection(conn->getAddress(), PlayerID());
+                    if (conn->supportsUnreliable()) lobby.server->enableUnreliableOutput(*in.server_conn);
                     in.remote = conn;
                     lobby.incoming_conns.push_back(in);
                 }
@@ -231,6 +238,15 @@ void SimpleKnightsLobby::readIncomingMessages(KnightsClient &client)
         client.receiveInputData(net_msg);
     }
 
+    // Also any packets from the unreliable channel. (These are
+    // processed after the reliable data, which may have set up the
+    // game that they refer to.)
+    if (outgoing_conn) {
+        while (outgoing_conn->receiveUnreliable(net_msg)) {
+            client.receiveUnreliableInputData(net_msg);
+        }
+    }
+
     // Now check if the outgoing connection (if applicable) has dropped
     if (outgoing_conn) {
         const auto state = outgoing_conn->getState();
@@ -38,19 +38,31 @@ RNG g_rng;
 
 class RNGImpl {
 public:
-    RNGImpl(std::seed_seq &seed);
+    RNGImpl(std::seed_seq &seed, bool thread_safe);
     float getFloat(float a, float b);
     int getInt(int a, int b);
 
 private:
 #ifndef VIRTUAL_SERVER
     boost::mutex mutex;
+    bool thread_safe;
 #endif
     std::mt19937 rng;
 };
 
-RNGImpl::RNGImpl(std::seed_seq &seed)
+RNGImpl::RNGImpl(std::seed_seq &seed, bool ts)
     : rng(seed)
+{
+#ifndef VIRTUAL_SERVER
+    thread_safe = ts;
+#endif
+}
+
+RNG::RNG(bool ts)
+    : thread_safe(ts)
+{}
+
+RNG::~RNG()
 {}
 
 void RNG::initialize()
@@ -70,7 +82,27 @@ void RNG::initialize(const unsigned char *bytes, int num_bytes)
 {
     // Initialize using the provided bytes
     std::seed_seq seq(bytes, bytes + num_bytes);
-    pimpl = std::make_unique<RNGImpl>(seq);
+    pimpl = std::make_unique<RNGImpl>(seq, thread_safe);
+}
+
+void RNG::initialize(uint64_t seed)
+{
+    // Use the bytes of the seed (in little-endian order, so that the
+    // result does not depend on the platform)
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<unsigned char>(seed >> (8*i));
+    }
+    initialize(bytes, sizeof(bytes));
+}
+
+uint64_t RNG::generateSeed()
+{
+    uint64_t seed = 0;
+    for (int i = 0; i < 4; ++i) {
+        seed = (seed << 16) | uint64_t(getInt(0, 0x10000));
+    }
+    return seed;
 }
 
 float RNGImpl::getFloat(float a, float b)
@@ -84,7 +116,8 @@ float RNGImpl::getFloat(float a, float b)
 
     {
 #ifndef VIRTUAL_SERVER
-        boost::unique_lock lock(mutex);
+        boost::unique_lock<boost::mutex> lock(mutex, boost::defer_lock);
+        if (thread_safe) lock.lock();
 #endif
         x = dist(rng);
     }
@@ -109,7 +142,8 @@ int RNGImpl::getInt(int a, int b)
     }
     std::uniform_int_distribution<int> dist(a, b-1);
 #ifndef VIRTUAL_SERVER
-    boost::unique_lock lock(mutex);
+    boost::unique_lock<boost::mutex> lock(mutex, boost::defer_lock);
+    if (thread_safe) lock.lock();
 #endif
     return dist(rng);
 }
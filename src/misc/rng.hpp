@@ -24,16 +24,23 @@
 #ifndef RNG_HPP
 #define RNG_HPP
 
+#include <cstdint>
 #include <memory>
 
 // RNG implementation has been simplified as of July 2025. There is
-// now one "global" (and thread-safe) RNG implementation, instead of
-// one per thread.
+// one "global" (and thread-safe) RNG, g_rng. In addition, each game
+// has its own RNG stream (see Mediator::getRNG), which is seeded from
+// a per-game seed, and is used only by that game's update thread.
 
 class RNGImpl;
 
 class RNG {
 public:
+    // If thread_safe is false then no locking is done, and the RNG
+    // must only be used by one thread at a time.
+    explicit RNG(bool thread_safe = true);
+    ~RNG();
+
     // Initialize using std::random_device
     void initialize();
 
@@ -41,6 +48,13 @@ public:
     // num_bytes must match the size of std::mt19937's state, else this will throw
     void initialize(const unsigned char *bytes, int num_bytes);
 
+    // Initialize from a 64-bit seed (e.g. one previously returned by generateSeed).
+    // The same seed always gives the same sequence of random numbers.
+    void initialize(uint64_t seed);
+
+    // Draw a new 64-bit seed value from this RNG
+    uint64_t generateSeed();
+
     // Generate random numbers
     float getU01() { return getFloat(0, 1); }  // return random float in range [0,1)
     bool getBool(float p = 0.5f) { return getU01() <= p; }  // return true with given probability
@@ -48,7 +62,11 @@ public:
     float getFloat(float a, float b);   // return random float in range [a,b)
 
 private:
+    RNG(const RNG &) = delete;
+    void operator=(const RNG &) = delete;
+
     std::unique_ptr<RNGImpl> pimpl;
+    bool thread_safe;
 };
 
 // for std::shuffle compatibility
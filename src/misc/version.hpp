@@ -24,10 +24,16 @@
 #ifndef VERSION_HPP
 #define VERSION_HPP
 
-#define KNIGHTS_VERSION "028"
-#define KNIGHTS_VERSION_NUM 28
+#define KNIGHTS_VERSION "029"
+#define KNIGHTS_VERSION_NUM 29
 #define COMPATIBLE_VERSION_NUM 28   // Lowest client version that can connect to this server
 
+// Lowest client versions that understand particular server messages.
+// Older clients are sent the equivalent older messages instead.
+#define SET_SQUARES_VERSION_NUM 29  // SERVER_SET_SQUARES
+#define PACKED_MINI_MAP_VERSION_NUM 29  // SERVER_SET_COLOURS_PACKED
+#define UNRELIABLE_CHANNEL_VERSION_NUM 29  // unreliable channel (see protocol.hpp)
+
 #ifdef WIN32
 #define KNIGHTS_PLATFORM "Windows"
 #else
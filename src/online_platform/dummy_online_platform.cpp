@@ -400,6 +400,7 @@ public:
         }
     }
     virtual void send(const std::vector<unsigned char> &data) { underlying->send(data); }
+    virtual void send(const Coercri::ByteChain &data) { underlying->send(data); }
     virtual std::string getAddress() { return user_id.getPlatformUserId(); }
     virtual int getPingTime() { return underlying->getPingTime(); }
 
@@ -97,6 +97,31 @@ enum ClientMessageCode {
 };
 
 // Messages sent by the server
+//
+// NOTE: The server messages form a single ordered stream, and must be
+// sent reliably (on ENet channel 0). Most of the dungeonview messages
+// are deltas against state the client already holds: MOVE_ENTITY and
+// SET_ANIM_DATA refer to entities created by an earlier ADD_ENTITY,
+// and SET_TILE etc. to squares the server has recorded as "seen".
+// Also SWITCH_PLAYER changes the meaning of all following messages.
+// So none of them can be dropped or reordered without first adding
+// periodic full-state "keyframes" to the protocol.
+//
+// The exceptions so far are TIME_REMAINING and MAP_KNIGHT_LOCATION,
+// which carry absolute values. For clients of version
+// UNRELIABLE_CHANNEL_VERSION_NUM or later, if the transport supports
+// it (see KnightsServer::enableUnreliableOutput), these are sent on a
+// second, unreliable sequenced channel (ENet channel 1), so that a
+// lost packet on the reliable channel does not hold them up:
+//  - An unreliable packet contains only SWITCH_PLAYER,
+//    MAP_KNIGHT_LOCATION and TIME_REMAINING messages.
+//  - Each packet starts with display 0 selected, independently of
+//    the reliable stream. (Multi-display connections get an explicit
+//    SWITCH_PLAYER before each display's messages.)
+//  - Each changed knight location is repeated twice, 50 ms apart,
+//    and all of them are re-sent every 3 seconds (with
+//    TIME_REMAINING) even if nothing has changed; so a lost packet
+//    is soon made good.
 enum ServerMessageCode {
 
     SERVER_ERROR = 1,                // followed by key and params (see read_write_loc.hpp)
@@ -171,6 +196,7 @@ enum ServerMessageCode {
     SERVER_ADD_CONTINUOUS_MESSAGE = 114,  // followed by LocalMsg
     SERVER_SET_SPEECH_BUBBLE = 115,  // followed by varint (id), ubyte (show flag)
     SERVER_SET_ITEM_NULL = 116,      // followed by room-coord
+    SERVER_SET_SQUARES = 117,        // complex (see below)
 
     // minimap
     SERVER_SET_MAP_SIZE = 150,       // followed by 2 ubytes (width, height)
@@ -178,6 +204,7 @@ enum ServerMessageCode {
     SERVER_WIPE_MAP = 152,           // no data
     SERVER_MAP_KNIGHT_LOCATION = 153, // followed by ubyte (plyrnum), EITHER 2 ubytes (x,y) OR 1 ubyte (255)
     SERVER_MAP_ITEM_LOCATION = 154,  // followed by 3 ubytes (x, y, flag)
+    SERVER_SET_COLOURS_PACKED = 155, // complex (see below)
 
     // status display
     SERVER_SET_BACKPACK = 200,       // followed by ubyte (slot), 2 varints (gfx ids), 2 ubytes (no_carried, no_max)
@@ -196,6 +223,30 @@ enum ServerMessageCode {
     SERVER_EXTENDED_MESSAGE = 255    // followed by extended code (varint), payload length (ushort) and payload.
 };
 
+// SERVER_SET_SQUARES (sent only to clients of version
+// SET_SQUARES_VERSION_NUM or later) replaces the item, clear-tiles and
+// set-tile messages for a run of complete squares. Many squares in a
+// room have identical contents, so each distinct "stack" (item plus
+// tiles) is sent once, and the squares refer to it by index:
+//   varint (num stacks), then for each stack:
+//     varint (item gfx-id, or 0), ubyte (num tiles),
+//     then for each tile: tile-info, varint (gfx-id), [colour-change]
+//   varint (num squares), then for each square:
+//     room-coord, varint (stack index)
+// The effect on each square, in order, is the same as SET_ITEM (or
+// SET_ITEM_NULL), CLEAR_TILES, and one SET_TILE per tile.
+//
+// SERVER_SET_COLOURS_PACKED (sent only to clients of version
+// PACKED_MINI_MAP_VERSION_NUM or later) replaces SERVER_SET_COLOUR.
+// It sets the mini map colours of rectangular blocks of squares:
+//   varint (num blocks), then for each block:
+//     4 ubytes (x, y, width, height),
+//     then the colours in row-major order, packed four to a byte
+//     (lowest bits first) as 2-bit values (colour - COL_WALL), or
+//     PACKED_COL_UNCHANGED for squares that the block does not change.
+
+constexpr int PACKED_COL_UNCHANGED = 3;
+
 enum ServerExtendedCode {
     SERVER_EXT_SET_QUEST_HINTS = 1,   // num hints, hints as LocalMsgs
     SERVER_EXT_NEXT_ANNOUNCEMENT_IS_ERROR = 2,
@@ -0,0 +1,114 @@
+/*
+ * game_scheduler.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Runs the update loops of many games on a fixed pool of worker
+ * threads.
+ *
+ * By default, each running KnightsGame has its own update thread,
+ * which spends most of its time asleep. For servers hosting a large
+ * number of games, this means a large number of threads. As an
+ * alternative, a GameScheduler can be given to the KnightsServer (see
+ * KnightsServer::setGameScheduler), in which case each game's update
+ * loop becomes a "Job" that is run on one of a small number of shared
+ * worker threads.
+ *
+ * Each time a Job runs, it does a small amount of work (typically one
+ * dungeon update), then returns the time at which it next wants to
+ * run. Waiting jobs are held in a timer wheel (with 1 ms resolution).
+ * A waiting job can be woken early (e.g. because player input has
+ * arrived) by calling wake().
+ *
+ * A given Job is never run on more than one thread at a time.
+ *
+ */
+
+#ifndef GAME_SCHEDULER_HPP
+#define GAME_SCHEDULER_HPP
+
+#include "timer/timer.hpp"  // coercri
+
+#include "boost/shared_ptr.hpp"
+#include <memory>
+
+class GameSchedulerImpl;
+
+class GameScheduler {
+public:
+
+    class Job {
+    public:
+        Job() : state(IDLE), wake_requested(false), due_time(0), wheel_next(nullptr), wheel_prev(nullptr) { }
+        virtual ~Job() { }
+
+        // Do some work. Return true if the job wants to be run again,
+        // in which case next_run_time should be set to the desired
+        // time (as a timer->getMsec() value). Return false if the job
+        // has finished.
+        // This is called from a worker thread, with no scheduler locks held.
+        // It should not throw.
+        virtual bool run(unsigned int &next_run_time) = 0;
+
+    private:
+        Job(const Job &) = delete;
+        void operator=(const Job &) = delete;
+
+        // The following are owned by GameSchedulerImpl (and protected by its mutex).
+        friend class GameScheduler;
+        friend class GameSchedulerImpl;
+        enum State { IDLE, WAITING, READY, RUNNING };
+        State state;
+        bool wake_requested;
+        unsigned int due_time;
+        Job *wheel_next, *wheel_prev;
+        boost::shared_ptr<Job> self;  // keeps the Job alive while it is scheduled
+    };
+
+    // num_threads is the number of worker threads to create (must be >= 1).
+    GameScheduler(boost::shared_ptr<Coercri::Timer> timer, int num_threads);
+
+    // Stops the worker threads. (All jobs should be removed before this is called.)
+    ~GameScheduler();
+
+    int getNumThreads() const;
+
+    // Add a job, which will be run as soon as possible.
+    // The job must not already be scheduled.
+    void add(boost::shared_ptr<Job> job);
+
+    // Run a waiting job as soon as possible. If the job is currently
+    // running, it will be run again immediately after it returns.
+    // Does nothing if the job is not scheduled.
+    void wake(Job &job);
+
+    // Remove a job. If the job is currently running, this waits for
+    // run() to return. Does nothing if the job is not scheduled (e.g.
+    // because it has already finished).
+    // Must not be called from within the job's own run() method.
+    void remove(Job &job);
+
+private:
+    std::unique_ptr<GameSchedulerImpl> pimpl;
+};
+
+#endif
@@ -0,0 +1,379 @@
+/*
+ * game_scheduler.cpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "misc.hpp"
+
+#include "game_scheduler.hpp"
+#include "my_exceptions.hpp"
+
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace {
+    // Number of slots in the timer wheel. Each slot covers one
+    // millisecond. KnightsGame never asks for a delay of more than
+    // 250 ms, so one revolution is normally enough; longer delays
+    // still work, but the job will be skipped over (rather than run)
+    // the first time its slot comes round.
+    const unsigned int WHEEL_SIZE = 256;
+    const unsigned int WHEEL_MASK = WHEEL_SIZE - 1;
+
+    // Returns true if time a is at or before time b (allowing for wrap-around)
+    bool TimeReached(unsigned int a, unsigned int b)
+    {
+        return int(a - b) <= 0;
+    }
+}
+
+class GameSchedulerImpl {
+public:
+    typedef GameScheduler::Job Job;
+
+    boost::shared_ptr<Coercri::Timer> timer;
+    std::vector<boost::shared_ptr<boost::thread> > threads;
+
+    boost::mutex mutex;
+
+    // Idle workers wait on work_cond, except for (at most) one worker
+    // which waits on timer_cond until the next job in the wheel is due.
+    boost::condition_variable work_cond;
+    boost::condition_variable timer_cond;
+    int num_idle;
+    bool timer_waiting;
+    unsigned int timer_wake_time;
+
+    // Signalled whenever a job stops running (for the benefit of remove())
+    boost::condition_variable job_stopped_cond;
+
+    bool shutting_down;
+
+    // Jobs that are due to run
+    std::deque<Job*> ready_queue;
+
+    // The timer wheel. Each slot is a doubly linked list of jobs (linked
+    // through Job::wheel_next and Job::wheel_prev). All slots up to and
+    // including wheel_time have been processed.
+    Job * wheel[WHEEL_SIZE];
+    unsigned int wheel_time;
+    int num_waiting;
+
+    void workerLoop();
+
+    void makeReady(Job *job);
+    void insertIntoWheel(Job *job, unsigned int due_time);
+    void removeFromWheel(Job *job);
+    void advanceWheel(unsigned int time_now);
+    bool findNextDueTime(unsigned int &result) const;
+    boost::shared_ptr<Job> finishJob(Job *job);
+};
+
+void GameSchedulerImpl::makeReady(Job *job)
+{
+    job->state = Job::READY;
+    ready_queue.push_back(job);
+
+    if (num_idle > 0) {
+        work_cond.notify_one();
+    } else if (timer_waiting) {
+        timer_cond.notify_one();
+    }
+}
+
+void GameSchedulerImpl::insertIntoWheel(Job *job, unsigned int due_time)
+{
+    if (TimeReached(due_time, wheel_time)) {
+        // The slot for this time has already gone past
+        makeReady(job);
+        return;
+    }
+
+    job->state = Job::WAITING;
+    job->due_time = due_time;
+
+    Job *& head = wheel[due_time & WHEEL_MASK];
+    job->wheel_prev = nullptr;
+    job->wheel_next = head;
+    if (head) head->wheel_prev = job;
+    head = job;
+    ++num_waiting;
+
+    // Make sure that somebody will wake up in time to run this job.
+    if (timer_waiting) {
+        if (int(due_time - timer_wake_time) < 0) {
+            timer_cond.notify_one();
+        }
+    } else if (num_idle > 0) {
+        work_cond.notify_one();
+    }
+}
+
+void GameSchedulerImpl::removeFromWheel(Job *job)
+{
+    if (job->wheel_prev) {
+        job->wheel_prev->wheel_next = job->wheel_next;
+    } else {
+        wheel[job->due_time & WHEEL_MASK] = job->wheel_next;
+    }
+    if (job->wheel_next) {
+        job->wheel_next->wheel_prev = job->wheel_prev;
+    }
+    job->wheel_next = job->wheel_prev = nullptr;
+    --num_waiting;
+}
+
+void GameSchedulerImpl::advanceWheel(unsigned int time_now)
+{
+    const int elapsed = time_now - wheel_time;
+    if (elapsed <= 0) return;
+
+    const int num_slots = std::min(elapsed, int(WHEEL_SIZE));
+    for (int i = 1; i <= num_slots; ++i) {
+        Job *job = wheel[(wheel_time + i) & WHEEL_MASK];
+        while (job) {
+            Job *next = job->wheel_next;
+            if (TimeReached(job->due_time, time_now)) {
+                removeFromWheel(job);
+                makeReady(job);
+            }
+            job = next;
+        }
+    }
+
+    wheel_time = time_now;
+}
+
+bool GameSchedulerImpl::findNextDueTime(unsigned int &result) const
+{
+    if (num_waiting == 0) return false;
+
+    for (unsigned int i = 1; i <= WHEEL_SIZE; ++i) {
+        const unsigned int t = wheel_time + i;
+        for (const Job *job = wheel[t & WHEEL_MASK]; job; job = job->wheel_next) {
+            if (job->due_time == t) {
+                result = t;
+                return true;
+            }
+        }
+    }
+
+    // All waiting jobs are more than one revolution away. Wake up
+    // after one revolution and look again.
+    result = wheel_time + WHEEL_SIZE;
+    return true;
+}
+
+boost::shared_ptr<GameScheduler::Job> GameSchedulerImpl::finishJob(Job *job)
+{
+    // Returns the job's "self" pointer, so that the caller can release it
+    // after unlocking the mutex (the Job destructor might do a lot of work).
+    job->state = Job::IDLE;
+    job->wake_requested = false;
+    boost::shared_ptr<Job> result;
+    result.swap(job->self);
+    job_stopped_cond.notify_all();
+    return result;
+}
+
+void GameSchedulerImpl::workerLoop()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+
+    while (!shutting_down) {
+
+        advanceWheel(timer->getMsec());
+
+        if (!ready_queue.empty()) {
+            Job *job = ready_queue.front();
+            ready_queue.pop_front();
+            job->state = Job::RUNNING;
+            job->wake_requested = false;
+
+            // If there are more jobs to run, or nobody is watching the
+            // wheel, get another worker to deal with it.
+            if (num_idle > 0 && (!ready_queue.empty() || (!timer_waiting && num_waiting > 0))) {
+                work_cond.notify_one();
+            }
+
+            // Run the job, with the mutex unlocked.
+            unsigned int next_run_time = 0;
+            bool run_again = false;
+            lock.unlock();
+            try {
+                run_again = job->run(next_run_time);
+            } catch (...) {
+                // Jobs are not supposed to throw, but if one does, we
+                // treat it as finished rather than let the exception
+                // terminate the worker thread.
+                run_again = false;
+            }
+            lock.lock();
+
+            if (run_again && job->self) {
+                if (job->wake_requested) {
+                    makeReady(job);
+                } else {
+                    insertIntoWheel(job, next_run_time);
+                }
+            } else {
+                boost::shared_ptr<Job> finished_job = finishJob(job);
+                lock.unlock();
+                finished_job.reset();
+                lock.lock();
+            }
+
+        } else if (!timer_waiting && findNextDueTime(timer_wake_time)) {
+            // Wait until the next job is due (or until somebody
+            // schedules an earlier job).
+            timer_waiting = true;
+            const int wait_time = timer_wake_time - timer->getMsec();
+            if (wait_time > 0) {
+                timer_cond.timed_wait(lock, boost::posix_time::milliseconds(wait_time));
+            }
+            timer_waiting = false;
+
+        } else {
+            // Nothing to do
+            ++num_idle;
+            work_cond.wait(lock);
+            --num_idle;
+        }
+    }
+}
+
+GameScheduler::GameScheduler(boost::shared_ptr<Coercri::Timer> timer, int num_threads)
+    : pimpl(new GameSchedulerImpl)
+{
+    if (num_threads < 1) throw UnexpectedError("GameScheduler: invalid number of threads");
+
+    pimpl->timer = timer;
+    pimpl->num_idle = 0;
+    pimpl->timer_waiting = false;
+    pimpl->timer_wake_time = 0;
+    pimpl->shutting_down = false;
+    std::fill(pimpl->wheel, pimpl->wheel + WHEEL_SIZE, nullptr);
+    pimpl->wheel_time = timer->getMsec();
+    pimpl->num_waiting = 0;
+
+    for (int i = 0; i < num_threads; ++i) {
+        GameSchedulerImpl *impl = pimpl.get();
+        pimpl->threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread([impl]() { impl->workerLoop(); })));
+    }
+}
+
+GameScheduler::~GameScheduler()
+{
+    std::vector<boost::shared_ptr<Job> > jobs;
+
+    {
+        boost::lock_guard<boost::mutex> lock(pimpl->mutex);
+        pimpl->shutting_down = true;
+        pimpl->work_cond.notify_all();
+        pimpl->timer_cond.notify_all();
+    }
+
+    for (auto &thr : pimpl->threads) {
+        thr->join();
+    }
+
+    // Release any jobs that were left behind.
+    for (Job *job : pimpl->ready_queue) {
+        jobs.push_back(pimpl->finishJob(job));
+    }
+    for (unsigned int i = 0; i < WHEEL_SIZE; ++i) {
+        while (Job *job = pimpl->wheel[i]) {
+            pimpl->removeFromWheel(job);
+            jobs.push_back(pimpl->finishJob(job));
+        }
+    }
+}
+
+int GameScheduler::getNumThreads() const
+{
+    return int(pimpl->threads.size());
+}
+
+void GameScheduler::add(boost::shared_ptr<Job> job)
+{
+    boost::lock_guard<boost::mutex> lock(pimpl->mutex);
+    if (job->state != Job::IDLE) throw UnexpectedError("GameScheduler: job added twice");
+    job->self = job;
+    pimpl->makeReady(job.get());
+}
+
+void GameScheduler::wake(Job &job)
+{
+    boost::lock_guard<boost::mutex> lock(pimpl->mutex);
+    switch (job.state) {
+    case Job::WAITING:
+        pimpl->removeFromWheel(&job);
+        pimpl->makeReady(&job);
+        break;
+
+    case Job::RUNNING:
+        job.wake_requested = true;
+        break;
+
+    default:
+        // Either already due to run, or not scheduled at all
+        break;
+    }
+}
+
+void GameScheduler::remove(Job &job)
+{
+    boost::shared_ptr<Job> removed_job;
+
+    boost::unique_lock<boost::mutex> lock(pimpl->mutex);
+    switch (job.state) {
+    case Job::WAITING:
+        pimpl->removeFromWheel(&job);
+        removed_job = pimpl->finishJob(&job);
+        break;
+
+    case Job::READY:
+        pimpl->ready_queue.erase(std::find(pimpl->ready_queue.begin(), pimpl->ready_queue.end(), &job));
+        removed_job = pimpl->finishJob(&job);
+        break;
+
+    case Job::RUNNING:
+        // Clearing "self" tells the worker not to reschedule the job
+        // when it returns. We keep our own reference in the meantime.
+        removed_job.swap(job.self);
+        while (job.state == Job::RUNNING) {
+            pimpl->job_stopped_cond.wait(lock);
+        }
+        break;
+
+    case Job::IDLE:
+        break;
+    }
+
+    lock.unlock();
+    // removed_job is released here (with the mutex unlocked)
+}
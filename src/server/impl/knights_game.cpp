@@ -32,6 +32,7 @@
 #include "menu.hpp"
 #include "my_ctype.hpp"
 #include "my_menu_listeners.hpp"
+#include "output_double_buffer.hpp"
 #include "overlay.hpp"
 #include "protocol.hpp"
 #include "read_write_loc.hpp"
@@ -40,6 +41,7 @@
 #include "server_callbacks.hpp"
 #include "sh_ptr_eq.hpp"
 #include "sound.hpp"
+#include "spsc_queue.hpp"
 #include "user_control.hpp"
 #include "vote_flags.hpp"
 
@@ -48,6 +50,7 @@
 #ifdef VIRTUAL_SERVER
 #include "syscalls.hpp"
 #else
+#include "game_scheduler.hpp"
 #include "boost/thread/condition_variable.hpp"
 #include "boost/thread/locks.hpp"
 #include "boost/thread/thread.hpp"
@@ -55,7 +58,9 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <iomanip>
 #include <map>
 #include <memory>
 #include <set>
@@ -76,12 +81,43 @@ using std::vector;
 namespace {
     class UpdateThread;
 }
+#else
+class KnightsGameImpl;
+
+namespace {
+    class UpdateJob;
+
+    // Handle to the update thread of a running game. Normally this
+    // wraps a boost::thread, but if the game was given a
+    // GameScheduler, the update loop runs as a job on the scheduler's
+    // worker threads instead. The interface mirrors boost::thread, so
+    // that the rest of this file does not need to care which is in
+    // use.
+    class UpdateThreadHandle {
+    public:
+        UpdateThreadHandle() : scheduler(nullptr) { }
+
+        bool joinable() const { return thread.joinable() || job; }
+        void start(KnightsGameImpl &kg);
+        void interrupt();
+        void join();
+
+        // Wake the update thread early (e.g. because a control has arrived).
+        void wakeUp(boost::condition_variable &wake_up_cond_var);
+
+        GameScheduler *scheduler;   // null = use a separate thread
+
+    private:
+        boost::thread thread;
+        boost::shared_ptr<UpdateJob> job;
+    };
+}
 #endif
 
 class GameConnection {
 public:
     GameConnection(const PlayerID &id1, const PlayerID &id2, bool new_obs_flag, int ver,
-                   bool approach_based_ctrls, bool action_bar_ctrls)
+                   bool approach_based_ctrls, bool action_bar_ctrls, bool unreliable)
         : id1(id1), id2(id2),
           is_ready(false), finished_loading(false), ready_to_end(false), voted_to_restart(false),
           obs_flag(new_obs_flag), cancel_obs_mode_after_game(false),
@@ -92,8 +128,12 @@ public:
           ping_time(0),
           speech_request(false), speech_bubble(false),
           approach_based_controls(approach_based_ctrls),
-          action_bar_controls(action_bar_ctrls)
-    { }
+          action_bar_controls(action_bar_ctrls),
+          unreliable_output(unreliable)
+    {
+        held_control[0] = held_control[1] = 0;
+        control_overflowed[0] = control_overflowed[1] = false;
+    }
 
     // These will be Steam IDs (or other platform IDs) in online-platform games,
     // or UTF8 player names otherwise.
@@ -104,7 +144,7 @@ public:
     bool finished_loading;   // true=ready to play, false=still loading
     bool ready_to_end;   // true=clicked mouse on winner/loser screen, false=still waiting.
     bool voted_to_restart;   // true=voted to restart the current game, false=not voted (or cancelled vote)
-    bool obs_flag;   // true=observer, false=player
+    std::atomic<bool> obs_flag;   // true=observer, false=player. Atomic so that sendControl can read it without locking.
     bool cancel_obs_mode_after_game;
     bool requires_catchup;
     int house_colour;  // Must fit in a ubyte. Set to zero for observers (but beware, zero is also a valid house colour for non-observers!).
@@ -114,15 +154,43 @@ public:
     int player_num;     // 0..num_players-1, or -1 if the game is not running.
                         //  Also, observers have -1, unless they are eliminated players,
                         //  in which case they retain their original player_num.
-    int ping_time;
-    
-    std::vector<unsigned char> output_data;    
+    std::atomic<int> ping_time;
+
+    // Data waiting to be sent to the client. Writers of output_data
+    // must lock my_mutex (if the update thread is running). The update
+    // thread moves output_data into published_output at the end of
+    // each update, from where getOutputData can collect it without
+    // having to wait for the mutex. (For observers, output_data refers
+    // to the encoded player cmds that all observers share.)
+    Coercri::ByteChain output_data;
+    OutputDoubleBuffer published_output;
+
+    // As above, but for the unreliable channel (see protocol.hpp).
+    // Only used if unreliable_output is set.
+    Coercri::ByteChain unreliable_output_data;
+    OutputDoubleBuffer published_unreliable_output;
+
+    // Controls received from the network, waiting to be picked up by
+    // the update thread. The main thread pushes, and the update
+    // thread pops, without locking. If the queue is full, controls go
+    // into control_overflow instead (under overflow_mutex), and keep
+    // going there until the update thread has emptied it, so that no
+    // controls are lost and the order is kept.
+    SpscQueue<const UserControl*, 128> control_input[2];
+    std::vector<const UserControl*> control_overflow[2];
+    std::atomic<bool> control_overflowed[2];
+#ifndef VIRTUAL_SERVER
+    boost::mutex overflow_mutex;
+#endif
 
-    std::vector<const UserControl*> control_queue[2];
+    // The most recent control, if it was a continuous one (this is
+    // re-sent to the engine on every update). Update thread only.
+    const UserControl * held_control[2];
 
-    bool speech_request, speech_bubble;
+    std::atomic<bool> speech_request, speech_bubble;
     bool approach_based_controls;
     bool action_bar_controls;
+    bool unreliable_output;
 };
 
 typedef std::vector<boost::shared_ptr<GameConnection> > game_conn_vector;
@@ -152,7 +220,8 @@ public:
     // the update thread will also lock this mutex when it is making changes to the KnightsGameImpl or GameConnection structures.
     boost::mutex my_mutex;
 
-    boost::thread update_thread;
+    UpdateThreadHandle update_thread;
+    boost::shared_ptr<GameScheduler> scheduler;
 #endif
 
     volatile bool update_thread_wants_to_exit;
@@ -169,14 +238,17 @@ public:
     // used during game startup
     volatile bool startup_signal;
     LocalMsg startup_err;
+    uint64_t rng_seed;  // seed for the KnightsEngine's random numbers (logged at game start)
 
     // Condition variable used to wake up the update thread when a control comes in
     // (instead of polling, like it used to do).
-    // Note, this is controlled using the same mutex (my_mutex) as the rest of the data.
+    // Note, this has its own mutex, so that waking the update thread never has to
+    // wait for a dungeon update to finish.
 #ifndef VIRTUAL_SERVER
+    boost::mutex wake_up_mutex;
     boost::condition_variable wake_up_cond_var;
 #endif
-    bool wake_up_flag;
+    std::atomic<bool> wake_up_flag;
 
     // Track previous house colours for reconnecting players (circular buffer)
     std::vector<std::pair<PlayerID, int>> previous_house_colours{HOUSE_COLOUR_CIRCULAR_BUFFER_SIZE};
@@ -270,11 +342,21 @@ namespace {
         }
     }
 
+    // Make output_data available to getOutputData. The mutex should be
+    // LOCKED when calling this (if the update thread is running).
+    void PublishOutput(KnightsGameImpl &kg)
+    {
+        for (game_conn_vector::iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
+            (*it)->published_output.publish((*it)->output_data);
+            (*it)->published_unreliable_output.publish((*it)->unreliable_output_data);
+        }
+    }
+
     void DeactivateReadyFlags(KnightsGameImpl &kg)
     {
         for (game_conn_vector::iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
             (*it)->is_ready = false;
-            (*it)->output_data.push_back(SERVER_DEACTIVATE_READY_FLAGS);
+            (*it)->output_data.ownBytes().push_back(SERVER_DEACTIVATE_READY_FLAGS);
         }
     }
     
@@ -574,7 +656,7 @@ namespace {
         // LOCKED when calling this routine.
 
         for (game_conn_vector::iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-            (*it)->output_data.push_back(SERVER_GOTO_MENU);
+            (*it)->output_data.ownBytes().push_back(SERVER_GOTO_MENU);
             (*it)->observer_num = 0;
             (*it)->player_num = -1;
             if ((*it)->cancel_obs_mode_after_game) (*it)->obs_flag = false;
@@ -590,6 +672,25 @@ namespace {
         }
     }
 
+#ifndef VIRTUAL_SERVER
+    // Attaches a KnightsEngine to the current thread for the lifetime of
+    // this object. The engine may be created or destroyed in the meantime,
+    // so the pointer is re-checked on exit.
+    class EngineThreadBinding {
+    public:
+        explicit EngineThreadBinding(boost::shared_ptr<KnightsEngine> &e) : engine(e)
+        {
+            if (engine) engine->attachToThread();
+        }
+        ~EngineThreadBinding()
+        {
+            if (engine) engine->detachFromThread();
+        }
+    private:
+        boost::shared_ptr<KnightsEngine> &engine;
+    };
+#endif
+
     class UpdateThread {
     public:
         UpdateThread(KnightsGameImpl &kg_, boost::shared_ptr<Coercri::Timer> timer_)
@@ -598,7 +699,11 @@ namespace {
               nplayers(0),
               game_over_sent(false),
               time_to_player_list_update(0),
-              time_to_force_quit(0)
+              time_to_force_quit(0),
+              dungeon_time(0)
+#ifndef VIRTUAL_SERVER
+              , job_stage(JOB_STARTING)
+#endif
         {
             // note: mutex is locked at this point
         }
@@ -607,141 +712,219 @@ namespace {
         {
             try {
 
-                // Initialize the game.
-                // NOTE: Main thread is waiting for us to set kg.startup_signal.
-                // We can do whatever we want to kg (without needing to lock it) before we set that flag.
-                // After the flag is set, need to lock kg before accessing it.
+                if (!initialize()) {
+#ifdef VIRTUAL_SERVER
+                    vs_exit_game_thread();
+#endif
+                    return;
+                }
+
+                // Wait until all players have set the 'finished_loading' flag
+                while (!allPlayersLoaded()) {
+#ifdef VIRTUAL_SERVER
+                    vs_switch_to_main_thread(100);
+#else
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+#endif
+                }
 
-                // Setup house colours and player IDs
-                // Also count how many players on each team.
-                std::vector<int> hse_cols;
-                std::vector<PlayerID> player_ids;
-                std::map<int, int> team_counts;
-                for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-                    if (!(*it)->obs_flag) {
-                        int col = (*it)->house_colour;
+                sendStartupMessages();
+
+                // Go into game loop. NOTE: This will run forever until the main thread interrupts us
+                // (or an exception occurs, or update() returns false).
+                mainGameLoop();
+
+            } catch (...) {
+                handleException();
+            }
+
+            shutDown();
+
+#ifdef VIRTUAL_SERVER
+            // Exit the thread
+            vs_exit_game_thread();
+#endif
+        }
+
+#ifndef VIRTUAL_SERVER
+        // Alternative to operator() for use with a GameScheduler.
+        // Instead of sleeping, this does one step of work (one pass
+        // round the main game loop, once the game is up and running)
+        // and then returns, setting next_run_time to the time it
+        // wants to be called again.
+        // Returns false once the thread has finished (in which case
+        // shutDown() will already have been called, if necessary).
+        bool runStep(unsigned int &next_run_time)
+        {
+            // Successive steps may run on different worker threads, so
+            // the engine is only attached to this thread for the
+            // duration of the step.
+            EngineThreadBinding binding(engine);
+
+            try {
+                switch (job_stage) {
+                case JOB_STARTING:
+                    if (!initialize()) return false;
+                    job_stage = JOB_LOADING;
+                    [[fallthrough]];
+
+                case JOB_LOADING:
+                    if (!allPlayersLoaded()) {
+                        next_run_time = timer->getMsec() + 100;
+                        return true;
+                    }
+                    sendStartupMessages();
+                    dungeon_time = timer->getMsec();
+                    job_stage = JOB_RUNNING;
+                    [[fallthrough]];
+
+                case JOB_RUNNING:
+                    // We have been woken up, so acknowledge the wake_up_flag
+                    // (see sleepUntil).
+                    kg.wake_up_flag = false;
+                    if (runUpdates(timer->getMsec(), next_run_time)) return true;
+                    break;
+                }
+
+            } catch (...) {
+                handleException();
+            }
+
+            shutDown();
+            return false;
+        }
+#endif
+
+        // Initialize the game. Returns false (having set kg.update_thread_wants_to_exit)
+        // if the KnightsEngine could not be created.
+        bool initialize()
+        {
+            // NOTE: Main thread is waiting for us to set kg.startup_signal.
+            // We can do whatever we want to kg (without needing to lock it) before we set that flag.
+            // After the flag is set, need to lock kg before accessing it.
+
+            // Setup house colours and player IDs
+            // Also count how many players on each team.
+            std::vector<int> hse_cols;
+            std::vector<PlayerID> player_ids;
+            for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
+                if (!(*it)->obs_flag) {
+                    int col = (*it)->house_colour;
+                    hse_cols.push_back(col);
+                    ++team_counts[col];
+                    player_ids.push_back((*it)->id1);
+
+                    if (!(*it)->id2.empty()) {
+                        ++col;  // split screen mode: house colours are consecutive (0 and 1)
                         hse_cols.push_back(col);
                         ++team_counts[col];
-                        player_ids.push_back((*it)->id1);
-                        
-                        if (!(*it)->id2.empty()) {
-                            ++col;  // split screen mode: house colours are consecutive (0 and 1)
-                            hse_cols.push_back(col);
-                            ++team_counts[col];
-                            player_ids.push_back((*it)->id2);
-                        }
+                        player_ids.push_back((*it)->id2);
                     }
                 }
+            }
 
-                kg.all_player_ids = player_ids;
+            kg.all_player_ids = player_ids;
 
-                if (player_ids.size() == 2 && kg.connections.size() == 1) {
-                    // Split screen game.
-                    // Reset to hard coded player names in this case (for benefit
-                    // of Lua kts.GetPlayerID function)
-                    for (size_t i = 0; i < player_ids.size(); ++i) {
-                        std::string name = "Player " + std::to_string(i+1);
-                        player_ids[i] = PlayerID(UTF8String::fromUTF8(name));
-                    }
+            if (player_ids.size() == 2 && kg.connections.size() == 1) {
+                // Split screen game.
+                // Reset to hard coded player names in this case (for benefit
+                // of Lua kts.GetPlayerID function)
+                for (size_t i = 0; i < player_ids.size(); ++i) {
+                    std::string name = "Player " + std::to_string(i+1);
+                    player_ids[i] = PlayerID(UTF8String::fromUTF8(name));
                 }
+            }
 
-                nplayers = player_ids.size();
+            nplayers = player_ids.size();
 
-                // Create the KnightsEngine. Pass any messages back to the players
-                std::vector<LocalMsg> messages;
-                try {
-                    engine.reset(new KnightsEngine(kg.knights_config, hse_cols, player_ids,
-                                                   kg.deathmatch_mode,  // output from KnightsEngine
-                                                   messages));   // output from KnightsEngine
+            // Create the KnightsEngine. Pass any messages back to the players
+            try {
+                engine.reset(new KnightsEngine(kg.knights_config, hse_cols, player_ids,
+                                               kg.rng_seed,
+                                               kg.deathmatch_mode,  // output from KnightsEngine
+                                               startup_messages));   // output from KnightsEngine
 
-                } catch (LuaPanic &) {
-                    // This is serious enough that we re-throw and let 
-                    // the game close itself down.
-                    throw;
+            } catch (LuaPanic &) {
+                // This is serious enough that we re-throw and let 
+                // the game close itself down.
+                throw;
 
-                } catch (const ExceptionBase &e) {
+            } catch (const ExceptionBase &e) {
 
-                    SendMessages(kg.connections, messages);
+                SendMessages(kg.connections, startup_messages);
 
-                    kg.startup_err = e.getMsg();
+                kg.startup_err = e.getMsg();
 
-                    kg.update_thread_wants_to_exit = true;
-#ifdef VIRTUAL_SERVER
-                    vs_exit_game_thread();
-#endif
-                    return;
+                kg.update_thread_wants_to_exit = true;
+                return false;
 
-                } catch (const std::exception &e) {
+            } catch (const std::exception &e) {
 
-                    SendMessages(kg.connections, messages);
+                SendMessages(kg.connections, startup_messages);
 
-                    kg.startup_err = {LocalKey("cxx_error_is"), {LocalParam(UTF8String::fromUTF8Safe(e.what()))}};
+                kg.startup_err = {LocalKey("cxx_error_is"), {LocalParam(UTF8String::fromUTF8Safe(e.what()))}};
 
-                    kg.update_thread_wants_to_exit = true;
-#ifdef VIRTUAL_SERVER
-                    vs_exit_game_thread();
-#endif
-                    return;
-                }
+                kg.update_thread_wants_to_exit = true;
+                return false;
+            }
 
-                for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-                    if (!(*it)->obs_flag) {
-                        for (int p = 0; p < ((*it)->id2.empty() ? 1 : 2); ++p) {
-                            engine->setApproachBasedControls((*it)->player_num + p, (*it)->approach_based_controls);
-                            engine->setActionBarControls((*it)->player_num + p, (*it)->action_bar_controls);
-                        }
+            for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
+                if (!(*it)->obs_flag) {
+                    for (int p = 0; p < ((*it)->id2.empty() ? 1 : 2); ++p) {
+                        engine->setApproachBasedControls((*it)->player_num + p, (*it)->approach_based_controls);
+                        engine->setActionBarControls((*it)->player_num + p, (*it)->action_bar_controls);
                     }
                 }
-                
-                callbacks.reset(new ServerCallbacks(hse_cols.size()));
-                
-                // The game has started successfully so signal the main thread to continue
-                kg.startup_signal = true;
-                
-                // Wait until all players have set the 'finished_loading' flag
-                while (1) {
-                    {
+            }
+
+            callbacks.reset(new ServerCallbacks(hse_cols.size()));
+
+            // The game has started successfully so signal the main thread to continue
+            kg.startup_signal = true;
+            return true;
+        }
+
+        // Returns true if all players have set the 'finished_loading' flag
+        bool allPlayersLoaded()
+        {
 #ifndef VIRTUAL_SERVER
-                        boost::lock_guard<boost::mutex> lock(kg.my_mutex);
-#endif
-                        bool all_loaded = true;
-                        for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-                            if (!(*it)->obs_flag && !(*it)->finished_loading) {
-                                all_loaded = false;
-                                break;
-                            }
-                        }
-                        if (all_loaded) break;
-                    }
-#ifdef VIRTUAL_SERVER
-                    vs_switch_to_main_thread(100);
-#else
-                    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+            boost::lock_guard<boost::mutex> lock(kg.my_mutex);
 #endif
+            for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
+                if (!(*it)->obs_flag && !(*it)->finished_loading) {
+                    return false;
                 }
+            }
+            return true;
+        }
 
-                {
+        void sendStartupMessages()
+        {
 #ifndef VIRTUAL_SERVER
-                    boost::lock_guard<boost::mutex> lock(kg.my_mutex);
+            boost::lock_guard<boost::mutex> lock(kg.my_mutex);
 #endif
 
-                    // Send through any initialization msgs from lua.
-                    SendMessages(kg.connections, messages);
+            // Send through any initialization msgs from lua.
+            SendMessages(kg.connections, startup_messages);
+            startup_messages.clear();
 
-                    // Send the team chat notification (but only if more than 1 player on the team; #151)
-                    for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-                        Coercri::OutputByteBuf buf((*it)->output_data);
+            // Send the team chat notification (but only if more than 1 player on the team; #151)
+            for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
+                Coercri::OutputByteBuf buf((*it)->output_data);
 
-                        if (!(*it)->obs_flag && team_counts[(*it)->house_colour] > 1) {
-                            buf.writeUbyte(SERVER_ANNOUNCEMENT_LOC);
-                            WriteLocalMsg(buf, LocalMsg{LocalKey("team_chat_avail")});
-                        }
-                    }
+                if (!(*it)->obs_flag && team_counts[(*it)->house_colour] > 1) {
+                    buf.writeUbyte(SERVER_ANNOUNCEMENT_LOC);
+                    WriteLocalMsg(buf, LocalMsg{LocalKey("team_chat_avail")});
                 }
+            }
+        }
 
-                // Go into game loop. NOTE: This will run forever until the main thread interrupts us
-                // (or an exception occurs, or update() returns false).
-                mainGameLoop();
+        // Deals with an exception thrown from the update thread. Must be called
+        // from within a catch block.
+        void handleException()
+        {
+            try {
+                throw;
 
             } catch (boost::thread_interrupted &) {
                 // Allow this to go through. The code that interrupted us knows what it's doing...
@@ -756,7 +939,11 @@ namespace {
             } catch (...) {
                 sendError(LocalMsg{LocalKey("unknown_error")});
             }
+        }
 
+        // Called when the update thread is about to exit.
+        void shutDown()
+        {
             // Before we go, delete the KnightsEngine. This will make sure that the Mediator
             // is still around while the KnightsEngine destructor runs.
             engine.reset();  // Never throws
@@ -764,11 +951,6 @@ namespace {
             // Tell the main thread that the update thread wants to exit.
             // Note no need to lock mutex because there is only one writer (us) and one reader (the main thread)
             kg.update_thread_wants_to_exit = true;
-
-#ifdef VIRTUAL_SERVER
-            // Exit the thread
-            vs_exit_game_thread();
-#endif
         }
 
         void sendError(const LocalMsg &msg)
@@ -807,53 +989,66 @@ namespace {
             // Our goal will be to keep advancing dungeon_time to try
             // to keep up with wall clock time, by making "update"
             // calls.
-            unsigned int dungeon_time = wall_clock_time;
+            dungeon_time = wall_clock_time;
 
             while (1) {
                 // Invariant: at this point, wall_clock_time equals
                 // the current value of timer->getMsec(), or as close
                 // as possible to it.
 
-                // The dungeon time is always at, or behind, wall
-                // clock time. Calculate exactly how much behind it
-                // is.
-                int update_delta_t = wall_clock_time - dungeon_time;
+                // Bring the dungeon up to date, and find out when the
+                // next update is due.
+                unsigned int next_update_time;
+                if (!runUpdates(wall_clock_time, next_update_time)) return;
 
-                // Simulate the dungeon forward in time until it
-                // catches up with wall_clock_time (if necessary).
-                if (update_delta_t > 0) {
-
-                    // We cap the actual dungeon update to 1000 ms;
-                    // this prevents excessively long updates.
-                    int capped_update_delta_t = update_delta_t > 1000 ? 1000 : update_delta_t;
+                // Sleep until next_update_time, or until something of
+                // interest happens (e.g. a new player input is
+                // received).
+                wall_clock_time = sleepUntil(next_update_time);
+            }
+        }
 
-                    // Do the actual game update. This simulates all
-                    // knights, monsters, etc., for a period of
-                    // "capped_update_delta_t".
-                    const bool should_continue = update(capped_update_delta_t);
+        // Simulates the dungeon forward until dungeon_time catches up
+        // with wall_clock_time, then sets next_update_time to the time
+        // at which the next update should be done.
+        // Returns false if the game is over.
+        bool runUpdates(unsigned int wall_clock_time, unsigned int &next_update_time)
+        {
+            // The dungeon time is always at, or behind, wall
+            // clock time. Calculate exactly how much behind it
+            // is.
+            int update_delta_t = wall_clock_time - dungeon_time;
 
-                    // We always advance dungeon_time by the full
-                    // amount, even if the update was capped.
-                    dungeon_time += update_delta_t;
+            // Simulate the dungeon forward in time until it
+            // catches up with wall_clock_time (if necessary).
+            if (update_delta_t > 0) {
 
-                    // Is the game over? If so, we are done here.
-                    if (!should_continue) return;
+                // We cap the actual dungeon update to 1000 ms;
+                // this prevents excessively long updates.
+                int capped_update_delta_t = update_delta_t > 1000 ? 1000 : update_delta_t;
 
-                }
+                // Do the actual game update. This simulates all
+                // knights, monsters, etc., for a period of
+                // "capped_update_delta_t".
+                const bool should_continue = update(capped_update_delta_t);
 
-                // Note: at this point, dungeon_time should be equal
-                // to wall_clock_time. (It could also be greater, but
-                // only if wall_clock_time ran backwards, which should
-                // never happen.)
+                // We always advance dungeon_time by the full
+                // amount, even if the update was capped.
+                dungeon_time += update_delta_t;
 
-                // Schedule the next update.
-                const unsigned int next_update_time = wall_clock_time + calculateUpdateDelay();
+                // Is the game over? If so, we are done here.
+                if (!should_continue) return false;
 
-                // Sleep until next_update_time, or until something of
-                // interest happens (e.g. a new player input is
-                // received).
-                wall_clock_time = sleepUntil(next_update_time);
             }
+
+            // Note: at this point, dungeon_time should be equal
+            // to wall_clock_time. (It could also be greater, but
+            // only if wall_clock_time ran backwards, which should
+            // never happen.)
+
+            // Schedule the next update.
+            next_update_time = wall_clock_time + calculateUpdateDelay();
+            return true;
         }
 
         int calculateUpdateDelay() const
@@ -891,27 +1086,28 @@ namespace {
                 }
 
                 // Otherwise, sleep for an appropriate period.
-#ifndef VIRTUAL_SERVER
-                boost::unique_lock<boost::mutex> lock(kg.my_mutex);
-#endif
-
-                // The call to timed_wait UNLOCKS the mutex, WAITS for
-                // either the time to expire, or the main loop to
-                // signal us, then LOCKS the mutex again before
-                // returning.
 #ifdef VIRTUAL_SERVER
                 vs_switch_to_main_thread(wait_time);
 #else
-                kg.wake_up_cond_var.timed_wait(lock,
-                    boost::posix_time::milliseconds(wait_time));
+                {
+                    // The call to timed_wait UNLOCKS the mutex, WAITS for
+                    // either the time to expire, or the main loop to
+                    // signal us, then LOCKS the mutex again before
+                    // returning. (The flag is checked first, in case the
+                    // main loop signalled us before we got here.)
+                    boost::unique_lock<boost::mutex> lock(kg.wake_up_mutex);
+                    if (!kg.wake_up_flag) {
+                        kg.wake_up_cond_var.timed_wait(lock,
+                            boost::posix_time::milliseconds(wait_time));
+                    }
+                }
 #endif
 
-                if (kg.wake_up_flag) {
+                if (kg.wake_up_flag.exchange(false)) {
                     // The reason that timed_wait() returned was that
                     // the main loop signalled us. Acknowledge the
                     // signal (by clearing the flag), then return
                     // early.
-                    kg.wake_up_flag = false;
                     return timer->getMsec();
                 }
 
@@ -934,15 +1130,23 @@ namespace {
             boost::lock_guard<boost::mutex> lock(kg.my_mutex);
 #endif
 
-            // Pre-update activities
-            bool pre_update_result = false;
-            if (!preUpdate(pre_update_result)) return pre_update_result;
+            bool result = false;
 
-            // Update the dungeon
-            engine->update(time_delta, *callbacks);
+            // Pre-update activities (if these return false, result
+            // is set to the value that we should return)
+            if (preUpdate(result)) {
 
-            // Post-update activities
-            return postUpdate(time_delta);
+                // Update the dungeon
+                engine->update(time_delta, *callbacks);
+
+                // Post-update activities
+                result = postUpdate(time_delta);
+            }
+
+            // Hand the new output over to the main thread
+            PublishOutput(kg);
+
+            return result;
         }
 
         // Prepare for a dungeon update, e.g. put eliminated players into observer mode,
@@ -1031,7 +1235,7 @@ namespace {
             // Check for players that need to catch up
             for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
                 if ((*it)->requires_catchup && (*it)->finished_loading) {
-                    std::vector<unsigned char> & buf = (*it)->output_data;
+                    std::vector<unsigned char> & buf = (*it)->output_data.ownBytes();
 
                     if ((*it)->obs_flag) {
                         for (int p = 0; p < nplayers; ++p) {
@@ -1087,76 +1291,128 @@ namespace {
         // Returns true if game is still running, or false if it has ended.
         bool postUpdate(int time_delta)
         {
-            // Read control inputs
+            // Read control inputs. (Inputs from observers are read, but ignored.)
             for (game_conn_vector::const_iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
-                if (!(*it)->obs_flag) {
-                    for (int p = 0; p < ((*it)->id2.empty() ? 1 : 2); ++p) {
+                GameConnection &conn = **it;
+                const bool is_player = !conn.obs_flag;
 
-                        const UserControl *final_ctrl = 0;
+                for (int p = 0; p < (conn.id2.empty() ? 1 : 2); ++p) {
 
-                        for (std::vector<const UserControl*>::const_iterator c = (*it)->control_queue[p].begin();
-                        c != (*it)->control_queue[p].end();
-                        ++c) {
-                            final_ctrl = *c;
-                            engine->setControl((*it)->player_num + p, *c);
-                        }
-                        (*it)->control_queue[p].clear();
+                    // Start with the continuous control held from last time (if any)
+                    const UserControl *final_ctrl = conn.held_control[p];
+                    if (final_ctrl && is_player) {
+                        engine->setControl(conn.player_num + p, final_ctrl);
+                    }
 
-                        // if the final control is continuous then re-insert it into the queue for next time.
-                        if (final_ctrl && final_ctrl->isContinuous()) {
-                            (*it)->control_queue[p].push_back(final_ctrl);
+                    const UserControl *ctrl;
+                    while (conn.control_input[p].pop(ctrl)) {
+                        final_ctrl = ctrl;
+                        if (is_player) {
+                            engine->setControl(conn.player_num + p, ctrl);
                         }
+                    }
 
-                        // speech bubble handling.
-                        if ((*it)->speech_request) {
-                            (*it)->speech_request = false;
-                            engine->setSpeechBubble((*it)->player_num, (*it)->speech_bubble);
+                    if (conn.control_overflowed[p]) {
+#ifndef VIRTUAL_SERVER
+                        boost::lock_guard<boost::mutex> lock(conn.overflow_mutex);
+#endif
+                        // While the flag is set, new controls go to the overflow
+                        // list, so anything still in the queue is older than the
+                        // overflow list and must be read first.
+                        while (conn.control_input[p].pop(ctrl)) {
+                            final_ctrl = ctrl;
+                            if (is_player) {
+                                engine->setControl(conn.player_num + p, ctrl);
+                            }
+                        }
+                        for (std::vector<const UserControl*>::const_iterator c = conn.control_overflow[p].begin();
+                        c != conn.control_overflow[p].end();
+                        ++c) {
+                            final_ctrl = *c;
+                            if (is_player) {
+                                engine->setControl(conn.player_num + p, *c);
+                            }
                         }
+                        conn.control_overflow[p].clear();
+                        conn.control_overflowed[p] = false;
                     }
+
+                    // if the final control is continuous then keep hold of it for next time.
+                    conn.held_control[p] = (final_ctrl && final_ctrl->isContinuous() && is_player) ? final_ctrl : 0;
+                }
+
+                // speech bubble handling.
+                if (conn.speech_request.exchange(false) && is_player) {
+                    engine->setSpeechBubble(conn.player_num, conn.speech_bubble);
                 }
             }
 
             // Copy output data back to GameConnection buffers
+            callbacks->advanceTime(time_delta);
             for (game_conn_vector::iterator it = kg.connections.begin(); it != kg.connections.end(); ++it) {
                 if (!(*it)->finished_loading) {
                     // Skip players who haven't finished loading yet
                     continue;
                 }
+                std::vector<unsigned char> * unreliable_buf =
+                    (*it)->unreliable_output ? &(*it)->unreliable_output_data.ownBytes() : nullptr;
                 if ((*it)->obs_flag) {
                     if ((*it)->observer_num > 0) {
                         // Send observer cmds to that player. (We're assuming observation is always allowed at the moment.)
-                        callbacks->appendObserverCmds((*it)->observer_num, (*it)->output_data);
+                        callbacks->appendObserverCmds((*it)->observer_num, (*it)->client_version, (*it)->output_data, unreliable_buf);
                     }
                 } else {
+                    // (Player output has no shared slices, so it can be written directly.)
+                    std::vector<unsigned char> & buf = (*it)->output_data.ownBytes();
                     const bool split_screen = !(*it)->id2.empty();
                     if (split_screen) {
                         // Select player 0 for split screen mode
-                        (*it)->output_data.push_back(SERVER_SWITCH_PLAYER);
-                        (*it)->output_data.push_back(0);
+                        buf.push_back(SERVER_SWITCH_PLAYER);
+                        buf.push_back(0);
+                        if (unreliable_buf) {
+                            // (The unreliable cmds always need the SWITCH_PLAYER; see
+                            // ServerCallbacks::appendObserverCmds.)
+                            unreliable_buf->push_back(SERVER_SWITCH_PLAYER);
+                            unreliable_buf->push_back(0);
+                        }
                     }
 
-                    const int buf_size_before_p0 = (*it)->output_data.size();
-                    callbacks->appendPlayerCmds((*it)->player_num, (*it)->output_data);
+                    const int buf_size_before_p0 = buf.size();
+                    const int unreliable_size_before_p0 = unreliable_buf ? unreliable_buf->size() : 0;
+                    callbacks->appendPlayerCmds((*it)->player_num, (*it)->client_version, buf, unreliable_buf);
 
                     if (split_screen) {
-                        if ((*it)->output_data.size() == buf_size_before_p0) {
+                        if (buf.size() == buf_size_before_p0) {
                             // can remove the SWITCH_PLAYER 0 cmd
-                            (*it)->output_data.pop_back();
-                            (*it)->output_data.pop_back();
+                            buf.pop_back();
+                            buf.pop_back();
+                        }
+                        if (unreliable_buf && unreliable_buf->size() == unreliable_size_before_p0) {
+                            unreliable_buf->pop_back();
+                            unreliable_buf->pop_back();
                         }
 
                         // Select player 1 for split screen mode
-                        (*it)->output_data.push_back(SERVER_SWITCH_PLAYER);
-                        (*it)->output_data.push_back(1);
+                        buf.push_back(SERVER_SWITCH_PLAYER);
+                        buf.push_back(1);
+                        if (unreliable_buf) {
+                            unreliable_buf->push_back(SERVER_SWITCH_PLAYER);
+                            unreliable_buf->push_back(1);
+                        }
 
                         // Send player 1's data
-                        const int buf_size_before_p1 = (*it)->output_data.size();
-                        callbacks->appendPlayerCmds((*it)->player_num + 1, (*it)->output_data);
+                        const int buf_size_before_p1 = buf.size();
+                        const int unreliable_size_before_p1 = unreliable_buf ? unreliable_buf->size() : 0;
+                        callbacks->appendPlayerCmds((*it)->player_num + 1, (*it)->client_version, buf, unreliable_buf);
 
-                        if ((*it)->output_data.size() == buf_size_before_p1) {
+                        if (buf.size() == buf_size_before_p1) {
                             // can remove the SWITCH_PLAYER 1 cmd
-                            (*it)->output_data.pop_back();
-                            (*it)->output_data.pop_back();
+                            buf.pop_back();
+                            buf.pop_back();
+                        }
+                        if (unreliable_buf && unreliable_buf->size() == unreliable_size_before_p1) {
+                            unreliable_buf->pop_back();
+                            unreliable_buf->pop_back();
                         }
                     }
                 }
@@ -1167,7 +1423,14 @@ namespace {
             time_to_player_list_update -= time_delta;
             if (engine->isPlayerListDirty() || time_to_player_list_update <= 0) {
                 doPlayerListUpdate();
-                if (time_to_player_list_update <= 0) time_to_player_list_update = 3000;  // 3 seconds
+                if (time_to_player_list_update <= 0) {
+                    // The periodic player list also re-sends the time
+                    // remaining; re-send the mini map knight locations
+                    // (on the unreliable channel) at the same time (in
+                    // the next update).
+                    callbacks->queueKeyframes();
+                    time_to_player_list_update = 3000;  // 3 seconds
+                }
             }
 
             // Check to see if the game is over
@@ -1314,8 +1577,11 @@ namespace {
                 }
 
                 if (time_remaining > -1) {
-                    buf.writeUbyte(SERVER_TIME_REMAINING);
-                    buf.writeVarInt(time_remaining);
+                    // (This goes on the unreliable channel if possible,
+                    // so that it cannot be held up by a lost packet.)
+                    Coercri::OutputByteBuf time_buf((*it)->unreliable_output ? (*it)->unreliable_output_data : (*it)->output_data);
+                    time_buf.writeUbyte(SERVER_TIME_REMAINING);
+                    time_buf.writeVarInt(time_remaining);
                 }
             }
         }
@@ -1330,8 +1596,94 @@ namespace {
         bool game_over_sent;
         int time_to_player_list_update;
         int time_to_force_quit;
+
+        std::vector<LocalMsg> startup_messages;  // messages from KnightsEngine ctor, sent once everyone has loaded
+        std::map<int, int> team_counts;  // number of players on each team (house colour)
+        unsigned int dungeon_time;  // "simulated time" inside the dungeon
+
+#ifndef VIRTUAL_SERVER
+        enum JobStage { JOB_STARTING, JOB_LOADING, JOB_RUNNING };
+        JobStage job_stage;  // used by runStep
+#endif
     };
 
+#ifndef VIRTUAL_SERVER
+    // Runs an UpdateThread on a GameScheduler.
+    class UpdateJob : public GameScheduler::Job {
+    public:
+        UpdateJob(KnightsGameImpl &kg, boost::shared_ptr<Coercri::Timer> timer)
+            : update_thread(kg, timer), finished(false)
+        { }
+
+        virtual bool run(unsigned int &next_run_time) override
+        {
+            const bool run_again = update_thread.runStep(next_run_time);
+            if (!run_again) finished = true;
+            return run_again;
+        }
+
+        // Called after the job has been removed from the scheduler.
+        // If the job didn't finish by itself (i.e. it was
+        // interrupted) then the UpdateThread needs to be shut down.
+        void stop()
+        {
+            if (!finished) {
+                update_thread.shutDown();
+                finished = true;
+            }
+        }
+
+    private:
+        UpdateThread update_thread;
+        bool finished;
+    };
+
+    void UpdateThreadHandle::start(KnightsGameImpl &kg)
+    {
+        if (scheduler) {
+            job.reset(new UpdateJob(kg, kg.timer));
+            scheduler->add(job);
+        } else {
+            UpdateThread thr(kg, kg.timer);
+            boost::thread new_thread(thr);
+            thread.swap(new_thread);  // start the sub-thread -- game is now running.
+        }
+    }
+
+    void UpdateThreadHandle::interrupt()
+    {
+        if (job) {
+            // Take the job off the scheduler (waiting for the current
+            // update to complete, if necessary) and then shut it down.
+            // This is the equivalent of interrupting the thread while
+            // it is sleeping.
+            scheduler->remove(*job);
+            job->stop();
+        } else {
+            thread.interrupt();
+        }
+    }
+
+    void UpdateThreadHandle::join()
+    {
+        if (job) {
+            interrupt();  // does nothing if the job has already finished
+            job.reset();
+        } else {
+            thread.join();
+        }
+    }
+
+    void UpdateThreadHandle::wakeUp(boost::condition_variable &wake_up_cond_var)
+    {
+        if (job) {
+            scheduler->wake(*job);
+        } else {
+            wake_up_cond_var.notify_one();
+        }
+    }
+#endif
+
     void DoSetReady(KnightsGameImpl &kg, GameConnection &conn, bool ready)
     {
         conn.is_ready = ready;
@@ -1418,15 +1770,14 @@ namespace {
             kg.emergency_err_msg.clear();
             kg.startup_signal = false;
             kg.startup_err = {};
+            kg.rng_seed = g_rng.generateSeed();
 
 #ifdef VIRTUAL_SERVER
             kg.update_thread.reset(new UpdateThread(kg, kg.timer));
             vs_start_game_thread(reinterpret_cast<void*>(&UpdateThread::operator()),
                                  static_cast<void*>(kg.update_thread.get()));
 #else
-            UpdateThread thr(kg, kg.timer);
-            boost::thread new_thread(thr);
-            kg.update_thread.swap(new_thread);  // start the sub-thread -- game is now running.
+            kg.update_thread.start(kg);  // game is now running.
 #endif
 
             // Wait for the sub thread to set the "startup_signal" flag.
@@ -1544,6 +1895,9 @@ namespace {
                         str << it->getDebugString();
                     }
 
+                    str << ", seed=" << std::hex << std::setw(16) << std::setfill('0') << kg.rng_seed
+                        << std::dec << std::setfill(' ');
+
                     LogMenuListener listener(str);
                     kg.knights_config->getCurrentMenuSettings(listener);
                     
@@ -1579,7 +1933,8 @@ KnightsGame::KnightsGame(boost::shared_ptr<KnightsConfig> config,
                          boost::shared_ptr<Coercri::Timer> tmr,
                          bool allow_split_screen,
                          KnightsLog *knights_log,
-                         const std::string &game_name)
+                         const std::string &game_name,
+                         boost::shared_ptr<GameScheduler> scheduler)
     : pimpl(new KnightsGameImpl)
 {
     pimpl->knights_config = config;
@@ -1601,6 +1956,11 @@ KnightsGame::KnightsGame(boost::shared_ptr<KnightsConfig> config,
     pimpl->game_name = game_name;
 
     pimpl->wake_up_flag = false;
+
+#ifndef VIRTUAL_SERVER
+    pimpl->scheduler = scheduler;
+    pimpl->update_thread.scheduler = scheduler.get();
+#endif
 }
 
 KnightsGame::~KnightsGame()
@@ -1665,7 +2025,8 @@ bool KnightsGame::getObsFlag(GameConnection &conn) const
 }
 
 GameConnection & KnightsGame::newClientConnection(const PlayerID &client_id, const PlayerID &client_id_2,
-                                                  int client_version, bool approach_based_controls, bool action_bar_controls)
+                                                  int client_version, bool approach_based_controls, bool action_bar_controls,
+                                                  bool unreliable_output)
 {
 #ifndef VIRTUAL_SERVER
     boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
@@ -1690,7 +2051,8 @@ GameConnection & KnightsGame::newClientConnection(const PlayerID &client_id, con
     // create the GameConnection
     boost::shared_ptr<GameConnection> conn(new GameConnection(client_id, client_id_2,
                                                               false, client_version,
-                                                              approach_based_controls, action_bar_controls));
+                                                              approach_based_controls, action_bar_controls,
+                                                              unreliable_output));
 
     // If game in progress, push to "incoming_connections" and exit early
     if (game_in_progress) {
@@ -2136,12 +2498,21 @@ void KnightsGame::sendControl(GameConnection &conn, int p, unsigned char control
     if (!pimpl->update_thread.joinable()) return; // Game is not running
 #endif
 
-#ifndef VIRTUAL_SERVER
-    boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
-#endif
+    // Note: no locking is needed here (usually), because control_input
+    // is a lock-free queue. (The update thread can put a player into
+    // observer mode at any time, so it checks obs_flag again as well.)
     if (!conn.obs_flag && p >= 0 && p < (conn.id2.empty() ? 1 : 2)) {
         const UserControl * control = control_num == 0 ? 0 : pimpl->controls.at(control_num - 1);
-        conn.control_queue[p].push_back(control);
+
+        // If the queue is full (the client is sending controls much faster
+        // than the game updates), the control goes to the overflow list.
+        if (conn.control_overflowed[p] || !conn.control_input[p].push(control)) {
+#ifndef VIRTUAL_SERVER
+            boost::lock_guard<boost::mutex> lock(conn.overflow_mutex);
+#endif
+            conn.control_overflow[p].push_back(control);
+            conn.control_overflowed[p] = true;
+        }
         pimpl->wake_up_flag = true;
     }
 }
@@ -2154,12 +2525,10 @@ void KnightsGame::requestSpeechBubble(GameConnection &conn, bool show)
     if (!pimpl->update_thread.joinable()) return;  // Game is not running
 #endif
 
-#ifndef VIRTUAL_SERVER
-    boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
-#endif
     if (!conn.obs_flag) {
-        conn.speech_request = true;
+        // speech_bubble must be written before speech_request (see postUpdate).
         conn.speech_bubble = show;
+        conn.speech_request = true;
         pimpl->wake_up_flag = true;
     }
 }
@@ -2179,12 +2548,13 @@ void KnightsGame::endOfMessagePacket()
     // only runs every 'control_poll_interval', currently 50ms.)
 
 #ifndef VIRTUAL_SERVER
-    bool flag;
-    {
-        boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
-        flag = (pimpl->wake_up_flag);
+    if (pimpl->wake_up_flag) {
+        // Briefly lock wake_up_mutex, so that we cannot signal in
+        // between the update thread checking the flag and starting
+        // to wait (see sleepUntil).
+        { boost::lock_guard<boost::mutex> lock(pimpl->wake_up_mutex); }
+        pimpl->update_thread.wakeUp(pimpl->wake_up_cond_var);
     }
-    if (flag) pimpl->wake_up_cond_var.notify_one();
 #endif
 }
 
@@ -2256,15 +2626,30 @@ void KnightsGame::setObsFlag(GameConnection &conn, bool new_obs_flag)
     UpdateNumPlayersAndTeams(*pimpl);
 }
 
-void KnightsGame::getOutputData(GameConnection &conn, std::vector<unsigned char> &data)
+void KnightsGame::getOutputData(GameConnection &conn, Coercri::ByteChain &data)
 {
     bool do_wait;
 
     {
 #ifndef VIRTUAL_SERVER
-        boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
+        // If the update thread is in the middle of an update, don't
+        // wait for it; just return whatever it has already published.
+        // (Anything else will be collected next time.)
+        boost::unique_lock<boost::mutex> lock(pimpl->my_mutex, boost::try_to_lock);
+        if (!lock.owns_lock()) {
+            conn.published_output.take(data);
+            return;
+        }
 #endif
-        std::swap(conn.output_data, data);
+        // Output is only published with the mutex locked, so the
+        // published data is all older than the contents of
+        // output_data, and must be sent first.
+        conn.published_output.take(data);
+        if (data.empty()) {
+            data.swap(conn.output_data);
+        } else {
+            data.append(conn.output_data);
+        }
         conn.output_data.clear();
         do_wait = pimpl->update_thread_wants_to_exit;
     }
@@ -2293,10 +2678,30 @@ void KnightsGame::getOutputData(GameConnection &conn, std::vector<unsigned char>
     }
 }
 
-void KnightsGame::setPingTime(GameConnection &conn, int ping)
+void KnightsGame::getUnreliableOutputData(GameConnection &conn, std::vector<unsigned char> &data)
 {
+    Coercri::ByteChain chain;
+    {
 #ifndef VIRTUAL_SERVER
-    boost::lock_guard<boost::mutex> lock(pimpl->my_mutex);
+        // As in getOutputData, don't wait for the update thread.
+        boost::unique_lock<boost::mutex> lock(pimpl->my_mutex, boost::try_to_lock);
+        const bool locked = lock.owns_lock();
+#else
+        const bool locked = true;
 #endif
+        conn.published_unreliable_output.take(chain);
+        if (locked) {
+            chain.append(conn.unreliable_output_data);
+            conn.unreliable_output_data.clear();
+        }
+    }
+
+    data.clear();
+    chain.moveTo(data);
+}
+
+void KnightsGame::setPingTime(GameConnection &conn, int ping)
+{
+    // No lock needed, as ping_time is atomic.
     conn.ping_time = ping;
 }
@@ -26,13 +26,15 @@
  * can have multiple KnightsGames.)
  *
  * This class is responsible for creating/destroying the sub-thread
- * used to run the game. 
+ * used to run the game. (If a GameScheduler is given, the game is
+ * run on the scheduler's worker threads instead.)
  * 
  */
 
 #ifndef KNIGHTS_GAME_HPP
 #define KNIGHTS_GAME_HPP
 
+class GameScheduler;
 class KnightsConfig;
 class KnightsGameImpl;
 class GameConnection;
@@ -59,7 +61,8 @@ public:
                          boost::shared_ptr<Coercri::Timer> timer,
                          bool allow_split_screen,
                          KnightsLog *knights_log,
-                         const std::string &game_name);
+                         const std::string &game_name,
+                         boost::shared_ptr<GameScheduler> scheduler);
     ~KnightsGame();
 
     // get information
@@ -72,8 +75,10 @@ public:
     // add players/observers.
     // will throw an exception if the same player is added twice.
     // (if client_id_2 is non-empty will create a split-screen 2-player connection, if allowed.)
+    // (if unreliable_output is set, some msgs are sent via getUnreliableOutputData instead; see protocol.hpp.)
     GameConnection & newClientConnection(const PlayerID &client_id, const PlayerID &client_id_2,
-                                         int client_version, bool approach_based_controls, bool action_bar_controls);
+                                         int client_version, bool approach_based_controls, bool action_bar_controls,
+                                         bool unreliable_output);
 
     // Remove a player/observer from the game.
     // The GameConnection is invalid after this call.
@@ -102,8 +107,14 @@ public:
     void endOfMessagePacket();
     
     // Get any outgoing msgs that need to be sent to the client.
-    // Any existing contents of "data" are replaced.
-    void getOutputData(GameConnection &conn, std::vector<unsigned char> &data);
+    // They are appended to "data". (If "data" is empty, the buffers
+    // are just swapped, so no copying is needed. Shared slices are
+    // passed on by reference.)
+    void getOutputData(GameConnection &conn, Coercri::ByteChain &data);
+
+    // Get the msgs for the unreliable channel (if enabled for this
+    // connection). Any existing contents of "data" are replaced.
+    void getUnreliableOutputData(GameConnection &conn, std::vector<unsigned char> &data);
 
     void setPingTime(GameConnection &conn, int ping);
 
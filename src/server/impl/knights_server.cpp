@@ -46,11 +46,12 @@ public:
         : platform_user_id(platform_user_id), game_conn(nullptr), client_version(0),
           version_string_received(false), connection_accepted(false),
           ip_addr(ip), error_sent(false),
-          approach_based_controls(true), action_bar_controls(false)
+          approach_based_controls(true), action_bar_controls(false),
+          unreliable_output(false)
     { }
     
     // output buffer
-    std::vector<unsigned char> output_data;
+    Coercri::ByteChain output_data;
 
     // player id
     PlayerID player_id;
@@ -75,6 +76,9 @@ public:
     // what type of controls they are using
     bool approach_based_controls;
     bool action_bar_controls;
+
+    // can we send them data on the unreliable channel?
+    bool unreliable_output;
 };
 
 typedef std::vector<boost::shared_ptr<ServerConnection> > connection_vector;
@@ -84,6 +88,10 @@ class KnightsServerImpl {
 public:
     boost::shared_ptr<Coercri::Timer> timer;
     bool allow_split_screen;
+
+    // NOTE: scheduler must be declared before games, so that the games are
+    // destroyed first.
+    boost::shared_ptr<GameScheduler> scheduler;
     
     game_map games;
     connection_vector connections;
@@ -98,15 +106,8 @@ namespace {
     void ReadDataFromKnightsGame(ServerConnection &conn)
     {
         if (conn.game) {
-            if (conn.output_data.empty()) {
-                // no existing data so can just overwrite
-                conn.game->getOutputData(*conn.game_conn, conn.output_data);
-            } else {
-                // append it to the existing data
-                std::vector<unsigned char> buf;
-                conn.game->getOutputData(*conn.game_conn, buf);
-                conn.output_data.insert(conn.output_data.end(), buf.begin(), buf.end());
-            }
+            // (This appends to any existing data.)
+            conn.game->getOutputData(*conn.game_conn, conn.output_data);
         }
     }
 
@@ -203,7 +204,7 @@ namespace {
         conn.game_name = "";
 
         // tell him that he has been booted out of the game
-        conn.output_data.push_back(SERVER_LEAVE_GAME);
+        conn.output_data.ownBytes().push_back(SERVER_LEAVE_GAME);
 
         // send SERVER_UPDATE_PLAYER messages to all connections
         for (connection_vector::iterator it = connections.begin(); it != connections.end(); ++it) {
@@ -397,7 +398,9 @@ void KnightsServer::receiveInputData(ServerConnection &conn,
                         conn.game_conn = &it->second->newClientConnection(client_id_1, client_id_2,
                                                                           conn.client_version,
                                                                           conn.approach_based_controls,
-                                                                          conn.action_bar_controls);
+                                                                          conn.action_bar_controls,
+                                                                          conn.unreliable_output
+                                                                          && conn.client_version >= UNRELIABLE_CHANNEL_VERSION_NUM);
                         conn.game = it->second;
                         conn.game_name = game_name;
 
@@ -632,9 +635,33 @@ void KnightsServer::getOutputData(ServerConnection &conn,
                                   std::vector<ubyte> &data)
 {
     ReadDataFromKnightsGame(conn);
-        
+
+    data.clear();
+    conn.output_data.moveTo(data);
+}
+
+void KnightsServer::getOutputData(ServerConnection &conn,
+                                  Coercri::ByteChain &data)
+{
+    ReadDataFromKnightsGame(conn);
+
+    data.clear();
     data.swap(conn.output_data);
-    conn.output_data.clear();
+}
+
+void KnightsServer::enableUnreliableOutput(ServerConnection &conn)
+{
+    conn.unreliable_output = true;
+}
+
+void KnightsServer::getUnreliableOutputData(ServerConnection &conn,
+                                            std::vector<ubyte> &data)
+{
+    if (conn.game && conn.unreliable_output) {
+        conn.game->getUnreliableOutputData(*conn.game_conn, data);
+    } else {
+        data.clear();
+    }
 }
 
 void KnightsServer::connectionClosed(ServerConnection &conn)
@@ -700,7 +727,8 @@ void KnightsServer::startNewGame(boost::shared_ptr<KnightsConfig> config,
         boost::shared_ptr<KnightsGame> game(new KnightsGame(config, pimpl->timer,
                                                             pimpl->allow_split_screen,
                                                             pimpl->knights_log,
-                                                            game_name));
+                                                            game_name,
+                                                            pimpl->scheduler));
         pimpl->games.insert(std::make_pair(game_name, game));
 
         // Notify players about the new game.
@@ -760,3 +788,8 @@ void KnightsServer::setKnightsLog(KnightsLog *klog)
 {
     pimpl->knights_log = klog;
 }
+
+void KnightsServer::setGameScheduler(boost::shared_ptr<GameScheduler> scheduler)
+{
+    pimpl->scheduler = scheduler;
+}
@@ -0,0 +1,107 @@
+/*
+ * output_double_buffer.hpp
+ *
+ * This file is part of Knights.
+ *
+ * Copyright (C) Stephen Thompson, 2006 - 2026.
+ * Copyright (C) Kalle Marjola, 1994.
+ *
+ * Knights is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Knights is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Knights.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Hands blocks of output bytes from one thread to another, without
+ * either thread having to wait for the other.
+ *
+ * The producer calls publish() to move the contents of a ByteChain
+ * into the buffer; the consumer calls take() to collect everything
+ * that has been published so far (in order). Only one thread may be
+ * publishing at a time, and only one thread may be taking at a time.
+ *
+ * Internally, published data is held in a ByteChain that is passed
+ * between the threads with an atomic exchange. The consumer hands its
+ * (emptied) chain back afterwards, so that in the steady state no
+ * memory allocation is needed.
+ *
+ */
+
+#ifndef OUTPUT_DOUBLE_BUFFER_HPP
+#define OUTPUT_DOUBLE_BUFFER_HPP
+
+#include "network/byte_buf.hpp"  // coercri
+
+#include <atomic>
+
+class OutputDoubleBuffer {
+public:
+    OutputDoubleBuffer() : back(new Coercri::ByteChain), front(nullptr), spare(nullptr) { }
+
+    ~OutputDoubleBuffer()
+    {
+        delete back;
+        delete front.load();
+        delete spare.load();
+    }
+
+    // Append "data" to the published output, and clear "data". (Producer only.)
+    void publish(Coercri::ByteChain &data)
+    {
+        if (data.empty()) return;
+
+        Coercri::ByteChain *prev = front.exchange(nullptr, std::memory_order_acquire);
+        if (prev) {
+            // The consumer has not collected the previous block yet;
+            // add the new data onto the end of it.
+            prev->append(data);
+            data.clear();
+            front.store(prev, std::memory_order_release);
+        } else {
+            back->swap(data);
+            data.clear();
+            front.store(back, std::memory_order_release);
+
+            // Get a new back buffer: normally the one the consumer
+            // most recently handed back.
+            back = spare.exchange(nullptr, std::memory_order_acquire);
+            if (!back) back = new Coercri::ByteChain;
+        }
+    }
+
+    // Append any published output to "out". (Consumer only.)
+    void take(Coercri::ByteChain &out)
+    {
+        Coercri::ByteChain *p = front.exchange(nullptr, std::memory_order_acquire);
+        if (!p) return;
+
+        if (out.empty()) {
+            out.swap(*p);
+        } else {
+            out.append(*p);
+        }
+        p->clear();
+
+        delete spare.exchange(p, std::memory_order_acq_rel);
+    }
+
+private:
+    OutputDoubleBuffer(const OutputDoubleBuffer &) = delete;
+    void operator=(const OutputDoubleBuffer &) = delete;
+
+    Coercri::ByteChain *back;                 // owned by the producer
+    std::atomic<Coercri::ByteChain *> front;  // published data (or null)
+    std::atomic<Coercri::ByteChain *> spare;  // returned by the consumer (or null)
+};
+
+#endif
@@ -33,6 +33,8 @@
 #include "sound.hpp"
 #include "user_control.hpp"
 
+#include "boost/make_shared.hpp"
+
 #include <iterator>
 #include <limits>
 
@@ -63,33 +65,65 @@ ServerCallbacks::~ServerCallbacks()
 {
 }
 
-void ServerCallbacks::appendPlayerCmds(int plyr, std::vector<ubyte> &out) const
+void ServerCallbacks::appendPlayerCmds(int plyr, int client_version, std::vector<ubyte> &out, std::vector<ubyte> *unreliable_out) const
 {
-    doAppendPlayerCmds(plyr, out, 0, true);
+    doAppendPlayerCmds(plyr, client_version, out, unreliable_out, 0, true);
 }
 
-void ServerCallbacks::doAppendPlayerCmds(int plyr, std::vector<ubyte> &out, int observer_num, bool include_private) const
+void ServerCallbacks::doAppendPlayerCmds(int plyr, int client_version, std::vector<ubyte> &out, std::vector<ubyte> *unreliable_out,
+                                         int observer_num, bool include_private) const
 {
     std::copy(pub[plyr].begin(), pub[plyr].end(), std::back_inserter(out));
     if (include_private) std::copy(prv[plyr].begin(), prv[plyr].end(), std::back_inserter(out));
-    mini_map[plyr]->appendMiniMapCmds(out);
-    dungeon_view[plyr]->appendDungeonViewCmds(observer_num*1000+plyr, out);  // note 'transformed' observer_num
+    mini_map[plyr]->appendMiniMapCmds(client_version, !unreliable_out, out);
+    if (unreliable_out) mini_map[plyr]->appendKnightLocationCmds(*unreliable_out);
+    dungeon_view[plyr]->appendDungeonViewCmds(observer_num*1000+plyr, client_version, out);  // note 'transformed' observer_num
 }
 
-void ServerCallbacks::appendObserverCmds(int observer_num, std::vector<ubyte> &out) const
+void ServerCallbacks::appendObserverCmds(int observer_num, int client_version, Coercri::ByteChain &out, std::vector<ubyte> *unreliable_out)
 {
     int num_to_observe = pub.size();
 
+    const std::pair<int, bool> key(client_version, !unreliable_out);
+    std::map<std::pair<int, bool>, std::vector<Coercri::ByteChain::Slice> >::iterator obs_it = obs_cmds.find(key);
+    if (obs_it == obs_cmds.end()) {
+        obs_it = obs_cmds.insert(std::make_pair(key, std::vector<Coercri::ByteChain::Slice>(num_to_observe))).first;
+        for (int i = 0; i < num_to_observe; ++i) {
+            obs_scratch.assign(pub[i].begin(), pub[i].end());
+            mini_map[i]->appendMiniMapCmds(client_version, !unreliable_out, obs_scratch);
+            if (!obs_scratch.empty()) {
+                // (A new vector is made each time, because the previous one
+                // may still be referenced from output that has not been sent yet.)
+                obs_it->second[i] = boost::make_shared<const std::vector<ubyte> >(obs_scratch);
+            }
+        }
+    }
+    const std::vector<Coercri::ByteChain::Slice> &obs_cmds_for_version = obs_it->second;
+
     for (int i = 0; i < num_to_observe; ++i) {
-        out.push_back(SERVER_SWITCH_PLAYER);
-        out.push_back(ubyte(i));
+        out.ownBytes().push_back(SERVER_SWITCH_PLAYER);
+        out.ownBytes().push_back(ubyte(i));
         const size_t prev_size = out.size();
-        doAppendPlayerCmds(i, out, observer_num, false);
+        out.append(obs_cmds_for_version[i]);
+        dungeon_view[i]->appendDungeonViewCmds(observer_num*1000+i, client_version, out);  // note 'transformed' observer_num
         if (out.size() == prev_size) {
             // remove the SWITCH_PLAYER cmd, it isn't needed if there
             // was no output for that player
-            out.pop_back();
-            out.pop_back();
+            out.ownBytes().pop_back();
+            out.ownBytes().pop_back();
+        }
+
+        if (unreliable_out) {
+            // (An unreliable packet may hold several updates' cmds,
+            // so the SWITCH_PLAYER is needed even for display 0.)
+            unreliable_out->push_back(SERVER_SWITCH_PLAYER);
+            unreliable_out->push_back(ubyte(i));
+            const size_t prev_unreliable_size = unreliable_out->size();
+            mini_map[i]->appendKnightLocationCmds(*unreliable_out);
+            if (unreliable_out->size() == prev_unreliable_size) {
+                unreliable_out->pop_back();
+                unreliable_out->pop_back();
+            }
         }
     }
 }
@@ -102,6 +136,21 @@ void ServerCallbacks::clearCmds()
         mini_map[i]->clearMiniMapCmds();
         dungeon_view[i]->clearDungeonViewCmds();
     }
+    obs_cmds.clear();
+}
+
+void ServerCallbacks::queueKeyframes()
+{
+    for (int i = 0; i < int(mini_map.size()); ++i) {
+        mini_map[i]->queueKnightLocations();
+    }
+}
+
+void ServerCallbacks::advanceTime(int time_delta)
+{
+    for (int i = 0; i < int(mini_map.size()); ++i) {
+        mini_map[i]->advanceTime(time_delta);
+    }
 }
 
 int ServerCallbacks::allocObserverNum()
@@ -32,8 +32,13 @@
 
 #include "knights_callbacks.hpp"
 
+#include "network/byte_buf.hpp"  // coercri
+
 #include "boost/shared_ptr.hpp"
 
+#include <map>
+#include <vector>
+
 class ServerDungeonView;
 class ServerMiniMap;
 class ServerStatusDisplay;
@@ -46,8 +51,11 @@ public:
     virtual ~ServerCallbacks();
 
     // methods to append queued cmds to the given vector.
-    void appendPlayerCmds(int plyr, std::vector<ubyte> &cmds) const;
-    void appendObserverCmds(int observer_num, std::vector<ubyte> &cmds) const;
+    // (client_version is the version of the receiving client; some messages are encoded differently for older clients.)
+    // If unreliable_cmds is non-null, the cmds that may be lost (see protocol.hpp) are appended there
+    // instead. (For observers, these are prefixed by SWITCH_PLAYER.)
+    void appendPlayerCmds(int plyr, int client_version, std::vector<ubyte> &cmds, std::vector<ubyte> *unreliable_cmds) const;
+    void appendObserverCmds(int observer_num, int client_version, Coercri::ByteChain &cmds, std::vector<ubyte> *unreliable_cmds);
 
     // observer num management
     int allocObserverNum();
@@ -64,6 +72,15 @@ public:
     // clear queued cmds.
     void clearCmds();
 
+    // re-send the state that is normally only sent when it changes
+    // (currently the mini map knight locations) on the unreliable
+    // channel, so that the client is corrected if it missed an update.
+    void queueKeyframes();
+
+    // count down the timers for repeating cmds on the unreliable
+    // channel (see ServerMiniMap::advanceTime). call once per update.
+    void advanceTime(int time_delta);
+
     
     // functions overridden from KnightsCallbacks
     virtual DungeonView & getDungeonView(int plyr) override;
@@ -90,7 +107,8 @@ public:
     virtual void prepareForCatchUp(int player_num) override;
 
 private:
-    void doAppendPlayerCmds(int plyr, std::vector<ubyte> &out, int observer_num, bool include_private) const;
+    void doAppendPlayerCmds(int plyr, int client_version, std::vector<ubyte> &out, std::vector<ubyte> *unreliable_out,
+                            int observer_num, bool include_private) const;
 
 private:
     std::vector<boost::shared_ptr<ServerDungeonView> > dungeon_view;
@@ -100,6 +118,15 @@ private:
     // output buffers
     std::vector<std::vector<ubyte> > pub, prv;
 
+    // the pub and mini map cmds for each player, as sent to observers.
+    // These are the same for every observer with a given client version,
+    // so they are only encoded once per version per update (by the first
+    // appendObserverCmds call after clearCmds), and shared between the
+    // observers' output buffers.
+    // key = (client version, knight locations included), value = cmds for each player.
+    std::map<std::pair<int, bool>, std::vector<Coercri::ByteChain::Slice> > obs_cmds;
+    std::vector<ubyte> obs_scratch;
+
     // caching
     std::vector<const UserControl*> prev_menu_highlight;
 
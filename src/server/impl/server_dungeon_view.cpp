@@ -31,8 +31,12 @@
 #include "read_write_loc.hpp"
 #include "read_write_player_id.hpp"
 #include "server_dungeon_view.hpp"
+#include "version.hpp"
+
+#include "boost/make_shared.hpp"
 
 #include <limits>
+#include <map>
 
 namespace {
     void WriteRoomCoord(Coercri::OutputByteBuf &buf, int x, int y)
@@ -60,12 +64,119 @@ namespace {
         else if (x > 32767) return 32767;
         else return x;
     }
+
+    // Builds up a SERVER_SET_SQUARES message (see protocol.hpp).
+    class SquaresMsg {
+    public:
+        explicit SquaresMsg(std::vector<unsigned char> &out_) : out(out_), num_squares(0) { }
+
+        // Add a square with the given item, followed by its tiles
+        void beginSquare(int x, int y, const Graphic *item)
+        {
+            // Room coords are nibbles, so there can be at most 15*15
+            // different squares; but a square might appear more than
+            // once, so flush if the message gets that big.
+            if (num_squares == 225) flush();
+            Coercri::OutputByteBuf sbuf(stack);
+            sbuf.writeVarInt(item ? item->getID() : 0);
+            num_tiles_pos = stack.size();
+            sbuf.writeUbyte(0);  // num tiles, backpatched by endSquare
+            square_x = x;
+            square_y = y;
+            num_tiles = 0;
+        }
+
+        void addTile(int depth, const Graphic *gfx, const boost::shared_ptr<const ColourChange> &cc)
+        {
+            Coercri::OutputByteBuf sbuf(stack);
+            WriteTileInfo(sbuf, depth, bool(cc));
+            sbuf.writeVarInt(gfx ? gfx->getID() : 0);
+            if (cc) cc->serialize(sbuf);
+            ++num_tiles;
+        }
+
+        void endSquare()
+        {
+            stack[num_tiles_pos] = ubyte(num_tiles);
+
+            std::map<std::vector<ubyte>, int>::iterator it = stack_index.find(stack);
+            if (it == stack_index.end()) {
+                const int index = int(stack_index.size());
+                stack_bytes.insert(stack_bytes.end(), stack.begin(), stack.end());
+                it = stack_index.insert(std::make_pair(stack, index)).first;
+            }
+            stack.clear();
+
+            Coercri::OutputByteBuf sqbuf(square_bytes);
+            WriteRoomCoord(sqbuf, square_x, square_y);
+            sqbuf.writeVarInt(it->second);
+            ++num_squares;
+        }
+
+        // Write out the squares added so far (if any)
+        void flush()
+        {
+            if (num_squares == 0) return;
+            Coercri::OutputByteBuf buf(out);
+            buf.writeUbyte(SERVER_SET_SQUARES);
+            buf.writeVarInt(int(stack_index.size()));
+            out.insert(out.end(), stack_bytes.begin(), stack_bytes.end());
+            buf.writeVarInt(num_squares);
+            out.insert(out.end(), square_bytes.begin(), square_bytes.end());
+            stack_index.clear();
+            stack_bytes.clear();
+            square_bytes.clear();
+            num_squares = 0;
+        }
+
+    private:
+        typedef unsigned char ubyte;
+
+        std::vector<ubyte> &out;
+
+        std::map<std::vector<ubyte>, int> stack_index;  // distinct stacks in this message
+        std::vector<ubyte> stack_bytes;   // encoded stacks, in index order
+        std::vector<ubyte> square_bytes;  // encoded (room-coord, stack index) pairs
+        int num_squares;
+
+        std::vector<ubyte> stack;  // the square currently being built
+        size_t num_tiles_pos;
+        int square_x, square_y, num_tiles;
+    };
 }
 
 
-void ServerDungeonView::appendDungeonViewCmds(int observer_num, std::vector<ubyte> &vec)
+void ServerDungeonView::appendDungeonViewCmds(int observer_num, int client_version, std::vector<ubyte> &vec)
 {
-    Coercri::OutputByteBuf buf(vec);
+    const EncodedCmds *enc = getEncodedCmds(observer_num, client_version);
+    if (enc) {
+        const std::vector<ubyte> &bytes = enc->shared ? *enc->shared : enc->bytes;
+        vec.insert(vec.end(), bytes.begin(), bytes.end());
+    }
+}
+
+void ServerDungeonView::appendDungeonViewCmds(int observer_num, int client_version, Coercri::ByteChain &chain)
+{
+    EncodedCmds *enc = getEncodedCmds(observer_num, client_version);
+    if (!enc) return;
+
+    if (!enc->shared && enc->bytes.size() < Coercri::ByteChain::MIN_SHARED_SLICE) {
+        // Too small to be worth sharing
+        chain.ownBytes().insert(chain.ownBytes().end(), enc->bytes.begin(), enc->bytes.end());
+    } else {
+        // Move the bytes into a shared slice (the first time round), so
+        // that the chain, and any other observers, can refer to them.
+        if (!enc->shared) enc->shared = boost::make_shared<const std::vector<ubyte> >(std::move(enc->bytes));
+        chain.append(enc->shared);
+    }
+}
+
+ServerDungeonView::EncodedCmds * ServerDungeonView::getEncodedCmds(int observer_num, int client_version)
+{
+    // If there are no commands then there is nothing to send, and
+    // nothing to update in the cache. (The RoomData can be created
+    // later, when it is needed.)
+    if (cmds.empty()) return nullptr;
 
     // First find the RoomData corresponding to the current room (for this observer_num)
     std::map<std::pair<int,int>, RoomData>::iterator room_data_it = cached_rooms.find(std::make_pair(observer_num, current_room));
@@ -78,36 +189,110 @@ void ServerDungeonView::appendDungeonViewCmds(int observer_num, std::vector<ubyt
     }
     RoomData & room_data = room_data_it->second;
 
-    // Now run through the commands.
-    for (std::vector<Cmd>::const_iterator cmd_it = cmds.begin(); cmd_it != cmds.end(); ++cmd_it) {
+    const bool compact = client_version >= SET_SQUARES_VERSION_NUM;
+
+    // The output depends only on the cmds, the square_seen state and
+    // whether the client understands SERVER_SET_SQUARES. Usually,
+    // everyone watching this player has the same square_seen state,
+    // so see if the cmds have already been encoded for that state.
+    for (std::vector<EncodedCmds>::iterator it = encoded_cmds.begin(); it != encoded_cmds.end(); ++it) {
+        if (it->compact == compact && it->seen_before == room_data.square_seen) {
+            room_data.square_seen = it->seen_after;
+            return &*it;
+        }
+    }
+
+    // Otherwise, encode them now (and keep the result for the next observer).
+    encoded_cmds.push_back(EncodedCmds());
+    EncodedCmds &enc = encoded_cmds.back();
+    enc.compact = compact;
+    enc.seen_before = room_data.square_seen;
+    encodeCmds(room_data, compact, enc.bytes);
+    enc.seen_after = room_data.square_seen;
+    return &enc;
+}
+
+std::vector<ServerDungeonView::Cmd>::const_iterator
+ServerDungeonView::findSquareUpload(std::vector<Cmd>::const_iterator start, bool unseen) const
+{
+    // Look for SET_ITEM, CLEAR_TILES, then any number of SET_TILEs, all
+    // on the same square and all needing to be sent. (This is what
+    // ViewManager::uploadSquare produces.)
+    std::vector<Cmd>::const_iterator it = start;
+    if (it->type != Cmd::SET_ITEM || !(unseen || it->force)) return start;
+    ++it;
+    if (it == cmds.end() || it->type != Cmd::CLEAR_TILES || it->x != start->x || it->y != start->y
+        || !(unseen || it->force)) {
+        return start;
+    }
+    ++it;
+    int num_tiles = 0;
+    while (it != cmds.end() && it->type == Cmd::SET_TILE && it->x == start->x && it->y == start->y
+           && (unseen || it->force) && num_tiles < 255) {
+        ++it;
+        ++num_tiles;
+    }
+    return it;
+}
+
+void ServerDungeonView::encodeCmds(RoomData &room_data, bool compact, std::vector<ubyte> &vec) const
+{
+    Coercri::OutputByteBuf buf(vec);
+
+    // Complete squares are collected here (in compact mode), and
+    // written out before the next individual command.
+    SquaresMsg squares_msg(vec);
+
+    // Run through the commands.
+    std::vector<Cmd>::const_iterator cmd_it = cmds.begin();
+    while (cmd_it != cmds.end()) {
 
         const int idx = cmd_it->y * current_room_width + cmd_it->x;
         const SquareState seen = room_data.square_seen[idx];
-        const bool must_send = cmd_it->force || (seen == UNSEEN);
-
-        if (must_send) {
-            switch (cmd_it->type) {
-            case Cmd::SET_TILE:
-                buf.writeUbyte(SERVER_SET_TILE);
-                WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
-                WriteTileInfo(buf, cmd_it->depth, bool(cmd_it->cc));
-                buf.writeVarInt(cmd_it->gfx ? cmd_it->gfx->getID() : 0);
-                if (cmd_it->cc) cmd_it->cc->serialize(buf);
-                break;
-            case Cmd::CLEAR_TILES:
-                buf.writeUbyte(SERVER_CLEAR_TILES);
-                WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
-                break;
-            case Cmd::SET_ITEM:
-                if (cmd_it->gfx) {
-                    buf.writeUbyte(SERVER_SET_ITEM);
+
+        // "last" is the last command handled by this iteration.
+        std::vector<Cmd>::const_iterator last = cmd_it;
+
+        const std::vector<Cmd>::const_iterator square_end =
+            compact ? findSquareUpload(cmd_it, seen == UNSEEN) : cmd_it;
+
+        if (square_end != cmd_it) {
+            squares_msg.beginSquare(cmd_it->x, cmd_it->y, cmd_it->gfx);
+            for (std::vector<Cmd>::const_iterator it = cmd_it + 2; it != square_end; ++it) {
+                squares_msg.addTile(it->depth, it->gfx, it->cc);
+            }
+            squares_msg.endSquare();
+            last = square_end - 1;
+
+        } else {
+            squares_msg.flush();
+
+            const bool must_send = cmd_it->force || (seen == UNSEEN);
+
+            if (must_send) {
+                switch (cmd_it->type) {
+                case Cmd::SET_TILE:
+                    buf.writeUbyte(SERVER_SET_TILE);
                     WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
-                    buf.writeVarInt(cmd_it->gfx->getID());
-                } else {
-                    buf.writeUbyte(SERVER_SET_ITEM_NULL);
+                    WriteTileInfo(buf, cmd_it->depth, bool(cmd_it->cc));
+                    buf.writeVarInt(cmd_it->gfx ? cmd_it->gfx->getID() : 0);
+                    if (cmd_it->cc) cmd_it->cc->serialize(buf);
+                    break;
+                case Cmd::CLEAR_TILES:
+                    buf.writeUbyte(SERVER_CLEAR_TILES);
                     WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
+                    break;
+                case Cmd::SET_ITEM:
+                    if (cmd_it->gfx) {
+                        buf.writeUbyte(SERVER_SET_ITEM);
+                        WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
+                        buf.writeVarInt(cmd_it->gfx->getID());
+                    } else {
+                        buf.writeUbyte(SERVER_SET_ITEM_NULL);
+                        WriteRoomCoord(buf, cmd_it->x, cmd_it->y);
+                    }
+                    break;
                 }
-                break;
             }
         }
 
@@ -115,18 +300,23 @@ void ServerDungeonView::appendDungeonViewCmds(int observer_num, std::vector<ubyt
             // Mark the square as seen, so that future (unforced) updates are not re-sent unnecessarily.
             // Note: we want all commands in a "batch" to be sent BEFORE marking the square seen.
             // So look ahead at the next cmd and if it's on this square too, then hold off on setting 'seen'.
-            std::vector<Cmd>::const_iterator look_ahead = cmd_it;
+            std::vector<Cmd>::const_iterator look_ahead = last;
             ++look_ahead;
-            if (look_ahead == cmds.end() || look_ahead->x != cmd_it->x || look_ahead->y != cmd_it->y) {
+            if (look_ahead == cmds.end() || look_ahead->x != last->x || look_ahead->y != last->y) {
                 room_data.square_seen[idx] = SEEN;
             }
         }
+
+        cmd_it = last + 1;
     }
+
+    squares_msg.flush();
 }
 
 void ServerDungeonView::clearDungeonViewCmds()
 {
     cmds.clear();
+    encoded_cmds.clear();
 }
 
 void ServerDungeonView::rmObserverNum(int observer_num)
@@ -171,6 +361,7 @@ void ServerDungeonView::setCurrentRoom(int r, int width, int height)
 
     // Now we can safely drop any existing cmds.
     cmds.clear();
+    encoded_cmds.clear();
     
     // Update the current_room variables
     current_room = r;
@@ -270,6 +461,7 @@ void ServerDungeonView::clearTiles(int x, int y, bool force)
     t.y = y;
     t.force = force;
     cmds.push_back(t);
+    encoded_cmds.clear();
 }
 
 void ServerDungeonView::setTile(int x, int y, int depth, const Graphic *gfx, boost::shared_ptr<const ColourChange> cc, bool force)
@@ -283,6 +475,7 @@ void ServerDungeonView::setTile(int x, int y, int depth, const Graphic *gfx, boo
     t.cc = cc;
     t.force = force;
     cmds.push_back(t);
+    encoded_cmds.clear();
 }
 
 void ServerDungeonView::setItem(int x, int y, const Graphic *gfx, bool force)
@@ -294,6 +487,7 @@ void ServerDungeonView::setItem(int x, int y, const Graphic *gfx, bool force)
     i.gfx = gfx;
     i.force = force;
     cmds.push_back(i);
+    encoded_cmds.clear();
 }
 
 void ServerDungeonView::placeIcon(int x, int y, const Graphic *gfx, int dur)
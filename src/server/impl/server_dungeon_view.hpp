@@ -26,6 +26,8 @@
 
 #include "dungeon_view.hpp"
 
+#include "network/byte_buf.hpp"  // coercri
+
 #include <list>
 #include <map>
 #include <vector>
@@ -37,7 +39,11 @@ public:
     explicit ServerDungeonView(std::vector<ubyte> &out_) : out(out_), current_room(-1),
                                                            current_room_width(0), current_room_height(0) { }
 
-    void appendDungeonViewCmds(int observer_num, std::vector<ubyte> &vec);
+    // Appends the queued tile/item cmds, encoded for the given client version.
+    // (The ByteChain version shares the encoded bytes between all
+    // observers that get the same encoding, instead of copying them.)
+    void appendDungeonViewCmds(int observer_num, int client_version, std::vector<ubyte> &vec);
+    void appendDungeonViewCmds(int observer_num, int client_version, Coercri::ByteChain &chain);
     void clearDungeonViewCmds();
     void rmObserverNum(int observer_num);  // clear caches
 
@@ -101,6 +107,31 @@ private:
     };
 
     std::vector<Cmd> cmds;
+
+    // Appends the encoding of "cmds" to vec, and updates room_data.square_seen.
+    // If "compact" is set, complete squares are sent using SERVER_SET_SQUARES.
+    void encodeCmds(RoomData &room_data, bool compact, std::vector<ubyte> &vec) const;
+
+    // If the cmds starting at "start" form a complete upload of one
+    // square, returns the end of those cmds; otherwise returns "start".
+    std::vector<Cmd>::const_iterator findSquareUpload(std::vector<Cmd>::const_iterator start, bool unseen) const;
+
+    // Encodings of "cmds" made by appendDungeonViewCmds so far, for
+    // each different starting square_seen state (and compact flag).
+    // Cleared whenever cmds changes.
+    // The bytes are moved into "shared" if they are passed to a
+    // ByteChain (shared slices must not change afterwards).
+    struct EncodedCmds {
+        bool compact;
+        std::vector<SquareState> seen_before, seen_after;
+        std::vector<ubyte> bytes;
+        Coercri::ByteChain::Slice shared;
+    };
+    std::vector<EncodedCmds> encoded_cmds;
+
+    // Returns the encoding of "cmds" for the given observer (null if
+    // there are no cmds), and updates that observer's square_seen state.
+    EncodedCmds * getEncodedCmds(int observer_num, int client_version);
 };
 
 #endif
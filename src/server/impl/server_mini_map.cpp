@@ -25,15 +25,22 @@
 
 #include "protocol.hpp"
 #include "server_mini_map.hpp"
+#include "version.hpp"
 
 #include "network/byte_buf.hpp"  // coercri
 
+#include <algorithm>
+
+namespace {
+    const int NUM_REPEATS = 2;
+    const int REPEAT_INTERVAL = 50;
+}
+
 void ServerMiniMap::setSize(int width, int height)
 {
-    Coercri::OutputByteBuf buf(out);
-    buf.writeUbyte(SERVER_SET_MAP_SIZE);
-    buf.writeUbyte(width);
-    buf.writeUbyte(height);
+    size_pending = true;
+    pending_width = width;
+    pending_height = height;
 }
 
 void ServerMiniMap::setColour(int x, int y, MiniMapColour col)
@@ -82,11 +89,96 @@ void ServerMiniMap::mapKnightLocation(int n, int x, int y)
         it->second.x = x;
         it->second.y = y;
     }
-    
-    Coercri::OutputByteBuf buf(out);
+
+    KtLocn &k = pending_kt_locn[n];
+    k.x = x;
+    k.y = y;
+
+    KtRepeat &r = kt_repeats[n];
+    r.repeats_left = NUM_REPEATS;
+    r.wait = REPEAT_INTERVAL;
+    r.due = false;
+}
+
+void ServerMiniMap::advanceTime(int time_delta)
+{
+    for (std::map<int, KtRepeat>::iterator it = kt_repeats.begin(); it != kt_repeats.end(); ) {
+        KtRepeat &r = it->second;
+        if (r.repeats_left == 0) {
+            // (The last repeat went out in the previous update.)
+            kt_repeats.erase(it++);
+            continue;
+        }
+        r.wait -= time_delta;
+        if (r.wait <= 0) {
+            r.due = true;
+            r.wait = REPEAT_INTERVAL;
+            --r.repeats_left;
+        }
+        ++it;
+    }
+}
+
+void ServerMiniMap::mapItemLocation(int x, int y, bool on)
+{
+    pending_item_locn[std::make_pair(x, y)] = on;
+}
+
+void ServerMiniMap::appendMiniMapCmds(int client_version, bool knight_locations, std::vector<ubyte> &vec) const
+{
+    Coercri::OutputByteBuf buf(vec);
+
+    // The size must go first, as the client ignores squares and
+    // locations outside the map.
+    if (size_pending) {
+        buf.writeUbyte(SERVER_SET_MAP_SIZE);
+        buf.writeUbyte(pending_width);
+        buf.writeUbyte(pending_height);
+    }
+
+    if (!mini_map_runs.empty()) {
+        if (client_version >= PACKED_MINI_MAP_VERSION_NUM) {
+            appendPackedColours(buf);
+        } else {
+            appendColourRuns(buf);
+        }
+    }
+
+    if (knight_locations) {
+        for (std::map<int, KtLocn>::const_iterator it = pending_kt_locn.begin(); it != pending_kt_locn.end(); ++it) {
+            appendKnightLocation(buf, it->first, it->second.x, it->second.y);
+        }
+    }
+
+    for (std::map<std::pair<int,int>, bool>::const_iterator it = pending_item_locn.begin(); it != pending_item_locn.end(); ++it) {
+        buf.writeUbyte(SERVER_MAP_ITEM_LOCATION);
+        buf.writeUbyte(it->first.first);
+        buf.writeUbyte(it->first.second);
+        buf.writeUbyte(it->second);
+    }
+}
+
+void ServerMiniMap::appendKnightLocationCmds(std::vector<ubyte> &vec) const
+{
+    // (prev_kt_locn already includes the pending changes.)
+    Coercri::OutputByteBuf buf(vec);
+    for (std::map<int, KtLocn>::const_iterator it = prev_kt_locn.begin(); it != prev_kt_locn.end(); ++it) {
+        bool send = keyframe_pending || pending_kt_locn.find(it->first) != pending_kt_locn.end();
+        if (!send) {
+            std::map<int, KtRepeat>::const_iterator r = kt_repeats.find(it->first);
+            send = r != kt_repeats.end() && r->second.due;
+        }
+        if (send) {
+            appendKnightLocation(buf, it->first, it->second.x, it->second.y);
+        }
+    }
+}
+
+void ServerMiniMap::appendKnightLocation(Coercri::OutputByteBuf &buf, int n, int x, int y)
+{
     buf.writeUbyte(SERVER_MAP_KNIGHT_LOCATION);
     buf.writeUbyte(n);
-    if (x<0) {
+    if (x < 0) {
         buf.writeUbyte(255);
     } else {
         buf.writeUbyte(x);
@@ -94,30 +186,103 @@ void ServerMiniMap::mapKnightLocation(int n, int x, int y)
     }
 }
 
-void ServerMiniMap::mapItemLocation(int x, int y, bool on)
+void ServerMiniMap::appendColourRuns(Coercri::OutputByteBuf &buf) const
 {
-    Coercri::OutputByteBuf buf(out);
-    buf.writeUbyte(SERVER_MAP_ITEM_LOCATION);
-    buf.writeUbyte(x);
-    buf.writeUbyte(y);
-    buf.writeUbyte(on);
+    buf.writeUbyte(SERVER_SET_COLOUR);
+    buf.writeVarInt(mini_map_runs.size());
+    for (std::vector<MiniMapRun>::const_iterator it = mini_map_runs.begin(); it != mini_map_runs.end(); ++it) {
+        buf.writeUbyte(it->start_x);
+        buf.writeUbyte(it->y);
+        buf.writeUbyte(it->cols.size());
+        for (size_t i = 0; i < it->cols.size(); ++i) {
+            buf.writeUbyte(it->cols[i]);
+        }
+    }
 }
 
-void ServerMiniMap::appendMiniMapCmds(std::vector<ubyte> &vec) const
+void ServerMiniMap::appendPackedColours(Coercri::OutputByteBuf &buf) const
 {
-    if (!mini_map_runs.empty()) {
-        Coercri::OutputByteBuf buf(vec);
-        buf.writeUbyte(SERVER_SET_COLOUR);
-        buf.writeVarInt(mini_map_runs.size());
-        for (std::vector<MiniMapRun>::const_iterator it = mini_map_runs.begin(); it != mini_map_runs.end(); ++it) {
-            buf.writeUbyte(it->start_x);
-            buf.writeUbyte(it->y);
-            buf.writeUbyte(it->cols.size());
-            for (size_t i = 0; i < it->cols.size(); ++i) {
-                // TODO: could compress even more (each square would fit
-                // into 2 bits) but we'll just use one byte per square...
-                buf.writeUbyte(it->cols[i]);
+    // The runs are gathered into rectangular blocks. Squares inside a
+    // block that were not set are sent as PACKED_COL_UNCHANGED, so a
+    // block can cover several separate runs (e.g. the walls that Magic
+    // Mapping sets, which are mostly short runs with gaps between
+    // them). Each run is added to the last block unless starting a
+    // new block would cost fewer bytes. (Only the last block is
+    // considered, so the runs are still applied in order.)
+    struct Block {
+        int x0, y0, x1, y1;   // x1, y1 are exclusive
+        std::vector<MiniMapRun>::const_iterator first, last;   // runs [first, last)
+        int cost() const { return 4 + ((x1 - x0) * (y1 - y0) + 3) / 4; }
+    };
+    std::vector<Block> blocks;
+    for (std::vector<MiniMapRun>::const_iterator it = mini_map_runs.begin(); it != mini_map_runs.end(); ++it) {
+        Block b;
+        b.x0 = it->start_x;
+        b.y0 = it->y;
+        b.x1 = it->start_x + int(it->cols.size());
+        b.y1 = it->y + 1;
+        b.first = it;
+        b.last = it + 1;
+
+        if (!blocks.empty()) {
+            const Block &prev = blocks.back();
+            Block merged = prev;
+            merged.x0 = std::min(prev.x0, b.x0);
+            merged.y0 = std::min(prev.y0, b.y0);
+            merged.x1 = std::max(prev.x1, b.x1);
+            merged.y1 = std::max(prev.y1, b.y1);
+            merged.last = b.last;
+            if (merged.x1 - merged.x0 <= 255 && merged.y1 - merged.y0 <= 255
+            && merged.cost() - prev.cost() <= b.cost()) {
+                blocks.back() = merged;
+                continue;
+            }
+        }
+        blocks.push_back(b);
+    }
+
+    buf.writeUbyte(SERVER_SET_COLOURS_PACKED);
+    buf.writeVarInt(blocks.size());
+    std::vector<ubyte> cols;
+    for (std::vector<Block>::const_iterator b = blocks.begin(); b != blocks.end(); ++b) {
+        const int width = b->x1 - b->x0;
+        const int height = b->y1 - b->y0;
+        buf.writeUbyte(b->x0);
+        buf.writeUbyte(b->y0);
+        buf.writeUbyte(width);
+        buf.writeUbyte(height);
+
+        // Later runs overwrite earlier ones, as they would on the client.
+        cols.assign(width * height, PACKED_COL_UNCHANGED);
+        for (std::vector<MiniMapRun>::const_iterator run = b->first; run != b->last; ++run) {
+            const int row = (run->y - b->y0) * width + run->start_x - b->x0;
+            for (size_t i = 0; i < run->cols.size(); ++i) {
+                cols[row + i] = run->cols[i] - COL_WALL;
             }
         }
+
+        // Colours are packed four to a byte, lowest bits first.
+        int byte = 0, shift = 0;
+        for (std::vector<ubyte>::const_iterator c = cols.begin(); c != cols.end(); ++c) {
+            byte |= *c << shift;
+            shift += 2;
+            if (shift == 8) {
+                buf.writeUbyte(byte);
+                byte = shift = 0;
+            }
+        }
+        if (shift != 0) buf.writeUbyte(byte);
+    }
+}
+
+void ServerMiniMap::clearMiniMapCmds()
+{
+    mini_map_runs.clear();
+    size_pending = false;
+    pending_kt_locn.clear();
+    pending_item_locn.clear();
+    keyframe_pending = false;
+    for (std::map<int, KtRepeat>::iterator it = kt_repeats.begin(); it != kt_repeats.end(); ++it) {
+        it->second.due = false;
     }
 }
@@ -29,13 +29,27 @@
 #include <map>
 #include <vector>
 
+namespace Coercri {
+    class OutputByteBuf;
+}
+
 class ServerMiniMap : public MiniMap {
 public:
     typedef unsigned char ubyte;
-    explicit ServerMiniMap(std::vector<ubyte> &out_) : out(out_) { }
+    explicit ServerMiniMap(std::vector<ubyte> &out_) : out(out_), size_pending(false), keyframe_pending(false) { }
+
+    // Appends the cmds queued during this update, encoded for the given client version.
+    // If knight_locations is false, the knight locations are left out
+    // (they go on the unreliable channel instead, see below).
+    void appendMiniMapCmds(int client_version, bool knight_locations, std::vector<ubyte> &vec) const;
+
+    // Appends the knight locations for the unreliable channel: the
+    // ones that changed during this update, and any repeats that are
+    // due (see advanceTime), or all of them if queueKnightLocations
+    // was called.
+    void appendKnightLocationCmds(std::vector<ubyte> &vec) const;
 
-    void appendMiniMapCmds(std::vector<ubyte> &vec) const;
-    void clearMiniMapCmds() { mini_map_runs.clear(); }
+    void clearMiniMapCmds();
     
     virtual void setSize(int width, int height) override;
     virtual void setColour(int x, int y, MiniMapColour col) override;
@@ -45,6 +59,22 @@ public:
 
     void prepareForCatchUp() { prev_kt_locn.clear(); }
 
+    // Send all known knight locations on the unreliable channel
+    // with the next cmds (even if none of them has changed).
+    void queueKnightLocations() { keyframe_pending = true; }
+
+    // On the unreliable channel, each changed knight location is
+    // repeated NUM_REPEATS times, REPEAT_INTERVAL ms apart, so that
+    // if it is lost, the client is corrected soon after (sooner than
+    // a reliable channel would re-send it). This should be called
+    // once per update, before the cmds are appended.
+    void advanceTime(int time_delta);
+
+private:
+    static void appendKnightLocation(Coercri::OutputByteBuf &buf, int n, int x, int y);
+    void appendColourRuns(Coercri::OutputByteBuf &buf) const;
+    void appendPackedColours(Coercri::OutputByteBuf &buf) const;
+
 private:
     std::vector<ubyte> &out;
 
@@ -55,12 +85,27 @@ private:
     };
     std::vector<MiniMapRun> mini_map_runs;
 
-    // caching
+    // Size and location changes are only sent once per update (the
+    // last value wins).
+    bool size_pending;
+    int pending_width, pending_height;
     struct KtLocn {
         int x;
         int y;
     };
+    std::map<int, KtLocn> pending_kt_locn;
+    std::map<std::pair<int, int>, bool> pending_item_locn;
+    bool keyframe_pending;
+
+    // caching
     std::map<int, KtLocn> prev_kt_locn;
+
+    struct KtRepeat {
+        int repeats_left;
+        int wait;   // ms until the next repeat
+        bool due;   // repeat in this update
+    };
+    std::map<int, KtRepeat> kt_repeats;
 };
 
 #endif
@@ -35,6 +35,7 @@
 
 #include "game_info.hpp"
 
+#include "network/byte_buf.hpp"  // coercri
 #include "timer/timer.hpp"  // coercri
 
 #include "boost/shared_ptr.hpp"
@@ -42,6 +43,7 @@
 #include <memory>
 #include <vector>
 
+class GameScheduler;
 class KnightsConfig;
 class KnightsLog;
 class KnightsServerImpl;
@@ -75,6 +77,21 @@ public:
     // Caller is responsible for making sure this data is sent to the client.
     void getOutputData(ServerConnection &conn, std::vector<ubyte> &data);
 
+    // As above, but the data is returned as a ByteChain. Output that is
+    // shared between several clients (e.g. observers) is then passed
+    // by reference instead of being copied, so it can be gathered
+    // straight into a network packet (see NetworkConnection::send).
+    void getOutputData(ServerConnection &conn, Coercri::ByteChain &data);
+
+    // If the transport has an unreliable (sequenced) channel, call
+    // enableUnreliableOutput just after newClientConnection. Some
+    // messages (see protocol.hpp) are then returned by
+    // getUnreliableOutputData, instead of getOutputData, and should
+    // be sent on the unreliable channel, as a single packet.
+    // (Any existing contents of 'data' are replaced.)
+    void enableUnreliableOutput(ServerConnection &conn);
+    void getUnreliableOutputData(ServerConnection &conn, std::vector<ubyte> &data);
+
     // Call this when a client disconnects
     void connectionClosed(ServerConnection &conn);
 
@@ -116,6 +133,17 @@ public:
     // not (currently) propagated to existing KnightsGames when this is called.
     void setKnightsLog(KnightsLog *);
 
+
+    //
+    // Threading
+    //
+
+    // By default each running game gets its own update thread. If a
+    // GameScheduler is set, games are instead run on the scheduler's
+    // (shared) worker threads. As with setKnightsLog, this only
+    // affects games created after the call.
+    void setGameScheduler(boost::shared_ptr<GameScheduler> scheduler);
+
     
 private:
     std::unique_ptr<KnightsServerImpl> pimpl;
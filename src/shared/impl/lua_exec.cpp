@@ -46,6 +46,21 @@ namespace {
         lua_pushstring(lua, result.c_str());
         return 1;
     }
+
+    // Registry key for the error handler. This is created once per
+    // lua_State, rather than on every LuaExec call, because
+    // PushCFunction has to register a new wrapper each time.
+    const char g_err_func_key = 0;
+
+    void PushErrFunc(lua_State *lua)
+    {
+        if (lua_rawgetp(lua, LUA_REGISTRYINDEX, &g_err_func_key) != LUA_TFUNCTION) {  // [x]
+            lua_pop(lua, 1);                                         // []
+            PushCFunction(lua, &LuaExecErrFunc);                     // [errfunc]
+            lua_pushvalue(lua, -1);                                  // [errfunc errfunc]
+            lua_rawsetp(lua, LUA_REGISTRYINDEX, &g_err_func_key);    // [errfunc]
+        }
+    }
 }
 
 void LuaExec(lua_State *lua, int nargs, int nresults)
@@ -64,7 +79,7 @@ void LuaExec(lua_State *lua, int nargs, int nresults)
     // We need to insert our error handling function so that the stack looks like this:
     // [<stuff> errfunc func arg1 ... argn]
 
-    PushCFunction(lua, &LuaExecErrFunc);
+    PushErrFunc(lua);
     lua_insert(lua, -(2 + nargs));
     
     // now we can do the call